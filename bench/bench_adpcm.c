@@ -0,0 +1,193 @@
+// ADPCM storage, what it saves and what it costs:
+//   ratio     - every WAV and MP3 in a folder encoded as it would be for
+//               "storage": "adpcm": PCM and ADPCM bytes and the
+//               signal-to-noise ratio of the round trip
+//   decode    - adpcm_decode_block() alone, per block and per sample
+//   mix       - mixer_render() with N looping voices stored as PCM and as
+//               ADPCM; the difference is the decode cost per voice per block
+//   polyphony - voices of each kind that fit in CPU_BUDGET_PERCENT of one
+//               core, from the cost per voice at the largest voice count
+//
+//   bench_adpcm [folder (default sounds)] [milliseconds per measurement]
+
+#include "bench_common.h"
+#include "adpcm.h"
+#include "audio_loader.h"
+#include "mixer.h"
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define SAMPLE_RATE 44100
+#define DEFAULT_FOLDER "sounds"
+#define DEFAULT_MS 200
+#define TONE_FRAMES SAMPLE_RATE
+#define BLOCK MIXER_BLOCK_FRAMES
+#define CPU_BUDGET_PERCENT 25
+
+static const size_t voice_counts[] = {1, 16, 64, 256};
+#define VOICE_CONFIGS (sizeof(voice_counts) / sizeof(voice_counts[0]))
+
+static int16_t tone[TONE_FRAMES];
+static uint8_t *tone_adpcm;
+static int16_t output[BLOCK];
+
+static bool is_audio(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot != NULL && (strcasecmp(dot, ".wav") == 0 || strcasecmp(dot, ".mp3") == 0);
+}
+
+// Signal-to-noise ratio of decoding blocks against the samples they encode
+static double round_trip_snr(const int16_t *samples, size_t count, const uint8_t *blocks) {
+    int16_t decoded[ADPCM_BLOCK_FRAMES];
+    double signal = 0.0, noise = 0.0;
+    for (size_t start = 0; start < count; start += ADPCM_BLOCK_FRAMES) {
+        size_t frames = count - start < ADPCM_BLOCK_FRAMES ? count - start : ADPCM_BLOCK_FRAMES;
+        adpcm_decode_block(blocks + start / ADPCM_BLOCK_FRAMES * ADPCM_BLOCK_BYTES, decoded, frames);
+        for (size_t i = 0; i < frames; i++) {
+            double error = (double)decoded[i] - samples[start + i];
+            signal += (double)samples[start + i] * samples[start + i];
+            noise += error * error;
+        }
+    }
+    return noise > 0.0 ? 10.0 * log10(signal / noise) : INFINITY;
+}
+
+static int report_ratios(const char *folder) {
+    DIR *dir = opendir(folder);
+    if (dir == NULL) {
+        fprintf(stderr, "bench_adpcm: can't open %s\n", folder);
+        return -1;
+    }
+
+    printf("adpcm: %s\n", folder);
+    size_t pcm_total = 0, adpcm_total = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!is_audio(entry->d_name)) {
+            continue;
+        }
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", folder, entry->d_name);
+        audio_data_t audio = {0};
+        int saved = bench_mute();
+        int loaded = audio_load_file(path, &audio);
+        bench_unmute(saved);
+        uint8_t *blocks;
+        if (loaded != 0 || adpcm_encode(audio.data, audio.sample_count, &blocks) != 0) {
+            fprintf(stderr, "bench_adpcm: can't load and encode %s\n", path);
+            audio_free(&audio);
+            continue;
+        }
+
+        size_t pcm = audio.sample_count * sizeof(int16_t);
+        size_t adpcm = adpcm_encoded_size(audio.sample_count);
+        pcm_total += pcm;
+        adpcm_total += adpcm;
+        printf("  %-48.48s %8zu -> %7zu bytes (%.2fx)  SNR %5.1f dB\n", entry->d_name, pcm, adpcm,
+               (double)pcm / adpcm, round_trip_snr(audio.data, audio.sample_count, blocks));
+        free(blocks);
+        audio_free(&audio);
+    }
+    closedir(dir);
+    if (adpcm_total > 0) {
+        printf("  %-48s %8zu -> %7zu bytes (%.2fx)\n", "total", pcm_total, adpcm_total,
+               (double)pcm_total / adpcm_total);
+    }
+    return 0;
+}
+
+// ns per decoded block
+static double measure_decode(uint64_t budget_ns) {
+    int16_t decoded[ADPCM_BLOCK_FRAMES];
+    size_t block_count = TONE_FRAMES / ADPCM_BLOCK_FRAMES;
+    size_t blocks = 0;
+    int32_t sink = 0;
+    uint64_t start = clock_now_ns();
+    do {
+        adpcm_decode_block(tone_adpcm + blocks % block_count * ADPCM_BLOCK_BYTES, decoded, ADPCM_BLOCK_FRAMES);
+        sink += decoded[blocks % ADPCM_BLOCK_FRAMES];
+        blocks++;
+    } while (blocks % 64 != 0 || clock_now_ns() - start < budget_ns);
+    double ns = (double)(clock_now_ns() - start) / (double)blocks;
+    return sink == INT32_MIN ? 0.0 : ns; // Keeps the decode from being optimised away
+}
+
+// ns per render block with that many looping voices of one kind
+static double measure_render(size_t voices, bool adpcm, uint64_t budget_ns) {
+    if (mixer_init(SAMPLE_RATE, voices, VOICE_STEAL_OLDEST) != 0) {
+        return 0.0;
+    }
+    size_t length = TONE_FRAMES - 4096;
+    for (size_t v = 0; v < voices; v++) {
+        float gain = 0.5f / (float)voices;
+        if (adpcm) {
+            // Offsets on block boundaries, as a retrigger would land
+            size_t offset = (v * 997) % 4096 / ADPCM_BLOCK_FRAMES;
+            mixer_start_adpcm(tone_adpcm + offset * ADPCM_BLOCK_BYTES, length, 0, gain, true, false);
+        } else {
+            mixer_start_voice(tone + (v * 997) % 4096, length, 0, gain, true, false);
+        }
+    }
+    mixer_render(output, BLOCK); // Applies the starts
+
+    uint64_t start = clock_now_ns();
+    uint64_t blocks = 0;
+    do {
+        mixer_render(output, BLOCK);
+        blocks++;
+    } while (clock_now_ns() - start < budget_ns);
+    double ns = (double)(clock_now_ns() - start) / (double)blocks;
+    mixer_cleanup();
+    return ns;
+}
+
+int main(int argc, char *argv[]) {
+    const char *folder = argc > 1 ? argv[1] : DEFAULT_FOLDER;
+    uint64_t budget_ns = (uint64_t)(argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_MS) * 1000000ull;
+
+    if (report_ratios(folder) != 0) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < TONE_FRAMES; i++) {
+        tone[i] = (int16_t)(20000.0 * sin(2.0 * 3.14159265358979 * 440.0 * (double)i / SAMPLE_RATE));
+    }
+    if (adpcm_encode(tone, TONE_FRAMES, &tone_adpcm) != 0) {
+        return 1;
+    }
+
+    double decode_ns = measure_decode(budget_ns);
+    printf("adpcm: decode %.0f ns per %d-frame block (%.2f ns per sample)\n",
+           decode_ns, ADPCM_BLOCK_FRAMES, decode_ns / ADPCM_BLOCK_FRAMES);
+
+    // Measured first: mixer_init() prints, and would split the table
+    double results[VOICE_CONFIGS][2];
+    int saved = bench_mute();
+    for (size_t i = 0; i < VOICE_CONFIGS; i++) {
+        results[i][0] = measure_render(voice_counts[i], false, budget_ns);
+        results[i][1] = measure_render(voice_counts[i], true, budget_ns);
+    }
+    bench_unmute(saved);
+
+    printf("adpcm: ns per %d-frame render block (ns per voice per block)\n", BLOCK);
+    printf("  %6s  %22s  %22s  %16s\n", "voices", "PCM", "ADPCM", "decode per voice");
+    for (size_t i = 0; i < VOICE_CONFIGS; i++) {
+        double voices = (double)voice_counts[i];
+        printf("  %6zu  %10.0f (%9.1f)  %10.0f (%9.1f)  %16.1f\n", voice_counts[i],
+               results[i][0], results[i][0] / voices, results[i][1], results[i][1] / voices,
+               (results[i][1] - results[i][0]) / voices);
+    }
+
+    double block_ns = (double)BLOCK * 1e9 / SAMPLE_RATE;
+    double cpu_ns = block_ns * CPU_BUDGET_PERCENT / 100.0;
+    double voices = (double)voice_counts[VOICE_CONFIGS - 1];
+    printf("adpcm: voices in %d%% of one core: PCM %.0f, ADPCM %.0f\n", CPU_BUDGET_PERCENT,
+           cpu_ns / (results[VOICE_CONFIGS - 1][0] / voices), cpu_ns / (results[VOICE_CONFIGS - 1][1] / voices));
+
+    free(tone_adpcm);
+    return 0;
+}
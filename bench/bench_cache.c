@@ -0,0 +1,121 @@
+// Startup with and without the sound-bank cache. Two generated banks are
+// loaded the way the player starts, each in its own child process:
+//   cold - no cache: every file is decoded, then the cache is written
+//   warm - the cache from the cold start is mapped and pads point into it
+// One bank is copies of an MP3 (the decode path the cache exists to skip),
+// the other WAV files, which decode almost for free. Reports wall time and
+// peak RSS; warm starts only fault in the pages that get played.
+//
+//   bench_cache [mp3 file] [copies]
+
+#include "bench_common.h"
+#include "midi_soundboard.h"
+#include "soundbank.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_MP3 "sounds/138049__pakasit21__typewriter.mp3"
+#define DEFAULT_COPIES 20
+#define WAV_FILES 200
+#define WAV_SECONDS 2
+
+static double load_run(void *ctx) {
+    return bench_load_bank(ctx);
+}
+
+// Writes copies of the file at source as the bank's sounds
+static int copy_bank(const config_t *config, const char *source) {
+    FILE *in = fopen(source, "rb");
+    if (in == NULL) {
+        return -1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char *data = size > 0 ? malloc((size_t)size) : NULL;
+    int result = data != NULL && fread(data, 1, (size_t)size, in) == (size_t)size ? 0 : -1;
+    fclose(in);
+
+    for (size_t i = 0; i < config->sound_count && result == 0; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s%s", config->base_path, config->sounds[i].filename);
+        FILE *out = fopen(path, "wb");
+        if (out == NULL) {
+            result = -1;
+            break;
+        }
+        if (fwrite(data, 1, (size_t)size, out) != (size_t)size) {
+            result = -1;
+        }
+        if (fclose(out) != 0) {
+            result = -1;
+        }
+    }
+    free(data);
+    return result;
+}
+
+static int write_tones(const config_t *config, const char *dir) {
+    for (size_t i = 0; i < config->sound_count; i++) {
+        if (bench_write_tone(dir, config->sounds[i].filename, SOUNDBOARD_SAMPLE_RATE,
+                             (size_t)SOUNDBOARD_SAMPLE_RATE * WAV_SECONDS, 220.0 + (double)i) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int start(config_t *config, const char *label) {
+    double ms;
+    size_t peak_kib;
+    if (bench_in_child(load_run, config, &ms, &peak_kib) != 0 || ms < 0) {
+        fprintf(stderr, "bench_cache: %s start failed\n", label);
+        return -1;
+    }
+    printf("    %-5s %9.1f ms  peak RSS %7zu KiB\n", label, ms, peak_kib);
+    return 0;
+}
+
+// Cold start, then warm start from the cache it wrote
+static int run_bank(const char *name, size_t files, const char *extension, const char *source) {
+    char dir[64];
+    config_t config;
+    if (bench_make_dir(dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    if (bench_config(&config, dir, files, extension) != 0) {
+        bench_remove_dir(dir);
+        return -1;
+    }
+
+    int result = source != NULL ? copy_bank(&config, source) : write_tones(&config, dir);
+    if (result != 0) {
+        fprintf(stderr, "bench_cache: can't write the %s bank\n", name);
+    }
+    if (result == 0) {
+        printf("  %s: %zu file(s)\n", name, files);
+        result = start(&config, "cold");
+    }
+    if (result == 0) {
+        result = start(&config, "warm");
+    }
+
+    config_free(&config);
+    bench_remove_dir(dir);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    const char *mp3 = argc > 1 ? argv[1] : DEFAULT_MP3;
+    size_t copies = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_COPIES;
+    if (copies == 0 || copies > 11 * BENCH_NOTES_PER_PAGE) {
+        fprintf(stderr, "Usage: %s [mp3 file] [copies (1-%d)]\n", argv[0], 11 * BENCH_NOTES_PER_PAGE);
+        return 2;
+    }
+
+    printf("cache: cold start decodes and writes %s, warm start maps it\n", SOUNDBANK_CACHE_NAME);
+    if (run_bank(mp3, copies, "mp3", mp3) != 0) {
+        return 1;
+    }
+    return run_bank("generated WAV, 2 s each", WAV_FILES, "wav", NULL) == 0 ? 0 : 1;
+}
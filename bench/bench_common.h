@@ -0,0 +1,195 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include "bank_loader.h"
+#include "config.h"
+#include "midi_soundboard.h"
+#include "monotonic_clock.h"
+#include "page_residency.h"
+#include "wav_writer.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Helpers for the programs under bench/ that load whole banks: a throwaway
+// sounds folder of generated WAV files, a config that maps them to pads,
+// and a way to run a load in a child process so its peak resident set size
+// is measured on its own.
+
+#define BENCH_NOTES_PER_PAGE 100
+
+// Creates an empty folder under /tmp; path gets its name
+static inline int bench_make_dir(char *path, size_t size) {
+    snprintf(path, size, "/tmp/soundboard_bench_XXXXXX");
+    return mkdtemp(path) == NULL ? -1 : 0;
+}
+
+// Deletes the files in dir, then dir itself (the folder is flat)
+static inline void bench_remove_dir(const char *dir) {
+    DIR *handle = opendir(dir);
+    if (handle != NULL) {
+        struct dirent *entry;
+        char path[1024];
+        while ((entry = readdir(handle)) != NULL) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(handle);
+    }
+    rmdir(dir);
+}
+
+static inline void bench_remove_file(const char *dir, const char *name) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+// Writes a mono sine of frames samples at rate to dir/name
+static inline int bench_write_tone(const char *dir, const char *name, uint32_t rate, size_t frames, double hz) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    wav_writer_t wav;
+    if (wav_writer_open(&wav, path, rate) != 0) {
+        return -1;
+    }
+
+    int16_t block[1024];
+    size_t written = 0;
+    while (written < frames) {
+        size_t count = frames - written < 1024 ? frames - written : 1024;
+        for (size_t i = 0; i < count; i++) {
+            block[i] = (int16_t)(8000.0 * sin(2.0 * 3.14159265358979 * hz * (double)(written + i) / rate));
+        }
+        if (wav_writer_write(&wav, block, count) != 0) {
+            wav_writer_close(&wav);
+            return -1;
+        }
+        written += count;
+    }
+    return wav_writer_close(&wav);
+}
+
+// A config with count sounds named 000.<extension>, 001.<extension>, ...
+// in dir, laid out BENCH_NOTES_PER_PAGE to a page. Every page is loaded,
+// nothing is streamed and there is no memory budget; callers change what
+// they measure.
+static inline int bench_config(config_t *config, const char *dir, size_t count, const char *extension) {
+    config_init(config);
+    config->sounds = calloc(count, sizeof(*config->sounds));
+    config->base_path = malloc(strlen(dir) + 2);
+    if (config->sounds == NULL || config->base_path == NULL) {
+        config_free(config);
+        return -1;
+    }
+    sprintf(config->base_path, "%s/", dir);
+    config->stream_threshold_seconds = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        sound_config_t *sound = &config->sounds[i];
+        char name[32];
+        snprintf(name, sizeof(name), "%03zu.%s", i, extension);
+        sound->filename = strdup(name);
+        if (sound->filename == NULL) {
+            config_free(config);
+            return -1;
+        }
+        config->sound_count = i + 1;
+        sound->page = (uint8_t)(i / BENCH_NOTES_PER_PAGE);
+        sound->note = (uint8_t)(i % BENCH_NOTES_PER_PAGE);
+        sound->mode = SOUND_MODE_ONESHOT;
+        sound->stream = STREAM_NEVER;
+    }
+    return 0;
+}
+
+// Sends stdout (the loader's per-sound lines) to /dev/null until
+// bench_unmute(); returns the descriptor to restore
+static inline int bench_mute(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+    return saved;
+}
+
+static inline void bench_unmute(int saved) {
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+// Loads every page of config the way the player does at startup and
+// returns the wall time in ms (negative on failure)
+static inline double bench_load_bank(const config_t *config) {
+    if (soundboard_init(config) != 0) {
+        return -1.0;
+    }
+    uint64_t start = clock_now_ns();
+    double result = -1.0;
+    if (page_residency_start(config) == 0) {
+        bank_loader_wait();
+        page_residency_poll();
+        result = (clock_now_ns() - start) / 1e6;
+    }
+    bank_loader_cancel();
+    soundboard_cleanup();
+    bank_loader_cleanup();
+    return result;
+}
+
+// Runs fn(ctx) in a child process with its stdout (the loader's per-sound
+// lines) discarded. The value it returns comes back in *value and the
+// child's peak RSS in *peak_kib. Returns 0 if the child ran and exited
+// cleanly. Call it before the parent touches much memory: pages shared
+// with the parent count towards the child's RSS.
+static inline int bench_in_child(double (*fn)(void *ctx), void *ctx, double *value, size_t *peak_kib) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        bench_mute();
+        double result = fn(ctx);
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], value, sizeof(*value));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return -1;
+    }
+#ifdef __APPLE__
+    *peak_kib = (size_t)usage.ru_maxrss / 1024; // Bytes on Darwin
+#else
+    *peak_kib = (size_t)usage.ru_maxrss;        // KiB on Linux
+#endif
+    return got == (ssize_t)sizeof(*value) && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,83 @@
+// Decode throughput: every WAV and MP3 file in a folder is decoded from
+// start to end with the streaming decoder audio_load_file() is built on,
+// repeatedly, as the bank loader does for a sound that is not in the
+// cache. Reports decoded frames per second and how many times faster than
+// real time that is.
+//
+//   bench_decode [folder (default sounds)] [milliseconds per file]
+
+#include "audio_loader.h"
+#include "monotonic_clock.h"
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define DEFAULT_FOLDER "sounds"
+#define DEFAULT_MS 300
+#define READ_FRAMES 4096
+
+static bool is_audio(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot != NULL && (strcasecmp(dot, ".wav") == 0 || strcasecmp(dot, ".mp3") == 0);
+}
+
+// Returns 0 and prints one line if the file decodes
+static int bench_file(const char *path, const char *name, uint64_t budget_ns) {
+    size_t frames = 0;
+    size_t loads = 0;
+    uint32_t rate = 0;
+    uint64_t start = clock_now_ns();
+    uint64_t elapsed;
+    static int16_t buffer[READ_FRAMES];
+    do {
+        audio_decoder_t *decoder;
+        audio_stream_info_t info;
+        if (audio_decoder_open(path, &decoder, &info) != 0) {
+            return -1;
+        }
+        size_t count;
+        while ((count = audio_decoder_read(decoder, buffer, READ_FRAMES)) > 0) {
+            frames += count;
+        }
+        audio_decoder_close(decoder);
+        rate = info.sample_rate;
+        loads++;
+        elapsed = clock_now_ns() - start;
+    } while (elapsed < budget_ns);
+
+    double per_second = frames / (elapsed / 1e9);
+    printf("  %-48.48s %8.2f ms/load  %7.2f Mframes/s  (%.0fx real time)\n",
+           name, elapsed / 1e6 / loads, per_second / 1e6, rate > 0 ? per_second / rate : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *folder = argc > 1 ? argv[1] : DEFAULT_FOLDER;
+    uint64_t budget_ns = (argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_MS) * 1000000ull;
+
+    DIR *dir = opendir(folder);
+    if (dir == NULL) {
+        fprintf(stderr, "bench_decode: can't open %s\n", folder);
+        return 1;
+    }
+
+    printf("decode: %s\n", folder);
+    int failures = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!is_audio(entry->d_name)) {
+            continue;
+        }
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", folder, entry->d_name);
+        if (bench_file(path, entry->d_name, budget_ns) != 0) {
+            fprintf(stderr, "bench_decode: failed to decode %s\n", path);
+            failures++;
+        }
+    }
+    closedir(dir);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// Peak memory of a bank load: generated banks of 44.1 kHz WAV files are
+// loaded the way the player does at startup, each in its own child
+// process, and the child's peak RSS is compared with the decoded PCM the
+// bank holds. The soundboard adopts each decoded buffer, so the growth
+// over an empty soundboard should stay close to one copy of the PCM; a
+// ratio near 2 means every sound was copied while loading.
+//
+//   bench_load [seconds per file]
+
+#include "bench_common.h"
+#include "midi_soundboard.h"
+#include "soundbank.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_SECONDS 2
+
+static const size_t bank_sizes[] = {25, 100, 400};
+
+static double load_run(void *ctx) {
+    return bench_load_bank(ctx);
+}
+
+// The same process with nothing loaded
+static double empty_run(void *ctx) {
+    if (soundboard_init(ctx) != 0) {
+        return -1.0;
+    }
+    soundboard_cleanup();
+    return 0.0;
+}
+
+static int load_bank(size_t files, size_t seconds, size_t baseline_kib) {
+    char dir[64];
+    config_t config;
+    if (bench_make_dir(dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    if (bench_config(&config, dir, files, "wav") != 0) {
+        bench_remove_dir(dir);
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < files && result == 0; i++) {
+        result = bench_write_tone(dir, config.sounds[i].filename, SOUNDBOARD_SAMPLE_RATE,
+                                  (size_t)SOUNDBOARD_SAMPLE_RATE * seconds, 220.0 + (double)i);
+    }
+
+    double ms;
+    size_t peak_kib;
+    if (result == 0 && (bench_in_child(load_run, &config, &ms, &peak_kib) != 0 || ms < 0)) {
+        result = -1;
+    }
+    if (result == 0) {
+        size_t pcm_kib = files * seconds * SOUNDBOARD_SAMPLE_RATE * sizeof(int16_t) / 1024;
+        size_t growth_kib = peak_kib > baseline_kib ? peak_kib - baseline_kib : 0;
+        printf("  %4zu file(s)  PCM %7zu KiB  peak RSS %7zu KiB  growth %7zu KiB (%.2fx PCM)  %8.1f ms\n",
+               files, pcm_kib, peak_kib, growth_kib, (double)growth_kib / (double)pcm_kib, ms);
+    } else {
+        fprintf(stderr, "bench_load: loading %zu file(s) failed\n", files);
+    }
+
+    config_free(&config);
+    bench_remove_dir(dir);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    size_t seconds = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_SECONDS;
+    if (seconds == 0) {
+        fprintf(stderr, "Usage: %s [seconds per file]\n", argv[0]);
+        return 2;
+    }
+
+    config_t empty;
+    config_init(&empty);
+    double unused;
+    size_t baseline_kib;
+    if (bench_in_child(empty_run, &empty, &unused, &baseline_kib) != 0) {
+        fprintf(stderr, "bench_load: can't start the soundboard\n");
+        return 1;
+    }
+
+    printf("load: %zu s per file, %zu KiB peak RSS with nothing loaded\n", seconds, baseline_kib);
+    for (size_t i = 0; i < sizeof(bank_sizes) / sizeof(bank_sizes[0]); i++) {
+        if (load_bank(bank_sizes[i], seconds, baseline_kib) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Mixing cost per output sample at 1, 10, 64 and 256 voices:
+//   render   - mixer_render() with N looping voices (the whole render path)
+//   kernel   - mixer_accumulate_gain() per voice plus one mixer_saturate()
+//   per-add  - scalar reference that clips after every voice add, with the
+//              end-of-sample check inside the loop, as mix_audio() used to
+//
+//   bench_mix [milliseconds per measurement]
+
+#include "mixer.h"
+#include "monotonic_clock.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_RATE 44100
+#define TONE_FRAMES SAMPLE_RATE
+#define BLOCK MIXER_BLOCK_FRAMES
+#define DEFAULT_MS 200
+
+static const size_t voice_counts[] = {1, 10, 64, 256};
+
+static int16_t tone[TONE_FRAMES];
+static int16_t output[BLOCK];
+static float bus[BLOCK];
+
+typedef struct {
+    size_t position;
+    float gain;
+} reference_voice_t;
+
+static void mix_per_add(reference_voice_t *voices, size_t count, int16_t *out, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        int32_t acc = 0;
+        for (size_t v = 0; v < count; v++) {
+            reference_voice_t *voice = &voices[v];
+            if (voice->position >= TONE_FRAMES) {
+                voice->position = 0;
+            }
+            acc += (int32_t)((float)tone[voice->position++] * voice->gain);
+            acc = acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc);
+        }
+        out[i] = (int16_t)acc;
+    }
+}
+
+static double measure_render(size_t voices, uint64_t budget_ns) {
+    if (mixer_init(SAMPLE_RATE, voices, VOICE_STEAL_OLDEST) != 0) {
+        return 0.0;
+    }
+    for (size_t v = 0; v < voices; v++) {
+        mixer_start_voice(tone + (v * 997) % 4096, TONE_FRAMES - 4096, 0, 0.5f / (float)voices, true, false);
+        if (v % 64 == 63) {
+            mixer_render(output, BLOCK); // Applies them before the command ring fills
+        }
+    }
+    mixer_render(output, BLOCK); // Applies the starts
+
+    uint64_t start = clock_now_ns();
+    uint64_t frames = 0;
+    do {
+        mixer_render(output, BLOCK);
+        frames += BLOCK;
+    } while (clock_now_ns() - start < budget_ns);
+    double ns = (double)(clock_now_ns() - start) / (double)frames;
+    mixer_cleanup();
+    return ns;
+}
+
+static double measure_kernel(size_t voices, uint64_t budget_ns) {
+    uint64_t start = clock_now_ns();
+    uint64_t frames = 0;
+    size_t position = 0;
+    do {
+        for (size_t i = 0; i < BLOCK; i++) {
+            bus[i] = 0.0f;
+        }
+        for (size_t v = 0; v < voices; v++) {
+            mixer_accumulate_gain(bus, tone + (position + v * 997) % (TONE_FRAMES - BLOCK), BLOCK,
+                                  0.5f / (float)voices);
+        }
+        mixer_saturate(output, bus, BLOCK);
+        position = (position + BLOCK) % TONE_FRAMES;
+        frames += BLOCK;
+    } while (clock_now_ns() - start < budget_ns);
+    return (double)(clock_now_ns() - start) / (double)frames;
+}
+
+static double measure_per_add(size_t voices, uint64_t budget_ns) {
+    reference_voice_t *state = calloc(voices, sizeof(*state));
+    if (!state) {
+        return 0.0;
+    }
+    for (size_t v = 0; v < voices; v++) {
+        state[v].position = (v * 997) % TONE_FRAMES;
+        state[v].gain = 0.5f / (float)voices;
+    }
+    uint64_t start = clock_now_ns();
+    uint64_t frames = 0;
+    do {
+        mix_per_add(state, voices, output, BLOCK);
+        frames += BLOCK;
+    } while (clock_now_ns() - start < budget_ns);
+    free(state);
+    return (double)(clock_now_ns() - start) / (double)frames;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t budget_ns = (uint64_t)(argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MS) * 1000000ull;
+    for (size_t i = 0; i < TONE_FRAMES; i++) {
+        tone[i] = (int16_t)(20000.0 * sin(2.0 * 3.14159265358979 * 440.0 * (double)i / SAMPLE_RATE));
+    }
+
+    // Measured first: mixer_init() prints, and would split the table
+    size_t configs = sizeof(voice_counts) / sizeof(voice_counts[0]);
+    double results[sizeof(voice_counts) / sizeof(voice_counts[0])][3];
+    for (size_t i = 0; i < configs; i++) {
+        results[i][0] = measure_render(voice_counts[i], budget_ns);
+        results[i][1] = measure_kernel(voice_counts[i], budget_ns);
+        results[i][2] = measure_per_add(voice_counts[i], budget_ns);
+    }
+
+    printf("mix: ns per output sample (ns per voice-sample)\n");
+    printf("  %6s  %20s  %20s  %20s\n", "voices", "render", "kernel", "per-add");
+    for (size_t i = 0; i < configs; i++) {
+        double voices = (double)voice_counts[i];
+        printf("  %6zu  %9.2f (%7.3f)  %9.2f (%7.3f)  %9.2f (%7.3f)\n", voice_counts[i],
+               results[i][0], results[i][0] / voices, results[i][1], results[i][1] / voices,
+               results[i][2], results[i][2] / voices);
+    }
+    return 0;
+}
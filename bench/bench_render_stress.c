@@ -0,0 +1,174 @@
+// Render stress: a control thread hammers the mixer's command ring with
+// starts, stops, retriggers and gain changes while this thread runs the
+// render loop paced like a device callback, timing every mixer_render()
+// call. The worst case is what matters: a call that outlasts its period is
+// an underrun.
+//
+//   bench_render_stress [voices] [calls]
+
+#include "async_log.h"
+#include "mixer.h"
+#include "monotonic_clock.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_RATE 44100
+#define CALL_FRAMES 128             // A low-latency device period (2.9 ms)
+#define DEFAULT_VOICES 64
+#define DEFAULT_CALLS 1000
+#define REFUSED_BACKOFF_NS 50000
+#define TONE_FRAMES SAMPLE_RATE
+
+typedef struct {
+    size_t voices;
+    atomic_bool stop;
+    uint64_t sent;                  // Commands the ring accepted
+    uint64_t rejected;              // Commands refused because the ring was full
+} hammer_t;
+
+static int16_t tone[TONE_FRAMES];
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    nanosleep(&ts, NULL);
+}
+
+// A producer that finds the ring full backs off until the next drain
+static void count(hammer_t *hammer, bool accepted) {
+    if (accepted) {
+        hammer->sent++;
+    } else {
+        hammer->rejected++;
+        sleep_ns(REFUSED_BACKOFF_NS);
+    }
+}
+
+// The only thread calling mixer control functions, as the MIDI thread is
+static void *hammer_thread(void *arg) {
+    hammer_t *hammer = arg;
+    voice_handle_t *handles = calloc(hammer->voices, sizeof(*handles));
+    if (!handles) {
+        return NULL;
+    }
+
+    uint32_t rng = 1;
+    size_t next = 0;
+    while (!atomic_load_explicit(&hammer->stop, memory_order_relaxed)) {
+        rng = rng * 1664525u + 1013904223u;
+        size_t slot = next++ % hammer->voices;
+        switch (rng >> 30) {
+            case 0:
+                count(hammer, mixer_retrigger_voice(handles[slot]) == 0);
+                break;
+            case 1:
+                count(hammer, mixer_set_voice_gain(handles[slot], (float)(rng & 0xFF) / 512.0f) == 0);
+                break;
+            default:
+                if (handles[slot] != VOICE_HANDLE_INVALID) {
+                    count(hammer, mixer_stop_voice(handles[slot]) == 0);
+                }
+                handles[slot] = mixer_start_voice(tone, TONE_FRAMES, 0, 0.1f, true, false);
+                count(hammer, handles[slot] != VOICE_HANDLE_INVALID);
+                break;
+        }
+    }
+
+    free(handles);
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t count, double p) {
+    size_t index = (size_t)(p * (double)(count - 1) + 0.5);
+    return sorted[index];
+}
+
+int main(int argc, char *argv[]) {
+    size_t voices = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_VOICES;
+    size_t calls = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_CALLS;
+    if (voices == 0 || calls == 0) {
+        fprintf(stderr, "Usage: %s [voices] [calls]\n", argv[0]);
+        return 2;
+    }
+
+    for (size_t i = 0; i < TONE_FRAMES; i++) {
+        tone[i] = (int16_t)(8000.0 * sin(2.0 * 3.14159265358979 * 440.0 * (double)i / SAMPLE_RATE));
+    }
+    // Refused commands are counted below rather than logged one by one
+    async_log_set_level(LOG_LEVEL_ERROR);
+    async_log_start();
+    if (mixer_init(SAMPLE_RATE, voices, VOICE_STEAL_OLDEST) != 0) {
+        async_log_stop();
+        return 1;
+    }
+
+    uint64_t *durations = malloc(calls * sizeof(*durations));
+    if (!durations) {
+        mixer_cleanup();
+        async_log_stop();
+        return 1;
+    }
+
+    hammer_t hammer = {.voices = voices};
+    atomic_init(&hammer.stop, false);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, hammer_thread, &hammer) != 0) {
+        free(durations);
+        mixer_cleanup();
+        async_log_stop();
+        return 1;
+    }
+
+    // The hammer runs whenever the render thread is waiting for its next
+    // period, as it would beside a real device
+    static int16_t output[CALL_FRAMES];
+    uint64_t period_ns = (uint64_t)CALL_FRAMES * 1000000000ull / SAMPLE_RATE;
+    uint64_t deadline = clock_now_ns();
+    size_t voice_sum = 0;
+    for (size_t i = 0; i < calls; i++) {
+        deadline += period_ns;
+        uint64_t start = clock_now_ns();
+        mixer_render(output, CALL_FRAMES);
+        uint64_t end = clock_now_ns();
+        durations[i] = end - start;
+        voice_sum += mixer_active_voices();
+        if (end < deadline) {
+            sleep_ns(deadline - end);
+        }
+    }
+
+    atomic_store(&hammer.stop, true);
+    pthread_join(thread, NULL);
+
+    qsort(durations, calls, sizeof(*durations), compare_u64);
+    size_t late = 0;
+    for (size_t i = 0; i < calls; i++) {
+        late += durations[i] > period_ns;
+    }
+
+    printf("render stress: %zu voice limit, %zu calls of %d frames, %.1f voices mixed on average\n",
+           voices, calls, CALL_FRAMES, (double)voice_sum / (double)calls);
+    printf("  commands: %llu sent, %llu refused by a full ring\n",
+           (unsigned long long)hammer.sent, (unsigned long long)hammer.rejected);
+    printf("  callback ns: p50 %llu  p99 %llu  p99.9 %llu  max %llu  (period %llu, %zu late)\n",
+           (unsigned long long)percentile(durations, calls, 0.50),
+           (unsigned long long)percentile(durations, calls, 0.99),
+           (unsigned long long)percentile(durations, calls, 0.999),
+           (unsigned long long)durations[calls - 1],
+           (unsigned long long)period_ns, late);
+
+    free(durations);
+    mixer_cleanup();
+    async_log_stop();
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Sample-rate conversion cost:
+//   throughput - resample_sinc() on 10 s of audio from common source rates
+//                to the output rate, in input samples per second
+//   bank load  - a generated bank of WAV files at 48 and 22.05 kHz loaded
+//                like the player does at startup, converted at load time
+//                and left for realtime conversion, against the same bank
+//                already at the output rate; wall time and peak RSS of the
+//                loading process
+//
+//   bench_resample [files] [seconds per file]
+
+#include "bench_common.h"
+#include "midi_soundboard.h"
+#include "monotonic_clock.h"
+#include "resampler.h"
+#include "soundbank.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_FILES 200
+#define DEFAULT_SECONDS 1
+#define THROUGHPUT_SECONDS 10
+#define THROUGHPUT_MS 300
+
+static const uint32_t source_rates[] = {22050, 32000, 48000, 96000};
+
+static double load_run(void *ctx) {
+    return bench_load_bank(ctx);
+}
+
+// Input samples converted per second from rate to the output rate
+static double throughput(uint32_t rate) {
+    size_t count = (size_t)rate * THROUGHPUT_SECONDS;
+    int16_t *input = malloc(count * sizeof(*input));
+    if (input == NULL) {
+        return 0.0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        input[i] = (int16_t)(8000.0 * sin(2.0 * 3.14159265358979 * 440.0 * (double)i / rate));
+    }
+
+    size_t converted = 0;
+    uint64_t start = clock_now_ns();
+    uint64_t elapsed;
+    do {
+        int16_t *out;
+        size_t out_count;
+        if (resample_sinc(input, count, rate, SOUNDBOARD_SAMPLE_RATE, &out, &out_count) != 0) {
+            break;
+        }
+        free(out);
+        converted += count;
+        elapsed = clock_now_ns() - start;
+    } while (elapsed < THROUGHPUT_MS * 1000000ull);
+    free(input);
+    return converted / ((clock_now_ns() - start) / 1e9);
+}
+
+// Writes the bank: even files at 48 kHz, odd ones at 22.05 kHz, or all at
+// the output rate
+static int write_bank(const char *dir, size_t files, size_t seconds, bool native) {
+    for (size_t i = 0; i < files; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%03zu.wav", i);
+        uint32_t rate = native ? SOUNDBOARD_SAMPLE_RATE : (i % 2 == 0 ? 48000 : 22050);
+        if (bench_write_tone(dir, name, rate, (size_t)rate * seconds, 220.0 + (double)i) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Loads the bank in a child with every sound set to mode, after removing
+// the cache so each run decodes from scratch
+static int load_bank(const char *dir, config_t *config, resample_mode_t mode, const char *label,
+                     size_t samples) {
+    for (size_t i = 0; i < config->sound_count; i++) {
+        config->sounds[i].resample = mode;
+    }
+    bench_remove_file(dir, SOUNDBANK_CACHE_NAME);
+
+    double ms;
+    size_t peak_kib;
+    if (bench_in_child(load_run, config, &ms, &peak_kib) != 0 || ms < 0) {
+        fprintf(stderr, "bench_resample: loading the %s bank failed\n", label);
+        return -1;
+    }
+    printf("  %-22s %9.1f ms  %7.2f Msamples/s  peak RSS %7zu KiB\n",
+           label, ms, samples / (ms / 1e3) / 1e6, peak_kib);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t files = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_FILES;
+    size_t seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_SECONDS;
+    if (files == 0 || files > 11 * BENCH_NOTES_PER_PAGE || seconds == 0) {
+        fprintf(stderr, "Usage: %s [files (1-%d)] [seconds per file]\n", argv[0], 11 * BENCH_NOTES_PER_PAGE);
+        return 2;
+    }
+
+    // The bank loads run first, in children forked while this process is
+    // still small, so their RSS is their own
+    char dir[64];
+    config_t config;
+    if (bench_make_dir(dir, sizeof(dir)) != 0 || bench_config(&config, dir, files, "wav") != 0) {
+        fprintf(stderr, "bench_resample: can't set up the bank\n");
+        return 1;
+    }
+
+    // Mixed bank: half at 48 kHz, half at 22.05 kHz
+    size_t mixed_samples = files / 2 * (48000 + 22050) * seconds + files % 2 * 48000 * seconds;
+    size_t native_samples = files * SOUNDBOARD_SAMPLE_RATE * seconds;
+    printf("resample: bank of %zu file(s) x %zu s\n", files, seconds);
+    int result = write_bank(dir, files, seconds, false);
+    if (result == 0) {
+        result = load_bank(dir, &config, RESAMPLE_AT_LOAD, "48k/22k, at load", mixed_samples);
+    }
+    if (result == 0) {
+        result = load_bank(dir, &config, RESAMPLE_REALTIME, "48k/22k, realtime", mixed_samples);
+    }
+    if (result == 0) {
+        result = write_bank(dir, files, seconds, true);
+    }
+    if (result == 0) {
+        result = load_bank(dir, &config, RESAMPLE_AT_LOAD, "44.1k, no conversion", native_samples);
+    }
+    config_free(&config);
+    bench_remove_dir(dir);
+    if (result != 0) {
+        return 1;
+    }
+
+    printf("resample: windowed sinc to %u Hz, %d s of input\n", SOUNDBOARD_SAMPLE_RATE, THROUGHPUT_SECONDS);
+    for (size_t i = 0; i < sizeof(source_rates) / sizeof(source_rates[0]); i++) {
+        double rate = throughput(source_rates[i]);
+        printf("  from %5u Hz  %7.2f Msamples/s  (%.0fx real time)\n",
+               source_rates[i], rate / 1e6, rate / source_rates[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Sample cache under a bank far larger than its budget: a generated bank is
+// loaded with cache_budget_mb set, then pads are played the way a set
+// would, one render block apart, with the main loop's sample_cache_poll()
+// after each note. Two patterns are played: most notes on a small hot set
+// of pads, and every pad equally often. Reports hits, misses, evictions
+// and reloads for each, the time spent in play and poll, and how long a
+// missed sound takes to get its body back.
+//
+//   bench_sample_cache [files] [budget MB] [notes per pattern]
+
+#include "bench_common.h"
+#include "async_log.h"
+#include "midi_soundboard.h"
+#include "sample_cache.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_FILES 200
+#define DEFAULT_BUDGET_MB 8
+#define DEFAULT_NOTES 2000
+#define FILE_SECONDS 2
+#define HOT_PADS 16
+#define HOT_PERCENT 90
+#define BLOCK_FRAMES MIXER_BLOCK_FRAMES
+
+static int16_t output[BLOCK_FRAMES];
+
+typedef struct {
+    sample_cache_stats_t before;
+    sample_cache_stats_t after;
+    uint64_t play_ns;
+    uint64_t play_max_ns;
+    uint64_t poll_ns;
+    uint64_t poll_max_ns;
+    uint64_t reload_ns;          // Misses until the body was back
+    uint64_t reload_max_ns;
+    size_t reloads_timed;
+} pattern_result_t;
+
+static uint32_t rng = 1;
+
+static size_t next_pad(size_t files, bool skewed) {
+    rng = rng * 1664525u + 1013904223u;
+    uint32_t r = rng >> 8;
+    if (skewed && r % 100 < HOT_PERCENT) {
+        return (r / 100) % HOT_PADS;
+    }
+    return (r / 100) % files;
+}
+
+static void record(uint64_t ns, uint64_t *total, uint64_t *max) {
+    *total += ns;
+    if (ns > *max) {
+        *max = ns;
+    }
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = {0, ms * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// After a miss, keeps rendering and polling like the main loop (which
+// waits a short interval while a reload is pending) until the body is back
+static void wait_reload(pattern_result_t *timing) {
+    uint64_t start = clock_now_ns();
+    while (sample_cache_reloading()) {
+        sleep_ms(1);
+        audio_offline_render(output, BLOCK_FRAMES);
+        sample_cache_poll();
+    }
+    record(clock_now_ns() - start, &timing->reload_ns, &timing->reload_max_ns);
+    timing->reloads_timed++;
+}
+
+static void play_pattern(const config_t *config, size_t notes, bool skewed, pattern_result_t *result) {
+    sample_cache_get_stats(&result->before);
+
+    for (size_t i = 0; i < notes; i++) {
+        const sound_config_t *sound = &config->sounds[next_pad(config->sound_count, skewed)];
+        sample_cache_stats_t stats;
+        sample_cache_get_stats(&stats);
+        uint32_t misses = stats.misses;
+
+        uint64_t t0 = clock_now_ns();
+        soundboard_play_note(sound->page, sound->note, 100, 0);
+        uint64_t t1 = clock_now_ns();
+        audio_offline_render(output, BLOCK_FRAMES);
+        uint64_t t2 = clock_now_ns();
+        sample_cache_poll();
+        uint64_t t3 = clock_now_ns();
+        record(t1 - t0, &result->play_ns, &result->play_max_ns);
+        record(t3 - t2, &result->poll_ns, &result->poll_max_ns);
+
+        sample_cache_get_stats(&stats);
+        if (stats.misses != misses) {
+            wait_reload(result);
+        }
+    }
+    sample_cache_get_stats(&result->after);
+}
+
+static void print_pattern(const char *name, size_t notes, const pattern_result_t *result) {
+    const sample_cache_stats_t *before = &result->before;
+    const sample_cache_stats_t *after = &result->after;
+    uint32_t hits = after->hits - before->hits;
+    uint32_t misses = after->misses - before->misses;
+    printf("  %-8s %5u hits  %5u misses (%5.1f%% hit)  %5u evictions  %5u reloads  resident %5.1f / %.1f MB\n",
+           name, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+           after->evictions - before->evictions, after->reloads - before->reloads,
+           after->resident_bytes / 1048576.0, after->budget_bytes / 1048576.0);
+    printf("           play avg %6.0f ns max %7llu  poll avg %6.0f ns max %7llu  reload avg %5.2f ms max %5.2f\n",
+           (double)result->play_ns / notes, (unsigned long long)result->play_max_ns,
+           (double)result->poll_ns / notes, (unsigned long long)result->poll_max_ns,
+           result->reloads_timed ? result->reload_ns / 1e6 / result->reloads_timed : 0.0,
+           result->reload_max_ns / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    size_t files = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_FILES;
+    uint32_t budget_mb = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : DEFAULT_BUDGET_MB;
+    size_t notes = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_NOTES;
+    if (files <= HOT_PADS || files > 11 * BENCH_NOTES_PER_PAGE || budget_mb == 0 || notes == 0) {
+        fprintf(stderr, "Usage: %s [files (%d-%d)] [budget MB] [notes per pattern]\n",
+                argv[0], HOT_PADS + 1, 11 * BENCH_NOTES_PER_PAGE);
+        return 2;
+    }
+
+    char dir[64];
+    config_t config;
+    if (bench_make_dir(dir, sizeof(dir)) != 0) {
+        return 1;
+    }
+    if (bench_config(&config, dir, files, "wav") != 0) {
+        bench_remove_dir(dir);
+        return 1;
+    }
+    config.cache_budget_mb = budget_mb;
+    int result = 0;
+    for (size_t i = 0; i < files && result == 0; i++) {
+        result = bench_write_tone(dir, config.sounds[i].filename, SOUNDBOARD_SAMPLE_RATE,
+                                  (size_t)SOUNDBOARD_SAMPLE_RATE * FILE_SECONDS, 220.0 + (double)i);
+    }
+
+    // Loads and reloads print a line per sound; results are printed after
+    async_log_set_level(LOG_LEVEL_WARN);
+    pattern_result_t hot = {0}, uniform = {0};
+    int saved = bench_mute();
+    if (result == 0 && soundboard_init(&config) == 0 && page_residency_start(&config) == 0) {
+        bank_loader_wait();
+        page_residency_poll();
+        play_pattern(&config, notes, true, &hot);
+        play_pattern(&config, notes, false, &uniform);
+    } else {
+        result = -1;
+    }
+    bench_unmute(saved);
+
+    if (result == 0) {
+        double bank_mb = (double)files * FILE_SECONDS * SOUNDBOARD_SAMPLE_RATE * sizeof(int16_t) / 1048576.0;
+        printf("sample cache: %zu file(s), %.1f MB of PCM, %u MB budget, %zu notes per pattern\n",
+               files, bank_mb, budget_mb, notes);
+        print_pattern("hot set", notes, &hot);
+        print_pattern("uniform", notes, &uniform);
+    } else {
+        fprintf(stderr, "bench_sample_cache: loading the bank failed\n");
+    }
+
+    bank_loader_cancel();
+    soundboard_cleanup();
+    bank_loader_cleanup();
+    config_free(&config);
+    bench_remove_dir(dir);
+    return result == 0 ? 0 : 1;
+}
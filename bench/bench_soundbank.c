@@ -0,0 +1,148 @@
+// Sound bank file throughput: a bank of generated PCM is written with
+// soundbank_write(), then mapped with soundbank_open() and every sample of
+// every entry read, first with the file dropped from the page cache (as
+// after a reboot) and then again warm (a restart of the soundboard).
+// The write is timed to the page cache, as the loader does it. Reports the
+// time to open alone, which only parses the table, and the read rate
+// through the mapping.
+//
+//   bench_soundbank [sounds] [seconds per sound]
+
+#include "bench_common.h"
+#include "soundbank.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_SOUNDS 200
+#define DEFAULT_SECONDS 2
+#define WARM_RUNS 3
+
+typedef struct {
+    double open_ms;
+    double read_ms;
+    int64_t sum;                 // Keeps the reads from being optimised away
+} read_result_t;
+
+// Asks the kernel to forget the file's pages; root is not needed for a
+// file we own. Returns false if they may still be cached.
+static bool drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool dropped = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+}
+
+static int read_bank(const char *path, read_result_t *result) {
+    soundbank_t bank;
+    uint64_t start = clock_now_ns();
+    if (soundbank_open(path, &bank) != 0) {
+        return -1;
+    }
+    uint64_t opened = clock_now_ns();
+
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < bank.header->entry_count; i++) {
+        const soundbank_entry_t *entry = &bank.entries[i];
+        const int16_t *samples = soundbank_samples(&bank, entry);
+        for (uint64_t s = 0; s < entry->sample_count; s++) {
+            sum += samples[s];
+        }
+    }
+    uint64_t done = clock_now_ns();
+    soundbank_close(&bank);
+
+    result->open_ms = (double)(opened - start) / 1e6;
+    result->read_ms = (double)(done - opened) / 1e6;
+    result->sum = sum;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t sounds = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_SOUNDS;
+    size_t seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_SECONDS;
+    if (sounds == 0 || sounds > 11 * BENCH_NOTES_PER_PAGE || seconds == 0) {
+        fprintf(stderr, "Usage: %s [sounds (1-%d)] [seconds per sound]\n", argv[0], 11 * BENCH_NOTES_PER_PAGE);
+        return 2;
+    }
+
+    char dir[64];
+    config_t config;
+    if (bench_make_dir(dir, sizeof(dir)) != 0) {
+        return 1;
+    }
+    if (bench_config(&config, dir, sounds, "wav") != 0) {
+        bench_remove_dir(dir);
+        return 1;
+    }
+
+    // One buffer of PCM shared by every entry: the bank's size is what counts
+    size_t frames = (size_t)SOUNDBOARD_SAMPLE_RATE * seconds;
+    int16_t *pcm = malloc(frames * sizeof(int16_t));
+    soundbank_item_t *items = calloc(sounds, sizeof(*items));
+    if (pcm == NULL || items == NULL) {
+        free(pcm);
+        free(items);
+        config_free(&config);
+        bench_remove_dir(dir);
+        return 1;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        pcm[i] = (int16_t)(i * 7919u);
+    }
+    for (size_t i = 0; i < sounds; i++) {
+        items[i] = (soundbank_item_t){
+            .sound = &config.sounds[i],
+            .samples = pcm,
+            .sample_count = frames,
+            .sample_rate = SOUNDBOARD_SAMPLE_RATE,
+        };
+    }
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", dir, SOUNDBANK_CACHE_NAME);
+    int saved = bench_mute();
+    uint64_t start = clock_now_ns();
+    int result = soundbank_write(path, items, sounds, SOUNDBOARD_SAMPLE_RATE);
+    double write_ms = (double)(clock_now_ns() - start) / 1e6;
+    bench_unmute(saved);
+
+    read_result_t cold = {0}, warm = {0};
+    bool dropped = false;
+    if (result == 0) {
+        dropped = drop_cache(path);
+        result = read_bank(path, &cold);
+    }
+    // Best of a few: the pages are all cached now
+    for (int run = 0; run < WARM_RUNS && result == 0; run++) {
+        read_result_t attempt;
+        result = read_bank(path, &attempt);
+        if (result == 0 && (run == 0 || attempt.read_ms < warm.read_ms)) {
+            warm = attempt;
+        }
+    }
+
+    if (result == 0) {
+        double mb = (double)sounds * frames * sizeof(int16_t) / 1048576.0;
+        printf("soundbank: %zu sound(s) of %zu s, %.1f MB of PCM\n", sounds, seconds, mb);
+        printf("  write %26s %8.1f ms  %7.1f MB/s\n", "", write_ms, mb / (write_ms / 1000.0));
+        printf("  cold  open %6.3f ms  read %8.1f ms  %7.1f MB/s%s\n", cold.open_ms, cold.read_ms,
+               mb / (cold.read_ms / 1000.0), dropped ? "" : "  (page cache not dropped)");
+        printf("  warm  open %6.3f ms  read %8.1f ms  %7.1f MB/s\n", warm.open_ms, warm.read_ms,
+               mb / (warm.read_ms / 1000.0));
+        if (cold.sum != warm.sum) {
+            fprintf(stderr, "bench_soundbank: cold and warm reads differ\n");
+            result = -1;
+        }
+    } else {
+        fprintf(stderr, "bench_soundbank: writing or reading %s failed\n", path);
+    }
+
+    free(items);
+    free(pcm);
+    config_free(&config);
+    bench_remove_dir(dir);
+    return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Disk stream refill rate: looping streams are drained as fast as the I/O
+// thread refills them, with the consumer yielding whenever every ring is
+// empty, as a render thread that had run out would wait for its next
+// callback. Reports how many times real time the read-ahead keeps up for
+// 1, 4 and 16 generated WAV streams at once (the first with the file
+// dropped from the page cache), and for one stream of a compressed file,
+// which the I/O thread has to decode.
+//
+//   bench_stream [file to stream (default the bundled MP3)] [seconds of audio per stream]
+
+#include "bench_common.h"
+#include "sound_stream.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_FILE "sounds/138049__pakasit21__typewriter.mp3"
+#define DEFAULT_SECONDS 20
+#define WAV_SECONDS 30
+#define MAX_STREAMS 16
+
+static const size_t stream_counts[] = {1, 4, MAX_STREAMS};
+#define STREAM_CONFIGS (sizeof(stream_counts) / sizeof(stream_counts[0]))
+
+typedef struct {
+    size_t streams;
+    double seconds;              // Audio consumed per stream
+    double elapsed_ms;
+    uint64_t yields;             // Times every ring was empty
+} refill_result_t;
+
+static bool drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+}
+
+// Drains frames past the head from every stream in turn until each has
+// delivered its share
+static int measure_refill(const char *path, size_t count, size_t seconds, refill_result_t *result) {
+    sound_stream_t *streams[MAX_STREAMS] = {0};
+    uint32_t epochs[MAX_STREAMS];
+    size_t remaining[MAX_STREAMS];
+    int status = 0;
+    for (size_t i = 0; i < count && status == 0; i++) {
+        streams[i] = sound_stream_open(path);
+        if (streams[i] == NULL) {
+            status = -1;
+            break;
+        }
+        remaining[i] = (size_t)sound_stream_sample_rate(streams[i]) * seconds;
+    }
+
+    uint64_t yields = 0;
+    uint64_t start = clock_now_ns();
+    for (size_t i = 0; i < count && status == 0; i++) {
+        epochs[i] = sound_stream_begin(streams[i], true);
+    }
+    size_t unfinished = status == 0 ? count : 0;
+    while (unfinished > 0) {
+        bool consumed = false;
+        for (size_t i = 0; i < count; i++) {
+            if (remaining[i] == 0) {
+                continue;
+            }
+            // An empty ring here means we are ahead of the I/O thread, not
+            // an underrun: prime checks without counting one
+            const int16_t *samples;
+            size_t available = 0;
+            if (sound_stream_prime(streams[i], epochs[i]) > 0) {
+                available = sound_stream_peek(streams[i], epochs[i], &samples);
+            }
+            if (available > remaining[i]) {
+                available = remaining[i];
+            }
+            if (available > 0) {
+                sound_stream_advance(streams[i], available);
+                remaining[i] -= available;
+                unfinished -= remaining[i] == 0;
+                consumed = true;
+            }
+        }
+        if (!consumed) {
+            sched_yield();
+            yields++;
+        }
+    }
+    uint64_t elapsed = clock_now_ns() - start;
+
+    for (size_t i = 0; i < count; i++) {
+        if (streams[i] != NULL) {
+            sound_stream_end(streams[i]);
+            sound_stream_close(streams[i]);
+        }
+    }
+    result->streams = count;
+    result->seconds = (double)seconds;
+    result->elapsed_ms = (double)elapsed / 1e6;
+    result->yields = yields;
+    return status;
+}
+
+static void print_result(const char *name, const refill_result_t *result) {
+    double realtime = result->seconds * 1000.0 / result->elapsed_ms;
+    printf("  %-14s %2zu stream(s)  %8.1f ms  %7.1fx realtime per stream  %8.1fx in total  %8llu yields\n",
+           name, result->streams, result->elapsed_ms, realtime, realtime * (double)result->streams,
+           (unsigned long long)result->yields);
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = argc > 1 ? argv[1] : DEFAULT_FILE;
+    size_t seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_SECONDS;
+    if (seconds == 0) {
+        fprintf(stderr, "Usage: %s [file to stream] [seconds of audio per stream]\n", argv[0]);
+        return 2;
+    }
+
+    char dir[64];
+    if (bench_make_dir(dir, sizeof(dir)) != 0) {
+        return 1;
+    }
+    char path[128];
+    snprintf(path, sizeof(path), "%s/long.wav", dir);
+    int result = bench_write_tone(dir, "long.wav", 44100, (size_t)44100 * WAV_SECONDS, 220.0);
+
+    refill_result_t cold = {0}, warm[STREAM_CONFIGS] = {{0}}, compressed = {0};
+    bool dropped = false, have_compressed = false;
+    if (result == 0) {
+        dropped = drop_cache(path);
+        result = measure_refill(path, 1, seconds, &cold);
+    }
+    for (size_t i = 0; i < STREAM_CONFIGS && result == 0; i++) {
+        result = measure_refill(path, stream_counts[i], seconds, &warm[i]);
+    }
+    if (result == 0) {
+        have_compressed = measure_refill(file, 1, seconds, &compressed) == 0;
+    }
+
+    if (result == 0) {
+        printf("stream refill: %d s WAV looped, %zu s of audio per stream, %d-frame chunks, %d-chunk rings\n",
+               WAV_SECONDS, seconds, STREAM_CHUNK_FRAMES, STREAM_RING_CHUNKS);
+        print_result(dropped ? "WAV cold" : "WAV (cached)", &cold);
+        for (size_t i = 0; i < STREAM_CONFIGS; i++) {
+            print_result("WAV warm", &warm[i]);
+        }
+        if (have_compressed) {
+            printf("  %s:\n", file);
+            print_result("compressed", &compressed);
+        } else {
+            fprintf(stderr, "bench_stream: can't stream %s (skipped)\n", file);
+        }
+    } else {
+        fprintf(stderr, "bench_stream: streaming %s failed\n", path);
+    }
+
+    sound_stream_shutdown();
+    bench_remove_dir(dir);
+    return result == 0 ? 0 : 1;
+}
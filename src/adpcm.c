@@ -0,0 +1,111 @@
+#include "adpcm.h"
+#include <stdlib.h>
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t index_table[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+// Applies one code to the decoder state; the encoder runs the same update
+// so both sides stay in step. The difference is (magnitude + 1/2) * step / 4
+// computed in one multiply rather than the usual chain of shifts and
+// branches, which keeps the decoder branch-free.
+static inline void apply_code(int code, int *predictor, int *index) {
+    int diff = ((code & 7) * 2 + 1) * step_table[*index] >> 3;
+
+    int value = (code & 8) ? *predictor - diff : *predictor + diff;
+    *predictor = value < -32768 ? -32768 : (value > 32767 ? 32767 : value);
+
+    int next = *index + index_table[code & 7];
+    *index = next < 0 ? 0 : (next > 88 ? 88 : next);
+}
+
+static inline int quantize(int sample, int predictor, int index) {
+    int step = step_table[index];
+    int diff = sample - predictor;
+    int code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        code |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        code |= 1;
+    }
+    return code;
+}
+
+int adpcm_encode(const int16_t *in, size_t count, uint8_t **out) {
+    if (in == NULL || count == 0 || out == NULL) {
+        return -1;
+    }
+
+    uint8_t *buffer = calloc(1, adpcm_encoded_size(count));
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    // The step index carries over between blocks; the predictor restarts
+    // from the exact first sample of each block
+    int index = 0;
+    uint8_t *block = buffer;
+    for (size_t start = 0; start < count; start += ADPCM_BLOCK_FRAMES, block += ADPCM_BLOCK_BYTES) {
+        size_t frames = count - start < ADPCM_BLOCK_FRAMES ? count - start : ADPCM_BLOCK_FRAMES;
+        int predictor = in[start];
+        block[0] = (uint8_t)((uint16_t)in[start] & 0xFF);
+        block[1] = (uint8_t)((uint16_t)in[start] >> 8);
+        block[2] = (uint8_t)index;
+
+        for (size_t i = 1; i < frames; i++) {
+            int code = quantize(in[start + i], predictor, index);
+            apply_code(code, &predictor, &index);
+            size_t nibble = i - 1;
+            block[4 + nibble / 2] |= (uint8_t)(nibble & 1 ? code << 4 : code);
+        }
+    }
+
+    *out = buffer;
+    return 0;
+}
+
+void adpcm_decode_block(const uint8_t *block, int16_t *out, size_t frame_count) {
+    if (frame_count == 0) {
+        return;
+    }
+    if (frame_count > ADPCM_BLOCK_FRAMES) {
+        frame_count = ADPCM_BLOCK_FRAMES;
+    }
+
+    int predictor = adpcm_block_first(block);
+    int index = block[2] > 88 ? 88 : block[2];
+    out[0] = (int16_t)predictor;
+
+    // Two codes per byte
+    const uint8_t *codes = block + 4;
+    size_t i = 1;
+    for (; i + 1 < frame_count; i += 2) {
+        uint8_t byte = *codes++;
+        apply_code(byte & 0x0F, &predictor, &index);
+        out[i] = (int16_t)predictor;
+        apply_code(byte >> 4, &predictor, &index);
+        out[i + 1] = (int16_t)predictor;
+    }
+    if (i < frame_count) {
+        apply_code(*codes & 0x0F, &predictor, &index);
+        out[i] = (int16_t)predictor;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// IMA-ADPCM in fixed-size blocks, used to keep sounds in memory at 4 bits
+// per sample. Every block starts with its first sample and the quantizer
+// state, so the mixer can decode any block on its own: a voice decodes the
+// block it is playing into a small buffer, and seeking (loops, retriggers)
+// costs at most one block.
+//
+// Block layout: int16 first sample (little-endian), uint8 step index,
+// uint8 reserved, then ADPCM_BLOCK_FRAMES - 1 samples as 4-bit codes, low
+// nibble first. The last block may hold fewer frames.
+
+#define ADPCM_BLOCK_FRAMES 256
+#define ADPCM_BLOCK_BYTES (4 + ADPCM_BLOCK_FRAMES / 2)
+
+static inline size_t adpcm_encoded_size(size_t frame_count) {
+    return (frame_count + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES * ADPCM_BLOCK_BYTES;
+}
+
+// On success *out is a newly malloc'd buffer of adpcm_encoded_size(count) bytes
+int adpcm_encode(const int16_t *in, size_t count, uint8_t **out);
+
+// Decodes the first frame_count (at most ADPCM_BLOCK_FRAMES) frames of block
+void adpcm_decode_block(const uint8_t *block, int16_t *out, size_t frame_count);
+
+// First frame of a block, without decoding it
+static inline int16_t adpcm_block_first(const uint8_t *block) {
+    return (int16_t)(uint16_t)(block[0] | (block[1] << 8));
+}
+
+#endif // ADPCM_H
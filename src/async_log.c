@@ -0,0 +1,497 @@
+#include "async_log.h"
+#include "spsc_ring.h"
+#include "monotonic_clock.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef ESP_PLATFORM
+#define LOG_MAX_THREADS 8
+#define LOG_RING_RECORDS 32
+#else
+#define LOG_MAX_THREADS 32          // Threads that can log at once; the rest drop
+#define LOG_RING_RECORDS 256
+#endif
+#define LOG_TEXT_BYTES ASYNC_LOG_TEXT_BYTES   // Room for the %s arguments of one record
+#define LOG_LINE_BYTES ASYNC_LOG_LINE_BYTES
+#define LOG_FLUSH_MS 10             // How often the writer drains the rings
+#define LOG_RATE_WINDOW_NS 1000000000ull
+
+// One message as queued: the format pointer, the raw argument values and
+// copies of the strings. Only formatted on the writer thread.
+typedef struct {
+    const char *format;
+    uint64_t args[ASYNC_LOG_MAX_ARGS];  // Integers, double bits, pointers or offsets into text
+    uint32_t suppressed;                // Messages from this site dropped by the rate limit just before
+    uint8_t level;
+    char text[LOG_TEXT_BYTES];
+} log_record_t;
+
+typedef enum {
+    LENGTH_NONE = 0,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_J,
+    LENGTH_Z,
+    LENGTH_T,
+    LENGTH_LONG_DOUBLE
+} length_t;
+
+// One conversion specification, e.g. "%-8.3lf"
+typedef struct {
+    const char *start;          // The '%'
+    int stars;                  // '*' widths or precisions, each an int argument
+    int precision;              // Digits after '.', -1 if none or given by '*'
+    bool precision_star;        // The last '*' is the precision
+    length_t length;
+    char conversion;
+} spec_t;
+
+// Ring ownership: a thread claims a free ring with its first message and
+// releases it when it exits; the writer frees it once it has drained it
+typedef enum {
+    RING_FREE = 0,
+    RING_OWNED,
+    RING_RELEASED
+} ring_state_t;
+
+static spsc_ring_t rings[LOG_MAX_THREADS];
+static _Atomic int ring_state[LOG_MAX_THREADS];
+static _Thread_local int thread_ring = -1;
+static pthread_key_t ring_key;
+
+static pthread_t writer_thread;
+static bool started = false;
+static _Atomic bool running = false;
+static _Atomic int min_level = LOG_LEVEL_INFO;
+static _Atomic uint32_t dropped = 0;
+static uint32_t reported_drops = 0;     // Writer thread
+
+// ---------------------------------------------------------------------------
+// Format parsing, shared by both sides
+// ---------------------------------------------------------------------------
+
+// Parses the specification after a '%' at p; returns the conversion character
+static const char *parse_spec(const char *p, spec_t *spec) {
+    spec->start = p - 1;
+    spec->stars = 0;
+    spec->precision = -1;
+    spec->precision_star = false;
+    spec->length = LENGTH_NONE;
+    while (*p != '\0' && strchr("-+ #0123456789.*", *p) != NULL) {
+        if (*p == '*') {
+            spec->stars++;
+        } else if (*p == '.') {
+            if (p[1] == '*') {
+                spec->precision_star = true;
+            } else {
+                spec->precision = (int)strtol(p + 1, NULL, 10);
+            }
+        }
+        p++;
+    }
+    if (p[0] == 'h' && p[1] == 'h') {
+        spec->length = LENGTH_HH;
+        p += 2;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        spec->length = LENGTH_LL;
+        p += 2;
+    } else if (*p != '\0' && strchr("hljztL", *p) != NULL) {
+        switch (*p) {
+            case 'h': spec->length = LENGTH_H; break;
+            case 'l': spec->length = LENGTH_L; break;
+            case 'j': spec->length = LENGTH_J; break;
+            case 'z': spec->length = LENGTH_Z; break;
+            case 't': spec->length = LENGTH_T; break;
+            default: spec->length = LENGTH_LONG_DOUBLE; break;
+        }
+        p++;
+    }
+    spec->conversion = *p;
+    return p;
+}
+
+static bool is_signed_conversion(char c) {
+    return c == 'd' || c == 'i';
+}
+
+static bool is_unsigned_conversion(char c) {
+    return c == 'u' || c == 'x' || c == 'X' || c == 'o' || c == 'c';
+}
+
+static bool is_double_conversion(char c) {
+    return c != '\0' && strchr("fFeEgGaA", c) != NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Call site
+// ---------------------------------------------------------------------------
+
+static uint64_t read_signed(va_list *args, length_t length) {
+    switch (length) {
+        case LENGTH_HH: return (uint64_t)(int64_t)(signed char)va_arg(*args, int);
+        case LENGTH_H: return (uint64_t)(int64_t)(short)va_arg(*args, int);
+        case LENGTH_L: return (uint64_t)(int64_t)va_arg(*args, long);
+        case LENGTH_LL: return (uint64_t)(int64_t)va_arg(*args, long long);
+        case LENGTH_J: return (uint64_t)(int64_t)va_arg(*args, intmax_t);
+        case LENGTH_Z: return (uint64_t)va_arg(*args, size_t);
+        case LENGTH_T: return (uint64_t)(int64_t)va_arg(*args, ptrdiff_t);
+        default: return (uint64_t)(int64_t)va_arg(*args, int);
+    }
+}
+
+static uint64_t read_unsigned(va_list *args, length_t length) {
+    switch (length) {
+        case LENGTH_HH: return (unsigned char)va_arg(*args, unsigned int);
+        case LENGTH_H: return (unsigned short)va_arg(*args, unsigned int);
+        case LENGTH_L: return va_arg(*args, unsigned long);
+        case LENGTH_LL: return va_arg(*args, unsigned long long);
+        case LENGTH_J: return va_arg(*args, uintmax_t);
+        case LENGTH_Z: return va_arg(*args, size_t);
+        case LENGTH_T: return (uint64_t)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, unsigned int);
+    }
+}
+
+// Copies the arguments, '*' widths and precisions included, into
+// record->args; scans the format but formats nothing
+static void capture_args(log_record_t *record, va_list *args) {
+    size_t count = 0;
+    size_t text_used = 0;
+    for (const char *p = record->format; *p != '\0' && count < ASYNC_LOG_MAX_ARGS; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        spec_t spec;
+        p = parse_spec(p + 1, &spec);
+        if (count + (size_t)spec.stars >= ASYNC_LOG_MAX_ARGS) {
+            break; // The value wouldn't fit after its width and precision
+        }
+        for (int i = 0; i < spec.stars; i++) {
+            int star = va_arg(*args, int);
+            record->args[count++] = (uint64_t)(int64_t)star;
+            if (spec.precision_star && i == spec.stars - 1) {
+                spec.precision = star < 0 ? -1 : star;
+            }
+        }
+
+        uint64_t value = 0;
+        if (is_signed_conversion(spec.conversion)) {
+            value = read_signed(args, spec.length);
+        } else if (is_unsigned_conversion(spec.conversion)) {
+            value = read_unsigned(args, spec.length);
+        } else if (is_double_conversion(spec.conversion)) {
+            double d = spec.length == LENGTH_LONG_DOUBLE ? (double)va_arg(*args, long double)
+                                                          : va_arg(*args, double);
+            memcpy(&value, &d, sizeof(value));
+        } else if (spec.conversion == 's') {
+            const char *s = va_arg(*args, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            // Offset of a NUL-terminated copy; LOG_TEXT_BYTES = no room left
+            // Only as much as a precision will print is kept
+            value = LOG_TEXT_BYTES;
+            if (text_used < LOG_TEXT_BYTES) {
+                size_t limit = LOG_TEXT_BYTES - text_used - 1;
+                if (spec.precision >= 0 && (size_t)spec.precision < limit) {
+                    limit = (size_t)spec.precision;
+                }
+                size_t n = strnlen(s, limit);
+                memcpy(record->text + text_used, s, n);
+                record->text[text_used + n] = '\0';
+                value = text_used;
+                text_used += n + 1;
+            }
+        } else if (spec.conversion == 'p' || spec.conversion == 'n') {
+            value = (uint64_t)(uintptr_t)va_arg(*args, void *);
+        } else {
+            break; // Unknown conversion; the rest can't be read safely
+        }
+        record->args[count++] = value;
+        if (*p == '\0') {
+            break;
+        }
+    }
+}
+
+// Every message from a site counts against its window; the first message
+// after a suppressed run carries the number suppressed
+static bool rate_allow(async_log_site_t *site, uint32_t *suppressed) {
+    uint64_t now = clock_now_ns();
+    uint64_t window = atomic_load_explicit(&site->window_ns, memory_order_relaxed);
+    if (now - window >= LOG_RATE_WINDOW_NS &&
+        atomic_compare_exchange_strong_explicit(&site->window_ns, &window, now,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) >= ASYNC_LOG_RATE_LIMIT) {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        return false;
+    }
+    *suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    return true;
+}
+
+// The calling thread's ring, claimed on first use (NULL if all are taken)
+static spsc_ring_t *claim_ring(void) {
+    if (thread_ring >= 0) {
+        return &rings[thread_ring];
+    }
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        int expected = RING_FREE;
+        if (atomic_compare_exchange_strong_explicit(&ring_state[i], &expected, RING_OWNED,
+                                                    memory_order_acquire, memory_order_relaxed)) {
+            thread_ring = i;
+            pthread_setspecific(ring_key, (void *)(intptr_t)(i + 1)); // Released on thread exit
+            return &rings[i];
+        }
+    }
+    return NULL;
+}
+
+// pthread key destructor: the thread is gone, so its ring has no producer
+static void release_ring(void *value) {
+    int index = (int)(intptr_t)value - 1;
+    atomic_store_explicit(&ring_state[index], RING_RELEASED, memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+static size_t append(char *line, size_t used, const char *text, size_t length) {
+    if (used + length >= LOG_LINE_BYTES) {
+        length = LOG_LINE_BYTES - 1 - used;
+    }
+    memcpy(line + used, text, length);
+    return used + length;
+}
+
+static void format_record(const log_record_t *record, char *line) {
+    size_t used = 0;
+    size_t count = 0;
+    const char *p = record->format;
+    while (*p != '\0' && used < LOG_LINE_BYTES - 1) {
+        const char *percent = strchr(p, '%');
+        if (percent == NULL) {
+            used = append(line, used, p, strlen(p));
+            break;
+        }
+        used = append(line, used, p, (size_t)(percent - p));
+        if (percent[1] == '%') {
+            used = append(line, used, "%", 1);
+            p = percent + 2;
+            continue;
+        }
+
+        spec_t spec;
+        const char *end = parse_spec(percent + 1, &spec);
+        if (spec.conversion == '\0') {
+            break;
+        }
+        p = end + 1;
+        if (count + (size_t)spec.stars >= ASYNC_LOG_MAX_ARGS || spec.conversion == 'n') {
+            count += (size_t)spec.stars + 1;
+            continue; // Beyond what was captured
+        }
+
+        // Rebuild the specification with each '*' replaced by the captured
+        // width or precision and with the length the stored value has
+        char format[48];
+        size_t n = 0;
+        for (const char *c = spec.start; c < end && n < sizeof(format) - 16; c++) {
+            if (*c == '*') {
+                int star = (int)(int64_t)record->args[count++];
+                if (n > 0 && format[n - 1] == '.' && star < 0) {
+                    n--; // A negative precision is taken as omitted
+                } else {
+                    n += (size_t)snprintf(format + n, sizeof(format) - n, "%d", star);
+                }
+            } else if (strchr("hljztL", *c) == NULL) {
+                format[n++] = *c;
+            }
+        }
+        uint64_t value = record->args[count++];
+        size_t room = LOG_LINE_BYTES - used;
+        int written = 0;
+        if (is_signed_conversion(spec.conversion) || is_unsigned_conversion(spec.conversion)) {
+            if (spec.conversion != 'c') {
+                format[n++] = 'l';
+                format[n++] = 'l';
+            }
+            format[n++] = spec.conversion;
+            format[n] = '\0';
+            if (spec.conversion == 'c') {
+                written = snprintf(line + used, room, format, (int)value);
+            } else if (is_signed_conversion(spec.conversion)) {
+                written = snprintf(line + used, room, format, (long long)(int64_t)value);
+            } else {
+                written = snprintf(line + used, room, format, (unsigned long long)value);
+            }
+        } else if (is_double_conversion(spec.conversion)) {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            format[n++] = spec.conversion;
+            format[n] = '\0';
+            written = snprintf(line + used, room, format, d);
+        } else if (spec.conversion == 's') {
+            format[n++] = 's';
+            format[n] = '\0';
+            written = snprintf(line + used, room, format, value < LOG_TEXT_BYTES ? record->text + value : "");
+        } else if (spec.conversion == 'p') {
+            format[n++] = 'p';
+            format[n] = '\0';
+            written = snprintf(line + used, room, format, (void *)(uintptr_t)value);
+        }
+        if (written > 0) {
+            used += (size_t)written < room ? (size_t)written : room - 1;
+        }
+    }
+    line[used] = '\0';
+}
+
+static void write_record(const log_record_t *record) {
+    FILE *out = record->level >= LOG_LEVEL_WARN ? stderr : stdout;
+    if (record->suppressed > 0) {
+        fprintf(out, "[LOG] %u message(s) like the next were suppressed (limit %d per second)\n",
+                record->suppressed, ASYNC_LOG_RATE_LIMIT);
+    }
+    char line[LOG_LINE_BYTES];
+    format_record(record, line);
+    fputs(line, out);
+}
+
+static void report_drops(void) {
+    uint32_t drops = atomic_load_explicit(&dropped, memory_order_relaxed);
+    if (drops != reported_drops) {
+        fprintf(stderr, "[LOG] %u message(s) dropped (log ring full)\n", drops - reported_drops);
+        reported_drops = drops;
+    }
+}
+
+// Writes everything queued; only one thread drains at a time
+static void drain(void) {
+    log_record_t record;
+    bool wrote = false;
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        int state = atomic_load_explicit(&ring_state[i], memory_order_acquire);
+        if (state == RING_FREE) {
+            continue;
+        }
+        while (spsc_ring_pop(&rings[i], &record)) {
+            write_record(&record);
+            wrote = true;
+        }
+        if (state == RING_RELEASED) {
+            atomic_store_explicit(&ring_state[i], RING_FREE, memory_order_release);
+        }
+    }
+    report_drops();
+    if (wrote) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct timespec interval = { .tv_sec = 0, .tv_nsec = LOG_FLUSH_MS * 1000000L };
+    while (atomic_load_explicit(&running, memory_order_acquire)) {
+        drain();
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+
+int async_log_start(void) {
+    if (started) {
+        return 0;
+    }
+    if (pthread_key_create(&ring_key, release_ring) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        if (spsc_ring_init(&rings[i], sizeof(log_record_t), LOG_RING_RECORDS) != 0) {
+            for (int j = 0; j < i; j++) {
+                spsc_ring_free(&rings[j]);
+            }
+            pthread_key_delete(ring_key);
+            return -1;
+        }
+        atomic_store(&ring_state[i], RING_FREE);
+    }
+
+    atomic_store_explicit(&running, true, memory_order_release);
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        atomic_store(&running, false);
+        for (int i = 0; i < LOG_MAX_THREADS; i++) {
+            spsc_ring_free(&rings[i]);
+        }
+        pthread_key_delete(ring_key);
+        return -1;
+    }
+    started = true;
+    return 0;
+}
+
+void async_log_stop(void) {
+    if (!started) {
+        return;
+    }
+    // Later messages are written directly. The rings stay allocated: a
+    // thread may still be pushing a message it started before the flag.
+    atomic_store_explicit(&running, false, memory_order_release);
+    pthread_join(writer_thread, NULL);
+    drain();
+    started = false;
+}
+
+void async_log_set_level(log_level_t level) {
+    atomic_store_explicit(&min_level, (int)level, memory_order_relaxed);
+}
+
+uint32_t async_log_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+void async_log_write(async_log_site_t *site, log_level_t level, const char *format, ...) {
+    if ((int)level < atomic_load_explicit(&min_level, memory_order_relaxed)) {
+        return;
+    }
+    uint32_t suppressed = 0;
+    if (!rate_allow(site, &suppressed)) {
+        return;
+    }
+
+    log_record_t record;
+    record.format = format;
+    record.level = (uint8_t)level;
+    record.suppressed = suppressed;
+    va_list args;
+    va_start(args, format);
+    capture_args(&record, &args);
+    va_end(args);
+
+    if (!atomic_load_explicit(&running, memory_order_acquire)) {
+        write_record(&record); // No writer thread: startup, shutdown or tools
+        return;
+    }
+    spsc_ring_t *ring = claim_ring();
+    if (ring == NULL || !spsc_ring_push(ring, &record)) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"  // For log_level_t
+
+// Logging that is safe on the hot path and in MIDI and audio callbacks.
+// A call copies its arguments into a fixed-size binary record on the
+// calling thread's own lock-free ring and returns; it never formats, locks,
+// allocates or touches stdio. A background thread drains every ring,
+// formats the records and writes them, stdout for debug and info and
+// stderr for warnings and errors.
+//
+// The format is printf-style (no %n) with at most ASYNC_LOG_MAX_ARGS
+// arguments, counting each '*' width or precision as one. It must be a
+// string literal: only the pointer is stored. %s arguments are copied into
+// ASYNC_LOG_TEXT_BYTES shared by the whole record, each truncated to the
+// room left. Formatted lines are cut at ASYNC_LOG_LINE_BYTES - 1 bytes.
+//
+// Each call site prints at most ASYNC_LOG_RATE_LIMIT messages per second;
+// the rest are suppressed and counted on the next message it prints.
+// Records that find their ring full are dropped and counted. Before
+// async_log_start() and after async_log_stop(), messages are written
+// directly by the calling thread.
+
+#define ASYNC_LOG_MAX_ARGS 8
+#define ASYNC_LOG_TEXT_BYTES 96
+#define ASYNC_LOG_LINE_BYTES 512
+#define ASYNC_LOG_RATE_LIMIT 100
+
+// Per call site rate-limit state (see ASYNC_LOG)
+typedef struct {
+    _Atomic uint64_t window_ns;     // Start of the current one-second window
+    _Atomic uint32_t count;         // Messages in the window
+    _Atomic uint32_t suppressed;    // Messages dropped by the limit since the last one printed
+} async_log_site_t;
+
+// Starts the writer thread. Returns 0 on success; on failure messages keep
+// being written synchronously.
+int async_log_start(void);
+// Writes everything still queued, reports drops and stops the thread
+void async_log_stop(void);
+
+// Messages below level are discarded at the call site (default info)
+void async_log_set_level(log_level_t level);
+
+// Use the macros below, which give every call site its own rate limit
+void async_log_write(async_log_site_t *site, log_level_t level, const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+// Records lost because a ring was full or no ring was free
+uint32_t async_log_dropped(void);
+
+#define ASYNC_LOG(level, ...) do { \
+        static async_log_site_t async_log_site_; \
+        async_log_write(&async_log_site_, (level), __VA_ARGS__); \
+    } while (0)
+
+#define LOG_DEBUG(...) ASYNC_LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) ASYNC_LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) ASYNC_LOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) ASYNC_LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,66 @@
+#include "audio_loader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int audio_load_file(const char *filepath, audio_data_t *audio) {
+    if (!filepath || !audio) {
+        return -1;
+    }
+    
+    memset(audio, 0, sizeof(*audio));
+    
+    audio_decoder_t *decoder = NULL;
+    audio_stream_info_t info;
+    if (audio_decoder_open(filepath, &decoder, &info) != 0) {
+        return -1;
+    }
+    
+    if (info.frame_count == 0) {
+        fprintf(stderr, "[AUDIO] Empty audio file: %s\n", filepath);
+        audio_decoder_close(decoder);
+        return -1;
+    }
+    
+    // Decode straight into a buffer sized from the header; no intermediate copies
+    int16_t *buffer = malloc(info.frame_count * sizeof(int16_t));
+    if (!buffer) {
+        fprintf(stderr, "[AUDIO] Failed to allocate %zu samples for %s\n", info.frame_count, filepath);
+        audio_decoder_close(decoder);
+        return -1;
+    }
+    
+    size_t total = 0;
+    while (total < info.frame_count) {
+        size_t got = audio_decoder_read(decoder, buffer + total, info.frame_count - total);
+        if (got == 0) {
+            break;
+        }
+        total += got;
+    }
+    audio_decoder_close(decoder);
+    
+    if (total == 0) {
+        free(buffer);
+        fprintf(stderr, "[AUDIO] Failed to read audio data\n");
+        return -1;
+    }
+    
+    audio->data = buffer;
+    audio->sample_count = total;
+    audio->sample_rate = info.sample_rate;
+    audio->channels = 1;
+    
+    printf("[AUDIO] Loaded %s: %zu samples @ %u Hz\n", filepath, audio->sample_count, audio->sample_rate);
+    return 0;
+}
+
+void audio_free(audio_data_t *audio) {
+    if (audio && audio->data) {
+        free(audio->data);
+        audio->data = NULL;
+        audio->sample_count = 0;
+        audio->sample_rate = 0;
+        audio->channels = 0;
+    }
+}
@@ -12,6 +12,25 @@ typedef struct {
     size_t channels;             // Number of channels (1=mono, 2=stereo)
 } audio_data_t;
 
+// Stream information reported when a decoder is opened
+typedef struct {
+    uint32_t sample_rate;        // Sample rate (Hz)
+    size_t channels;             // Channels in the file (decoded output is always mono)
+    size_t frame_count;          // Total frames (upper bound for compressed formats)
+} audio_stream_info_t;
+
+// Streaming decoder, implemented per platform:
+//   audio_loader_macos.c    - ExtAudioFile (MP3, WAV, AIFF, AAC, ...)
+//   audio_loader_portable.c - WAV (PCM 8/16/24/32-bit, float) and MP3 (mp3_decoder.c)
+typedef struct audio_decoder audio_decoder_t;
+
+int audio_decoder_open(const char *filepath, audio_decoder_t **decoder, audio_stream_info_t *info);
+// Decodes up to frame_count mono frames into out; returns frames written (0 at end)
+size_t audio_decoder_read(audio_decoder_t *decoder, int16_t *out, size_t frame_count);
+// Repositions to an absolute frame; the next read starts there
+int audio_decoder_seek(audio_decoder_t *decoder, size_t frame);
+void audio_decoder_close(audio_decoder_t *decoder);
+
 // Load audio file (MP3, WAV, etc.) and convert to PCM
 int audio_load_file(const char *filepath, audio_data_t *audio);
 void audio_free(audio_data_t *audio);
@@ -6,12 +6,16 @@
 #include <stdlib.h>
 #include <string.h>
 
-int audio_load_file(const char *filepath, audio_data_t *audio) {
-    if (!filepath || !audio) {
+struct audio_decoder {
+    ExtAudioFileRef file;
+};
+
+int audio_decoder_open(const char *filepath, audio_decoder_t **decoder, audio_stream_info_t *info) {
+    if (!filepath || !decoder || !info) {
         return -1;
     }
     
-    memset(audio, 0, sizeof(*audio));
+    memset(info, 0, sizeof(*info));
     
     CFStringRef path = CFStringCreateWithCString(NULL, filepath, kCFStringEncodingUTF8);
     if (!path) {
@@ -73,43 +77,59 @@ int audio_load_file(const char *filepath, audio_data_t *audio) {
     size = sizeof(numFrames);
     ExtAudioFileGetProperty(extAudioFile, kExtAudioFileProperty_FileLengthFrames, &size, &numFrames);
     
-    size_t bufferSize = numFrames * outputFormat.mBytesPerFrame;
-    int16_t *buffer = malloc(bufferSize);
+    audio_decoder_t *dec = calloc(1, sizeof(*dec));
+    if (!dec) {
+        ExtAudioFileDispose(extAudioFile);
+        return -1;
+    }
+    dec->file = extAudioFile;
+    
+    info->sample_rate = (uint32_t)outputFormat.mSampleRate;
+    info->channels = sourceFormat.mChannelsPerFrame;
+    info->frame_count = numFrames > 0 ? (size_t)numFrames : 0;
+    *decoder = dec;
+    return 0;
+}
+
+size_t audio_decoder_read(audio_decoder_t *decoder, int16_t *out, size_t frame_count) {
+    if (!decoder || !out || frame_count == 0) {
+        return 0;
+    }
     
     AudioBufferList bufferList;
     bufferList.mNumberBuffers = 1;
     bufferList.mBuffers[0].mNumberChannels = 1;
-    bufferList.mBuffers[0].mDataByteSize = bufferSize;
-    bufferList.mBuffers[0].mData = buffer;
-    
-    UInt32 numFramesRead = (UInt32)numFrames;
-    status = ExtAudioFileRead(extAudioFile, &numFramesRead, &bufferList);
-    
-    ExtAudioFileDispose(extAudioFile);
+    bufferList.mBuffers[0].mDataByteSize = (UInt32)(frame_count * sizeof(int16_t));
+    bufferList.mBuffers[0].mData = out;
     
+    UInt32 numFramesRead = (UInt32)frame_count;
+    OSStatus status = ExtAudioFileRead(decoder->file, &numFramesRead, &bufferList);
     if (status != noErr) {
-        free(buffer);
-        fprintf(stderr, "[AUDIO] Failed to read audio data\n");
+        fprintf(stderr, "[AUDIO] Failed to read audio data (status=%d)\n", (int)status);
+        return 0;
+    }
+    return numFramesRead;
+}
+
+int audio_decoder_seek(audio_decoder_t *decoder, size_t frame) {
+    if (!decoder) {
+        return -1;
+    }
+    // Frames are in the client format, which keeps the file's sample rate
+    OSStatus status = ExtAudioFileSeek(decoder->file, (SInt64)frame);
+    if (status != noErr) {
+        fprintf(stderr, "[AUDIO] Failed to seek (status=%d)\n", (int)status);
         return -1;
     }
-    
-    audio->data = buffer;
-    audio->sample_count = numFramesRead;
-    audio->sample_rate = (uint32_t)outputFormat.mSampleRate;
-    audio->channels = 1;
-    
-    printf("[AUDIO] Loaded %s: %zu samples @ %u Hz\n", filepath, audio->sample_count, audio->sample_rate);
     return 0;
 }
 
-void audio_free(audio_data_t *audio) {
-    if (audio && audio->data) {
-        free(audio->data);
-        audio->data = NULL;
-        audio->sample_count = 0;
-        audio->sample_rate = 0;
-        audio->channels = 0;
+void audio_decoder_close(audio_decoder_t *decoder) {
+    if (!decoder) {
+        return;
     }
+    ExtAudioFileDispose(decoder->file);
+    free(decoder);
 }
 
 #endif // __APPLE__
@@ -0,0 +1,433 @@
+#ifndef __APPLE__
+
+// Portable decoder used on Linux and ESP32: WAV (PCM 8/16/24/32-bit and
+// IEEE float, any channel count) is parsed here and streamed from disk.
+// MP3 (MPEG-1 Layer III) is decoded by mp3_decoder.c; frame counts for
+// preallocation come from a header scan that needs no decoding.
+
+#include "audio_loader.h"
+#include "mp3_decoder.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_IEEE_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define DECODE_CHUNK_BYTES 16384
+
+typedef enum {
+    DECODER_WAV = 0,
+    DECODER_MP3
+} decoder_kind_t;
+
+struct audio_decoder {
+    decoder_kind_t kind;
+    FILE *file;
+    size_t channels;
+
+    // WAV
+    uint16_t wav_format;
+    uint16_t bits_per_sample;
+    uint16_t block_align;
+    long data_offset;           // File offset of the first frame
+    size_t data_frames;
+    size_t frames_left;
+    uint8_t chunk[DECODE_CHUNK_BYTES];
+
+    // MP3 (whole compressed file is kept in memory; it is small)
+    uint8_t *mp3_data;
+    size_t mp3_size;
+    size_t mp3_offset;
+    size_t mp3_start;           // First byte after any ID3 tag
+    uint32_t mp3_sample_rate;
+    mp3_decoder_t *mp3;
+    int16_t pcm[MP3_MAX_FRAME_SAMPLES * 2];
+    size_t pcm_frames;
+    size_t pcm_pos;
+};
+
+static uint16_t read_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ---------------------------------------------------------------------------
+// WAV
+// ---------------------------------------------------------------------------
+
+static int wav_open(audio_decoder_t *dec, const char *filepath, audio_stream_info_t *info) {
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), dec->file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "[AUDIO] Not a RIFF/WAVE file: %s\n", filepath);
+        return -1;
+    }
+
+    bool have_format = false;
+    uint32_t sample_rate = 0;
+    for (;;) {
+        uint8_t chunk_header[8];
+        if (fread(chunk_header, 1, sizeof(chunk_header), dec->file) != sizeof(chunk_header)) {
+            fprintf(stderr, "[AUDIO] No data chunk in %s\n", filepath);
+            return -1;
+        }
+        uint32_t chunk_size = read_le32(chunk_header + 4);
+
+        if (memcmp(chunk_header, "fmt ", 4) == 0) {
+            uint8_t fmt[40] = {0};
+            size_t want = chunk_size < sizeof(fmt) ? chunk_size : sizeof(fmt);
+            if (chunk_size < 16 || fread(fmt, 1, want, dec->file) != want) {
+                fprintf(stderr, "[AUDIO] Bad fmt chunk in %s\n", filepath);
+                return -1;
+            }
+            if (chunk_size > want) {
+                fseek(dec->file, (long)(chunk_size - want), SEEK_CUR);
+            }
+
+            dec->wav_format = read_le16(fmt);
+            dec->channels = read_le16(fmt + 2);
+            sample_rate = read_le32(fmt + 4);
+            dec->block_align = read_le16(fmt + 12);
+            dec->bits_per_sample = read_le16(fmt + 14);
+            if (dec->wav_format == WAV_FORMAT_EXTENSIBLE && chunk_size >= 26) {
+                dec->wav_format = read_le16(fmt + 24); // First two bytes of the sub-format GUID
+            }
+            have_format = true;
+        } else if (memcmp(chunk_header, "data", 4) == 0) {
+            if (!have_format) {
+                fprintf(stderr, "[AUDIO] data chunk before fmt chunk in %s\n", filepath);
+                return -1;
+            }
+            dec->data_offset = ftell(dec->file);
+            dec->data_frames = dec->block_align ? chunk_size / dec->block_align : 0;
+            dec->frames_left = dec->data_frames;
+            break;
+        } else {
+            // Chunks are word aligned
+            fseek(dec->file, (long)(chunk_size + (chunk_size & 1)), SEEK_CUR);
+        }
+    }
+
+    bool supported =
+        (dec->wav_format == WAV_FORMAT_PCM &&
+         (dec->bits_per_sample == 8 || dec->bits_per_sample == 16 ||
+          dec->bits_per_sample == 24 || dec->bits_per_sample == 32)) ||
+        (dec->wav_format == WAV_FORMAT_IEEE_FLOAT &&
+         (dec->bits_per_sample == 32 || dec->bits_per_sample == 64));
+    if (!supported || dec->channels == 0 ||
+        dec->block_align != dec->channels * (dec->bits_per_sample / 8) ||
+        dec->block_align > DECODE_CHUNK_BYTES) {
+        fprintf(stderr, "[AUDIO] Unsupported WAV format %u/%u-bit/%zu ch: %s\n",
+                dec->wav_format, dec->bits_per_sample, dec->channels, filepath);
+        return -1;
+    }
+
+    info->sample_rate = sample_rate;
+    info->channels = dec->channels;
+    info->frame_count = dec->frames_left;
+    return 0;
+}
+
+// One channel sample converted to float on the int16 scale
+static float wav_sample(const audio_decoder_t *dec, const uint8_t *p) {
+    switch (dec->bits_per_sample) {
+        case 8:
+            return (float)((int)p[0] - 128) * 256.0f;
+        case 16:
+            return (float)(int16_t)read_le16(p);
+        case 24: {
+            int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+            return (float)(v >> 8) / 256.0f;
+        }
+        case 32:
+            if (dec->wav_format == WAV_FORMAT_IEEE_FLOAT) {
+                uint32_t bits = read_le32(p);
+                float f;
+                memcpy(&f, &bits, sizeof(f));
+                return f * 32768.0f;
+            }
+            return (float)(int32_t)read_le32(p) / 65536.0f;
+        case 64: {
+            uint64_t bits = (uint64_t)read_le32(p) | ((uint64_t)read_le32(p + 4) << 32);
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            return (float)(d * 32768.0);
+        }
+        default:
+            return 0.0f;
+    }
+}
+
+static int16_t clamp_sample(float s) {
+    s = s > 32767.0f ? 32767.0f : (s < -32768.0f ? -32768.0f : s);
+    return (int16_t)(s < 0.0f ? s - 0.5f : s + 0.5f);
+}
+
+static size_t wav_read(audio_decoder_t *dec, int16_t *out, size_t frame_count) {
+    size_t bytes_per_sample = dec->bits_per_sample / 8;
+    float channel_scale = 1.0f / (float)dec->channels;
+    size_t written = 0;
+
+    while (written < frame_count && dec->frames_left > 0) {
+        size_t frames = DECODE_CHUNK_BYTES / dec->block_align;
+        if (frames > frame_count - written) frames = frame_count - written;
+        if (frames > dec->frames_left) frames = dec->frames_left;
+
+        size_t got = fread(dec->chunk, dec->block_align, frames, dec->file);
+        if (got == 0) {
+            dec->frames_left = 0; // Truncated file
+            break;
+        }
+
+        const uint8_t *p = dec->chunk;
+        for (size_t f = 0; f < got; f++) {
+            if (dec->channels == 1 && dec->bits_per_sample == 16) {
+                out[written + f] = (int16_t)read_le16(p);
+                p += 2;
+                continue;
+            }
+            // Downmix to mono by averaging channels
+            float sum = 0.0f;
+            for (size_t c = 0; c < dec->channels; c++) {
+                sum += wav_sample(dec, p);
+                p += bytes_per_sample;
+            }
+            out[written + f] = clamp_sample(sum * channel_scale);
+        }
+
+        written += got;
+        dec->frames_left -= got;
+    }
+    return written;
+}
+
+static int wav_seek(audio_decoder_t *dec, size_t frame) {
+    if (frame > dec->data_frames ||
+        fseek(dec->file, dec->data_offset + (long)(frame * dec->block_align), SEEK_SET) != 0) {
+        return -1;
+    }
+    dec->frames_left = dec->data_frames - frame;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// MP3
+// ---------------------------------------------------------------------------
+
+static size_t mp3_skip_id3(const uint8_t *data, size_t size) {
+    if (size >= 10 && memcmp(data, "ID3", 3) == 0) {
+        size_t tag = ((size_t)(data[6] & 0x7F) << 21) | ((size_t)(data[7] & 0x7F) << 14) |
+                     ((size_t)(data[8] & 0x7F) << 7) | (size_t)(data[9] & 0x7F);
+        tag += 10;
+        if (data[5] & 0x10) {
+            tag += 10; // Footer present
+        }
+        return tag < size ? tag : size;
+    }
+    return 0;
+}
+
+static int mp3_open(audio_decoder_t *dec, const char *filepath, audio_stream_info_t *info) {
+    fseek(dec->file, 0, SEEK_END);
+    long size = ftell(dec->file);
+    fseek(dec->file, 0, SEEK_SET);
+    if (size <= 0) {
+        return -1;
+    }
+
+    dec->mp3_data = malloc((size_t)size);
+    if (!dec->mp3_data || fread(dec->mp3_data, 1, (size_t)size, dec->file) != (size_t)size) {
+        fprintf(stderr, "[AUDIO] Failed to read %s\n", filepath);
+        return -1;
+    }
+    dec->mp3_size = (size_t)size;
+    dec->mp3_start = mp3_skip_id3(dec->mp3_data, dec->mp3_size);
+    dec->mp3_offset = dec->mp3_start;
+
+    // Walk frame headers to size the output buffer without decoding
+    size_t offset = dec->mp3_offset;
+    size_t frames = 0;
+    uint32_t sample_rate = 0;
+    size_t channels = 0;
+    bool mpeg1 = false;
+    while (offset + 4 <= dec->mp3_size) {
+        mp3_frame_header_t header;
+        size_t length = mp3_parse_header(dec->mp3_data + offset, dec->mp3_size - offset, &header);
+        if (length == 0 || (sample_rate != 0 && header.sample_rate != sample_rate)) {
+            offset++; // Resync
+            continue;
+        }
+        if (sample_rate == 0) {
+            sample_rate = header.sample_rate;
+            channels = header.channels;
+            mpeg1 = header.mpeg1;
+        }
+        frames += header.samples;
+        offset += length;
+    }
+
+    if (sample_rate == 0) {
+        fprintf(stderr, "[AUDIO] No MPEG Layer III frames in %s\n", filepath);
+        return -1;
+    }
+    if (!mpeg1) {
+        fprintf(stderr, "[AUDIO] %s is MPEG-2/2.5 (16-24 kHz or lower), which only Mac OS decodes; "
+                "re-encode it at 32, 44.1 or 48 kHz or convert it to WAV\n", filepath);
+        return -1;
+    }
+
+    dec->mp3 = mp3_decoder_create();
+    if (!dec->mp3) {
+        return -1;
+    }
+    dec->pcm_frames = 0;
+    dec->pcm_pos = 0;
+    dec->mp3_sample_rate = sample_rate;
+
+    dec->channels = channels;
+    info->sample_rate = sample_rate;
+    info->channels = channels;
+    info->frame_count = frames;
+    return 0;
+}
+
+static size_t mp3_read(audio_decoder_t *dec, int16_t *out, size_t frame_count) {
+    size_t written = 0;
+    while (written < frame_count) {
+        if (dec->pcm_pos == dec->pcm_frames) {
+            if (dec->mp3_offset + 4 > dec->mp3_size) {
+                break;
+            }
+            mp3_frame_header_t frame;
+            int samples = mp3_decoder_decode(dec->mp3, dec->mp3_data + dec->mp3_offset,
+                                             dec->mp3_size - dec->mp3_offset, dec->pcm, &frame);
+            if (samples < 0 || frame.sample_rate != dec->mp3_sample_rate) {
+                dec->mp3_offset++; // Resync past junk, as the header scan did
+                continue;
+            }
+            dec->mp3_offset += frame.frame_bytes;
+            dec->pcm_frames = (size_t)samples;
+            dec->pcm_pos = 0;
+            dec->channels = frame.channels;
+            continue;
+        }
+
+        size_t n = dec->pcm_frames - dec->pcm_pos;
+        if (n > frame_count - written) n = frame_count - written;
+        for (size_t i = 0; i < n; i++) {
+            size_t frame_index = dec->pcm_pos + i;
+            if (dec->channels == 2) {
+                int32_t l = dec->pcm[frame_index * 2];
+                int32_t r = dec->pcm[frame_index * 2 + 1];
+                out[written + i] = (int16_t)((l + r) / 2);
+            } else {
+                out[written + i] = dec->pcm[frame_index];
+            }
+        }
+        dec->pcm_pos += n;
+        written += n;
+    }
+    return written;
+}
+
+// MP3 frames depend on the bit reservoir of earlier frames, so seeking
+// decodes from the start and discards everything before the target
+static int mp3_seek(audio_decoder_t *dec, size_t frame) {
+    mp3_decoder_reset(dec->mp3);
+    dec->mp3_offset = dec->mp3_start;
+    dec->pcm_frames = 0;
+    dec->pcm_pos = 0;
+
+    int16_t discard[1024];
+    while (frame > 0) {
+        size_t want = frame < 1024 ? frame : 1024;
+        size_t got = mp3_read(dec, discard, want);
+        if (got == 0) {
+            return -1;
+        }
+        frame -= got;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------------------
+
+static bool has_extension(const char *filepath, const char *ext) {
+    size_t len = strlen(filepath);
+    size_t ext_len = strlen(ext);
+    if (len < ext_len) return false;
+    const char *tail = filepath + len - ext_len;
+    for (size_t i = 0; i < ext_len; i++) {
+        char c = tail[i];
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        if (c != ext[i]) return false;
+    }
+    return true;
+}
+
+int audio_decoder_open(const char *filepath, audio_decoder_t **decoder, audio_stream_info_t *info) {
+    if (!filepath || !decoder || !info) {
+        return -1;
+    }
+
+    memset(info, 0, sizeof(*info));
+
+    FILE *file = fopen(filepath, "rb");
+    if (!file) {
+        fprintf(stderr, "[AUDIO] Failed to open audio file: %s\n", filepath);
+        return -1;
+    }
+
+    audio_decoder_t *dec = calloc(1, sizeof(*dec));
+    if (!dec) {
+        fclose(file);
+        return -1;
+    }
+    dec->file = file;
+    dec->kind = has_extension(filepath, ".mp3") ? DECODER_MP3 : DECODER_WAV;
+
+    int result = dec->kind == DECODER_MP3 ? mp3_open(dec, filepath, info) : wav_open(dec, filepath, info);
+    if (result != 0) {
+        audio_decoder_close(dec);
+        return -1;
+    }
+
+    *decoder = dec;
+    return 0;
+}
+
+size_t audio_decoder_read(audio_decoder_t *decoder, int16_t *out, size_t frame_count) {
+    if (!decoder || !out || frame_count == 0) {
+        return 0;
+    }
+    return decoder->kind == DECODER_MP3 ? mp3_read(decoder, out, frame_count)
+                                        : wav_read(decoder, out, frame_count);
+}
+
+int audio_decoder_seek(audio_decoder_t *decoder, size_t frame) {
+    if (!decoder) {
+        return -1;
+    }
+    return decoder->kind == DECODER_MP3 ? mp3_seek(decoder, frame) : wav_seek(decoder, frame);
+}
+
+void audio_decoder_close(audio_decoder_t *decoder) {
+    if (!decoder) {
+        return;
+    }
+    if (decoder->file) {
+        fclose(decoder->file);
+    }
+    mp3_decoder_destroy(decoder->mp3);
+    free(decoder->mp3_data);
+    free(decoder);
+}
+
+#endif // !__APPLE__
@@ -0,0 +1,510 @@
+#include "bank_loader.h"
+#include "adpcm.h"
+#include "audio_loader.h"
+#include "midi_soundboard.h"
+#include "monotonic_clock.h"
+#include "resampler.h"
+#include "sample_cache.h"
+#include "soundbank.h"
+#include "sound_stream.h"
+#include "thread_pool.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef ESP_PLATFORM
+#include <sys/resource.h>
+#endif
+
+typedef struct {
+    const config_t *config;
+    thread_pool_t *pool;
+    uint64_t start_ns;
+    soundbank_t bank;            // Current cache (empty if none)
+    soundbank_t *old_banks;      // Replaced caches; soundbites may still map them
+    size_t old_bank_count;
+    soundbank_item_t *items;     // What each sound of the batch was decoded from
+    int16_t **scratch;           // Decoded audio of ADPCM sounds, kept for the cache write
+    size_t *jobs;                // Sound index of each job in the batch
+    size_t job_count;
+    char cache_path[1024];
+    _Atomic size_t processed;    // Jobs past the load step
+    _Atomic size_t completed;    // Jobs done (the last one after writing the cache)
+    _Atomic size_t loaded;
+    _Atomic size_t cached;
+    _Atomic bool stale;          // Some sound was decoded; rewrite the cache
+    _Atomic bool cancel;
+} bank_load_t;
+
+static bank_load_t load;
+
+// Peak resident set size of the process in KiB (0 where unsupported)
+static size_t peak_rss_kib(void) {
+#ifndef ESP_PLATFORM
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return (size_t)usage.ru_maxrss / 1024; // Bytes on Darwin
+#else
+        return (size_t)usage.ru_maxrss;        // KiB on Linux
+#endif
+    }
+#endif
+    return 0;
+}
+
+// Encodes samples and registers them as an ADPCM soundbite
+static int adopt_adpcm(const sound_config_t *sound_cfg, const int16_t *samples, size_t count, uint32_t sample_rate) {
+    uint8_t *blocks;
+    if (adpcm_encode(samples, count, &blocks) != 0) {
+        return -1;
+    }
+    if (soundboard_adopt_adpcm(sound_cfg->page, sound_cfg->note, blocks, count, sample_rate,
+                               sound_cfg->volume_offset, sound_cfg->mode, sound_cfg->max_instances) != 0) {
+        free(blocks);
+        return -1;
+    }
+    return 0;
+}
+
+// The entry a sound can be played from, if it is still valid for the config
+// and the source file
+static const soundbank_entry_t *current_entry(const sound_config_t *sound_cfg, const char *filepath) {
+    const soundbank_entry_t *entry = soundbank_find(&load.bank, sound_cfg);
+    if (entry == NULL || entry->resample != (uint8_t)sound_cfg->resample) {
+        return NULL;
+    }
+#ifdef ESP_PLATFORM
+    // The flash bank is the only copy of the sounds
+    (void)filepath;
+    return entry;
+#else
+    return soundbank_source_fresh(&entry->source, filepath) ? entry : NULL;
+#endif
+}
+
+// What a sound outside the batch keeps in a rewritten cache
+static soundbank_item_t entry_item(const sound_config_t *sound_cfg, const soundbank_entry_t *entry) {
+    bool adpcm = entry->storage == STORAGE_ADPCM;
+    return (soundbank_item_t){
+        .sound = sound_cfg,
+        .samples = adpcm ? NULL : soundbank_samples(&load.bank, entry),
+        .adpcm = adpcm ? soundbank_adpcm(&load.bank, entry) : NULL,
+        .sample_count = entry->sample_count,
+        .sample_rate = entry->sample_rate,
+        .source = entry->source,
+    };
+}
+
+// Registers the sound straight from the mapped bank if its entry is still
+// valid. Stored ADPCM is played in place; PCM entries of ADPCM sounds are
+// encoded from the mapping instead of being decoded again.
+static bool load_cached(size_t index, const char *filepath) {
+    const sound_config_t *sound_cfg = &load.config->sounds[index];
+    const soundbank_entry_t *entry = current_entry(sound_cfg, filepath);
+    if (entry == NULL) {
+        return false;
+    }
+
+    int result;
+    if (entry->storage == STORAGE_ADPCM) {
+        result = soundboard_map_adpcm(sound_cfg->page, sound_cfg->note, soundbank_adpcm(&load.bank, entry),
+                                      entry->sample_count, entry->sample_rate, sound_cfg->volume_offset,
+                                      sound_cfg->mode, sound_cfg->max_instances);
+    } else if (sound_cfg->storage == STORAGE_ADPCM) {
+        result = adopt_adpcm(sound_cfg, soundbank_samples(&load.bank, entry), entry->sample_count,
+                             entry->sample_rate);
+    } else {
+        result = soundboard_map_soundbite(sound_cfg->page, sound_cfg->note, soundbank_samples(&load.bank, entry),
+                                          entry->sample_count, entry->sample_rate, sound_cfg->volume_offset,
+                                          sound_cfg->mode, sound_cfg->max_instances);
+    }
+    if (result != 0) {
+        return false;
+    }
+
+    load.items[index] = entry_item(sound_cfg, entry);
+    atomic_fetch_add(&load.loaded, 1);
+    atomic_fetch_add(&load.cached, 1);
+    printf("[LOADER] Ready page=%u note=%u %s (cached)\n",
+           sound_cfg->page, sound_cfg->note, sound_cfg->filename);
+    return true;
+}
+
+// Long sounds are streamed from disk instead of being decoded into RAM
+static bool wants_stream(const sound_config_t *sound_cfg, const char *filepath) {
+    if (sound_cfg->stream != STREAM_AUTO) {
+        return sound_cfg->stream == STREAM_ALWAYS;
+    }
+    uint32_t threshold = load.config->stream_threshold_seconds;
+    if (threshold == 0) {
+        return false;
+    }
+
+    // A cached entry already knows the length; otherwise ask the decoder
+    const soundbank_entry_t *entry = soundbank_find(&load.bank, sound_cfg);
+    if (entry != NULL && entry->sample_rate > 0) {
+        return entry->sample_count / entry->sample_rate > threshold;
+    }
+    audio_decoder_t *decoder;
+    audio_stream_info_t info;
+    if (audio_decoder_open(filepath, &decoder, &info) != 0) {
+        return false;
+    }
+    audio_decoder_close(decoder);
+    return info.sample_rate > 0 && info.frame_count / info.sample_rate > threshold;
+}
+
+static bool load_streamed(size_t index, const char *filepath) {
+    const sound_config_t *sound_cfg = &load.config->sounds[index];
+
+    uint64_t t0 = clock_now_ns();
+    sound_stream_t *stream = sound_stream_open(filepath);
+    if (stream == NULL) {
+        fprintf(stderr, "[LOADER] Can't stream %s, loading it into memory\n", filepath);
+        return false;
+    }
+    if (sound_stream_sample_rate(stream) != SOUNDBOARD_SAMPLE_RATE) {
+        fprintf(stderr, "[LOADER] %s is not at %u Hz, loading it into memory instead of streaming\n",
+                filepath, SOUNDBOARD_SAMPLE_RATE);
+        sound_stream_close(stream);
+        return false;
+    }
+    if (soundboard_stream_soundbite(sound_cfg->page, sound_cfg->note, stream,
+                                    sound_cfg->volume_offset, sound_cfg->mode) != 0) {
+        fprintf(stderr, "[LOADER] Failed to register soundbite: %s\n", filepath);
+        sound_stream_close(stream);
+        return false;
+    }
+
+    atomic_fetch_add(&load.loaded, 1);
+    printf("[LOADER] Ready page=%u note=%u %s (streamed, %.1f s, opened in %.1f ms)\n",
+           sound_cfg->page, sound_cfg->note, sound_cfg->filename,
+           (double)sound_stream_length(stream) / SOUNDBOARD_SAMPLE_RATE, (clock_now_ns() - t0) / 1e6);
+    return true;
+}
+
+// Under a memory budget, sounds are decoded whole while they fit and only
+// their attack once it is spent; the cache reloads the rest on demand.
+// Sounds no longer than the attack are always kept and not counted.
+static bool load_budgeted(size_t index, const char *filepath) {
+    const sound_config_t *sound_cfg = &load.config->sounds[index];
+
+    audio_decoder_t *decoder;
+    audio_stream_info_t info;
+    if (audio_decoder_open(filepath, &decoder, &info) != 0) {
+        return false;
+    }
+    audio_decoder_close(decoder);
+    size_t frames = info.frame_count;
+    uint32_t rate = info.sample_rate;
+    if (sound_cfg->resample == RESAMPLE_AT_LOAD && rate > 0 && rate != SOUNDBOARD_SAMPLE_RATE) {
+        frames = (size_t)((uint64_t)frames * SOUNDBOARD_SAMPLE_RATE / rate);
+        rate = SOUNDBOARD_SAMPLE_RATE;
+    }
+    size_t attack_frames = sample_cache_attack_frames(rate);
+    if (frames <= attack_frames) {
+        return false;
+    }
+
+    uint64_t t0 = clock_now_ns();
+    size_t bytes = frames * sizeof(int16_t);
+    bool whole = sample_cache_reserve(bytes);
+    audio_data_t audio;
+    if (sample_cache_decode(filepath, sound_cfg->resample, whole ? 0 : attack_frames, &audio) != 0) {
+        fprintf(stderr, "[LOADER] Failed to load: %s\n", filepath);
+        if (whole) {
+            sample_cache_unreserve(bytes);
+        }
+        return true;
+    }
+
+    if (soundboard_adopt_evictable(sound_cfg->page, sound_cfg->note, audio.data, audio.sample_count, whole,
+                                   bytes, audio.sample_rate, filepath, sound_cfg->resample,
+                                   sound_cfg->volume_offset, sound_cfg->mode, sound_cfg->max_instances) != 0) {
+        fprintf(stderr, "[LOADER] Failed to register soundbite: %s\n", filepath);
+        audio_free(&audio);
+        if (whole) {
+            sample_cache_unreserve(bytes);
+        }
+        return true;
+    }
+
+    // The cache may evict the buffer at any time, so it is not written to
+    // the sound bank
+    atomic_fetch_add(&load.loaded, 1);
+    printf("[LOADER] Ready page=%u note=%u %s (%s, %.1f ms)\n",
+           sound_cfg->page, sound_cfg->note, sound_cfg->filename,
+           whole ? "decoded" : "attack only", (clock_now_ns() - t0) / 1e6);
+    return true;
+}
+
+static void load_sound(size_t index) {
+    const sound_config_t *sound_cfg = &load.config->sounds[index];
+
+    char filepath[1024];
+    snprintf(filepath, sizeof(filepath), "%s%s", load.config->base_path, sound_cfg->filename);
+
+#ifdef ESP_PLATFORM
+    // There are no files to decode: every sound plays from the flash bank
+    if (!load_cached(index, filepath)) {
+        fprintf(stderr, "[LOADER] Not in the flash bank: %s\n", sound_cfg->filename);
+    }
+    return;
+#endif
+
+    if (wants_stream(sound_cfg, filepath) && load_streamed(index, filepath)) {
+        return;
+    }
+    if (load_cached(index, filepath)) {
+        return;
+    }
+    if (sound_cfg->storage == STORAGE_PCM && sample_cache_enabled() && load_budgeted(index, filepath)) {
+        return;
+    }
+
+    uint64_t t0 = clock_now_ns();
+    audio_data_t audio = {0};
+    if (audio_load_file(filepath, &audio) != 0) {
+        fprintf(stderr, "[LOADER] Failed to load: %s\n", filepath);
+        return;
+    }
+
+    uint64_t t1 = clock_now_ns();
+    if (sound_cfg->resample == RESAMPLE_AT_LOAD && audio.sample_rate != SOUNDBOARD_SAMPLE_RATE) {
+        int16_t *converted = NULL;
+        size_t converted_count = 0;
+        if (resample_sinc(audio.data, audio.sample_count, audio.sample_rate, SOUNDBOARD_SAMPLE_RATE,
+                          &converted, &converted_count) == 0) {
+            audio_free(&audio);
+            audio.data = converted;
+            audio.sample_count = converted_count;
+            audio.sample_rate = SOUNDBOARD_SAMPLE_RATE;
+        } else {
+            fprintf(stderr, "[LOADER] Failed to resample %s, using realtime conversion\n", filepath);
+        }
+    }
+
+    // Registration publishes the pad atomically; it is playable from here on
+    uint64_t t2 = clock_now_ns();
+    soundbank_item_t item = {
+        .sound = sound_cfg,
+        .samples = audio.data,
+        .sample_count = audio.sample_count,
+        .sample_rate = audio.sample_rate,
+    };
+    bool adpcm = sound_cfg->storage == STORAGE_ADPCM;
+    int result;
+    if (adpcm) {
+        result = adopt_adpcm(sound_cfg, audio.data, audio.sample_count, audio.sample_rate);
+    } else {
+        result = soundboard_adopt_soundbite(sound_cfg->page, sound_cfg->note,
+                                            audio.data, audio.sample_count, audio.sample_rate,
+                                            sound_cfg->volume_offset, sound_cfg->mode,
+                                            sound_cfg->max_instances);
+    }
+    uint64_t t3 = clock_now_ns();
+
+    if (result != 0) {
+        fprintf(stderr, "[LOADER] Failed to register soundbite: %s\n", filepath);
+        audio_free(&audio);
+        return;
+    }
+
+    // The soundboard now owns the decoded buffer, which stays valid for the
+    // cache write. ADPCM sounds keep the buffer here until then.
+    atomic_fetch_add(&load.loaded, 1);
+    printf("[LOADER] Ready page=%u note=%u %s (decode %.1f ms, convert %.1f ms, register %.1f ms%s)\n",
+           sound_cfg->page, sound_cfg->note, sound_cfg->filename,
+           (t1 - t0) / 1e6, (t2 - t1) / 1e6, (t3 - t2) / 1e6, adpcm ? ", ADPCM" : "");
+
+    if (soundbank_source_stat(filepath, &item.source, true) == 0) {
+        load.items[index] = item;
+        atomic_store(&load.stale, true);
+        if (adpcm) {
+            load.scratch[index] = audio.data;
+            return;
+        }
+    }
+    if (adpcm) {
+        audio_free(&audio);
+    }
+}
+
+static void free_scratch(void) {
+    for (size_t i = 0; load.scratch != NULL && i < load.config->sound_count; i++) {
+        free(load.scratch[i]);
+        load.scratch[i] = NULL;
+    }
+}
+
+// Rewrites the cache if anything had to be decoded. Sounds outside the batch
+// keep their entries from the current cache, which is then swapped for the
+// new file; soundbites may point into the old mapping, so it stays mapped.
+static void write_cache(void) {
+    if (atomic_load(&load.cancel) || !atomic_load(&load.stale)) {
+        return;
+    }
+
+    for (size_t i = 0; i < load.config->sound_count; i++) {
+        const sound_config_t *sound_cfg = &load.config->sounds[i];
+        const soundbank_entry_t *entry = soundbank_find(&load.bank, sound_cfg);
+        if (load.items[i].samples != NULL || load.items[i].adpcm != NULL || entry == NULL ||
+            entry->resample != (uint8_t)sound_cfg->resample) {
+            continue;
+        }
+        load.items[i] = entry_item(sound_cfg, entry);
+    }
+    if (soundbank_write(load.cache_path, load.items, load.config->sound_count, SOUNDBOARD_SAMPLE_RATE) != 0) {
+        return;
+    }
+
+    soundbank_t fresh;
+    soundbank_t *old_banks = realloc(load.old_banks, (load.old_bank_count + 1) * sizeof(*old_banks));
+    if (old_banks == NULL) {
+        return;
+    }
+    load.old_banks = old_banks;
+    if (soundbank_open(load.cache_path, &fresh) == 0) {
+        if (load.bank.header != NULL) {
+            load.old_banks[load.old_bank_count++] = load.bank;
+        }
+        load.bank = fresh;
+    }
+}
+
+static void load_job(size_t job, void *ctx) {
+    (void)ctx;
+
+    if (!atomic_load(&load.cancel)) {
+        load_sound(load.jobs[job]);
+    }
+
+    // The last job to finish writes the cache, so it never happens on the
+    // MIDI thread; the batch only counts as done once it is written
+    if (atomic_fetch_add(&load.processed, 1) + 1 == load.job_count) {
+        write_cache();
+        free_scratch();
+    }
+    atomic_fetch_add(&load.completed, 1);
+}
+
+int bank_loader_start(const config_t *config) {
+    if (config == NULL || load.config != NULL) {
+        return -1;
+    }
+
+    size_t count = config->sound_count ? config->sound_count : 1;
+    load.items = calloc(count, sizeof(*load.items));
+    load.jobs = calloc(count, sizeof(*load.jobs));
+    load.scratch = calloc(count, sizeof(*load.scratch));
+    if (load.items == NULL || load.jobs == NULL || load.scratch == NULL) {
+        bank_loader_cleanup();
+        return -1;
+    }
+
+    load.config = config;
+    load.job_count = 0;
+    atomic_store(&load.processed, 0);
+    atomic_store(&load.completed, 0);
+    atomic_store(&load.cancel, false);
+
+#ifdef ESP_PLATFORM
+    // The bank packed by soundbank_pack, played from flash. Entries carry
+    // their own rate, so a bank packed for another output rate still plays
+    // at the right pitch (converted while mixing).
+    return soundbank_open_partition(SOUNDBANK_PARTITION_LABEL, &load.bank);
+#endif
+
+    // Sounds whose cache entry is still valid are played straight from the
+    // mapping; only new or changed files are decoded
+    snprintf(load.cache_path, sizeof(load.cache_path), "%s%s", config->base_path, SOUNDBANK_CACHE_NAME);
+    if (soundbank_open(load.cache_path, &load.bank) == 0 &&
+        load.bank.header->output_rate != SOUNDBOARD_SAMPLE_RATE) {
+        soundbank_close(&load.bank);
+    }
+    return 0;
+}
+
+int bank_loader_load_pages(uint32_t page_mask, uint8_t first_page) {
+    if (load.config == NULL || load.pool != NULL || atomic_load(&load.cancel)) {
+        return -1;
+    }
+
+    // Sounds on first_page are queued ahead of the rest; jobs are picked up
+    // in order
+    const config_t *config = load.config;
+    size_t job_count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < config->sound_count; i++) {
+            uint8_t page = config->sounds[i].page;
+            if ((page_mask & (1u << page)) != 0 && (page == first_page) == (pass == 0)) {
+                load.jobs[job_count++] = i;
+            }
+        }
+    }
+
+    memset(load.items, 0, config->sound_count * sizeof(*load.items));
+    load.job_count = job_count;
+    load.start_ns = clock_now_ns();
+    atomic_store(&load.processed, 0);
+    atomic_store(&load.completed, 0);
+    atomic_store(&load.loaded, 0);
+    atomic_store(&load.cached, 0);
+    atomic_store(&load.stale, false);
+    if (job_count == 0) {
+        return 0;
+    }
+
+    load.pool = thread_pool_start(job_count, load_job, NULL, 0);
+    if (load.pool == NULL) {
+        fprintf(stderr, "[LOADER] Failed to start loader threads\n");
+        load.job_count = 0;
+        return -1;
+    }
+
+    printf("[LOADER] Loading %zu sound(s) in the background\n", job_count);
+    return 0;
+}
+
+size_t bank_loader_wait(void) {
+    if (load.pool == NULL) {
+        return atomic_load(&load.loaded);
+    }
+
+    thread_pool_wait(load.pool);
+    load.pool = NULL;
+
+    size_t loaded = atomic_load(&load.loaded);
+    printf("[LOADER] Loaded %zu of %zu sound(s), %zu from cache, in %.1f ms (peak RSS %zu KiB)\n",
+           loaded, load.job_count, atomic_load(&load.cached),
+           (clock_now_ns() - load.start_ns) / 1e6, peak_rss_kib());
+    return loaded;
+}
+
+void bank_loader_cancel(void) {
+    atomic_store(&load.cancel, true);
+    bank_loader_wait();
+}
+
+bool bank_loader_done(void) {
+    return load.config != NULL && atomic_load(&load.completed) == load.job_count;
+}
+
+void bank_loader_cleanup(void) {
+    bank_loader_cancel();
+    soundbank_close(&load.bank);
+    for (size_t i = 0; i < load.old_bank_count; i++) {
+        soundbank_close(&load.old_banks[i]);
+    }
+    free(load.old_banks);
+    free(load.items);
+    free(load.jobs);
+    free(load.scratch);
+    load.old_banks = NULL;
+    load.old_bank_count = 0;
+    load.items = NULL;
+    load.jobs = NULL;
+    load.scratch = NULL;
+    load.config = NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef BANK_LOADER_H
+#define BANK_LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Background sound-bank loader. Every configured file is decoded, converted
+// to the output rate and registered with the soundboard on a worker pool;
+// each pad becomes playable the moment its own file is done, so MIDI can be
+// served while the rest of the bank is still loading.
+//
+// Decoded sounds are cached in a compiled sound bank (soundbank.h) in the
+// sounds folder. On later starts that file is memory-mapped and unchanged
+// sounds are played from it directly without decoding. On ESP32 there are
+// no files: every sound is played from the bank flashed to the soundbank
+// partition.
+//
+// Sounds are loaded in batches of whole pages, one batch at a time, so the
+// page residency manager can bring pages in as they are needed.
+
+// Opens the cache (the flash bank on ESP32); no sounds are loaded until bank_loader_load_pages().
+// config must stay valid until bank_loader_cleanup().
+int bank_loader_start(const config_t *config);
+
+// Starts loading every sound on the pages in page_mask (bit n = page n),
+// those on first_page first. Fails while the previous batch is running.
+int bank_loader_load_pages(uint32_t page_mask, uint8_t first_page);
+
+// Blocks until every file of the batch has been processed (or skipped after
+// a cancel) and prints the load summary. Returns the number of sounds loaded.
+size_t bank_loader_wait(void);
+
+// Skip the files that have not been started yet, then wait. No further
+// batches can be started.
+void bank_loader_cancel(void);
+
+// True once the current batch is finished (or none was started)
+bool bank_loader_done(void);
+
+// Unmaps the sound-bank cache. Soundbites may point into it, so call this
+// after soundboard_cleanup().
+void bank_loader_cleanup(void);
+
+#endif // BANK_LOADER_H
@@ -50,6 +50,21 @@ static int parse_float(const char **json, float *out) {
     return 0;
 }
 
+static int parse_bool(const char **json, bool *out) {
+    skip_whitespace(json);
+    if (strncmp(*json, "true", 4) == 0) {
+        *out = true;
+        *json += 4;
+        return 0;
+    }
+    if (strncmp(*json, "false", 5) == 0) {
+        *out = false;
+        *json += 5;
+        return 0;
+    }
+    return -1;
+}
+
 static int parse_sound_entry(const char **json, sound_config_t *sound) {
     skip_whitespace(json);
     if (**json != '{') return -1;
@@ -106,6 +121,62 @@ static int parse_sound_entry(const char **json, sound_config_t *sound) {
                     sound->volume_offset = 0.0f;
                 }
             }
+        } else if (strcmp(key, "resample") == 0) {
+            char *resample_str = NULL;
+            if (parse_string(json, &resample_str) == 0) {
+                if (strcmp(resample_str, "load") == 0) {
+                    sound->resample = RESAMPLE_AT_LOAD;
+                } else if (strcmp(resample_str, "realtime") == 0) {
+                    sound->resample = RESAMPLE_REALTIME;
+                } else {
+                    fprintf(stderr, "[CONFIG] Invalid resample: %s (must be load or realtime)\n", resample_str);
+                }
+                free(resample_str);
+            }
+        } else if (strcmp(key, "storage") == 0) {
+            char *storage_str = NULL;
+            if (parse_string(json, &storage_str) == 0) {
+                if (strcmp(storage_str, "pcm") == 0) {
+                    sound->storage = STORAGE_PCM;
+                } else if (strcmp(storage_str, "adpcm") == 0) {
+                    sound->storage = STORAGE_ADPCM;
+                } else {
+                    fprintf(stderr, "[CONFIG] Invalid storage: %s (must be pcm or adpcm)\n", storage_str);
+                }
+                free(storage_str);
+            }
+        } else if (strcmp(key, "velocity_curve") == 0) {
+            char *curve_str = NULL;
+            if (parse_string(json, &curve_str) == 0) {
+                if (strcmp(curve_str, "linear") == 0) {
+                    sound->velocity_curve = VELOCITY_LINEAR;
+                } else if (strcmp(curve_str, "soft") == 0) {
+                    sound->velocity_curve = VELOCITY_SOFT;
+                } else if (strcmp(curve_str, "hard") == 0) {
+                    sound->velocity_curve = VELOCITY_HARD;
+                } else if (strcmp(curve_str, "fixed") == 0) {
+                    sound->velocity_curve = VELOCITY_FIXED;
+                } else {
+                    fprintf(stderr, "[CONFIG] Invalid velocity_curve: %s (must be linear, soft, hard or fixed)\n", curve_str);
+                }
+                free(curve_str);
+            }
+        } else if (strcmp(key, "max_instances") == 0) {
+            int val;
+            if (parse_number(json, &val) == 0) {
+                if (val >= 1 && val <= 16) {
+                    sound->max_instances = (uint8_t)val;
+                } else {
+                    fprintf(stderr, "[CONFIG] Invalid max_instances: %d (must be 1-16)\n", val);
+                }
+            }
+        } else if (strcmp(key, "stream") == 0) {
+            bool stream;
+            if (parse_bool(json, &stream) == 0) {
+                sound->stream = stream ? STREAM_ALWAYS : STREAM_NEVER;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid stream: must be true or false\n");
+            }
         } else if (strcmp(key, "color") == 0) {
             skip_whitespace(json);
             if (**json == '[') {
@@ -147,6 +218,211 @@ static int parse_sound_entry(const char **json, sound_config_t *sound) {
     return 0;
 }
 
+// Engine settings live at the top level of the config object, next to "sounds"
+static void parse_engine_settings(const char *json, config_t *config) {
+    const char *p = strstr(json, "\"max_voices\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= 1 && val <= 1024) {
+                config->max_voices = (size_t)val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid max_voices: %d (must be 1-1024)\n", val);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"voice_steal\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        char *policy = NULL;
+        if (parse_string(&p, &policy) == 0) {
+            if (strcmp(policy, "oldest") == 0) {
+                config->steal_policy = VOICE_STEAL_OLDEST;
+            } else if (strcmp(policy, "quietest") == 0) {
+                config->steal_policy = VOICE_STEAL_QUIETEST;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid voice_steal: %s (must be oldest or quietest)\n", policy);
+            }
+            free(policy);
+        }
+    }
+    
+    p = strstr(json, "\"stream_threshold_seconds\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= 0) {
+                config->stream_threshold_seconds = (uint32_t)val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid stream_threshold_seconds: %d (must be >= 0)\n", val);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"master_volume\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        float vol;
+        if (parse_float(&p, &vol) == 0) {
+            if (vol >= 0.0f && vol <= 2.0f) {
+                config->master_volume = vol;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid master_volume: %f (must be 0.0 to 2.0)\n", vol);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"page_cc\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= -1 && val <= 127) {
+                config->page_cc = val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid page_cc: %d (must be 0-127, or -1 for none)\n", val);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"resident_pages\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= -1 && val <= 10) {
+                config->resident_pages = val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid resident_pages: %d (must be 0-10, or -1 for all)\n", val);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"cache_budget_mb\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= 0) {
+                config->cache_budget_mb = (uint32_t)val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid cache_budget_mb: %d (must be 0 or more)\n", val);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"cache_attack_ms\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= CONFIG_MIN_CACHE_ATTACK_MS && val <= CONFIG_MAX_CACHE_ATTACK_MS) {
+                config->cache_attack_ms = (uint32_t)val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid cache_attack_ms: %d (must be %d-%d)\n", val,
+                        CONFIG_MIN_CACHE_ATTACK_MS, CONFIG_MAX_CACHE_ATTACK_MS);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"audio_output\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        char *output = NULL;
+        if (parse_string(&p, &output) == 0) {
+            if (strcmp(output, "unit") == 0) {
+                config->audio_output = AUDIO_OUTPUT_UNIT;
+            } else if (strcmp(output, "queue") == 0) {
+                config->audio_output = AUDIO_OUTPUT_QUEUE;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid audio_output: %s (must be unit or queue)\n", output);
+            }
+            free(output);
+        }
+    }
+    
+    p = strstr(json, "\"audio_device\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        char *device = NULL;
+        if (parse_string(&p, &device) == 0) {
+            free(config->audio_device);
+            config->audio_device = device;
+        }
+    }
+    
+    p = strstr(json, "\"midi_input\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        char *input = NULL;
+        if (parse_string(&p, &input) == 0) {
+            free(config->midi_input);
+            config->midi_input = input;
+        }
+    }
+    
+    p = strstr(json, "\"control_socket\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        char *path = NULL;
+        if (parse_string(&p, &path) == 0) {
+            free(config->control_socket);
+            config->control_socket = path;
+        }
+    }
+    
+    p = strstr(json, "\"log_level\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        char *level = NULL;
+        if (parse_string(&p, &level) == 0) {
+            if (strcmp(level, "debug") == 0) {
+                config->log_level = LOG_LEVEL_DEBUG;
+            } else if (strcmp(level, "info") == 0) {
+                config->log_level = LOG_LEVEL_INFO;
+            } else if (strcmp(level, "warn") == 0) {
+                config->log_level = LOG_LEVEL_WARN;
+            } else if (strcmp(level, "error") == 0) {
+                config->log_level = LOG_LEVEL_ERROR;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid log_level: %s (must be debug, info, warn or error)\n", level);
+            }
+            free(level);
+        }
+    }
+    
+    p = strstr(json, "\"buffer_frames\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= CONFIG_MIN_BUFFER_FRAMES && val <= CONFIG_MAX_BUFFER_FRAMES) {
+                config->buffer_frames = (uint32_t)val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid buffer_frames: %d (must be %d-%d)\n",
+                        val, CONFIG_MIN_BUFFER_FRAMES, CONFIG_MAX_BUFFER_FRAMES);
+            }
+        }
+    }
+    
+    p = strstr(json, "\"buffer_count\"");
+    if (p && (p = strchr(p, ':')) != NULL) {
+        p++;
+        int val;
+        if (parse_number(&p, &val) == 0) {
+            if (val >= CONFIG_MIN_BUFFER_COUNT && val <= CONFIG_MAX_BUFFER_COUNT) {
+                config->buffer_count = (uint32_t)val;
+            } else {
+                fprintf(stderr, "[CONFIG] Invalid buffer_count: %d (must be %d-%d)\n",
+                        val, CONFIG_MIN_BUFFER_COUNT, CONFIG_MAX_BUFFER_COUNT);
+            }
+        }
+    }
+}
+
 int config_load(const char *json_path, config_t *config) {
     FILE *f = fopen(json_path, "r");
     if (!f) {
@@ -181,7 +457,7 @@ int config_load(const char *json_path, config_t *config) {
     json[size] = '\0';
     fclose(f);
     
-    memset(config, 0, sizeof(*config));
+    config_init(config);
     
     // Extract base path
     const char *last_slash = strrchr(json_path, '/');
@@ -213,6 +489,7 @@ int config_load(const char *json_path, config_t *config) {
     }
     
     config->sounds = calloc(config->sound_count, sizeof(sound_config_t));
+    parse_engine_settings(json, config);
     
     // Parse sounds array
     p = json;
@@ -239,6 +516,16 @@ int config_load(const char *json_path, config_t *config) {
     return 0;
 }
 
+void config_init(config_t *config) {
+    memset(config, 0, sizeof(*config));
+    config->stream_threshold_seconds = CONFIG_DEFAULT_STREAM_THRESHOLD;
+    config->master_volume = 1.0f;
+    config->page_cc = CONFIG_DEFAULT_PAGE_CC;
+    config->resident_pages = -1;
+    config->cache_attack_ms = CONFIG_DEFAULT_CACHE_ATTACK_MS;
+    config->log_level = LOG_LEVEL_INFO;
+}
+
 void config_free(config_t *config) {
     if (!config) return;
     
@@ -247,6 +534,9 @@ void config_free(config_t *config) {
     }
     free(config->sounds);
     free(config->base_path);
+    free(config->audio_device);
+    free(config->midi_input);
+    free(config->control_socket);
     memset(config, 0, sizeof(*config));
 }
 
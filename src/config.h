@@ -12,6 +12,64 @@ typedef enum {
     SOUND_MODE_HOLD = 2
 } sound_mode_t;
 
+// Voice stealing policies used when all voices are busy
+typedef enum {
+    VOICE_STEAL_OLDEST = 0,     // Steal the longest-running oneshot
+    VOICE_STEAL_QUIETEST = 1    // Steal the quietest oneshot
+} voice_steal_policy_t;
+
+// Where sample-rate conversion happens for sounds not at the output rate
+typedef enum {
+    RESAMPLE_AT_LOAD = 0,       // High-quality windowed sinc when loading
+    RESAMPLE_REALTIME = 1       // Linear interpolation in the mixer
+} resample_mode_t;
+
+// Whether a sound is played from RAM or streamed from disk
+typedef enum {
+    STREAM_AUTO = 0,            // Stream if longer than stream_threshold_seconds
+    STREAM_ALWAYS = 1,
+    STREAM_NEVER = 2
+} stream_mode_t;
+
+// How a sound's samples are kept in memory
+typedef enum {
+    STORAGE_PCM = 0,            // 16-bit samples
+    STORAGE_ADPCM = 1           // IMA-ADPCM, 4 bits per sample, decoded while mixing
+} sample_storage_t;
+
+// How note velocity maps to voice gain
+typedef enum {
+    VELOCITY_LINEAR = 0,        // Gain proportional to velocity
+    VELOCITY_SOFT = 1,          // Square root: light hits come through louder
+    VELOCITY_HARD = 2,          // Squared: needs a firm hit for full volume
+    VELOCITY_FIXED = 3,         // Ignore velocity
+    VELOCITY_CURVE_COUNT
+} velocity_curve_t;
+
+// Audio output path
+typedef enum {
+    AUDIO_OUTPUT_UNIT = 0,      // Render callback on the device's I/O thread (low latency)
+    AUDIO_OUTPUT_QUEUE = 1      // Queued buffers (more latency, more slack)
+} audio_output_t;
+
+// Least severe log messages that are printed
+typedef enum {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO = 1,         // Default: notes, page switches, status
+    LOG_LEVEL_WARN = 2,
+    LOG_LEVEL_ERROR = 3
+} log_level_t;
+
+#define CONFIG_DEFAULT_STREAM_THRESHOLD 30  // Seconds
+#define CONFIG_DEFAULT_PAGE_CC 0            // Bank Select MSB
+#define CONFIG_MIN_BUFFER_FRAMES 32
+#define CONFIG_MAX_BUFFER_FRAMES 8192
+#define CONFIG_MIN_BUFFER_COUNT 2
+#define CONFIG_MAX_BUFFER_COUNT 8
+#define CONFIG_DEFAULT_CACHE_ATTACK_MS 200
+#define CONFIG_MIN_CACHE_ATTACK_MS 10
+#define CONFIG_MAX_CACHE_ATTACK_MS 5000
+
 // Sound configuration entry
 typedef struct {
     char *filename;           // MP3 filename
@@ -22,6 +80,11 @@ typedef struct {
     uint8_t color_g;            // RGB color green component (0-255)
     uint8_t color_b;            // RGB color blue component (0-255)
     sound_mode_t mode;          // Playback mode
+    uint8_t max_instances;      // Overlapping oneshot voices (0 = default)
+    resample_mode_t resample;   // Sample-rate conversion mode
+    stream_mode_t stream;       // RAM or disk streaming
+    sample_storage_t storage;   // In-memory sample format
+    velocity_curve_t velocity_curve; // Velocity to gain mapping
 } sound_config_t;
 
 // Configuration structure
@@ -29,10 +92,27 @@ typedef struct {
     sound_config_t *sounds;     // Array of sound configurations
     size_t sound_count;         // Number of sounds
     char *base_path;            // Base path to sounds folder
+    size_t max_voices;          // Polyphony (0 = default)
+    voice_steal_policy_t steal_policy; // What to steal when polyphony is exhausted
+    uint32_t stream_threshold_seconds; // Auto-stream longer sounds (0 = never)
+    float master_volume;        // Gain applied to every voice (0.0 to 2.0)
+    int page_cc;                // Controller whose value selects the page (-1 = none)
+    int resident_pages;         // Neighbouring pages kept loaded on each side (-1 = all)
+    uint32_t cache_budget_mb;   // Memory for decoded sounds (0 = unlimited)
+    uint32_t cache_attack_ms;   // Start of each sound kept when over budget
+    audio_output_t audio_output;
+    uint32_t buffer_frames;     // Frames per output buffer (0 = backend default)
+    uint32_t buffer_count;      // Queued buffers for AUDIO_OUTPUT_QUEUE (0 = default)
+    char *audio_device;         // Output device (NULL = backend default; Linux only)
+    char *midi_input;           // MIDI source (NULL = backend default; Linux only)
+    char *control_socket;       // Control server socket path (NULL = default, "none" = off)
+    log_level_t log_level;
 } config_t;
 
 // Configuration functions
 int config_load(const char *json_path, config_t *config);
+// Empty config with every setting at its default
+void config_init(config_t *config);
 void config_free(config_t *config);
 sound_config_t *config_find_sound(const config_t *config, uint8_t page, uint8_t note);
 
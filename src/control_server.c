@@ -0,0 +1,529 @@
+#ifndef ESP_PLATFORM
+
+#include "control_server.h"
+#include "async_log.h"
+#include "latency_stats.h"
+#include "midi_soundboard.h"
+#include "mixer.h"
+#include "monotonic_clock.h"
+#include "page_residency.h"
+#include "sample_cache.h"
+#include "spsc_ring.h"
+#include "platform/platform.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_LINE_BYTES 128      // Longest command line
+#define CONTROL_REPLY_BYTES 1024
+#define CONTROL_QUEUE_SIZE 64       // Commands waiting for the control thread
+#define CONTROL_POLL_MS 1000
+#define LOAD_INTERVAL_NS 1000000000ull
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL     // A client that went away is not a SIGPIPE
+#else
+#define SEND_FLAGS 0                // Mac OS: SO_NOSIGPIPE on each connection
+#endif
+
+typedef enum {
+    CONTROL_CMD_PAGE = 0,
+    CONTROL_CMD_STOP,
+    CONTROL_CMD_TRIGGER,
+    CONTROL_CMD_RELOAD
+} control_command_type_t;
+
+typedef struct {
+    control_command_type_t type;
+    uint8_t value;              // Page or note
+    uint8_t velocity;
+} control_command_t;
+
+typedef struct {
+    int fd;                     // -1 = free
+    size_t length;              // Bytes of a partial line in line[]
+    bool overlong;              // Skipping the rest of a line that didn't fit
+    char line[CONTROL_LINE_BYTES];
+} client_t;
+
+// Published by the control thread in control_server_poll(), read by the
+// server thread. The sequence is odd while an update is in progress.
+static _Atomic uint32_t snapshot_sequence;
+static _Atomic uint32_t snapshot_page;
+static _Atomic uint32_t snapshot_midi_dropped;
+static _Atomic bool snapshot_cache_enabled;
+static _Atomic uint32_t snapshot_cache_hits;
+static _Atomic uint32_t snapshot_cache_misses;
+static _Atomic uint32_t snapshot_cache_evictions;
+static _Atomic uint32_t snapshot_cache_reloads;
+static _Atomic uint64_t snapshot_cache_resident;
+static _Atomic uint64_t snapshot_cache_budget;
+
+typedef struct {
+    uint32_t page;
+    uint32_t midi_dropped;
+    bool cache_enabled;
+    sample_cache_stats_t cache;
+} snapshot_t;
+
+// Control thread
+static bool running = false;
+static spsc_ring_t command_queue;       // Server thread -> control thread
+static pthread_t server_thread;
+static int listen_fd = -1;
+static int wake_pipe[2] = {-1, -1};     // Closing the write end stops the server
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+// Server thread
+static client_t clients[CONTROL_MAX_CLIENTS];
+static uint64_t load_sample_ns;
+static uint64_t load_render_ns;
+static uint64_t load_audio_ns;
+static double render_load = 0.0;        // Over the last LOAD_INTERVAL_NS
+
+// ---------------------------------------------------------------------------
+// Snapshot
+// ---------------------------------------------------------------------------
+
+static void publish_snapshot(void) {
+    sample_cache_stats_t cache = {0};
+    bool cache_enabled = sample_cache_enabled();
+    if (cache_enabled) {
+        sample_cache_get_stats(&cache);
+    }
+
+    uint32_t sequence = atomic_load_explicit(&snapshot_sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&snapshot_page, soundboard_get_current_page(), memory_order_relaxed);
+    atomic_store_explicit(&snapshot_midi_dropped, midi_overflow_count(), memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_enabled, cache_enabled, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_hits, cache.hits, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_misses, cache.misses, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_evictions, cache.evictions, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_reloads, cache.reloads, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_resident, cache.resident_bytes, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_cache_budget, cache.budget_bytes, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_sequence, sequence + 2, memory_order_release);
+}
+
+static void read_snapshot(snapshot_t *snapshot) {
+    uint32_t sequence;
+    do {
+        sequence = atomic_load_explicit(&snapshot_sequence, memory_order_acquire);
+        snapshot->page = atomic_load_explicit(&snapshot_page, memory_order_relaxed);
+        snapshot->midi_dropped = atomic_load_explicit(&snapshot_midi_dropped, memory_order_relaxed);
+        snapshot->cache_enabled = atomic_load_explicit(&snapshot_cache_enabled, memory_order_relaxed);
+        snapshot->cache.hits = atomic_load_explicit(&snapshot_cache_hits, memory_order_relaxed);
+        snapshot->cache.misses = atomic_load_explicit(&snapshot_cache_misses, memory_order_relaxed);
+        snapshot->cache.evictions = atomic_load_explicit(&snapshot_cache_evictions, memory_order_relaxed);
+        snapshot->cache.reloads = atomic_load_explicit(&snapshot_cache_reloads, memory_order_relaxed);
+        snapshot->cache.resident_bytes = atomic_load_explicit(&snapshot_cache_resident, memory_order_relaxed);
+        snapshot->cache.budget_bytes = atomic_load_explicit(&snapshot_cache_budget, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((sequence & 1) != 0 ||
+             sequence != atomic_load_explicit(&snapshot_sequence, memory_order_relaxed));
+}
+
+// ---------------------------------------------------------------------------
+// Server thread
+// ---------------------------------------------------------------------------
+
+// Render time over audio time since the previous sample
+static void sample_render_load(void) {
+    uint64_t now = clock_now_ns();
+    if (now - load_sample_ns < LOAD_INTERVAL_NS) {
+        return;
+    }
+    uint64_t render_ns, audio_ns;
+    mixer_render_time(&render_ns, &audio_ns);
+    render_load = audio_ns > load_audio_ns
+                  ? (double)(render_ns - load_render_ns) / (double)(audio_ns - load_audio_ns)
+                  : 0.0;
+    load_sample_ns = now;
+    load_render_ns = render_ns;
+    load_audio_ns = audio_ns;
+}
+
+static void format_stats(char *reply, size_t size) {
+    snapshot_t state;
+    read_snapshot(&state);
+    latency_summary_t latency, render;
+    latency_stats_summary(LATENCY_TRIGGER_TO_SOUND, &latency);
+    latency_stats_summary(LATENCY_RENDER_DURATION, &render);
+
+    snprintf(reply, size,
+             "{\"page\":%u,\"active_voices\":%zu,"
+             "\"render\":{\"load\":%.4f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+             "\"late\":%u,\"xruns\":%u},"
+             "\"cache\":{\"enabled\":%s,\"resident_bytes\":%llu,\"budget_bytes\":%llu,"
+             "\"hits\":%u,\"misses\":%u,\"evictions\":%u,\"reloads\":%u},"
+             "\"latency_ms\":{\"count\":%llu,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,"
+             "\"p999\":%.3f,\"max\":%.3f},"
+             "\"midi_dropped\":%u,\"log_dropped\":%u}\n",
+             state.page, mixer_active_voices(),
+             render_load, render.p50_ns / 1e3, render.p99_ns / 1e3, render.max_ns / 1e3,
+             latency_stats_late_renders(), latency_stats_xruns(),
+             state.cache_enabled ? "true" : "false",
+             (unsigned long long)state.cache.resident_bytes, (unsigned long long)state.cache.budget_bytes,
+             state.cache.hits, state.cache.misses, state.cache.evictions, state.cache.reloads,
+             (unsigned long long)latency.count, latency.p50_ns / 1e6, latency.p90_ns / 1e6,
+             latency.p99_ns / 1e6, latency.p999_ns / 1e6, latency.max_ns / 1e6,
+             state.midi_dropped, async_log_dropped());
+}
+
+static const char *queue_command(control_command_type_t type, uint8_t value, uint8_t velocity) {
+    control_command_t command = { .type = type, .value = value, .velocity = velocity };
+    if (!spsc_ring_push(&command_queue, &command)) {
+        return "error busy\n";
+    }
+    midi_wake(); // The control thread may be asleep waiting for MIDI
+    return "ok\n";
+}
+
+// Parses one command line into a reply
+static void handle_line(const char *line, char *reply, size_t size) {
+    char word[16];
+    int first = -1, second = -1;
+    int fields = sscanf(line, "%15s %d %d", word, &first, &second);
+    const char *result;
+    if (fields < 1) {
+        result = "error empty command\n";
+    } else if (strcmp(word, "stats") == 0) {
+        format_stats(reply, size);
+        return;
+    } else if (strcmp(word, "page") == 0) {
+        if (fields < 2 || first < 0 || first >= SOUNDBOARD_PAGES) {
+            snprintf(reply, size, "error usage: page <0-%d>\n", SOUNDBOARD_PAGES - 1);
+            return;
+        }
+        result = queue_command(CONTROL_CMD_PAGE, (uint8_t)first, 0);
+    } else if (strcmp(word, "stop") == 0) {
+        result = queue_command(CONTROL_CMD_STOP, 0, 0);
+    } else if (strcmp(word, "trigger") == 0) {
+        if (fields < 3) {
+            second = 127;
+        }
+        result = fields >= 2 && first >= 0 && first <= 127 && second >= 1 && second <= 127
+                 ? queue_command(CONTROL_CMD_TRIGGER, (uint8_t)first, (uint8_t)second)
+                 : "error usage: trigger <note 0-127> [velocity 1-127]\n";
+    } else if (strcmp(word, "reload") == 0) {
+        result = queue_command(CONTROL_CMD_RELOAD, 0, 0);
+    } else {
+        result = "error unknown command (stats, page, stop, trigger, reload)\n";
+    }
+    snprintf(reply, size, "%s", result);
+}
+
+static void close_client(client_t *client) {
+    close(client->fd);
+    client->fd = -1;
+    client->length = 0;
+    client->overlong = false;
+}
+
+static bool send_reply(client_t *client, const char *reply) {
+    size_t length = strlen(reply);
+    // Replies are small; a client that doesn't read them is dropped
+    if (send(client->fd, reply, length, SEND_FLAGS) != (ssize_t)length) {
+        close_client(client);
+        return false;
+    }
+    return true;
+}
+
+static void accept_client(void) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            clients[i].fd = fd;
+            clients[i].length = 0;
+            clients[i].overlong = false;
+            return;
+        }
+    }
+    const char *full = "error too many clients\n";
+    send(fd, full, strlen(full), SEND_FLAGS);
+    close(fd);
+}
+
+// Reads what the client sent and answers every complete line
+static void service_client(client_t *client) {
+    char reply[CONTROL_REPLY_BYTES];
+    for (;;) {
+        ssize_t got = recv(client->fd, client->line + client->length,
+                           sizeof(client->line) - 1 - client->length, 0);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_client(client);
+            return;
+        }
+        if (got < 0) {
+            return;
+        }
+        client->length += (size_t)got;
+        client->line[client->length] = '\0';
+
+        char *start = client->line;
+        char *end;
+        while ((end = strchr(start, '\n')) != NULL) {
+            *end = '\0';
+            if (end > start && end[-1] == '\r') {
+                end[-1] = '\0';
+            }
+            if (client->overlong) {
+                client->overlong = false; // Its error was already sent
+            } else {
+                handle_line(start, reply, sizeof(reply));
+                if (!send_reply(client, reply)) {
+                    return;
+                }
+            }
+            start = end + 1;
+        }
+        client->length -= (size_t)(start - client->line);
+        memmove(client->line, start, client->length);
+        if (client->length == sizeof(client->line) - 1) {
+            client->length = 0;
+            if (!client->overlong) {
+                client->overlong = true;
+                if (!send_reply(client, "error line too long\n")) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void *server_main(void *arg) {
+    (void)arg;
+    struct pollfd fds[2 + CONTROL_MAX_CLIENTS];
+    int owners[2 + CONTROL_MAX_CLIENTS];    // Client of each pollfd (-1 = none)
+    for (;;) {
+        nfds_t count = 0;
+        fds[count] = (struct pollfd){ .fd = wake_pipe[0], .events = POLLIN };
+        owners[count++] = -1;
+        fds[count] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        owners[count++] = -1;
+        for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0) {
+                fds[count] = (struct pollfd){ .fd = clients[i].fd, .events = POLLIN };
+                owners[count++] = i;
+            }
+        }
+
+        int ready = poll(fds, count, CONTROL_POLL_MS);
+        if (fds[0].revents != 0) {
+            break;
+        }
+        sample_render_load();
+        if (ready <= 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_client();
+        }
+        for (nfds_t i = 2; i < count; i++) {
+            if (fds[i].revents != 0) {
+                service_client(&clients[owners[i]]);
+            }
+        }
+    }
+
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            close_client(&clients[i]);
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Control thread
+// ---------------------------------------------------------------------------
+
+static void apply_command(const control_command_t *command) {
+    switch (command->type) {
+    case CONTROL_CMD_PAGE:
+        page_residency_set_page(command->value);
+        break;
+    case CONTROL_CMD_STOP:
+        LOG_INFO("[CONTROL] Stopped %d voice(s)\n", soundboard_stop_all());
+        break;
+    case CONTROL_CMD_TRIGGER: {
+        uint8_t page = soundboard_get_current_page();
+        if (soundboard_play_note(page, command->value, command->velocity, 0) != 0) {
+            LOG_WARN("[CONTROL] Nothing to play on page %u note %u\n", page, command->value);
+        }
+        break;
+    }
+    case CONTROL_CMD_RELOAD:
+        // Loops and held pads would otherwise keep playing the old sounds
+        // with no pad left to stop them
+        soundboard_stop_all();
+        if (page_residency_reload() != 0) {
+            LOG_WARN("[CONTROL] Reload refused while pages are loading\n");
+        }
+        break;
+    }
+}
+
+// Whatever exists at path is replaced only if it is a socket nobody listens on
+static int claim_path(const struct sockaddr_un *address) {
+    struct stat info;
+    if (lstat(address->sun_path, &info) != 0) {
+        return 0;
+    }
+    if (!S_ISSOCK(info.st_mode)) {
+        fprintf(stderr, "[CONTROL] %s exists and is not a socket\n", address->sun_path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int connected = connect(fd, (const struct sockaddr *)address, sizeof(*address));
+    int error = errno;
+    close(fd);
+    if (connected == 0) {
+        fprintf(stderr, "[CONTROL] %s is in use by another instance\n", address->sun_path);
+        return -1;
+    }
+    if (error != ECONNREFUSED) {
+        fprintf(stderr, "[CONTROL] Can't check %s: %s\n", address->sun_path, strerror(error));
+        return -1;
+    }
+    unlink(address->sun_path); // Left over from a previous run
+    return 0;
+}
+
+static int open_listener(const struct sockaddr_un *address) {
+    if (claim_path(address) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "[CONTROL] Failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+    if (bind(fd, (const struct sockaddr *)address, sizeof(*address)) != 0) {
+        fprintf(stderr, "[CONTROL] Failed to bind %s: %s\n", address->sun_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, CONTROL_MAX_CLIENTS) != 0) {
+        fprintf(stderr, "[CONTROL] Failed to listen on %s: %s\n", address->sun_path, strerror(errno));
+        close(fd);
+        unlink(address->sun_path);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void close_listener(void) {
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path);
+}
+
+int control_server_start(const char *path) {
+    if (running) {
+        return 0;
+    }
+    if (path == NULL) {
+        path = CONTROL_DEFAULT_SOCKET;
+    }
+    if (strcmp(path, "none") == 0) {
+        return 0;
+    }
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "[CONTROL] Socket path too long: %s\n", path);
+        return -1;
+    }
+    memcpy(address.sun_path, path, strlen(path) + 1);
+    memcpy(socket_path, path, strlen(path) + 1);
+
+    if (spsc_ring_init(&command_queue, sizeof(control_command_t), CONTROL_QUEUE_SIZE) != 0) {
+        return -1;
+    }
+    listen_fd = open_listener(&address);
+    if (listen_fd < 0) {
+        spsc_ring_free(&command_queue);
+        return -1;
+    }
+    if (pipe(wake_pipe) != 0) {
+        close_listener();
+        spsc_ring_free(&command_queue);
+        return -1;
+    }
+
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        clients[i].length = 0;
+        clients[i].overlong = false;
+    }
+    load_sample_ns = clock_now_ns();
+    mixer_render_time(&load_render_ns, &load_audio_ns);
+    render_load = 0.0;
+    publish_snapshot();
+
+    if (pthread_create(&server_thread, NULL, server_main, NULL) != 0) {
+        fprintf(stderr, "[CONTROL] Failed to start the server thread\n");
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+        close_listener();
+        spsc_ring_free(&command_queue);
+        return -1;
+    }
+
+    running = true;
+    printf("[CONTROL] Listening on %s\n", path);
+    return 0;
+}
+
+void control_server_stop(void) {
+    if (!running) {
+        return;
+    }
+    // The read end reports end-of-file, which wakes the server's poll()
+    close(wake_pipe[1]);
+    pthread_join(server_thread, NULL);
+    close(wake_pipe[0]);
+    close_listener();
+    spsc_ring_free(&command_queue);
+    running = false;
+}
+
+void control_server_poll(void) {
+    if (!running) {
+        return;
+    }
+    control_command_t command;
+    while (spsc_ring_pop(&command_queue, &command)) {
+        apply_command(&command);
+    }
+    publish_snapshot(); // After the commands, so a page switch shows at once
+}
+
+#endif // !ESP_PLATFORM
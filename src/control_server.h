@@ -0,0 +1,36 @@
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+// Local control and stats endpoint on a Unix domain socket (Mac OS and
+// Linux). Clients send one command per line and get one line back:
+//
+//   stats                      live stats as a JSON object
+//   page <n>                   switch to page n
+//   stop                       stop every voice
+//   trigger <note> [velocity]  play a pad of the current page (velocity 127)
+//   reload                     stop every voice and load the sounds of the
+//                              loaded pages again
+//
+// Commands answer "ok" once queued or "error <reason>". Queuing one wakes
+// the control thread with midi_wake(), which applies it in its next
+// control_server_poll().
+//
+// The server runs on its own thread and never touches soundboard state.
+// Render-thread figures come from the atomics the mixer and the latency
+// stats publish, and control-thread figures (page, cache, dropped MIDI)
+// from a snapshot control_server_poll() publishes, so a client polling
+// stats as fast as it likes never takes a lock the audio or MIDI path uses.
+
+#define CONTROL_DEFAULT_SOCKET "/tmp/midi_soundboard.sock"
+
+// path NULL = CONTROL_DEFAULT_SOCKET; "none" leaves the server off and
+// returns 0. Call once the soundboard is initialized.
+int control_server_start(const char *path);
+// Closes every connection and removes the socket
+void control_server_stop(void);
+
+// Control thread, called regularly: publishes the snapshot and applies the
+// commands received since the last call
+void control_server_poll(void);
+
+#endif // CONTROL_SERVER_H
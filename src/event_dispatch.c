@@ -0,0 +1,32 @@
+#include "event_dispatch.h"
+#include "page_residency.h"
+#include <string.h>
+
+void event_dispatch_init(event_dispatch_t *dispatch, const config_t *config) {
+    dispatch->page_cc = config->page_cc;
+    memset(dispatch->note_pages, 0, sizeof(dispatch->note_pages));
+}
+
+bool event_dispatch(event_dispatch_t *dispatch, const midi_event_t *event, uint8_t *page) {
+    if (event->type == MIDI_EVENT_PROGRAM) {
+        page_residency_set_page(event->note);
+        return false;
+    }
+    if (event->type == MIDI_EVENT_CONTROL) {
+        if (event->note == dispatch->page_cc) {
+            page_residency_set_page(event->velocity);
+        }
+        return false;
+    }
+
+    uint8_t note = event->note & 0x7F;
+    if (event->is_on) {
+        *page = soundboard_get_current_page();
+        dispatch->note_pages[note] = *page;
+        soundboard_play_note(*page, event->note, event->velocity, event->timestamp_ns);
+    } else {
+        *page = dispatch->note_pages[note];
+        soundboard_stop_note(*page, event->note, event->timestamp_ns);
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef EVENT_DISPATCH_H
+#define EVENT_DISPATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "midi_soundboard.h"
+
+// Routes parsed MIDI events to the soundboard, shared by the live main loop
+// and the offline renderer so both play a performance the same way. Program
+// changes and the page controller switch pages; a note plays on the current
+// page and is released on the page it was pressed on, even if the page
+// changed in between. Control thread only.
+typedef struct {
+    int page_cc;                // Controller that selects the page (-1 = none)
+    uint8_t note_pages[128];    // Page each note was pressed on
+} event_dispatch_t;
+
+void event_dispatch_init(event_dispatch_t *dispatch, const config_t *config);
+
+// Handles one event at its timestamp. Returns true for note events, with the
+// page the note went to in *page.
+bool event_dispatch(event_dispatch_t *dispatch, const midi_event_t *event, uint8_t *page);
+
+#endif // EVENT_DISPATCH_H
@@ -0,0 +1,156 @@
+#include "latency_stats.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+// Values below 2^SUB_BITS ns get a bucket each; above that every octave is
+// split into 2^SUB_BITS buckets
+#define SUB_BITS 2
+#define SUB_BUCKETS (1u << SUB_BITS)
+#define BUCKET_COUNT ((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+typedef struct {
+    _Atomic uint32_t buckets[BUCKET_COUNT];
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t max_ns;
+} histogram_t;
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    double unit_ns;
+} histogram_info_t;
+
+static const histogram_info_t histogram_info[LATENCY_HISTOGRAM_COUNT] = {
+    [LATENCY_INPUT_TO_DISPATCH] = { "MIDI receive to dispatch", "ms", 1e6 },
+    [LATENCY_DISPATCH_TO_START] = { "Dispatch to voice start", "ms", 1e6 },
+    [LATENCY_TRIGGER_TO_SOUND] = { "MIDI receive to first sample", "ms", 1e6 },
+    [LATENCY_RENDER_DURATION] = { "Render callback duration", "us", 1e3 },
+};
+
+static histogram_t histograms[LATENCY_HISTOGRAM_COUNT];
+static _Atomic uint32_t late_renders;
+static _Atomic uint32_t xruns;
+
+static size_t bucket_index(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return (size_t)ns;
+    }
+    int octave = 63 - __builtin_clzll(ns);
+    return (size_t)(octave - SUB_BITS + 1) * SUB_BUCKETS + ((ns >> (octave - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+// Smallest value that falls into bucket index
+static uint64_t bucket_lower(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int octave = (int)(index / SUB_BUCKETS) + SUB_BITS - 1;
+    return (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << (octave - SUB_BITS);
+}
+
+// Largest value that falls into bucket index
+static uint64_t bucket_upper(size_t index) {
+    return index + 1 < BUCKET_COUNT ? bucket_lower(index + 1) - 1 : UINT64_MAX;
+}
+
+void latency_stats_record(latency_histogram_t histogram, uint64_t ns) {
+    if ((unsigned)histogram >= LATENCY_HISTOGRAM_COUNT) {
+        return;
+    }
+    // Single writer: plain load-and-store updates, no read-modify-write
+    histogram_t *h = &histograms[histogram];
+    _Atomic uint32_t *bucket = &h->buckets[bucket_index(ns)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&h->total_ns, atomic_load_explicit(&h->total_ns, memory_order_relaxed) + ns,
+                          memory_order_relaxed);
+    if (ns > atomic_load_explicit(&h->max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max_ns, ns, memory_order_relaxed);
+    }
+}
+
+void latency_stats_count_late_render(void) {
+    atomic_fetch_add_explicit(&late_renders, 1, memory_order_relaxed);
+}
+
+void latency_stats_count_xrun(void) {
+    atomic_fetch_add_explicit(&xruns, 1, memory_order_relaxed);
+}
+
+uint32_t latency_stats_late_renders(void) {
+    return atomic_load_explicit(&late_renders, memory_order_relaxed);
+}
+
+uint32_t latency_stats_xruns(void) {
+    return atomic_load_explicit(&xruns, memory_order_relaxed);
+}
+
+void latency_stats_summary(latency_histogram_t histogram, latency_summary_t *summary) {
+    *summary = (latency_summary_t){0};
+    if ((unsigned)histogram >= LATENCY_HISTOGRAM_COUNT) {
+        return;
+    }
+    histogram_t *h = &histograms[histogram];
+
+    // Buckets only grow, so counting first and walking second can only
+    // overshoot the targets, never miss them
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        count += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+    if (count == 0) {
+        return;
+    }
+    uint64_t max_ns = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    summary->count = count;
+    summary->mean_ns = atomic_load_explicit(&h->total_ns, memory_order_relaxed) / count;
+    summary->max_ns = max_ns;
+
+    // Rank of each percentile, rounded up, and where it is stored
+    const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+    uint64_t *results[] = { &summary->p50_ns, &summary->p90_ns, &summary->p99_ns, &summary->p999_ns };
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT && next < 4; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        while (next < 4 && (double)seen >= fractions[next] * (double)count) {
+            // Report the top of the bucket, so percentiles never understate
+            uint64_t value = bucket_upper(i);
+            *results[next++] = value < max_ns ? value : max_ns;
+        }
+    }
+}
+
+static void dump_histogram(latency_histogram_t histogram) {
+    const histogram_info_t *info = &histogram_info[histogram];
+    histogram_t *h = &histograms[histogram];
+    latency_summary_t summary;
+    latency_stats_summary(histogram, &summary);
+    if (summary.count == 0) {
+        printf("[STATS] %s: no samples\n", info->name);
+        return;
+    }
+
+    double unit = info->unit_ns;
+    printf("[STATS] %s: %llu sample(s), mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, max %.3f %s\n",
+           info->name, (unsigned long long)summary.count, summary.mean_ns / unit, summary.p50_ns / unit,
+           summary.p90_ns / unit, summary.p99_ns / unit, summary.p999_ns / unit, summary.max_ns / unit,
+           info->unit);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        uint32_t count = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        seen += count;
+        printf("[STATS]   %10.3f - %10.3f %s %10u  %5.1f%%\n", bucket_lower(i) / unit,
+               ((double)bucket_upper(i) + 1) / unit, info->unit, count,
+               seen < summary.count ? 100.0 * seen / summary.count : 100.0);
+    }
+}
+
+void latency_stats_dump(void) {
+    for (int i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+        dump_histogram((latency_histogram_t)i);
+    }
+    printf("[STATS] %u late render(s), %u xrun(s)\n", latency_stats_late_renders(), latency_stats_xruns());
+}
@@ -0,0 +1,55 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Timing of the trigger-to-sound path and of the render callback, kept as
+// log-bucketed histograms (four buckets per octave, so any percentile is
+// within about 20%). Each histogram has a single writer thread; recording is
+// a handful of relaxed atomic stores with no locks or allocation, so the
+// render thread can record every call. Any thread may read a summary or dump
+// at any time; a read racing a write may be off by the sample in flight.
+//
+// The stages of one note, each timestamped where it happens:
+//   MIDI receive   input thread stamps the event (midi_event_t.timestamp_ns)
+//   dispatch       main loop hands the event to the soundboard
+//   voice start    render thread applies the start command
+//   first sample   the render call containing the voice's first sample returns
+
+typedef enum {
+    LATENCY_INPUT_TO_DISPATCH = 0,  // MIDI receive -> dispatch (control thread)
+    LATENCY_DISPATCH_TO_START,      // Start command sent -> applied (render thread)
+    LATENCY_TRIGGER_TO_SOUND,       // MIDI receive -> first sample rendered (render thread)
+    LATENCY_RENDER_DURATION,        // mixer_render() wall time (render thread)
+    LATENCY_HISTOGRAM_COUNT
+} latency_histogram_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} latency_summary_t;
+
+// Only from the histogram's writer thread
+void latency_stats_record(latency_histogram_t histogram, uint64_t ns);
+
+// Any thread: render calls that took longer than the audio they produced,
+// and device underruns reported by the platform backend
+void latency_stats_count_late_render(void);
+void latency_stats_count_xrun(void);
+uint32_t latency_stats_late_renders(void);
+uint32_t latency_stats_xruns(void);
+
+// Any thread
+void latency_stats_summary(latency_histogram_t histogram, latency_summary_t *summary);
+
+// Prints every histogram with its non-empty buckets, and the counters.
+// Formats on the calling thread; never call it from the render thread.
+void latency_stats_dump(void);
+
+#endif // LATENCY_STATS_H
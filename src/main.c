@@ -1,69 +1,63 @@
 #include "midi_soundboard.h"
+#include "async_log.h"
 #include "config.h"
-#include "audio_loader.h"
+#include "bank_loader.h"
+#include "control_server.h"
+#include "event_dispatch.h"
+#include "latency_stats.h"
+#include "page_residency.h"
+#include "sample_cache.h"
+#include "soundbank.h"
+#include "monotonic_clock.h"
 #include "platform/platform.h"
 #include <stdio.h>
 #include <string.h>
-#ifdef __APPLE__
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
 #include <signal.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <libgen.h>
+#ifdef __APPLE__
 #include <mach-o/dyld.h>
-#elif defined(ESP_PLATFORM)
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #endif
+#endif
+
+#define MIDI_BATCH_SIZE 64
+#define MAIN_WAIT_MS 100
+#define RELOAD_WAIT_MS 2                // While the cache has a body to attach
+#define STATUS_INTERVAL_NS 5000000000ull
 
 static volatile bool running = true;
+static volatile bool stats_requested = false;
 
-#ifdef __APPLE__
+#ifndef ESP_PLATFORM
 void signal_handler(int sig) {
     (void)sig;
     running = false;
 }
+
+// SIGUSR1: the main loop prints the latency histograms on its next pass
+void stats_signal_handler(int sig) {
+    (void)sig;
+    stats_requested = true;
+}
 #endif
 
-static int load_sounds_from_config(const char *config_path) {
-    config_t config;
-    if (config_load(config_path, &config) != 0) {
-        return -1;
-    }
-    
-    char filepath[1024];
-    int loaded_count = 0;
-    
-    for (size_t i = 0; i < config.sound_count; i++) {
-        sound_config_t *sound_cfg = &config.sounds[i];
-        
-        // Build full path
-        snprintf(filepath, sizeof(filepath), "%s%s", config.base_path, sound_cfg->filename);
-        
-        printf("[MAIN] Loading sound: %s (page=%u, note=%u)\n", 
-               filepath, sound_cfg->page, sound_cfg->note);
-        
-        audio_data_t audio = {0};
-        if (audio_load_file(filepath, &audio) != 0) {
-            fprintf(stderr, "[MAIN] Failed to load: %s\n", filepath);
-            continue;
-        }
-        
-        if (soundboard_load_soundbite(sound_cfg->page, sound_cfg->note,
-                                     audio.data, audio.sample_count, audio.sample_rate,
-                                     sound_cfg->volume_offset, sound_cfg->mode) != 0) {
-            fprintf(stderr, "[MAIN] Failed to register soundbite\n");
-            audio_free(&audio);
-            continue;
-        }
-        
-        // Note: audio.data is now owned by soundboard, clear pointer to avoid double-free
-        audio.data = NULL;
-        audio_free(&audio); // Safe to call with NULL data
-        loaded_count++;
+// CPU time used by the whole process (all threads), for the status line
+static uint64_t process_cpu_ns(void) {
+#ifndef ESP_PLATFORM
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
     }
-    
-    config_free(&config);
-    printf("[MAIN] Successfully loaded %d sound(s)\n", loaded_count);
-    return loaded_count > 0 ? 0 : -1;
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000ull +
+           ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000ull;
+#else
+    return 0; // Not tracked per process on ESP32
+#endif
 }
 
 #ifdef ESP_PLATFORM
@@ -72,6 +66,7 @@ void app_main(void) {
 int main(int argc, char *argv[]) {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGUSR1, stats_signal_handler);
     
     // Determine config path
     char config_path[1024] = "sounds/config.json";
@@ -96,6 +91,15 @@ int main(int argc, char *argv[]) {
                 snprintf(config_path, sizeof(config_path), "%s/sounds/config.json", dir);
                 test = fopen(config_path, "r");
             }
+#elif defined(__linux__)
+            char exe_path[1024];
+            ssize_t length = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+            if (length > 0) {
+                exe_path[length] = '\0';
+                char *dir = dirname(exe_path);
+                snprintf(config_path, sizeof(config_path), "%s/sounds/config.json", dir);
+                test = fopen(config_path, "r");
+            }
 #endif
         }
         if (test) {
@@ -105,10 +109,33 @@ int main(int argc, char *argv[]) {
 #endif
     
     printf("MIDI Soundboard starting...\n");
+    
+    config_t config;
+#ifdef ESP_PLATFORM
+    // No filesystem: the pads are whatever was packed into the flash bank
+    printf("Sound bank partition: %s\n", SOUNDBANK_PARTITION_LABEL);
+    soundbank_t bank;
+    int config_result = -1;
+    if (soundbank_open_partition(SOUNDBANK_PARTITION_LABEL, &bank) == 0) {
+        config_result = soundbank_config(&bank, &config);
+        soundbank_close(&bank);
+    }
+    if (config_result != 0) {
+#else
     printf("Config path: %s\n", config_path);
+    if (config_load(config_path, &config) != 0) {
+#endif
+        printf("Failed to load config\n");
+#ifdef ESP_PLATFORM
+        return;
+#else
+        return 1;
+#endif
+    }
     
-    if (soundboard_init() != 0) {
+    if (soundboard_init(&config) != 0) {
         printf("Failed to initialize soundboard\n");
+        config_free(&config);
 #ifdef ESP_PLATFORM
         return;
 #else
@@ -116,9 +143,13 @@ int main(int argc, char *argv[]) {
 #endif
     }
     
-    if (load_sounds_from_config(config_path) != 0) {
-        printf("Failed to load sounds from config\n");
+    // Pads become playable as their files finish loading; the config must
+    // outlive the loader
+    if (page_residency_start(&config) != 0) {
+        printf("Failed to start loading sounds\n");
         soundboard_cleanup();
+        bank_loader_cleanup();
+        config_free(&config);
 #ifdef ESP_PLATFORM
         return;
 #else
@@ -127,45 +158,128 @@ int main(int argc, char *argv[]) {
     }
     
     printf("MIDI Soundboard ready. Press keys on your MIDI keyboard.\n");
-    printf("Current page: %u (use MIDI CC to change pages)\n", soundboard_get_current_page());
-#ifdef __APPLE__
-    printf("Press Ctrl+C to exit.\n");
+    printf("Current page: %u (use Program Change", soundboard_get_current_page());
+    if (config.page_cc >= 0) {
+        printf(" or CC %d", config.page_cc);
+    }
+    printf(" to change pages)\n");
+#ifndef ESP_PLATFORM
+    printf("Press Ctrl+C to exit (SIGUSR1 prints latency statistics).\n");
+#endif
+    
+    // From here on the loop, callbacks and loader threads log through the
+    // background writer instead of blocking on stdout
+    async_log_set_level(config.log_level);
+    if (async_log_start() != 0) {
+        fprintf(stderr, "[MAIN] Failed to start the log thread, logging synchronously\n");
+    }
+#ifndef ESP_PLATFORM
+    // Stats and commands for local tools; the player runs fine without it
+    control_server_start(config.control_socket);
 #endif
     
-    midi_event_t event;
-    unsigned long loop_count = 0;
+    midi_event_t events[MIDI_BATCH_SIZE];
+    event_dispatch_t dispatch;
+    event_dispatch_init(&dispatch, &config);
+    uint32_t reported_overflows = 0;
+    uint64_t status_ns = clock_now_ns();
+    uint64_t status_cpu_ns = process_cpu_ns();
+    unsigned long status_events = 0;
+    uint64_t latency_total_ns = 0;
+    uint64_t latency_max_ns = 0;
     while (running) {
-        int result = midi_read(&event);
-        if (result == 0) {
-            uint8_t page = soundboard_get_current_page();
-            
-            if (event.is_on) {
-                printf("[MAIN] Note ON: %d (velocity: %d) on page %u\n", 
-                       event.note, event.velocity, page);
-                soundboard_play_note(page, event.note);
-            } else {
-                printf("[MAIN] Note OFF: %d on page %u\n", event.note, page);
-                soundboard_stop_note(page, event.note);
+        // Sleep until the MIDI driver or the control socket has something
+        // for us; the timeout only keeps the housekeeping below ticking
+        // while nothing is played.
+        // A reloading sound is playing its attack, so check back quickly.
+        midi_wait(sample_cache_reloading() ? RELOAD_WAIT_MS : MAIN_WAIT_MS);
+        
+        // Handle everything that arrived since the last wakeup, in order
+        size_t count;
+        do {
+            count = midi_read_batch(events, MIDI_BATCH_SIZE);
+            for (size_t i = 0; i < count; i++) {
+                const midi_event_t *event = &events[i];
+                uint8_t page;
+                if (!event_dispatch(&dispatch, event, &page)) {
+                    continue;
+                }
+                
+                uint64_t latency_ns = clock_now_ns() - event->timestamp_ns;
+                latency_stats_record(LATENCY_INPUT_TO_DISPATCH, latency_ns);
+                latency_total_ns += latency_ns;
+                if (latency_ns > latency_max_ns) {
+                    latency_max_ns = latency_ns;
+                }
+                status_events++;
+                
+                if (event->is_on) {
+                    LOG_INFO("[MAIN] Note ON: %d (velocity: %d) on page %u\n",
+                             event->note, event->velocity, page);
+                } else {
+                    LOG_INFO("[MAIN] Note OFF: %d on page %u\n", event->note, page);
+                }
             }
-        } else if (result < 0) {
-            printf("[MAIN] ERROR: midi_read() returned error\n");
-        }
+        } while (count == MIDI_BATCH_SIZE);
         
-        // Print status every 5 seconds
-        loop_count++;
-        if (loop_count % 5000 == 0) {
-            printf("[MAIN] Still running... (page %u)\n", soundboard_get_current_page());
+        uint32_t overflows = midi_overflow_count();
+        if (overflows != reported_overflows) {
+            LOG_WARN("[MAIN] WARNING: %u MIDI event(s) dropped (queue full)\n",
+                     overflows - reported_overflows);
+            reported_overflows = overflows;
         }
         
-#ifdef __APPLE__
-        usleep(1000); // Small delay to prevent busy waiting
-#else
-        vTaskDelay(pdMS_TO_TICKS(1));
+#ifndef ESP_PLATFORM
+        // Commands from the control socket run here, on the control thread
+        control_server_poll();
 #endif
+        
+        if (stats_requested) {
+            stats_requested = false;
+            latency_stats_dump();
+        }
+        
+        // Collect finished loads and load or unload pages around the current one
+        page_residency_poll();
+        // Move voices onto reloaded sounds and evict down to the budget
+        sample_cache_poll();
+        // Free sounds replaced by a reload once their voices have finished
+        soundboard_free_retired();
+        
+        // Print status every 5 seconds
+        uint64_t now = clock_now_ns();
+        if (now - status_ns >= STATUS_INTERVAL_NS) {
+            uint64_t cpu_ns = process_cpu_ns();
+            double cpu_percent = 100.0 * (double)(cpu_ns - status_cpu_ns) / (double)(now - status_ns);
+            double latency_avg_ms = status_events ? latency_total_ns / 1e6 / status_events : 0.0;
+            LOG_INFO("[MAIN] Still running... (page %u, %lu event(s), dispatch latency avg %.3f ms max %.3f ms, CPU %.1f%%)\n",
+                     soundboard_get_current_page(), status_events, latency_avg_ms,
+                     latency_max_ns / 1e6, cpu_percent);
+            if (sample_cache_enabled()) {
+                sample_cache_stats_t cache;
+                sample_cache_get_stats(&cache);
+                LOG_INFO("[CACHE] %zu/%zu MB resident, %u hit(s), %u miss(es), %u eviction(s), %u reload(s)\n",
+                         cache.resident_bytes >> 20, cache.budget_bytes >> 20, cache.hits, cache.misses,
+                         cache.evictions, cache.reloads);
+            }
+            status_ns = now;
+            status_cpu_ns = cpu_ns;
+            status_events = 0;
+            latency_total_ns = 0;
+            latency_max_ns = 0;
+        }
     }
     
     printf("\nShutting down...\n");
+#ifndef ESP_PLATFORM
+    control_server_stop();
+#endif
+    latency_stats_dump();
+    bank_loader_cancel();
     soundboard_cleanup();
+    bank_loader_cleanup();
+    config_free(&config);
+    async_log_stop();
     
 #ifndef ESP_PLATFORM
     return 0;
@@ -0,0 +1,376 @@
+#include "midi_file.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_TEMPO_US 500000     // 120 bpm until the first tempo event
+#define MAX_FILE_BYTES (64u << 20)  // Far beyond any real performance
+
+// Event in file order, before tracks are merged. Tempo changes and track
+// ends ride along as entries with no bytes.
+typedef struct {
+    uint64_t tick;              // Ticks for MIDI files, nanoseconds for logs
+    uint32_t order;             // Position in the file; breaks ties in time
+    uint32_t tempo_us;          // Microseconds per quarter note (tempo events only)
+    uint8_t bytes[3];
+    uint8_t length;             // 0 for tempo and end-of-track entries
+} raw_event_t;
+
+typedef struct {
+    raw_event_t *items;
+    size_t count;
+    size_t capacity;
+} raw_list_t;
+
+static int push_event(raw_list_t *list, const raw_event_t *event) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        raw_event_t *items = realloc(list->items, capacity * sizeof(*items));
+        if (items == NULL) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    raw_event_t *slot = &list->items[list->count];
+    *slot = *event;
+    slot->order = (uint32_t)list->count;
+    list->count++;
+    return 0;
+}
+
+static int compare_events(const void *a, const void *b) {
+    const raw_event_t *x = a;
+    const raw_event_t *y = b;
+    if (x->tick != y->tick) {
+        return x->tick < y->tick ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+// Data bytes following a channel status byte
+static size_t channel_data_length(uint8_t status) {
+    uint8_t type = status & 0xF0;
+    return type == 0xC0 || type == 0xD0 ? 1 : 2;
+}
+
+static uint32_t read_be(const uint8_t *bytes, int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// Variable-length quantity of at most four bytes
+static int read_vlq(const uint8_t **cursor, const uint8_t *end, uint32_t *value) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        if (*cursor >= end) {
+            return -1;
+        }
+        uint8_t byte = *(*cursor)++;
+        result = (result << 7) | (byte & 0x7F);
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------------------------
+// Standard MIDI Files
+// ---------------------------------------------------------------------------
+
+static int parse_track(const uint8_t *data, size_t size, raw_list_t *list) {
+    const uint8_t *cursor = data;
+    const uint8_t *end = data + size;
+    uint64_t tick = 0;
+    uint8_t status = 0; // Running status (0 = none)
+
+    while (cursor < end) {
+        uint32_t delta;
+        if (read_vlq(&cursor, end, &delta) != 0 || cursor >= end) {
+            return -1;
+        }
+        tick += delta;
+        uint8_t byte = *cursor;
+
+        if (byte == 0xFF || byte == 0xF0 || byte == 0xF7) {
+            // Meta and system exclusive events carry a length and cancel
+            // running status
+            cursor++;
+            uint8_t type = 0;
+            if (byte == 0xFF) {
+                if (cursor >= end) {
+                    return -1;
+                }
+                type = *cursor++;
+            }
+            uint32_t length;
+            if (read_vlq(&cursor, end, &length) != 0 || length > (size_t)(end - cursor)) {
+                return -1;
+            }
+            if (byte == 0xFF && type == 0x51 && length == 3) {
+                raw_event_t tempo = { .tick = tick, .tempo_us = read_be(cursor, 3) };
+                if (tempo.tempo_us > 0 && push_event(list, &tempo) != 0) {
+                    return -1;
+                }
+            } else if (byte == 0xFF && type == 0x2F) {
+                break;
+            }
+            cursor += length;
+            status = 0;
+            continue;
+        }
+
+        if (byte & 0x80) {
+            if (byte >= 0xF0) {
+                return -1; // System common and realtime messages can't appear here
+            }
+            status = byte;
+            cursor++;
+        } else if (status == 0) {
+            return -1;
+        }
+
+        size_t data_length = channel_data_length(status);
+        if ((size_t)(end - cursor) < data_length) {
+            return -1;
+        }
+        raw_event_t event = { .tick = tick, .length = (uint8_t)(1 + data_length) };
+        event.bytes[0] = status;
+        memcpy(event.bytes + 1, cursor, data_length);
+        if (push_event(list, &event) != 0) {
+            return -1;
+        }
+        cursor += data_length;
+    }
+
+    // End of track, which may be later than the last note
+    raw_event_t track_end = { .tick = tick };
+    return push_event(list, &track_end);
+}
+
+// Converts the merged, sorted ticks to nanoseconds in place
+static void apply_tempo_map(raw_list_t *list, uint16_t division) {
+    if (division & 0x8000) {
+        // SMPTE: frames per second (negated) and ticks per frame; 29 is 29.97
+        int fps = -(int8_t)(division >> 8);
+        double rate = fps == 29 ? 29.97 : fps;
+        double tick_ns = 1e9 / (rate * (division & 0xFF));
+        for (size_t i = 0; i < list->count; i++) {
+            list->items[i].tick = (uint64_t)(list->items[i].tick * tick_ns + 0.5);
+        }
+        return;
+    }
+
+    // Quarter notes: time is piecewise linear between tempo changes
+    uint64_t base_tick = 0;
+    uint64_t base_ns = 0;
+    double tick_ns = DEFAULT_TEMPO_US * 1000.0 / division;
+    for (size_t i = 0; i < list->count; i++) {
+        raw_event_t *event = &list->items[i];
+        uint64_t tick = event->tick;
+        event->tick = base_ns + (uint64_t)((tick - base_tick) * tick_ns + 0.5);
+        if (event->tempo_us > 0) {
+            base_tick = tick;
+            base_ns = event->tick;
+            tick_ns = event->tempo_us * 1000.0 / division;
+        }
+    }
+}
+
+static int parse_smf(const uint8_t *data, size_t size, raw_list_t *list) {
+    if (size < 14 || read_be(data + 4, 4) < 6) {
+        return -1;
+    }
+    uint32_t header_length = read_be(data + 4, 4);
+    uint16_t format = (uint16_t)read_be(data + 8, 2);
+    uint16_t track_count = (uint16_t)read_be(data + 10, 2);
+    uint16_t division = (uint16_t)read_be(data + 12, 2);
+    if (format > 1) {
+        fprintf(stderr, "[MIDIFILE] Format %u files are not supported\n", format);
+        return -1;
+    }
+    if (division == 0 || ((division & 0x8000) && (division & 0xFF) == 0)) {
+        return -1;
+    }
+    if (header_length > size - 8) {
+        return -1;
+    }
+
+    size_t offset = 8 + (size_t)header_length;
+    uint16_t tracks = 0;
+    while (tracks < track_count && size - offset >= 8) {
+        uint32_t chunk_length = read_be(data + offset + 4, 4);
+        const uint8_t *chunk = data + offset + 8;
+        if (chunk_length > size - offset - 8) {
+            return -1;
+        }
+        // Unknown chunk types are skipped, as the format requires
+        if (memcmp(data + offset, "MTrk", 4) == 0) {
+            if (parse_track(chunk, chunk_length, list) != 0) {
+                fprintf(stderr, "[MIDIFILE] Track %u is malformed\n", tracks);
+                return -1;
+            }
+            tracks++;
+        }
+        offset += 8 + (size_t)chunk_length;
+    }
+    if (tracks < track_count) {
+        fprintf(stderr, "[MIDIFILE] Expected %u track(s), found %u\n", track_count, tracks);
+        return -1;
+    }
+
+    qsort(list->items, list->count, sizeof(*list->items), compare_events);
+    apply_tempo_map(list, division);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Event logs
+// ---------------------------------------------------------------------------
+
+// Parses one line; blank and comment lines leave the list unchanged
+static int parse_log_line(const char *line, raw_list_t *list) {
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+    if (*line == '\0' || *line == '#') {
+        return 0;
+    }
+
+    char *next;
+    double seconds = strtod(line, &next);
+    if (next == line || !(seconds >= 0.0) || seconds > 1e9) {
+        return -1;
+    }
+
+    raw_event_t event = { .tick = (uint64_t)(seconds * 1e9 + 0.5) };
+    for (;;) {
+        line = next;
+        while (isspace((unsigned char)*line)) {
+            line++;
+        }
+        if (*line == '\0' || *line == '#') {
+            break;
+        }
+        unsigned long byte = strtoul(line, &next, 16);
+        if (next == line || byte > 0xFF || event.length == sizeof(event.bytes)) {
+            return -1;
+        }
+        event.bytes[event.length++] = (uint8_t)byte;
+    }
+
+    uint8_t status = event.bytes[0];
+    if (event.length == 0 || status < 0x80 || status >= 0xF0 ||
+        event.length != 1 + channel_data_length(status)) {
+        return -1;
+    }
+    for (uint8_t i = 1; i < event.length; i++) {
+        if (event.bytes[i] & 0x80) {
+            return -1;
+        }
+    }
+    return push_event(list, &event);
+}
+
+static int parse_log(char *text, raw_list_t *list) {
+    unsigned line_number = 1;
+    for (char *line = text; line != NULL; line_number++) {
+        char *newline = strchr(line, '\n');
+        if (newline != NULL) {
+            *newline = '\0';
+        }
+        if (parse_log_line(line, list) != 0) {
+            fprintf(stderr, "[MIDIFILE] Line %u: expected \"<seconds> <status> <data>...\" in hex\n",
+                    line_number);
+            return -1;
+        }
+        line = newline != NULL ? newline + 1 : NULL;
+    }
+    // Lines need not be in order; equal times keep their order
+    qsort(list->items, list->count, sizeof(*list->items), compare_events);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static char *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    char *data = NULL;
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        length = ftell(file);
+    }
+    if (length >= 0 && (unsigned long)length <= MAX_FILE_BYTES && fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)length + 1);
+        if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    if (data != NULL) {
+        data[length] = '\0'; // Event logs are parsed as a string
+        *size = (size_t)length;
+    }
+    return data;
+}
+
+int midi_file_load(const char *path, midi_file_t *file) {
+    memset(file, 0, sizeof(*file));
+
+    size_t size;
+    char *data = read_file(path, &size);
+    if (data == NULL) {
+        fprintf(stderr, "[MIDIFILE] Failed to read %s\n", path);
+        return -1;
+    }
+
+    raw_list_t list = {0};
+    bool is_smf = size >= 4 && memcmp(data, "MThd", 4) == 0;
+    int result = is_smf ? parse_smf((const uint8_t *)data, size, &list) : parse_log(data, &list);
+    free(data);
+    if (result != 0) {
+        fprintf(stderr, "[MIDIFILE] Not a valid %s: %s\n", is_smf ? "MIDI file" : "event log", path);
+        free(list.items);
+        return -1;
+    }
+
+    // Keep the messages; tempo and end-of-track entries only extend the length
+    file->events = malloc((list.count ? list.count : 1) * sizeof(*file->events));
+    if (file->events == NULL) {
+        free(list.items);
+        return -1;
+    }
+    for (size_t i = 0; i < list.count; i++) {
+        const raw_event_t *raw = &list.items[i];
+        if (raw->tick > file->length_ns) {
+            file->length_ns = raw->tick;
+        }
+        if (raw->length == 0) {
+            continue;
+        }
+        midi_file_event_t *event = &file->events[file->event_count++];
+        event->time_ns = raw->tick;
+        memcpy(event->bytes, raw->bytes, sizeof(event->bytes));
+        event->length = raw->length;
+    }
+    free(list.items);
+    return 0;
+}
+
+void midi_file_free(midi_file_t *file) {
+    free(file->events);
+    file->events = NULL;
+    file->event_count = 0;
+    file->length_ns = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef MIDI_FILE_H
+#define MIDI_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Reads a performance for offline rendering: a Standard MIDI File (format 0
+// or 1, any number of tracks, tempo changes and SMPTE timing) or a plain
+// event log with one message per line:
+//
+//   # seconds  status data...   (hex bytes)
+//   0.000      90 24 7f
+//   0.500      80 24 00
+//
+// Only channel messages are kept. They are returned merged into one list in
+// time order, with the status byte written out on every message.
+
+typedef struct {
+    uint64_t time_ns;           // From the start of the performance
+    uint8_t bytes[3];           // Status and data bytes
+    uint8_t length;
+} midi_file_event_t;
+
+typedef struct {
+    midi_file_event_t *events;
+    size_t event_count;
+    uint64_t length_ns;         // Time of the last event, or the end of track if later
+} midi_file_t;
+
+// Detects the format from the contents. Returns 0 on success.
+int midi_file_load(const char *path, midi_file_t *file);
+void midi_file_free(midi_file_t *file);
+
+#endif // MIDI_FILE_H
@@ -0,0 +1,194 @@
+#include "midi_queue.h"
+#if !defined(__APPLE__) && !defined(ESP_PLATFORM)
+#include <errno.h>
+#include <time.h>
+#endif
+
+int midi_queue_init(midi_queue_t *queue, size_t capacity) {
+    if (queue == NULL) {
+        return -1;
+    }
+    atomic_init(&queue->overflows, 0);
+    atomic_init(&queue->signaled, false);
+    
+#if defined(__APPLE__)
+    queue->wakeup = dispatch_semaphore_create(0);
+    if (queue->wakeup == NULL) {
+        return -1;
+    }
+#elif defined(ESP_PLATFORM)
+    queue->wakeup = xSemaphoreCreateBinary();
+    if (queue->wakeup == NULL) {
+        return -1;
+    }
+#else
+    if (sem_init(&queue->wakeup, 0, 0) != 0) {
+        return -1;
+    }
+#endif
+    
+    if (spsc_ring_init(&queue->ring, sizeof(midi_event_t), capacity) != 0) {
+        midi_queue_free(queue);
+        return -1;
+    }
+    return 0;
+}
+
+void midi_queue_free(midi_queue_t *queue) {
+    if (queue == NULL) {
+        return;
+    }
+    spsc_ring_free(&queue->ring);
+#if defined(__APPLE__)
+    if (queue->wakeup != NULL) {
+        dispatch_release(queue->wakeup);
+        queue->wakeup = NULL;
+    }
+#elif defined(ESP_PLATFORM)
+    if (queue->wakeup != NULL) {
+        vSemaphoreDelete(queue->wakeup);
+        queue->wakeup = NULL;
+    }
+#else
+    sem_destroy(&queue->wakeup);
+#endif
+}
+
+bool midi_queue_push(midi_queue_t *queue, const midi_event_t *event) {
+    if (!spsc_ring_push(&queue->ring, event)) {
+        atomic_fetch_add_explicit(&queue->overflows, 1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void midi_queue_notify(midi_queue_t *queue) {
+    if (atomic_exchange(&queue->signaled, true)) {
+        return; // Consumer hasn't picked up the previous wakeup yet
+    }
+#if defined(__APPLE__)
+    dispatch_semaphore_signal(queue->wakeup);
+#elif defined(ESP_PLATFORM)
+    xSemaphoreGive(queue->wakeup);
+#else
+    sem_post(&queue->wakeup);
+#endif
+}
+
+size_t midi_queue_pop_batch(midi_queue_t *queue, midi_event_t *events, size_t max) {
+    size_t count = 0;
+    while (count < max && spsc_ring_pop(&queue->ring, &events[count])) {
+        count++;
+    }
+    return count;
+}
+
+bool midi_queue_wait(midi_queue_t *queue, uint32_t timeout_ms) {
+    if (spsc_ring_count(&queue->ring) > 0) {
+        return true;
+    }
+    
+    bool woken;
+#if defined(__APPLE__)
+    dispatch_time_t deadline = dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeout_ms * 1000000);
+    woken = dispatch_semaphore_wait(queue->wakeup, deadline) == 0;
+#elif defined(ESP_PLATFORM)
+    woken = xSemaphoreTake(queue->wakeup, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    int result;
+    while ((result = sem_timedwait(&queue->wakeup, &deadline)) != 0 && errno == EINTR) {
+    }
+    woken = result == 0;
+#endif
+    
+    // Cleared before the caller drains, so anything pushed after this point
+    // posts a fresh wakeup
+    if (woken) {
+        atomic_store(&queue->signaled, false);
+    }
+    return woken;
+}
+
+uint32_t midi_queue_overflows(midi_queue_t *queue) {
+    return atomic_load_explicit(&queue->overflows, memory_order_relaxed);
+}
+
+// Data bytes that follow a channel status byte
+static uint8_t channel_message_length(uint8_t status) {
+    uint8_t type = status & 0xF0;
+    return (type == 0xC0 || type == 0xD0) ? 1 : 2;
+}
+
+size_t midi_parser_feed(midi_parser_t *parser, const uint8_t *bytes, size_t len,
+                        uint64_t timestamp_ns, midi_queue_t *queue) {
+    size_t pushed = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = bytes[i];
+
+        if (byte >= 0xF8) {
+            continue; // Realtime (clock, start/stop, active sensing) may appear anywhere
+        }
+
+        if (byte & 0x80) {
+            if (byte == 0xF0) {
+                parser->in_sysex = true;
+                parser->status = 0;
+            } else if (byte == 0xF7) {
+                parser->in_sysex = false;
+            } else if (byte >= 0xF0) {
+                parser->in_sysex = false;
+                parser->status = 0; // System common messages cancel running status
+            } else {
+                parser->in_sysex = false;
+                parser->status = byte;
+            }
+            parser->count = 0;
+            continue;
+        }
+
+        if (parser->in_sysex || parser->status == 0) {
+            continue;
+        }
+
+        parser->data[parser->count++] = byte;
+        if (parser->count < channel_message_length(parser->status)) {
+            continue;
+        }
+        parser->count = 0; // Running status: the next data byte starts a new message
+
+        uint8_t type = parser->status & 0xF0;
+        midi_event_t event = {
+            .note = parser->data[0],
+            .velocity = parser->data[1],
+            .timestamp_ns = timestamp_ns,
+        };
+        if (type == 0x90 || type == 0x80) {
+            event.type = MIDI_EVENT_NOTE;
+            event.is_on = type == 0x90 && parser->data[1] > 0;
+        } else if (type == 0xB0) {
+            event.type = MIDI_EVENT_CONTROL;
+        } else if (type == 0xC0) {
+            event.type = MIDI_EVENT_PROGRAM;
+            event.velocity = 0;
+        } else {
+            continue; // Aftertouch and pitch bend aren't used
+        }
+        if (midi_queue_push(queue, &event)) {
+            pushed++;
+        }
+    }
+    
+    if (pushed > 0) {
+        midi_queue_notify(queue);
+    }
+    return pushed;
+}
@@ -0,0 +1,74 @@
+#ifndef MIDI_QUEUE_H
+#define MIDI_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "midi_soundboard.h"  // For midi_event_t
+#include "spsc_ring.h"
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#else
+#include <semaphore.h>
+#endif
+
+// Lossless hand-off of MIDI events from the driver's input thread to the
+// main loop. The driver thread parses raw bytes and pushes every event;
+// the main loop drains them in batches. The producer never blocks. If
+// the consumer falls far behind, new events are counted as overflows
+// rather than overwriting older ones.
+//
+// The consumer can sleep in midi_queue_wait() until the producer posts a
+// wakeup. At most one wakeup is outstanding at a time, so a burst of events
+// costs the producer one semaphore post.
+
+#define MIDI_QUEUE_SIZE 1024
+
+typedef struct {
+    spsc_ring_t ring;
+    _Atomic uint32_t overflows;
+    _Atomic bool signaled;       // A wakeup is posted and not yet consumed
+#if defined(__APPLE__)
+    dispatch_semaphore_t wakeup;
+#elif defined(ESP_PLATFORM)
+    SemaphoreHandle_t wakeup;
+#else
+    sem_t wakeup;
+#endif
+} midi_queue_t;
+
+int midi_queue_init(midi_queue_t *queue, size_t capacity);
+void midi_queue_free(midi_queue_t *queue);
+
+// Producer: returns false (and counts an overflow) if the queue is full
+bool midi_queue_push(midi_queue_t *queue, const midi_event_t *event);
+// Producer: wakes the consumer if it is waiting (no-op if already posted)
+void midi_queue_notify(midi_queue_t *queue);
+// Consumer: pops up to max events in arrival order; returns the count
+size_t midi_queue_pop_batch(midi_queue_t *queue, midi_event_t *events, size_t max);
+// Consumer: blocks until events may be queued or timeout_ms passes.
+// Returns true if woken by the producer.
+bool midi_queue_wait(midi_queue_t *queue, uint32_t timeout_ms);
+uint32_t midi_queue_overflows(midi_queue_t *queue);
+
+// Byte-stream parser for one MIDI source. Handles several messages per
+// packet, running status, and realtime bytes interleaved with a message.
+// System exclusive data is skipped.
+typedef struct {
+    uint8_t status;              // Current running status (0 = none)
+    uint8_t data[2];
+    uint8_t count;               // Data bytes collected for status
+    bool in_sysex;
+} midi_parser_t;
+
+// Parses len bytes and pushes every complete note, control change and
+// program change message to queue, stamped with timestamp_ns (monotonic
+// receive time), then wakes the consumer. Returns the number of events pushed.
+size_t midi_parser_feed(midi_parser_t *parser, const uint8_t *bytes, size_t len,
+                        uint64_t timestamp_ns, midi_queue_t *queue);
+
+#endif // MIDI_QUEUE_H
@@ -1,143 +1,427 @@
 #include "midi_soundboard.h"
 #include "platform/platform.h"
+#include "sample_cache.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #define MAX_NOTES 128
-#define MAX_PAGES 11
+#define MAX_PAGES SOUNDBOARD_PAGES
 
+// Soundbites are built off to the side (possibly on a loader thread) and
+// published with a single atomic store, so a pad is either absent or fully
+// initialized when the MIDI thread looks it up.
 typedef struct {
-    soundbite_t soundbites[MAX_NOTES];
+    _Atomic(soundbite_t *) soundbites[MAX_NOTES];
 } page_t;
 
-static page_t pages[MAX_PAGES] = {0};
+// Replaced soundbites may still be referenced by playing voices, so they are
+// kept until soundboard_free_retired() finds them silent rather than freed
+// on replacement
+typedef struct retired_soundbite {
+    soundbite_t *soundbite;
+    struct retired_soundbite *next;
+} retired_soundbite_t;
+
+static page_t pages[MAX_PAGES];
 static uint8_t current_page = 0;
 static bool initialized = false;
+static retired_soundbite_t *retired = NULL;
+static pthread_mutex_t retired_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Velocity response is taken from the config per pad, so changing a curve
+// never touches the loaded audio. Gains are tabulated once at init.
+static uint8_t velocity_curves[MAX_PAGES][MAX_NOTES];
+static float velocity_gain[VELOCITY_CURVE_COUNT][128];
+static float master_gain = 1.0f;
+
+static void init_velocity_tables(void) {
+    for (int v = 0; v < 128; v++) {
+        float x = v / 127.0f;
+        velocity_gain[VELOCITY_LINEAR][v] = x;
+        velocity_gain[VELOCITY_SOFT][v] = sqrtf(x);
+        velocity_gain[VELOCITY_HARD][v] = x * x;
+        velocity_gain[VELOCITY_FIXED][v] = 1.0f;
+    }
+}
+
+static soundbite_t *get_soundbite(uint8_t page, uint8_t note) {
+    return atomic_load_explicit(&pages[page].soundbites[note], memory_order_acquire);
+}
+
+static void free_soundbite(soundbite_t *sb) {
+    if (sb) {
+        if (sb->owns_data) {
+            free((void *)sb->data);
+            free((void *)sb->adpcm);
+        }
+        sound_stream_close(sb->stream);
+        free(sb->body);
+        free(sb->attack);
+        free(sb->source_path);
+        free(sb);
+    }
+}
 
-int soundboard_init(void) {
+int soundboard_init(const config_t *config) {
     if (initialized) {
         return 0;
     }
     
-    memset(pages, 0, sizeof(pages));
+    for (int p = 0; p < MAX_PAGES; p++) {
+        for (int n = 0; n < MAX_NOTES; n++) {
+            atomic_init(&pages[p].soundbites[n], NULL);
+        }
+    }
     current_page = 0;
     
-    if (midi_init() != 0) {
+    init_velocity_tables();
+    memset(velocity_curves, VELOCITY_LINEAR, sizeof(velocity_curves));
+    master_gain = config ? config->master_volume : 1.0f;
+    for (size_t i = 0; config && i < config->sound_count; i++) {
+        const sound_config_t *sound = &config->sounds[i];
+        if (sound->page < MAX_PAGES && sound->note < MAX_NOTES) {
+            velocity_curves[sound->page][sound->note] = (uint8_t)sound->velocity_curve;
+        }
+    }
+    
+    if (midi_init(config ? config->midi_input : NULL) != 0) {
         return -1;
     }
     
-    if (audio_init(44100) != 0) {
+    audio_settings_t settings = {
+        .sample_rate = SOUNDBOARD_SAMPLE_RATE,
+        .max_voices = config ? config->max_voices : 0,
+        .steal_policy = config ? config->steal_policy : VOICE_STEAL_OLDEST,
+        .output = config ? config->audio_output : AUDIO_OUTPUT_UNIT,
+        .buffer_frames = config ? config->buffer_frames : 0,
+        .buffer_count = config ? config->buffer_count : 0,
+        .device = config ? config->audio_device : NULL,
+    };
+    
+    if (audio_init(&settings) != 0) {
         midi_cleanup();
         return -1;
     }
     
+    if (config && config->cache_budget_mb > 0) {
+        sample_cache_init((size_t)config->cache_budget_mb << 20, config->cache_attack_ms);
+    }
+    
     initialized = true;
     return 0;
 }
 
-int soundboard_load_soundbite(uint8_t page, uint8_t note, const int16_t *data, size_t length, 
-                              uint32_t sample_rate, float volume_offset, sound_mode_t mode) {
-    // Validate inputs
-    if (page >= MAX_PAGES || note >= MAX_NOTES || data == NULL || length == 0) {
-        return -1;
+static soundbite_t *new_soundbite(uint8_t page, uint8_t note, const int16_t *data, bool owns_data,
+                                  sound_stream_t *stream, size_t length, uint32_t sample_rate,
+                                  float volume_offset, sound_mode_t mode, uint8_t max_instances) {
+    // Validate inputs (ADPCM soundbites have no data)
+    if (page >= MAX_PAGES || note >= MAX_NOTES || length == 0) {
+        return NULL;
     }
     if (mode > SOUND_MODE_HOLD) {
-        return -1; // Invalid mode
-    }
-    
-    soundbite_t *sb = &pages[page].soundbites[note];
-    
-    // Free existing data if any
-    if (sb->data) {
-        free(sb->data);
+        return NULL; // Invalid mode
     }
     
-    // Allocate and copy data
-    sb->data = malloc(length * sizeof(int16_t));
-    if (!sb->data) {
-        return -1;
-    }
-    
-    // Apply volume offset
-    float volume_mult = 1.0f + volume_offset;
-    volume_mult = fmaxf(0.0f, fminf(2.0f, volume_mult)); // Clamp to 0-2x
-    
-    for (size_t i = 0; i < length; i++) {
-        float sample = (float)data[i] * volume_mult;
-        sb->data[i] = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, sample));
+    // Safe to call from loader threads: everything below touches only the
+    // new soundbite until it is published
+    soundbite_t *sb = calloc(1, sizeof(*sb));
+    if (!sb) {
+        return NULL;
     }
     
+    // The buffer is used as-is; the volume offset is applied by the mixer as
+    // a per-voice gain
+    sb->data = data;
+    sb->owns_data = owns_data;
+    sb->stream = stream;
+    sb->gain = fmaxf(0.0f, fminf(2.0f, 1.0f + volume_offset)); // Clamp to 0-2x
     sb->length = length;
     sb->sample_rate = sample_rate;
     sb->volume_offset = volume_offset;
     sb->page = page;
     sb->mode = mode;
     sb->is_playing = false;
-    
+    sb->max_instances = max_instances;
+    if (sb->max_instances == 0) {
+        sb->max_instances = SOUNDBITE_DEFAULT_INSTANCES;
+    } else if (sb->max_instances > SOUNDBITE_MAX_INSTANCES) {
+        sb->max_instances = SOUNDBITE_MAX_INSTANCES;
+    }
+    return sb;
+}
+
+static void publish_soundbite(uint8_t page, uint8_t note, soundbite_t *sb) {
+    sample_cache_track(sb);
+    soundbite_t *old = atomic_exchange_explicit(&pages[page].soundbites[note], sb, memory_order_acq_rel);
+    if (old) {
+        sample_cache_forget(old);
+        retired_soundbite_t *entry = malloc(sizeof(*entry));
+        pthread_mutex_lock(&retired_mutex);
+        if (entry) {
+            entry->soundbite = old;
+            entry->next = retired;
+            retired = entry;
+        }
+        pthread_mutex_unlock(&retired_mutex);
+        // If the list node can't be allocated the old soundbite is leaked
+        // rather than freed under a playing voice
+    }
+}
+
+static int register_soundbite(uint8_t page, uint8_t note, const int16_t *data, bool owns_data,
+                              sound_stream_t *stream, size_t length, uint32_t sample_rate,
+                              float volume_offset, sound_mode_t mode, uint8_t max_instances) {
+    if (data == NULL) {
+        return -1;
+    }
+    soundbite_t *sb = new_soundbite(page, note, data, owns_data, stream, length, sample_rate,
+                                    volume_offset, mode, max_instances);
+    if (sb == NULL) {
+        return -1;
+    }
+    publish_soundbite(page, note, sb);
     return 0;
 }
 
-int soundboard_play_note(uint8_t page, uint8_t note) {
-    if (page >= MAX_PAGES || note >= MAX_NOTES) {
+int soundboard_adopt_soundbite(uint8_t page, uint8_t note, int16_t *data, size_t length, 
+                               uint32_t sample_rate, float volume_offset, sound_mode_t mode,
+                               uint8_t max_instances) {
+    return register_soundbite(page, note, data, true, NULL, length, sample_rate, volume_offset,
+                              mode, max_instances);
+}
+
+int soundboard_map_soundbite(uint8_t page, uint8_t note, const int16_t *data, size_t length, 
+                             uint32_t sample_rate, float volume_offset, sound_mode_t mode,
+                             uint8_t max_instances) {
+    return register_soundbite(page, note, data, false, NULL, length, sample_rate, volume_offset,
+                              mode, max_instances);
+}
+
+int soundboard_adopt_evictable(uint8_t page, uint8_t note, int16_t *data, size_t length, bool whole,
+                               size_t cache_bytes, uint32_t sample_rate, const char *source_path,
+                               resample_mode_t resample, float volume_offset, sound_mode_t mode,
+                               uint8_t max_instances) {
+    if (data == NULL) {
+        return -1;
+    }
+    soundbite_t *sb = new_soundbite(page, note, data, false, NULL, length, sample_rate, volume_offset,
+                                    mode, max_instances);
+    if (sb == NULL) {
         return -1;
     }
     
-    soundbite_t *sb = &pages[page].soundbites[note];
-    if (sb->data == NULL || sb->length == 0) {
-        return -1; // No soundbite loaded for this note
+    size_t attack_length = sample_cache_attack_frames(sample_rate);
+    if (attack_length == 0 || attack_length > length) {
+        attack_length = length;
+    }
+    sb->evictable = true;
+    sb->resample = resample;
+    sb->attack_length = attack_length;
+    sb->source_path = source_path ? strdup(source_path) : NULL;
+    if (whole) {
+        // Keep a copy of the start to fall back on once the body is evicted
+        sb->body = data;
+        sb->cache_bytes = cache_bytes;
+        sb->attack = malloc(attack_length * sizeof(int16_t));
+        if (sb->attack != NULL) {
+            memcpy(sb->attack, data, attack_length * sizeof(int16_t));
+        }
+    } else {
+        sb->attack = data;
+        sb->data = sb->attack;
+        sb->length = attack_length;
+    }
+    if (sb->source_path == NULL || sb->attack == NULL) {
+        // data stays with the caller on failure
+        sb->body = NULL;
+        if (!whole) {
+            sb->attack = NULL;
+        }
+        free_soundbite(sb);
+        return -1;
     }
     
+    publish_soundbite(page, note, sb);
+    return 0;
+}
+
+static int register_adpcm(uint8_t page, uint8_t note, const uint8_t *blocks, bool owns_data, size_t length,
+                          uint32_t sample_rate, float volume_offset, sound_mode_t mode, uint8_t max_instances) {
+    if (blocks == NULL) {
+        return -1;
+    }
+    soundbite_t *sb = new_soundbite(page, note, NULL, owns_data, NULL, length, sample_rate, volume_offset,
+                                    mode, max_instances);
+    if (sb == NULL) {
+        return -1;
+    }
+    sb->adpcm = blocks;
+    publish_soundbite(page, note, sb);
+    return 0;
+}
+
+int soundboard_adopt_adpcm(uint8_t page, uint8_t note, uint8_t *blocks, size_t length, uint32_t sample_rate,
+                           float volume_offset, sound_mode_t mode, uint8_t max_instances) {
+    return register_adpcm(page, note, blocks, true, length, sample_rate, volume_offset, mode, max_instances);
+}
+
+int soundboard_map_adpcm(uint8_t page, uint8_t note, const uint8_t *blocks, size_t length, uint32_t sample_rate,
+                         float volume_offset, sound_mode_t mode, uint8_t max_instances) {
+    return register_adpcm(page, note, blocks, false, length, sample_rate, volume_offset, mode, max_instances);
+}
+
+int soundboard_stream_soundbite(uint8_t page, uint8_t note, sound_stream_t *stream, float volume_offset,
+                                sound_mode_t mode) {
+    if (stream == NULL) {
+        return -1;
+    }
+    return register_soundbite(page, note, sound_stream_head(stream), false, stream,
+                              sound_stream_length(stream), sound_stream_sample_rate(stream),
+                              volume_offset, mode, 1);
+}
+
+// gain already includes velocity and master volume
+static voice_handle_t start_voice(const soundbite_t *sb, float gain, bool loop, bool hold) {
+    if (sb->stream != NULL) {
+        return audio_start_stream(sb->stream, gain, loop, hold);
+    }
+    if (sb->adpcm != NULL) {
+        return audio_start_adpcm(sb->adpcm, sb->length, sb->sample_rate, gain, loop, hold);
+    }
+    return audio_start_sound(sb->data, sb->length, sb->sample_rate, gain, loop, hold);
+}
+
+static int stop_voice(const soundbite_t *sb, voice_handle_t voice) {
+    if (sb->stream != NULL) {
+        sound_stream_end(sb->stream); // Stop reading ahead
+    }
+    return audio_stop_sound(voice);
+}
+
+static int trigger_soundbite(soundbite_t *sb, float gain) {
     // Handle different modes
-    bool loop = false;
-    bool hold = false;
-    
     if (sb->mode == SOUND_MODE_LOOP) { // LOOP mode - toggle on/off
         if (sb->is_playing) {
             // Already playing - stop it (toggle off)
             sb->is_playing = false;
-            return audio_stop_sound(sb->data);
-        } else {
-            // Not playing - start it (toggle on)
-            loop = true;
-            hold = false;
-            sb->is_playing = true;
+            return stop_voice(sb, sb->voices[0]);
         }
+        // Not playing - start it (toggle on)
+        sb->voices[0] = start_voice(sb, gain, true, false);
+        sb->is_playing = sb->voices[0] != VOICE_HANDLE_INVALID;
+        return sb->is_playing ? 0 : -1;
     } else if (sb->mode == SOUND_MODE_HOLD) { // HOLD mode
-        loop = false;
-        hold = true;
         if (sb->is_playing) {
             return 0; // Already playing
         }
-        sb->is_playing = true;
-    } else { // ONESHOT mode
-        loop = false;
-        hold = false;
+        sb->voices[0] = start_voice(sb, gain, false, true);
+        sb->is_playing = sb->voices[0] != VOICE_HANDLE_INVALID;
+        return sb->is_playing ? 0 : -1;
+    }
+    
+    // ONESHOT mode - layer up to max_instances voices, replacing the oldest.
+    // Stopping a handle whose voice already finished is a harmless no-op.
+    voice_handle_t *slot = &sb->voices[sb->next_instance];
+    if (*slot != VOICE_HANDLE_INVALID) {
+        stop_voice(sb, *slot);
+    }
+    *slot = start_voice(sb, gain, false, false);
+    sb->next_instance = (uint8_t)((sb->next_instance + 1) % sb->max_instances);
+    return *slot != VOICE_HANDLE_INVALID ? 0 : -1;
+}
+
+static int release_soundbite(soundbite_t *sb) {
+    if (sb->mode == SOUND_MODE_HOLD) { // HOLD mode - stop when note released
+        sb->is_playing = false;
+        return stop_voice(sb, sb->voices[0]);
+    } else if (sb->mode == SOUND_MODE_LOOP) { // LOOP mode - note off doesn't stop (toggle only)
+        // Loop mode is toggled by note on, not note off
+        return 0;
     }
+    // ONESHOT mode - already finished, nothing to stop
     
-    return audio_start_sound(sb->data, sb->length, loop, hold);
+    return 0;
 }
 
-int soundboard_stop_note(uint8_t page, uint8_t note) {
+int soundboard_play_note(uint8_t page, uint8_t note, uint8_t velocity, uint64_t timestamp_ns) {
     if (page >= MAX_PAGES || note >= MAX_NOTES) {
         return -1;
     }
     
-    soundbite_t *sb = &pages[page].soundbites[note];
-    if (sb->data == NULL || sb->length == 0) {
+    soundbite_t *sb = get_soundbite(page, note);
+    if (sb == NULL || (sb->data == NULL && sb->adpcm == NULL) || sb->length == 0) {
+        return -1; // No soundbite loaded for this note
+    }
+    
+    // Starts on the attack if the body was evicted; it follows shortly
+    sample_cache_touch(sb);
+    
+    // One copy of the audio serves every velocity; the mixer applies the
+    // combined gain per voice
+    float gain = sb->gain * velocity_gain[velocity_curves[page][note]][velocity & 0x7F] * master_gain;
+    
+    // Voices started and stopped here (including a replaced instance) all
+    // take effect at the event's time
+    audio_schedule(timestamp_ns);
+    int result = trigger_soundbite(sb, gain);
+    audio_schedule(0);
+    return result;
+}
+
+int soundboard_stop_note(uint8_t page, uint8_t note, uint64_t timestamp_ns) {
+    if (page >= MAX_PAGES || note >= MAX_NOTES) {
         return -1;
     }
     
-    if (sb->mode == SOUND_MODE_HOLD) { // HOLD mode - stop when note released
-        sb->is_playing = false;
-        return audio_stop_sound(sb->data);
-    } else if (sb->mode == SOUND_MODE_LOOP) { // LOOP mode - note off doesn't stop (toggle only)
-        // Loop mode is toggled by note on, not note off
+    soundbite_t *sb = get_soundbite(page, note);
+    if (sb == NULL || (sb->data == NULL && sb->adpcm == NULL) || sb->length == 0) {
+        return -1;
+    }
+    
+    audio_schedule(timestamp_ns);
+    int result = release_soundbite(sb);
+    audio_schedule(0);
+    return result;
+}
+
+// Stops whatever the pad is playing, in every mode
+static int silence_soundbite(soundbite_t *sb) {
+    int stopped = 0;
+    for (int i = 0; i < SOUNDBITE_MAX_INSTANCES; i++) {
+        if (sb->voices[i] != VOICE_HANDLE_INVALID && audio_sound_active(sb->voices[i])) {
+            stop_voice(sb, sb->voices[i]);
+            stopped++;
+        }
+    }
+    sb->is_playing = false;
+    return stopped;
+}
+
+int soundboard_stop_all(void) {
+    if (!initialized) {
         return 0;
     }
-    // ONESHOT mode - already finished, nothing to stop
     
-    return 0;
+    int stopped = 0;
+    for (int p = 0; p < MAX_PAGES; p++) {
+        for (int n = 0; n < MAX_NOTES; n++) {
+            soundbite_t *sb = get_soundbite(p, n);
+            if (sb != NULL) {
+                stopped += silence_soundbite(sb);
+            }
+        }
+    }
+    
+    // Voices started before their pad was replaced are still playing too
+    pthread_mutex_lock(&retired_mutex);
+    for (retired_soundbite_t *entry = retired; entry != NULL; entry = entry->next) {
+        stopped += silence_soundbite(entry->soundbite);
+    }
+    pthread_mutex_unlock(&retired_mutex);
+    return stopped;
 }
 
 uint8_t soundboard_get_current_page(void) {
@@ -150,23 +434,93 @@ void soundboard_set_page(uint8_t page) {
     }
 }
 
+static bool soundbite_busy(const soundbite_t *sb) {
+    for (int i = 0; i < SOUNDBITE_MAX_INSTANCES; i++) {
+        if (sb->voices[i] != VOICE_HANDLE_INVALID && audio_sound_active(sb->voices[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int soundboard_unload_page(uint8_t page) {
+    if (page >= MAX_PAGES) {
+        return -1;
+    }
+    
+    // Voices read the sample data in place, so nothing is freed while any
+    // of them (or a start still queued for the mixer) is alive, nor while
+    // the cache is reloading its body
+    for (int n = 0; n < MAX_NOTES; n++) {
+        soundbite_t *sb = get_soundbite(page, n);
+        if (sb != NULL && (soundbite_busy(sb) || sb->reload_pending)) {
+            return -1;
+        }
+    }
+    
+    int count = 0;
+    for (int n = 0; n < MAX_NOTES; n++) {
+        soundbite_t *sb = atomic_exchange_explicit(&pages[page].soundbites[n], NULL, memory_order_acq_rel);
+        if (sb != NULL) {
+            sample_cache_forget(sb);
+            free_soundbite(sb);
+            count++;
+        }
+    }
+    return count;
+}
+
+int soundboard_free_retired(void) {
+    if (!initialized) {
+        return 0;
+    }
+    
+    // Same rule as unloading a page: no voice (or queued start) and no
+    // body reload may still point into the soundbite
+    int count = 0;
+    pthread_mutex_lock(&retired_mutex);
+    retired_soundbite_t **link = &retired;
+    while (*link != NULL) {
+        retired_soundbite_t *entry = *link;
+        if (soundbite_busy(entry->soundbite) || entry->soundbite->reload_pending) {
+            link = &entry->next;
+            continue;
+        }
+        *link = entry->next;
+        free_soundbite(entry->soundbite);
+        free(entry);
+        count++;
+    }
+    pthread_mutex_unlock(&retired_mutex);
+    return count;
+}
+
 void soundboard_cleanup(void) {
     if (!initialized) {
         return;
     }
     
+    // Stop the render thread before freeing the sample data it reads
+    midi_cleanup();
+    audio_cleanup();
+    sample_cache_shutdown();
+    
     // Free all soundbite data
     for (int p = 0; p < MAX_PAGES; p++) {
         for (int n = 0; n < MAX_NOTES; n++) {
-            if (pages[p].soundbites[n].data) {
-                free(pages[p].soundbites[n].data);
-                pages[p].soundbites[n].data = NULL;
-            }
+            free_soundbite(atomic_exchange(&pages[p].soundbites[n], NULL));
         }
     }
     
-    midi_cleanup();
-    audio_cleanup();
-    memset(pages, 0, sizeof(pages));
+    pthread_mutex_lock(&retired_mutex);
+    while (retired) {
+        retired_soundbite_t *next = retired->next;
+        free_soundbite(retired->soundbite);
+        free(retired);
+        retired = next;
+    }
+    pthread_mutex_unlock(&retired_mutex);
+    sound_stream_shutdown();
+    
     initialized = false;
 }
@@ -5,41 +5,110 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "config.h"  // For sound_mode_t enum
+#include "mixer.h"   // For voice_handle_t
+#include "sound_stream.h"
 
-// MIDI note structure
+#define SOUNDBOARD_SAMPLE_RATE 44100
+#define SOUNDBOARD_PAGES 11
+
+#define SOUNDBITE_MAX_INSTANCES 16
+#define SOUNDBITE_DEFAULT_INSTANCES 4
+
+// Kinds of MIDI message passed on from the drivers
+typedef enum {
+    MIDI_EVENT_NOTE = 0,        // Note on/off
+    MIDI_EVENT_CONTROL,         // Control Change: note = controller, velocity = value
+    MIDI_EVENT_PROGRAM          // Program Change: note = program
+} midi_event_type_t;
+
+// MIDI event structure
 typedef struct {
+    midi_event_type_t type;
     uint8_t note;      // MIDI note number (0-127)
     uint8_t velocity;  // Note velocity (0-127)
     bool is_on;        // true for note on, false for note off
+    uint64_t timestamp_ns; // Monotonic time the event was received
 } midi_event_t;
 
 // Platform abstraction functions
 // MIDI input
-int midi_init(void);
+int midi_init(const char *source);
 int midi_read(midi_event_t *event);
 void midi_cleanup(void);
 
-// Audio output
-int audio_init(uint32_t sample_rate);
-int audio_play_sample(const int16_t *samples, size_t sample_count);
-void audio_cleanup(void);
+// Audio output is declared in platform/audio.h
 
 // Soundbite management
 typedef struct {
-    int16_t *data;              // Audio data (owned by soundboard)
+    const int16_t *data;        // Audio data (see owns_data)
+    bool owns_data;             // data/adpcm freed with the soundbite (false for mapped banks)
+    sound_stream_t *stream;     // Disk stream (data is its head), or NULL
+    const uint8_t *adpcm;       // IMA-ADPCM blocks played instead of data, or NULL
     size_t length;
     uint32_t sample_rate;
     float volume_offset;         // Volume adjustment (-1.0 to 1.0)
+    float gain;                  // Voice gain derived from volume_offset (before velocity)
     uint8_t page;                // Page number (0-10)
     uint8_t color_r, color_g, color_b; // RGB color
     sound_mode_t mode;           // Playback mode (use enum from config.h)
     bool is_playing;             // Currently playing (for loop/hold mode)
+    uint8_t max_instances;       // Overlapping voices allowed (oneshot mode)
+    uint8_t next_instance;       // Next entry in voices[] to (re)use
+    voice_handle_t voices[SOUNDBITE_MAX_INSTANCES]; // Most recent voice handles
+    
+    // Sample cache (sample_cache.h). For evictable sounds data is either
+    // body (the whole sound) or attack (its start, always in memory).
+    bool evictable;
+    int16_t *body;               // Owned whole sound, or NULL while evicted
+    int16_t *attack;             // Owned copy of the first attack_length frames
+    size_t attack_length;
+    size_t cache_bytes;          // Budget charged for body
+    char *source_path;           // File the body is reloaded from
+    resample_mode_t resample;
+    uint64_t last_used;          // LRU stamp
+    bool reload_pending;
 } soundbite_t;
 
-int soundboard_init(void);
-int soundboard_load_soundbite(uint8_t page, uint8_t note, const int16_t *data, size_t length, uint32_t sample_rate, float volume_offset, sound_mode_t mode);
-int soundboard_play_note(uint8_t page, uint8_t note);
-int soundboard_stop_note(uint8_t page, uint8_t note);
+int soundboard_init(const config_t *config);  // config may be NULL for defaults
+// Takes ownership of data (a malloc'd buffer) on success; on failure the
+// caller still owns it
+int soundboard_adopt_soundbite(uint8_t page, uint8_t note, int16_t *data, size_t length, uint32_t sample_rate, float volume_offset, sound_mode_t mode, uint8_t max_instances);
+// Plays data in place (e.g. from a mapped sound bank); it must stay valid
+// until soundboard_cleanup()
+int soundboard_map_soundbite(uint8_t page, uint8_t note, const int16_t *data, size_t length, uint32_t sample_rate, float volume_offset, sound_mode_t mode, uint8_t max_instances);
+// Registers a sound under the sample cache's memory budget; takes ownership
+// of data. data holds either the whole sound (whole, with cache_bytes
+// already reserved) or just its attack; the rest is decoded from
+// source_path whenever the sound is played.
+int soundboard_adopt_evictable(uint8_t page, uint8_t note, int16_t *data, size_t length, bool whole,
+                               size_t cache_bytes, uint32_t sample_rate, const char *source_path,
+                               resample_mode_t resample, float volume_offset, sound_mode_t mode,
+                               uint8_t max_instances);
+// Takes ownership of blocks (length frames of IMA-ADPCM, see adpcm.h) on
+// success; the mixer decodes them while playing
+int soundboard_adopt_adpcm(uint8_t page, uint8_t note, uint8_t *blocks, size_t length, uint32_t sample_rate,
+                           float volume_offset, sound_mode_t mode, uint8_t max_instances);
+// Plays ADPCM blocks in place (e.g. from a flash-mapped sound bank); they
+// must stay valid until soundboard_cleanup()
+int soundboard_map_adpcm(uint8_t page, uint8_t note, const uint8_t *blocks, size_t length, uint32_t sample_rate,
+                         float volume_offset, sound_mode_t mode, uint8_t max_instances);
+// Takes ownership of stream. Streamed sounds play one voice at a time.
+int soundboard_stream_soundbite(uint8_t page, uint8_t note, sound_stream_t *stream, float volume_offset, sound_mode_t mode);
+// timestamp_ns is the monotonic time the triggering event was received
+// (0 = now); the change is heard at a fixed delay from it. velocity scales
+// the voice through the pad's velocity curve.
+int soundboard_play_note(uint8_t page, uint8_t note, uint8_t velocity, uint64_t timestamp_ns);
+int soundboard_stop_note(uint8_t page, uint8_t note, uint64_t timestamp_ns);
+// Control thread: stops every voice on every page, loops and held pads
+// included. Returns the number of voices stopped.
+int soundboard_stop_all(void);
+// Control thread: frees every soundbite on page. Fails (-1) without freeing
+// anything while a voice of the page is still playing. Returns the number
+// of soundbites freed.
+int soundboard_unload_page(uint8_t page);
+// Control thread: frees soundbites replaced by a reload once none of their
+// voices is playing. Returns the number freed.
+int soundboard_free_retired(void);
 uint8_t soundboard_get_current_page(void);
 void soundboard_set_page(uint8_t page);
 void soundboard_cleanup(void);
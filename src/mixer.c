@@ -0,0 +1,990 @@
+#include "mixer.h"
+#include "async_log.h"
+#include "spsc_ring.h"
+#include "latency_stats.h"
+#include "monotonic_clock.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SIMD selection is compile-time: SSE2 is baseline on x86-64, AVX2 needs
+// -mavx2, NEON is baseline on Apple Silicon / AArch64.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIXER_USE_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MIXER_USE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MIXER_USE_NEON 1
+#endif
+
+#define COMMAND_QUEUE_SIZE 256
+#define STEAL_PROBE_FRAMES 128      // Look-ahead used to estimate a voice's loudness
+#define SCHEDULE_MAX_AHEAD_MS 1000  // Timestamps further out are treated as bogus
+#define MAX_TRACKED_STARTS 64       // Timed voice starts per render call; more go untimed
+
+// Control commands sent from the MIDI/main thread to the render callback
+typedef enum {
+    MIXER_CMD_START = 0,
+    MIXER_CMD_STOP,
+    MIXER_CMD_RETRIGGER,
+    MIXER_CMD_GAIN,
+    MIXER_CMD_EXTEND
+} mixer_command_type_t;
+
+typedef struct {
+    mixer_command_type_t type;
+    voice_handle_t handle;
+    const int16_t *data;
+    const uint8_t *adpcm;
+    size_t length;
+    size_t head_length;
+    sound_stream_t *stream;
+    uint32_t stream_epoch;
+    uint64_t step;
+    bool loop;
+    bool hold;
+    float gain;
+    uint64_t frame;                 // Mixer frame the command takes effect at
+    uint64_t trigger_ns;            // Start: input timestamp of the event (0 = untimed)
+    uint64_t sent_ns;               // Start: when the control thread sent it
+} mixer_command_t;
+
+static bool initialized = false;
+
+// Commands are the only way into the render thread; it never takes a lock
+static spsc_ring_t command_queue;
+
+// Live voices are kept dense in voices[0..voice_count) so the render loop
+// never scans idle slots. The pool holds max_voices playing voices plus a
+// reserve for voices that are fading out after being stolen or stopped.
+static mixer_voice_t *voices = NULL;
+static size_t voice_capacity = 0;
+static size_t voice_count = 0;
+static size_t fading_count = 0;
+static size_t max_voices = MIXER_DEFAULT_VOICES;
+static voice_steal_policy_t steal_policy = VOICE_STEAL_OLDEST;
+
+// Handle table. A handle is (generation << 16) | (slot + 1). The control
+// thread allocates slots from a free stack and bumps the generation; the
+// render thread maps slots to dense voice indices and hands slots back
+// through release_queue when their voice ends. Stale handles fail the
+// generation check, so commands for finished voices are harmless no-ops.
+static size_t handle_capacity = 0;
+static int32_t *handle_voice = NULL;        // Render thread: slot -> voice index or -1
+static uint16_t *handle_generation = NULL;  // Control thread: current generation per slot
+static uint16_t *free_handles = NULL;       // Control thread: free slot stack
+static bool *handle_live = NULL;            // Control thread: slot is allocated
+static size_t free_handle_count = 0;
+static spsc_ring_t release_queue;           // Render -> control: released slots
+
+// Render-thread sample clock, used to age voices and to schedule commands
+static uint64_t frame_clock = 0;
+static uint32_t output_rate = 44100;
+
+// voice_count as of the end of the last render call, for other threads
+static _Atomic uint32_t published_voice_count;
+// Render thread: total time spent in mixer_render() and frames it produced
+static _Atomic uint64_t published_render_ns;
+static _Atomic uint64_t published_render_frames;
+
+// Render thread: start time of the current render call, and the input
+// timestamps of timed voices it started, recorded once their first samples
+// are out
+static uint64_t render_start_ns = 0;
+static uint64_t started_triggers[MAX_TRACKED_STARTS];
+static size_t started_count = 0;
+
+// Oldest command not yet due; later ones wait behind it in command_queue
+static mixer_command_t next_command;
+static bool has_next_command = false;
+
+// Published by the render thread at the start of every render call so the
+// control thread can map event timestamps to frames. Guarded by a sequence
+// counter that is odd while an update is in progress.
+static _Atomic uint32_t anchor_sequence;
+static _Atomic uint64_t anchor_frame;
+static _Atomic uint64_t anchor_ns;
+static _Atomic uint64_t anchor_frames_per_call;
+
+// Control thread: frame requested by mixer_schedule*() and the frame of the
+// last command sent. Commands never take effect before earlier ones.
+static uint64_t schedule_frame = 0;
+static uint64_t last_command_frame = 0;
+static uint64_t schedule_trigger_ns = 0;    // Timestamp given to mixer_schedule(), for latency stats
+
+// Mix bus (owned by the render thread)
+static float bus[MIXER_BLOCK_FRAMES];
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+void mixer_accumulate(float *bus_out, const int16_t *src, size_t count) {
+    size_t i = 0;
+#if defined(MIXER_USE_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i))));
+        _mm256_storeu_ps(bus_out + i, _mm256_add_ps(_mm256_loadu_ps(bus_out + i), s));
+    }
+#elif defined(MIXER_USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // Sign-extend by placing each int16 in the top half and shifting down
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 16));
+        _mm_storeu_ps(bus_out + i, _mm_add_ps(_mm_loadu_ps(bus_out + i), lo));
+        _mm_storeu_ps(bus_out + i + 4, _mm_add_ps(_mm_loadu_ps(bus_out + i + 4), hi));
+    }
+#elif defined(MIXER_USE_NEON)
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(bus_out + i, vaddq_f32(vld1q_f32(bus_out + i), lo));
+        vst1q_f32(bus_out + i + 4, vaddq_f32(vld1q_f32(bus_out + i + 4), hi));
+    }
+#endif
+    for (; i < count; i++) {
+        bus_out[i] += (float)src[i];
+    }
+}
+
+void mixer_accumulate_gain(float *bus_out, const int16_t *src, size_t count, float gain) {
+    size_t i = 0;
+#if defined(MIXER_USE_AVX2)
+    const __m256 g = _mm256_set1_ps(gain);
+    for (; i + 8 <= count; i += 8) {
+        __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i))));
+        _mm256_storeu_ps(bus_out + i, _mm256_add_ps(_mm256_loadu_ps(bus_out + i), _mm256_mul_ps(s, g)));
+    }
+#elif defined(MIXER_USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 16));
+        _mm_storeu_ps(bus_out + i, _mm_add_ps(_mm_loadu_ps(bus_out + i), _mm_mul_ps(lo, g)));
+        _mm_storeu_ps(bus_out + i + 4, _mm_add_ps(_mm_loadu_ps(bus_out + i + 4), _mm_mul_ps(hi, g)));
+    }
+#elif defined(MIXER_USE_NEON)
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(bus_out + i, vmlaq_n_f32(vld1q_f32(bus_out + i), lo, gain));
+        vst1q_f32(bus_out + i + 4, vmlaq_n_f32(vld1q_f32(bus_out + i + 4), hi, gain));
+    }
+#endif
+    for (; i < count; i++) {
+        bus_out[i] += (float)src[i] * gain;
+    }
+}
+
+void mixer_accumulate_ramp(float *bus_out, const int16_t *src, size_t count, float gain, float step) {
+    // Only used for short fades, so a scalar loop is sufficient
+    for (size_t i = 0; i < count; i++) {
+        bus_out[i] += (float)src[i] * gain;
+        gain += step;
+    }
+}
+
+void mixer_saturate(int16_t *output, const float *bus_in, size_t count) {
+    size_t i = 0;
+#if defined(MIXER_USE_AVX2) || defined(MIXER_USE_SSE2)
+    // Clamp in float first so huge values can't wrap in the int32 conversion
+    const __m128 lo_limit = _mm_set1_ps(-32768.0f);
+    const __m128 hi_limit = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus_in + i), lo_limit), hi_limit);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus_in + i + 4), lo_limit), hi_limit);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *)(output + i), packed);
+    }
+#elif defined(MIXER_USE_NEON)
+    for (; i + 8 <= count; i += 8) {
+        // vcvtnq rounds to nearest; vqmovn saturates to int16
+        int32x4_t a = vcvtnq_s32_f32(vld1q_f32(bus_in + i));
+        int32x4_t b = vcvtnq_s32_f32(vld1q_f32(bus_in + i + 4));
+        vst1q_s16(output + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+    }
+#endif
+    for (; i < count; i++) {
+        float s = bus_in[i];
+        s = s > 32767.0f ? 32767.0f : (s < -32768.0f ? -32768.0f : s);
+        output[i] = (int16_t)(s < 0.0f ? s - 0.5f : s + 0.5f);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Render thread
+// ---------------------------------------------------------------------------
+
+static size_t handle_slot(voice_handle_t handle) {
+    return (size_t)(handle & 0xFFFF) - 1;
+}
+
+static void release_handle(voice_handle_t handle) {
+    uint16_t slot = (uint16_t)handle_slot(handle);
+    handle_voice[slot] = -1;
+    spsc_ring_push(&release_queue, &slot); // Sized so it can never be full
+}
+
+static mixer_voice_t *find_voice(voice_handle_t handle) {
+    size_t slot = handle_slot(handle);
+    if (handle == VOICE_HANDLE_INVALID || slot >= handle_capacity || handle_voice[slot] < 0) {
+        return NULL;
+    }
+    mixer_voice_t *voice = &voices[handle_voice[slot]];
+    return voice->handle == handle ? voice : NULL;
+}
+
+// A voice whose fade ran to the end has already left fading_count
+static void remove_voice(size_t index) {
+    if (voices[index].fade_remaining > 0) {
+        fading_count--;
+    }
+    release_handle(voices[index].handle);
+
+    voices[index] = voices[--voice_count];
+    if (index < voice_count) {
+        handle_voice[handle_slot(voices[index].handle)] = (int32_t)index;
+    }
+}
+
+static void begin_fade(mixer_voice_t *voice) {
+    if (voice->fade_remaining == 0) {
+        voice->fade_remaining = MIXER_FADE_FRAMES;
+        fading_count++;
+    }
+    voice->is_looping = false;
+}
+
+// Frames in one ADPCM block of a voice (the last one may be short)
+static size_t block_frames(const mixer_voice_t *voice, size_t index) {
+    size_t left = voice->length - index * ADPCM_BLOCK_FRAMES;
+    return left < ADPCM_BLOCK_FRAMES ? left : ADPCM_BLOCK_FRAMES;
+}
+
+static const int16_t *decode_block(mixer_voice_t *voice, size_t index) {
+    if (voice->block_index != index) {
+        adpcm_decode_block(voice->adpcm + index * ADPCM_BLOCK_BYTES, voice->block, block_frames(voice, index));
+        voice->block_index = index;
+    }
+    return voice->block;
+}
+
+// One frame of a PCM or ADPCM voice, for the interpolating path
+static inline int16_t voice_sample(mixer_voice_t *voice, size_t pos) {
+    if (voice->adpcm == NULL) {
+        return voice->data[pos];
+    }
+    size_t index = pos / ADPCM_BLOCK_FRAMES;
+    size_t offset = pos % ADPCM_BLOCK_FRAMES;
+    if (offset == 0 && index != voice->block_index) {
+        // Interpolating across a block boundary only needs the next block's
+        // first frame, which is stored uncompressed
+        return adpcm_block_first(voice->adpcm + index * ADPCM_BLOCK_BYTES);
+    }
+    return decode_block(voice, index)[offset];
+}
+
+static float estimate_level(const mixer_voice_t *voice) {
+    if (voice->position >= voice->head_length) {
+        return 32767.0f * voice->gain; // Streamed audio can't be looked at ahead; assume loud
+    }
+
+    const int16_t *src = voice->data;
+    size_t start = voice->position;
+    size_t end = voice->position + STEAL_PROBE_FRAMES;
+    if (end > voice->length) {
+        end = voice->length;
+    }
+    if (voice->adpcm != NULL) {
+        // Only the block already decoded is looked at
+        size_t index = voice->position / ADPCM_BLOCK_FRAMES;
+        if (index != voice->block_index) {
+            return 32767.0f * voice->gain;
+        }
+        src = voice->block;
+        start = voice->position % ADPCM_BLOCK_FRAMES;
+        end = start + STEAL_PROBE_FRAMES;
+        if (end > block_frames(voice, index)) {
+            end = block_frames(voice, index);
+        }
+    }
+
+    int32_t peak = 0;
+    for (size_t i = start; i < end; i++) {
+        int32_t s = src[i] < 0 ? -(int32_t)src[i] : src[i];
+        if (s > peak) {
+            peak = s;
+        }
+    }
+    return (float)peak * voice->gain;
+}
+
+// Pick the voice to sacrifice when the pool is full. Loops and holds are the
+// backbone of a set, so they are only stolen when nothing else is playing.
+static size_t choose_victim(void) {
+    size_t victim = SIZE_MAX;
+    bool victim_protected = true;
+    float victim_level = 0.0f;
+
+    for (size_t i = 0; i < voice_count; i++) {
+        const mixer_voice_t *voice = &voices[i];
+        if (voice->fade_remaining > 0) continue; // Already on its way out
+
+        bool is_protected = voice->is_looping || voice->is_hold;
+        if (victim != SIZE_MAX && is_protected && !victim_protected) continue;
+
+        bool better;
+        float level = 0.0f;
+        if (victim == SIZE_MAX || (victim_protected && !is_protected)) {
+            better = true;
+            if (steal_policy == VOICE_STEAL_QUIETEST) {
+                level = estimate_level(voice);
+            }
+        } else if (steal_policy == VOICE_STEAL_QUIETEST) {
+            level = estimate_level(voice);
+            better = level < victim_level;
+        } else {
+            better = voice->start_frame < voices[victim].start_frame;
+        }
+
+        if (better) {
+            victim = i;
+            victim_protected = is_protected;
+            victim_level = level;
+        }
+    }
+    return victim;
+}
+
+// The fading voice closest to silence, or SIZE_MAX if none is fading
+static size_t choose_faded(void) {
+    size_t faded = SIZE_MAX;
+    for (size_t i = 0; i < voice_count; i++) {
+        size_t remaining = voices[i].fade_remaining;
+        if (remaining > 0 && (faded == SIZE_MAX || remaining < voices[faded].fade_remaining)) {
+            faded = i;
+        }
+    }
+    return faded;
+}
+
+static void apply_start(const mixer_command_t *cmd) {
+    size_t index = voice_count;
+
+    if (voice_count - fading_count >= max_voices) {
+        size_t victim = choose_victim();
+        if (victim == SIZE_MAX) {
+            release_handle(cmd->handle); // Nothing can be stolen; drop the start
+            return;
+        }
+        if (voice_count < voice_capacity) {
+            begin_fade(&voices[victim]); // Fade out and take a reserve slot
+        } else {
+            index = victim; // Reserve exhausted - hard cut
+            release_handle(voices[victim].handle);
+        }
+    } else if (voice_count == voice_capacity) {
+        // Under the polyphony limit, but the reserve is full of voices that
+        // were stopped faster than they fade (e.g. quick taps on hold pads):
+        // cut the fade closest to silence short and reuse its slot
+        index = choose_faded();
+        if (index == SIZE_MAX) {
+            release_handle(cmd->handle);
+            return;
+        }
+        release_handle(voices[index].handle);
+        fading_count--;
+    }
+
+    if (index == voice_count) {
+        voice_count++;
+    }
+
+    mixer_voice_t *voice = &voices[index];
+    voice->handle = cmd->handle;
+    voice->data = cmd->data;
+    voice->adpcm = cmd->adpcm;
+    voice->block_index = SIZE_MAX;
+    voice->length = cmd->length;
+    voice->head_length = cmd->head_length;
+    voice->stream = cmd->stream;
+    voice->stream_epoch = cmd->stream_epoch;
+    voice->position = 0;
+    voice->frac = 0;
+    voice->step = cmd->step;
+    voice->is_looping = cmd->loop;
+    voice->is_hold = cmd->hold;
+    voice->gain = cmd->gain;
+    voice->fade_remaining = 0;
+    voice->start_frame = frame_clock;
+    handle_voice[handle_slot(cmd->handle)] = (int32_t)index;
+
+    if (cmd->trigger_ns != 0) {
+        latency_stats_record(LATENCY_DISPATCH_TO_START,
+                             render_start_ns > cmd->sent_ns ? render_start_ns - cmd->sent_ns : 0);
+        if (started_count < MAX_TRACKED_STARTS) {
+            started_triggers[started_count++] = cmd->trigger_ns;
+        }
+    }
+}
+
+static void apply_command(const mixer_command_t *cmd) {
+    if (cmd->type == MIXER_CMD_START) {
+        apply_start(cmd);
+        return;
+    }
+
+    mixer_voice_t *voice = find_voice(cmd->handle);
+    if (voice == NULL || voice->fade_remaining > 0) {
+        return; // Voice already finished or on its way out
+    }
+
+    switch (cmd->type) {
+        case MIXER_CMD_STOP:
+            // Stop regardless of mode (hold release, loop toggle off), with a
+            // short fade instead of a click
+            begin_fade(voice);
+            break;
+        case MIXER_CMD_RETRIGGER:
+            // A stream can only restart through a new epoch (a new voice)
+            if (voice->stream == NULL) {
+                voice->position = 0;
+            }
+            break;
+        case MIXER_CMD_GAIN:
+            voice->gain = cmd->gain;
+            break;
+        case MIXER_CMD_EXTEND:
+            // The new buffer starts with the frames played so far, so the
+            // voice carries on from its current position
+            if (voice->stream == NULL && voice->adpcm == NULL && cmd->length > voice->length) {
+                voice->data = cmd->data;
+                voice->length = cmd->length;
+                voice->head_length = cmd->length;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Realtime rate conversion for voices whose sample rate differs from the
+// output: linear interpolation with a 32.32 fixed-point position.
+static bool render_voice_interp(mixer_voice_t *voice, float *bus_out, size_t frame_count) {
+    const float frac_scale = 1.0f / 4294967296.0f;
+    float gain = voice->gain;
+    float gain_step = 0.0f;
+    if (voice->fade_remaining > 0) {
+        gain_step = -voice->gain / MIXER_FADE_FRAMES;
+        gain = -gain_step * voice->fade_remaining;
+    }
+
+    for (size_t i = 0; i < frame_count; i++) {
+        if (voice->position >= voice->length) {
+            if (!voice->is_looping) {
+                return false; // Sound finished
+            }
+            voice->position %= voice->length; // Loop back
+        }
+
+        size_t pos = voice->position;
+        float s0 = voice_sample(voice, pos);
+        float s1 = pos + 1 < voice->length ? voice_sample(voice, pos + 1)
+                 : (voice->is_looping ? voice_sample(voice, 0) : s0);
+        bus_out[i] += (s0 + (s1 - s0) * ((float)voice->frac * frac_scale)) * gain;
+
+        if (voice->fade_remaining > 0) {
+            gain += gain_step;
+            if (--voice->fade_remaining == 0) {
+                fading_count--;
+                return false; // Fade complete
+            }
+        }
+
+        uint64_t next = (uint64_t)voice->frac + voice->step;
+        voice->position += (size_t)(next >> 32);
+        voice->frac = (uint32_t)next;
+    }
+    return true;
+}
+
+// Mix one voice into the bus as a series of contiguous runs, each bounded by
+// the end of the sample (or loop point) so the inner kernel has no branches.
+// Streamed voices read their head from memory and the rest in place from the
+// stream's ring. Returns false once the voice has finished.
+static bool render_voice(mixer_voice_t *voice, float *bus_out, size_t frame_count) {
+    if (voice->step != MIXER_UNITY_STEP) {
+        return render_voice_interp(voice, bus_out, frame_count);
+    }
+
+    if (voice->stream != NULL && voice->position < voice->head_length) {
+        sound_stream_prime(voice->stream, voice->stream_epoch);
+    }
+
+    size_t done = 0;
+    while (done < frame_count) {
+        if (voice->position >= voice->length) {
+            if (!voice->is_looping) {
+                return false; // Sound finished
+            }
+            voice->position = 0; // Loop back
+        }
+
+        size_t run = voice->length - voice->position;
+        const int16_t *src;
+        bool streamed = voice->position >= voice->head_length;
+        if (streamed) {
+            size_t available = sound_stream_peek(voice->stream, voice->stream_epoch, &src);
+            if (available == 0) {
+                // Underrun: hold the position and play silence until the I/O
+                // thread catches up. A fading voice just ends.
+                return voice->fade_remaining == 0;
+            }
+            if (run > available) {
+                run = available;
+            }
+        } else if (voice->adpcm != NULL) {
+            // Runs stop at block boundaries; each block is decoded once
+            size_t index = voice->position / ADPCM_BLOCK_FRAMES;
+            size_t offset = voice->position % ADPCM_BLOCK_FRAMES;
+            src = decode_block(voice, index) + offset;
+            if (run > block_frames(voice, index) - offset) {
+                run = block_frames(voice, index) - offset;
+            }
+        } else {
+            src = voice->data + voice->position;
+            if (run > voice->head_length - voice->position) {
+                run = voice->head_length - voice->position;
+            }
+        }
+        if (run > frame_count - done) {
+            run = frame_count - done;
+        }
+
+        if (voice->fade_remaining > 0) {
+            if (run > voice->fade_remaining) {
+                run = voice->fade_remaining;
+            }
+            float step = voice->gain / MIXER_FADE_FRAMES;
+            float start = step * voice->fade_remaining;
+            mixer_accumulate_ramp(bus_out + done, src, run, start, -step);
+            voice->fade_remaining -= run;
+            if (voice->fade_remaining == 0) {
+                fading_count--;
+                return false; // Fade complete
+            }
+        } else if (voice->gain == 1.0f) {
+            mixer_accumulate(bus_out + done, src, run);
+        } else {
+            mixer_accumulate_gain(bus_out + done, src, run, voice->gain);
+        }
+
+        if (streamed) {
+            sound_stream_advance(voice->stream, run);
+        }
+        voice->position += run;
+        done += run;
+    }
+    return true;
+}
+
+// Applies every command due at the current frame and returns how many
+// frames (up to limit) can be rendered before the next one is due
+static size_t apply_due_commands(size_t limit) {
+    for (;;) {
+        if (!has_next_command) {
+            if (!spsc_ring_pop(&command_queue, &next_command)) {
+                return limit;
+            }
+            has_next_command = true;
+        }
+        if (next_command.frame > frame_clock) {
+            uint64_t wait = next_command.frame - frame_clock;
+            return wait < limit ? (size_t)wait : limit;
+        }
+        apply_command(&next_command); // Late commands apply right away
+        has_next_command = false;
+    }
+}
+
+void mixer_render(int16_t *output, size_t frame_count) {
+    render_start_ns = clock_now_ns();
+    uint32_t sequence = atomic_load_explicit(&anchor_sequence, memory_order_relaxed);
+    atomic_store_explicit(&anchor_sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&anchor_frame, frame_clock, memory_order_relaxed);
+    atomic_store_explicit(&anchor_ns, render_start_ns, memory_order_relaxed);
+    atomic_store_explicit(&anchor_frames_per_call, frame_count, memory_order_relaxed);
+    atomic_store_explicit(&anchor_sequence, sequence + 2, memory_order_release);
+
+    size_t done = 0;
+    while (done < frame_count) {
+        size_t block = frame_count - done;
+        if (block > MIXER_BLOCK_FRAMES) {
+            block = MIXER_BLOCK_FRAMES;
+        }
+        // Split the block where the next command is due so voices start and
+        // stop on the exact frame
+        block = apply_due_commands(block);
+
+        memset(bus, 0, block * sizeof(float));
+        for (size_t i = 0; i < voice_count; ) {
+            if (render_voice(&voices[i], bus, block)) {
+                i++;
+            } else {
+                remove_voice(i); // Swapped-in voice is rendered next
+            }
+        }
+        mixer_saturate(output + done, bus, block);
+        done += block;
+        frame_clock += block;
+    }
+    atomic_store_explicit(&published_voice_count, (uint32_t)voice_count, memory_order_relaxed);
+
+    // The first samples of voices started in this call leave with it
+    uint64_t end_ns = clock_now_ns();
+    uint64_t elapsed_ns = end_ns - render_start_ns;
+    latency_stats_record(LATENCY_RENDER_DURATION, elapsed_ns);
+    atomic_store_explicit(&published_render_ns,
+                          atomic_load_explicit(&published_render_ns, memory_order_relaxed) + elapsed_ns,
+                          memory_order_relaxed);
+    atomic_store_explicit(&published_render_frames,
+                          atomic_load_explicit(&published_render_frames, memory_order_relaxed) + frame_count,
+                          memory_order_relaxed);
+    if (elapsed_ns * output_rate > (uint64_t)frame_count * 1000000000ull) {
+        latency_stats_count_late_render();
+    }
+    for (size_t i = 0; i < started_count; i++) {
+        uint64_t trigger_ns = started_triggers[i];
+        latency_stats_record(LATENCY_TRIGGER_TO_SOUND, end_ns > trigger_ns ? end_ns - trigger_ns : 0);
+    }
+    started_count = 0;
+}
+
+size_t mixer_active_voices(void) {
+    return atomic_load_explicit(&published_voice_count, memory_order_relaxed);
+}
+
+void mixer_render_time(uint64_t *render_ns, uint64_t *audio_ns) {
+    *render_ns = atomic_load_explicit(&published_render_ns, memory_order_relaxed);
+    uint64_t frames = atomic_load_explicit(&published_render_frames, memory_order_relaxed);
+    *audio_ns = frames / output_rate * 1000000000ull + frames % output_rate * 1000000000ull / output_rate;
+}
+
+// ---------------------------------------------------------------------------
+// Control thread
+// ---------------------------------------------------------------------------
+
+static void mixer_cleanup_tables(void) {
+    free(voices);
+    free(handle_voice);
+    free(handle_generation);
+    free(free_handles);
+    free(handle_live);
+    voices = NULL;
+    handle_voice = NULL;
+    handle_generation = NULL;
+    free_handles = NULL;
+    handle_live = NULL;
+    voice_capacity = 0;
+    handle_capacity = 0;
+    free_handle_count = 0;
+    voice_count = 0;
+}
+
+int mixer_init(uint32_t sample_rate, size_t voice_limit, voice_steal_policy_t policy) {
+    if (initialized) {
+        return 0;
+    }
+
+    if (voice_limit == 0) {
+        voice_limit = MIXER_DEFAULT_VOICES;
+    }
+    if (voice_limit > MIXER_MAX_VOICES) {
+        voice_limit = MIXER_MAX_VOICES;
+    }
+
+    // Everything is allocated up front; the render thread never allocates.
+    // Every voice can hold a handle, plus one per start still in the queue.
+    max_voices = voice_limit;
+    voice_capacity = voice_limit + voice_limit / 4 + 4;
+    handle_capacity = voice_capacity + COMMAND_QUEUE_SIZE;
+    voices = calloc(voice_capacity, sizeof(mixer_voice_t));
+    handle_voice = malloc(handle_capacity * sizeof(int32_t));
+    handle_generation = calloc(handle_capacity, sizeof(uint16_t));
+    free_handles = malloc(handle_capacity * sizeof(uint16_t));
+    handle_live = calloc(handle_capacity, sizeof(bool));
+    if (voices == NULL || handle_voice == NULL || handle_generation == NULL || free_handles == NULL ||
+        handle_live == NULL) {
+        fprintf(stderr, "[MIXER] Failed to allocate %zu voices\n", voice_capacity);
+        mixer_cleanup_tables();
+        return -1;
+    }
+
+    // Must exist before the first render callback can run
+    if (spsc_ring_init(&command_queue, sizeof(mixer_command_t), COMMAND_QUEUE_SIZE) != 0 ||
+        spsc_ring_init(&release_queue, sizeof(uint16_t), handle_capacity) != 0) {
+        fprintf(stderr, "[MIXER] Failed to allocate command queues\n");
+        spsc_ring_free(&command_queue);
+        mixer_cleanup_tables();
+        return -1;
+    }
+
+    for (size_t i = 0; i < handle_capacity; i++) {
+        handle_voice[i] = -1;
+        free_handles[i] = (uint16_t)(handle_capacity - 1 - i);
+    }
+    free_handle_count = handle_capacity;
+    voice_count = 0;
+    fading_count = 0;
+    steal_policy = policy;
+    frame_clock = 0;
+    output_rate = sample_rate;
+    has_next_command = false;
+    schedule_frame = 0;
+    last_command_frame = 0;
+    schedule_trigger_ns = 0;
+    started_count = 0;
+    atomic_store(&anchor_frame, 0);
+    atomic_store(&anchor_ns, 0);
+    atomic_store(&anchor_frames_per_call, 0);
+    atomic_store(&published_voice_count, 0);
+    atomic_store(&published_render_ns, 0);
+    atomic_store(&published_render_frames, 0);
+
+    printf("[MIXER] %zu voice(s), steal policy: %s\n", max_voices,
+           policy == VOICE_STEAL_QUIETEST ? "quietest" : "oldest");
+    initialized = true;
+    return 0;
+}
+
+void mixer_cleanup(void) {
+    if (!initialized) {
+        return;
+    }
+
+    // Caller must have stopped the render thread
+    mixer_cleanup_tables();
+    spsc_ring_free(&command_queue);
+    spsc_ring_free(&release_queue);
+    initialized = false;
+}
+
+static int send_command(mixer_command_t *cmd) {
+    if (!initialized || cmd->handle == VOICE_HANDLE_INVALID) {
+        return -1;
+    }
+
+    // The render thread applies commands in queue order, so a command can't
+    // be due before the one sent ahead of it
+    cmd->frame = schedule_frame > last_command_frame ? schedule_frame : last_command_frame;
+    if (cmd->type == MIXER_CMD_START && schedule_trigger_ns != 0) {
+        cmd->trigger_ns = schedule_trigger_ns;
+        cmd->sent_ns = clock_now_ns();
+    }
+    if (!spsc_ring_push(&command_queue, cmd)) {
+        LOG_WARN("[MIXER] Command queue full, dropping command\n");
+        return -1;
+    }
+    last_command_frame = cmd->frame;
+    return 0;
+}
+
+uint64_t mixer_frame_for_time(uint64_t timestamp_ns) {
+    uint32_t sequence;
+    uint64_t frame, ns, frames_per_call;
+    do {
+        sequence = atomic_load_explicit(&anchor_sequence, memory_order_acquire);
+        frame = atomic_load_explicit(&anchor_frame, memory_order_relaxed);
+        ns = atomic_load_explicit(&anchor_ns, memory_order_relaxed);
+        frames_per_call = atomic_load_explicit(&anchor_frames_per_call, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((sequence & 1) != 0 ||
+             sequence != atomic_load_explicit(&anchor_sequence, memory_order_relaxed));
+
+    if (frames_per_call == 0) {
+        return 0; // Nothing rendered yet
+    }
+
+    // An event received during one render call's period is heard one call
+    // later, at the same offset. Events from before the anchor land in the
+    // past and play as soon as possible.
+    int64_t elapsed_ns = (int64_t)(timestamp_ns - ns);
+    int64_t max_ahead_ns = (int64_t)SCHEDULE_MAX_AHEAD_MS * 1000000;
+    if (elapsed_ns > max_ahead_ns) {
+        elapsed_ns = max_ahead_ns;
+    }
+    int64_t offset = elapsed_ns * (int64_t)output_rate / 1000000000 + (int64_t)frames_per_call;
+    if (offset <= 0) {
+        return 0;
+    }
+    return frame + (uint64_t)offset;
+}
+
+void mixer_schedule_frame(uint64_t frame) {
+    schedule_frame = frame;
+    schedule_trigger_ns = 0; // Not on the monotonic clock, so not timed
+}
+
+void mixer_schedule(uint64_t timestamp_ns) {
+    schedule_frame = timestamp_ns != 0 ? mixer_frame_for_time(timestamp_ns) : 0;
+    schedule_trigger_ns = timestamp_ns;
+}
+
+static void free_handle(uint16_t slot) {
+    handle_live[slot] = false;
+    free_handles[free_handle_count++] = slot;
+}
+
+// Reclaims slots of voices the render thread has finished with
+static void reclaim_handles(void) {
+    uint16_t slot;
+    while (spsc_ring_pop(&release_queue, &slot)) {
+        free_handle(slot);
+    }
+}
+
+static voice_handle_t allocate_handle(void) {
+    reclaim_handles();
+    if (free_handle_count == 0) {
+        return VOICE_HANDLE_INVALID;
+    }
+
+    uint16_t slot = free_handles[--free_handle_count];
+    handle_live[slot] = true;
+    handle_generation[slot]++;
+    return ((voice_handle_t)handle_generation[slot] << 16) | (voice_handle_t)(slot + 1);
+}
+
+// Starts a voice on samples or, if adpcm is set, on ADPCM blocks
+static voice_handle_t start_memory_voice(const int16_t *samples, const uint8_t *adpcm, size_t sample_count,
+                                         uint32_t sample_rate, float gain, bool loop, bool hold) {
+    if (!initialized || (samples == NULL && adpcm == NULL) || sample_count == 0) {
+        return VOICE_HANDLE_INVALID;
+    }
+
+    uint64_t step = MIXER_UNITY_STEP;
+    if (sample_rate != 0 && sample_rate != output_rate) {
+        step = ((uint64_t)sample_rate << 32) / output_rate;
+    }
+
+    mixer_command_t cmd = {
+        .type = MIXER_CMD_START,
+        .handle = allocate_handle(),
+        .data = samples,
+        .adpcm = adpcm,
+        .length = sample_count,
+        .head_length = sample_count,
+        .step = step,
+        .gain = gain,
+        .loop = loop,
+        .hold = hold,
+    };
+    if (cmd.handle == VOICE_HANDLE_INVALID) {
+        LOG_WARN("[MIXER] Out of voice handles\n");
+        return VOICE_HANDLE_INVALID;
+    }
+
+    if (send_command(&cmd) != 0) {
+        free_handle((uint16_t)handle_slot(cmd.handle));
+        return VOICE_HANDLE_INVALID;
+    }
+    return cmd.handle;
+}
+
+voice_handle_t mixer_start_voice(const int16_t *samples, size_t sample_count, uint32_t sample_rate,
+                                 float gain, bool loop, bool hold) {
+    if (samples == NULL) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return start_memory_voice(samples, NULL, sample_count, sample_rate, gain, loop, hold);
+}
+
+voice_handle_t mixer_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t sample_rate,
+                                 float gain, bool loop, bool hold) {
+    if (blocks == NULL) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return start_memory_voice(NULL, blocks, sample_count, sample_rate, gain, loop, hold);
+}
+
+voice_handle_t mixer_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold) {
+    if (!initialized || stream == NULL) {
+        return VOICE_HANDLE_INVALID;
+    }
+    if (sound_stream_sample_rate(stream) != output_rate) {
+        LOG_WARN("[MIXER] Streamed sounds must be at %u Hz\n", output_rate);
+        return VOICE_HANDLE_INVALID;
+    }
+
+    mixer_command_t cmd = {
+        .type = MIXER_CMD_START,
+        .handle = allocate_handle(),
+        .data = sound_stream_head(stream),
+        .length = sound_stream_length(stream),
+        .head_length = sound_stream_head_length(stream),
+        .stream = stream,
+        .step = MIXER_UNITY_STEP,
+        .gain = gain,
+        .loop = loop,
+        .hold = hold,
+    };
+    if (cmd.handle == VOICE_HANDLE_INVALID) {
+        LOG_WARN("[MIXER] Out of voice handles\n");
+        return VOICE_HANDLE_INVALID;
+    }
+
+    // Read-ahead for the new epoch starts now; the head covers the latency
+    cmd.stream_epoch = sound_stream_begin(stream, loop);
+    if (send_command(&cmd) != 0) {
+        sound_stream_end(stream);
+        free_handle((uint16_t)handle_slot(cmd.handle));
+        return VOICE_HANDLE_INVALID;
+    }
+    return cmd.handle;
+}
+
+bool mixer_voice_active(voice_handle_t voice) {
+    if (!initialized || voice == VOICE_HANDLE_INVALID) {
+        return false;
+    }
+    reclaim_handles();
+    size_t slot = handle_slot(voice);
+    return slot < handle_capacity && handle_live[slot] &&
+           handle_generation[slot] == (uint16_t)(voice >> 16);
+}
+
+int mixer_stop_voice(voice_handle_t voice) {
+    mixer_command_t cmd = { .type = MIXER_CMD_STOP, .handle = voice };
+    return send_command(&cmd);
+}
+
+int mixer_retrigger_voice(voice_handle_t voice) {
+    mixer_command_t cmd = { .type = MIXER_CMD_RETRIGGER, .handle = voice };
+    return send_command(&cmd);
+}
+
+int mixer_set_voice_gain(voice_handle_t voice, float gain) {
+    mixer_command_t cmd = { .type = MIXER_CMD_GAIN, .handle = voice, .gain = gain };
+    return send_command(&cmd);
+}
+
+int mixer_extend_voice(voice_handle_t voice, const int16_t *samples, size_t sample_count) {
+    mixer_command_t cmd = {
+        .type = MIXER_CMD_EXTEND,
+        .handle = voice,
+        .data = samples,
+        .length = sample_count,
+    };
+    return send_command(&cmd);
+}
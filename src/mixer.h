@@ -0,0 +1,99 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "config.h"  // For voice_steal_policy_t
+#include "sound_stream.h"
+#include "adpcm.h"
+
+// Portable multi-voice mixing core shared by the platform audio backends.
+// Control functions are called from a single control thread (MIDI/main) and
+// are forwarded to the render thread through a lock-free command ring.
+// mixer_render() is called from the platform's audio callback only.
+
+#define MIXER_DEFAULT_VOICES 64
+#define MIXER_MAX_VOICES 1024
+#define MIXER_BLOCK_FRAMES 1024     // Internal bus size; renders are chunked to this
+#define MIXER_FADE_FRAMES 256       // ~6ms fade applied to stolen and stopped voices
+#define MIXER_UNITY_STEP ((uint64_t)1 << 32)  // 32.32 playback step for native-rate voices
+
+// Identifies one playing instance of a sound. Handles are never reused
+// while their voice is alive, and stale handles are safely ignored.
+typedef uint32_t voice_handle_t;
+#define VOICE_HANDLE_INVALID 0
+
+// Voice being mixed (owned by the render thread)
+typedef struct {
+    voice_handle_t handle;      // Handle the control thread knows this voice by
+    const int16_t *data;        // Audio data (the head only for streamed voices)
+    size_t length;              // Total length in samples
+    size_t head_length;         // Samples in data; the rest comes from stream
+    sound_stream_t *stream;     // Disk stream feeding frames past the head, or NULL
+    uint32_t stream_epoch;      // Stream epoch this voice was started with
+    size_t position;            // Current playback position
+    uint32_t frac;              // Fractional position (realtime rate conversion)
+    uint64_t step;              // 32.32 source frames per output frame
+    bool is_looping;            // Should this voice loop
+    bool is_hold;               // Hold mode - stops when note off
+    float gain;                 // Linear gain applied while mixing
+    size_t fade_remaining;      // Frames left in fade-out (0 = not fading)
+    uint64_t start_frame;       // Mixer clock when the voice started
+    const uint8_t *adpcm;       // IMA-ADPCM blocks played instead of data, or NULL
+    size_t block_index;         // ADPCM block decoded into block (SIZE_MAX = none)
+    int16_t block[ADPCM_BLOCK_FRAMES];
+} mixer_voice_t;
+
+// voice_limit of 0 selects MIXER_DEFAULT_VOICES
+int mixer_init(uint32_t sample_rate, size_t voice_limit, voice_steal_policy_t policy);
+void mixer_cleanup(void);
+
+// Control thread. All are O(1); start returns VOICE_HANDLE_INVALID on failure.
+// A sample_rate other than the output rate (0 = output rate) is converted in
+// realtime by linear interpolation. gain is the voice's initial linear gain;
+// samples are never modified, so several voices can share one buffer.
+voice_handle_t mixer_start_voice(const int16_t *samples, size_t sample_count, uint32_t sample_rate,
+                                 float gain, bool loop, bool hold);
+// Plays sample_count frames stored as IMA-ADPCM blocks (adpcm.h), decoded
+// block by block while mixing; otherwise as mixer_start_voice()
+voice_handle_t mixer_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t sample_rate,
+                                 float gain, bool loop, bool hold);
+// Streamed sounds must be at the output rate; one voice per stream
+voice_handle_t mixer_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold);
+// True from start until the voice has finished (including any fade-out)
+bool mixer_voice_active(voice_handle_t voice);
+// Any thread: voices mixed by the last render call, including fading ones
+size_t mixer_active_voices(void);
+// Any thread: wall time spent rendering and the duration of the audio
+// rendered, both since mixer_init(). Their ratio over an interval is the
+// render thread's load.
+void mixer_render_time(uint64_t *render_ns, uint64_t *audio_ns);
+int mixer_stop_voice(voice_handle_t voice);
+int mixer_retrigger_voice(voice_handle_t voice);
+int mixer_set_voice_gain(voice_handle_t voice, float gain);
+// Swaps a playing voice over to a longer buffer that begins with the one it
+// was started with (e.g. the whole sound once its attack is playing)
+int mixer_extend_voice(voice_handle_t voice, const int16_t *samples, size_t sample_count);
+
+// Control thread: commands sent after this take effect at the start of the
+// given mixer frame instead of the next render call (0 = as soon as
+// possible). They never take effect before commands sent earlier, and
+// frames already rendered play as soon as possible.
+void mixer_schedule_frame(uint64_t frame);
+// Control thread: schedules by monotonic time (clock_now_ns(); 0 = as soon
+// as possible). Timestamps are heard one render call after the call they
+// fall into, trading one buffer of latency for sample-accurate timing.
+void mixer_schedule(uint64_t timestamp_ns);
+uint64_t mixer_frame_for_time(uint64_t timestamp_ns);
+
+// Render thread: mixes all voices into output, saturating once per sample
+void mixer_render(int16_t *output, size_t frame_count);
+
+// Vectorized kernels. The bus holds floats on the int16 scale (+-32768).
+void mixer_accumulate(float *bus, const int16_t *src, size_t count);
+void mixer_accumulate_gain(float *bus, const int16_t *src, size_t count, float gain);
+void mixer_accumulate_ramp(float *bus, const int16_t *src, size_t count, float gain, float step);
+void mixer_saturate(int16_t *output, const float *bus, size_t count);
+
+#endif // MIXER_H
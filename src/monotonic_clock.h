@@ -0,0 +1,15 @@
+#ifndef MONOTONIC_CLOCK_H
+#define MONOTONIC_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Monotonic time in nanoseconds (CLOCK_MONOTONIC is available on Mac OS,
+// Linux and ESP-IDF)
+static inline uint64_t clock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif // MONOTONIC_CLOCK_H
@@ -0,0 +1,1184 @@
+#ifndef __APPLE__
+
+#include "mp3_decoder.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Straightforward floating point implementation of ISO/IEC 11172-3 Layer
+// III: Huffman and scalefactor decoding, requantisation, joint stereo,
+// reordering, alias reduction, IMDCT with overlap-add and the polyphase
+// synthesis filterbank, each written out from the standard's formulas.
+// Decoding happens at load time or on a stream refill worker, never on the
+// render thread, so clarity wins over the fast transforms real-time
+// decoders use.
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define GRANULE_LINES 576
+#define SUBBANDS 32
+#define SUBBAND_LINES 18
+#define SYNTH_HISTORY 1024
+#define MAX_RESERVOIR 511           // Largest main_data_begin back-pointer
+#define MAX_FRAME_BYTES 1441        // 320 kbps at 32 kHz, padded
+#define MAIN_DATA_PADDING 64        // Zeroed slack for reads past a corrupt granule
+
+static const uint16_t header_bitrates[2][15] = {
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},  // MPEG-1 Layer III
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}       // MPEG-2/2.5 Layer III
+};
+static const uint32_t header_sample_rates[3] = {44100, 48000, 32000};
+
+// Scalefactor band boundaries for 44.1, 48 and 32 kHz
+static const uint16_t sfb_long[3][23] = {
+    {0, 4, 8, 12, 16, 20, 24, 30, 36, 44, 52, 62, 74, 90, 110, 134, 162, 196, 238, 288, 342, 418, 576},
+    {0, 4, 8, 12, 16, 20, 24, 30, 36, 42, 50, 60, 72, 88, 106, 128, 156, 190, 230, 276, 330, 384, 576},
+    {0, 4, 8, 12, 16, 20, 24, 30, 36, 44, 54, 66, 82, 102, 126, 156, 194, 240, 296, 364, 448, 550, 576}
+};
+static const uint16_t sfb_short[3][14] = {
+    {0, 4, 8, 12, 16, 22, 30, 40, 52, 66, 84, 106, 136, 192},
+    {0, 4, 8, 12, 16, 22, 28, 38, 50, 64, 80, 100, 126, 192},
+    {0, 4, 8, 12, 16, 22, 30, 42, 58, 78, 104, 138, 180, 192}
+};
+
+static const uint8_t pretab[22] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 3, 2, 0};
+
+// slen1 and slen2 for each scalefac_compress value
+static const uint8_t slen_table[2][16] = {
+    {0, 0, 0, 0, 3, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4},
+    {0, 1, 2, 3, 0, 1, 2, 3, 1, 2, 3, 1, 2, 3, 2, 3}
+};
+
+static const float alias_coefficients[8] = {
+    -0.6f, -0.535f, -0.33f, -0.185f, -0.095f, -0.041f, -0.0142f, -0.0037f
+};
+
+// Huffman code words and lengths of ISO/IEC 11172-3 Table B.7, indexed by
+// x * size + y. Tables 16 and 24 are shared by the linbits variants.
+static const uint16_t huff1_codes[4] = {
+    1, 1,
+    1, 0
+};
+static const uint8_t huff1_lengths[4] = {
+    1, 3,
+    2, 3
+};
+
+static const uint16_t huff2_codes[9] = {
+    1, 2, 1,
+    3, 1, 1,
+    3, 2, 0
+};
+static const uint8_t huff2_lengths[9] = {
+    1, 3, 6,
+    3, 3, 5,
+    5, 5, 6
+};
+
+static const uint16_t huff3_codes[9] = {
+    3, 2, 1,
+    1, 1, 1,
+    3, 2, 0
+};
+static const uint8_t huff3_lengths[9] = {
+    2, 2, 6,
+    3, 2, 5,
+    5, 5, 6
+};
+
+static const uint16_t huff5_codes[16] = {
+    1, 2, 6, 5,
+    3, 1, 4, 4,
+    7, 5, 7, 1,
+    6, 1, 1, 0
+};
+static const uint8_t huff5_lengths[16] = {
+    1, 3, 6, 7,
+    3, 3, 6, 7,
+    6, 6, 7, 8,
+    7, 6, 7, 8
+};
+
+static const uint16_t huff6_codes[16] = {
+    7, 3, 5, 1,
+    6, 2, 3, 2,
+    5, 4, 4, 1,
+    3, 3, 2, 0
+};
+static const uint8_t huff6_lengths[16] = {
+    3, 3, 5, 7,
+    3, 2, 4, 5,
+    4, 4, 5, 6,
+    6, 5, 6, 7
+};
+
+static const uint16_t huff7_codes[36] = {
+    1, 2, 10, 19, 16, 10,
+    3, 3, 7, 10, 5, 3,
+    11, 4, 13, 17, 8, 4,
+    12, 11, 18, 15, 11, 2,
+    7, 6, 9, 14, 3, 1,
+    6, 4, 5, 3, 2, 0
+};
+static const uint8_t huff7_lengths[36] = {
+    1, 3, 6, 8, 8, 9,
+    3, 4, 6, 7, 7, 8,
+    6, 5, 7, 8, 8, 9,
+    7, 7, 8, 9, 9, 9,
+    7, 7, 8, 9, 9, 10,
+    8, 8, 9, 10, 10, 10
+};
+
+static const uint16_t huff8_codes[36] = {
+    3, 4, 6, 18, 12, 5,
+    5, 1, 2, 16, 9, 3,
+    7, 3, 5, 14, 7, 3,
+    19, 17, 15, 13, 10, 4,
+    13, 5, 8, 11, 5, 1,
+    12, 4, 4, 1, 1, 0
+};
+static const uint8_t huff8_lengths[36] = {
+    2, 3, 6, 8, 8, 9,
+    3, 2, 4, 8, 8, 8,
+    6, 4, 6, 8, 8, 9,
+    8, 8, 8, 9, 9, 10,
+    8, 7, 8, 9, 10, 10,
+    9, 8, 9, 9, 11, 11
+};
+
+static const uint16_t huff9_codes[36] = {
+    7, 5, 9, 14, 15, 7,
+    6, 4, 5, 5, 6, 7,
+    7, 6, 8, 8, 8, 5,
+    15, 6, 9, 10, 5, 1,
+    11, 7, 9, 6, 4, 1,
+    14, 4, 6, 2, 6, 0
+};
+static const uint8_t huff9_lengths[36] = {
+    3, 3, 5, 6, 8, 9,
+    3, 3, 4, 5, 6, 8,
+    4, 4, 5, 6, 7, 8,
+    6, 5, 6, 7, 7, 8,
+    7, 6, 7, 7, 8, 9,
+    8, 7, 8, 8, 9, 9
+};
+
+static const uint16_t huff10_codes[64] = {
+    1, 2, 10, 23, 35, 30, 12, 17,
+    3, 3, 8, 12, 18, 21, 12, 7,
+    11, 9, 15, 21, 32, 40, 19, 6,
+    14, 13, 22, 34, 46, 23, 18, 7,
+    20, 19, 33, 47, 27, 22, 9, 3,
+    31, 22, 41, 26, 21, 20, 5, 3,
+    14, 13, 10, 11, 16, 6, 5, 1,
+    9, 8, 7, 8, 4, 4, 2, 0
+};
+static const uint8_t huff10_lengths[64] = {
+    1, 3, 6, 8, 9, 9, 9, 10,
+    3, 4, 6, 7, 8, 9, 8, 8,
+    6, 6, 7, 8, 9, 10, 9, 9,
+    7, 7, 8, 9, 10, 10, 9, 10,
+    8, 8, 9, 10, 10, 10, 10, 10,
+    9, 9, 10, 10, 11, 11, 10, 11,
+    8, 8, 9, 10, 10, 10, 11, 11,
+    9, 8, 9, 10, 10, 11, 11, 11
+};
+
+static const uint16_t huff11_codes[64] = {
+    3, 4, 10, 24, 34, 33, 21, 15,
+    5, 3, 4, 10, 32, 17, 11, 10,
+    11, 7, 13, 18, 30, 31, 20, 5,
+    25, 11, 19, 59, 27, 18, 12, 5,
+    35, 33, 31, 58, 30, 16, 7, 5,
+    28, 26, 32, 19, 17, 15, 8, 14,
+    14, 12, 9, 13, 14, 9, 4, 1,
+    11, 4, 6, 6, 6, 3, 2, 0
+};
+static const uint8_t huff11_lengths[64] = {
+    2, 3, 5, 7, 8, 9, 8, 9,
+    3, 3, 4, 6, 8, 8, 7, 8,
+    5, 5, 6, 7, 8, 9, 8, 8,
+    7, 6, 7, 9, 8, 10, 8, 9,
+    8, 8, 8, 9, 9, 10, 9, 10,
+    8, 8, 9, 10, 10, 11, 10, 11,
+    8, 7, 7, 8, 9, 10, 10, 10,
+    8, 7, 8, 9, 10, 10, 10, 10
+};
+
+static const uint16_t huff12_codes[64] = {
+    9, 6, 16, 33, 41, 39, 38, 26,
+    7, 5, 6, 9, 23, 16, 26, 11,
+    17, 7, 11, 14, 21, 30, 10, 7,
+    17, 10, 15, 12, 18, 28, 14, 5,
+    32, 13, 22, 19, 18, 16, 9, 5,
+    40, 17, 31, 29, 17, 13, 4, 2,
+    27, 12, 11, 15, 10, 7, 4, 1,
+    27, 12, 8, 12, 6, 3, 1, 0
+};
+static const uint8_t huff12_lengths[64] = {
+    4, 3, 5, 7, 8, 9, 9, 9,
+    3, 3, 4, 5, 7, 7, 8, 8,
+    5, 4, 5, 6, 7, 8, 7, 8,
+    6, 5, 6, 6, 7, 8, 8, 8,
+    7, 6, 7, 7, 8, 8, 8, 9,
+    8, 7, 8, 8, 8, 9, 8, 9,
+    8, 7, 7, 8, 8, 9, 9, 10,
+    9, 8, 8, 9, 9, 9, 9, 10
+};
+
+static const uint16_t huff13_codes[256] = {
+    1, 5, 14, 21, 34, 51, 46, 71, 42, 52, 68, 52, 67, 44, 43, 19,
+    3, 4, 12, 19, 31, 26, 44, 33, 31, 24, 32, 24, 31, 35, 22, 14,
+    15, 13, 23, 36, 59, 49, 77, 65, 29, 40, 30, 40, 27, 33, 42, 16,
+    22, 20, 37, 61, 56, 79, 73, 64, 43, 76, 56, 37, 26, 31, 25, 14,
+    35, 16, 60, 57, 97, 75, 114, 91, 54, 73, 55, 41, 48, 53, 23, 24,
+    58, 27, 50, 96, 76, 70, 93, 84, 77, 58, 79, 29, 74, 49, 41, 17,
+    47, 45, 78, 74, 115, 94, 90, 79, 69, 83, 71, 50, 59, 38, 36, 15,
+    72, 34, 56, 95, 92, 85, 91, 90, 86, 73, 77, 65, 51, 44, 43, 42,
+    43, 20, 30, 44, 55, 78, 72, 87, 78, 61, 46, 54, 37, 30, 20, 16,
+    53, 25, 41, 37, 44, 59, 54, 81, 66, 76, 57, 54, 37, 18, 39, 11,
+    35, 33, 31, 57, 42, 82, 72, 80, 47, 58, 55, 21, 22, 26, 38, 22,
+    53, 25, 23, 38, 70, 60, 51, 36, 55, 26, 34, 23, 27, 14, 9, 7,
+    34, 32, 28, 39, 49, 75, 30, 52, 48, 40, 52, 28, 18, 17, 9, 5,
+    45, 21, 34, 64, 56, 50, 49, 45, 31, 19, 12, 15, 10, 7, 6, 3,
+    48, 23, 20, 39, 36, 35, 53, 21, 16, 23, 13, 10, 6, 1, 4, 2,
+    16, 15, 17, 27, 25, 20, 29, 11, 17, 12, 16, 8, 1, 1, 0, 1
+};
+static const uint8_t huff13_lengths[256] = {
+    1, 4, 6, 7, 8, 9, 9, 10, 9, 10, 11, 11, 12, 12, 13, 13,
+    3, 4, 6, 7, 8, 8, 9, 9, 9, 9, 10, 10, 11, 12, 12, 12,
+    6, 6, 7, 8, 9, 9, 10, 10, 9, 10, 10, 11, 11, 12, 13, 13,
+    7, 7, 8, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 13, 13,
+    8, 7, 9, 9, 10, 10, 11, 11, 10, 11, 11, 12, 12, 13, 13, 14,
+    9, 8, 9, 10, 10, 10, 11, 11, 11, 11, 12, 11, 13, 13, 14, 14,
+    9, 9, 10, 10, 11, 11, 11, 11, 11, 12, 12, 12, 13, 13, 14, 14,
+    10, 9, 10, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 14, 16, 16,
+    9, 8, 9, 10, 10, 11, 11, 12, 12, 12, 12, 13, 13, 14, 15, 15,
+    10, 9, 10, 10, 11, 11, 11, 13, 12, 13, 13, 14, 14, 14, 16, 15,
+    10, 10, 10, 11, 11, 12, 12, 13, 12, 13, 14, 13, 14, 15, 16, 17,
+    11, 10, 10, 11, 12, 12, 12, 12, 13, 13, 13, 14, 15, 15, 15, 16,
+    11, 11, 11, 12, 12, 13, 12, 13, 14, 14, 15, 15, 15, 16, 16, 16,
+    12, 11, 12, 13, 13, 13, 14, 14, 14, 14, 14, 15, 16, 15, 16, 16,
+    13, 12, 12, 13, 13, 13, 15, 14, 14, 17, 15, 15, 15, 17, 16, 16,
+    12, 12, 13, 14, 14, 14, 15, 14, 15, 15, 16, 16, 19, 18, 19, 16
+};
+
+static const uint16_t huff15_codes[256] = {
+    7, 12, 18, 53, 47, 76, 124, 108, 89, 123, 108, 119, 107, 81, 122, 63,
+    13, 5, 16, 27, 46, 36, 61, 51, 42, 70, 52, 83, 65, 41, 59, 36,
+    19, 17, 15, 24, 41, 34, 59, 48, 40, 64, 50, 78, 62, 80, 56, 33,
+    29, 28, 25, 43, 39, 63, 55, 93, 76, 59, 93, 72, 54, 75, 50, 29,
+    52, 22, 42, 40, 67, 57, 95, 79, 72, 57, 89, 69, 49, 66, 46, 27,
+    77, 37, 35, 66, 58, 52, 91, 74, 62, 48, 79, 63, 90, 62, 40, 38,
+    125, 32, 60, 56, 50, 92, 78, 65, 55, 87, 71, 51, 73, 51, 70, 30,
+    109, 53, 49, 94, 88, 75, 66, 122, 91, 73, 56, 42, 64, 44, 21, 25,
+    90, 43, 41, 77, 73, 63, 56, 92, 77, 66, 47, 67, 48, 53, 36, 20,
+    71, 34, 67, 60, 58, 49, 88, 76, 67, 106, 71, 54, 38, 39, 23, 15,
+    109, 53, 51, 47, 90, 82, 58, 57, 48, 72, 57, 41, 23, 27, 62, 9,
+    86, 42, 40, 37, 70, 64, 52, 43, 70, 55, 42, 25, 29, 18, 11, 11,
+    118, 68, 30, 55, 50, 46, 74, 65, 49, 39, 24, 16, 22, 13, 14, 7,
+    91, 44, 39, 38, 34, 63, 52, 45, 31, 52, 28, 19, 14, 8, 9, 3,
+    123, 60, 58, 53, 47, 43, 32, 22, 37, 24, 17, 12, 15, 10, 2, 1,
+    71, 37, 34, 30, 28, 20, 17, 26, 21, 16, 10, 6, 8, 6, 2, 0
+};
+static const uint8_t huff15_lengths[256] = {
+    3, 4, 5, 7, 7, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12, 13,
+    4, 3, 5, 6, 7, 7, 8, 8, 8, 9, 9, 10, 10, 10, 11, 11,
+    5, 5, 5, 6, 7, 7, 8, 8, 8, 9, 9, 10, 10, 11, 11, 11,
+    6, 6, 6, 7, 7, 8, 8, 9, 9, 9, 10, 10, 10, 11, 11, 11,
+    7, 6, 7, 7, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 11,
+    8, 7, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+    9, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 12, 12,
+    9, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 12,
+    9, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 12, 12, 12,
+    9, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12,
+    10, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 11, 12, 13, 12,
+    10, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 13,
+    11, 10, 9, 10, 10, 10, 11, 11, 11, 11, 11, 11, 12, 12, 13, 13,
+    11, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13,
+    12, 11, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 12, 13,
+    12, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13, 13, 13
+};
+
+static const uint16_t huff16_codes[256] = {
+    1, 5, 14, 44, 74, 63, 110, 93, 172, 149, 138, 242, 225, 195, 376, 17,
+    3, 4, 12, 20, 35, 62, 53, 47, 83, 75, 68, 119, 201, 107, 207, 9,
+    15, 13, 23, 38, 67, 58, 103, 90, 161, 72, 127, 117, 110, 209, 206, 16,
+    45, 21, 39, 69, 64, 114, 99, 87, 158, 140, 252, 212, 199, 387, 365, 26,
+    75, 36, 68, 65, 115, 101, 179, 164, 155, 264, 246, 226, 395, 382, 362, 9,
+    66, 30, 59, 56, 102, 185, 173, 265, 142, 253, 232, 400, 388, 378, 445, 16,
+    111, 54, 52, 100, 184, 178, 160, 133, 257, 244, 228, 217, 385, 366, 715, 10,
+    98, 48, 91, 88, 165, 157, 148, 261, 248, 407, 397, 372, 380, 889, 884, 8,
+    85, 84, 81, 159, 156, 143, 260, 249, 427, 401, 392, 383, 727, 713, 708, 7,
+    154, 76, 73, 141, 131, 256, 245, 426, 406, 394, 384, 735, 359, 710, 352, 11,
+    139, 129, 67, 125, 247, 233, 229, 219, 393, 743, 737, 720, 885, 882, 439, 4,
+    243, 120, 118, 115, 227, 223, 396, 746, 742, 736, 721, 712, 706, 223, 436, 6,
+    202, 224, 222, 218, 216, 389, 386, 381, 364, 888, 443, 707, 440, 437, 1728, 4,
+    747, 211, 210, 208, 370, 379, 734, 723, 714, 1735, 883, 877, 876, 3459, 865, 2,
+    377, 369, 102, 187, 726, 722, 358, 711, 709, 866, 1734, 871, 3458, 870, 434, 0,
+    12, 10, 7, 11, 10, 17, 11, 9, 13, 12, 10, 7, 5, 3, 1, 3
+};
+static const uint8_t huff16_lengths[256] = {
+    1, 4, 6, 8, 9, 9, 10, 10, 11, 11, 11, 12, 12, 12, 13, 9,
+    3, 4, 6, 7, 8, 9, 9, 9, 10, 10, 10, 11, 12, 11, 12, 8,
+    6, 6, 7, 8, 9, 9, 10, 10, 11, 10, 11, 11, 11, 12, 12, 9,
+    8, 7, 8, 9, 9, 10, 10, 10, 11, 11, 12, 12, 12, 13, 13, 10,
+    9, 8, 9, 9, 10, 10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 9,
+    9, 8, 9, 9, 10, 11, 11, 12, 11, 12, 12, 13, 13, 13, 14, 10,
+    10, 9, 9, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 14, 10,
+    10, 9, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 13, 15, 15, 10,
+    10, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 13, 14, 14, 14, 10,
+    11, 10, 10, 11, 11, 12, 12, 13, 13, 13, 13, 14, 13, 14, 13, 11,
+    11, 11, 10, 11, 12, 12, 12, 12, 13, 14, 14, 14, 15, 15, 14, 10,
+    12, 11, 11, 11, 12, 12, 13, 14, 14, 14, 14, 14, 14, 13, 14, 11,
+    12, 12, 12, 12, 12, 13, 13, 13, 13, 15, 14, 14, 14, 14, 16, 11,
+    14, 12, 12, 12, 13, 13, 14, 14, 14, 16, 15, 15, 15, 17, 15, 11,
+    13, 13, 11, 12, 14, 14, 13, 14, 14, 15, 16, 15, 17, 15, 14, 11,
+    9, 8, 8, 9, 9, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 8
+};
+
+static const uint16_t huff24_codes[256] = {
+    15, 13, 46, 80, 146, 262, 248, 434, 426, 669, 653, 649, 621, 517, 1032, 88,
+    14, 12, 21, 38, 71, 130, 122, 216, 209, 198, 327, 345, 319, 297, 279, 42,
+    47, 22, 41, 74, 68, 128, 120, 221, 207, 194, 182, 340, 315, 295, 541, 18,
+    81, 39, 75, 70, 134, 125, 116, 220, 204, 190, 178, 325, 311, 293, 271, 16,
+    147, 72, 69, 135, 127, 118, 112, 210, 200, 188, 352, 323, 306, 285, 540, 14,
+    263, 66, 129, 126, 119, 114, 214, 202, 192, 180, 341, 317, 301, 281, 262, 12,
+    249, 123, 121, 117, 113, 215, 206, 195, 185, 347, 330, 308, 291, 272, 520, 10,
+    435, 115, 111, 109, 211, 203, 196, 187, 353, 332, 313, 298, 283, 531, 381, 17,
+    427, 212, 208, 205, 201, 193, 186, 177, 169, 320, 303, 286, 268, 514, 377, 16,
+    335, 199, 197, 191, 189, 181, 174, 333, 321, 305, 289, 275, 521, 379, 371, 11,
+    668, 184, 183, 179, 175, 344, 331, 314, 304, 290, 277, 530, 383, 373, 366, 10,
+    652, 346, 171, 168, 164, 318, 309, 299, 287, 276, 263, 513, 375, 368, 362, 6,
+    648, 322, 316, 312, 307, 302, 292, 284, 269, 261, 512, 376, 370, 364, 359, 4,
+    620, 300, 296, 294, 288, 282, 273, 266, 515, 380, 374, 369, 365, 361, 357, 2,
+    1033, 280, 278, 274, 267, 264, 259, 382, 378, 372, 367, 363, 360, 358, 356, 0,
+    43, 20, 19, 17, 15, 13, 11, 9, 7, 6, 4, 7, 5, 3, 1, 3
+};
+static const uint8_t huff24_lengths[256] = {
+    4, 4, 6, 7, 8, 9, 9, 10, 10, 11, 11, 11, 11, 11, 12, 9,
+    4, 4, 5, 6, 7, 8, 8, 9, 9, 9, 10, 10, 10, 10, 10, 8,
+    6, 5, 6, 7, 7, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 7,
+    7, 6, 7, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 7,
+    8, 7, 7, 8, 8, 8, 8, 9, 9, 9, 10, 10, 10, 10, 11, 7,
+    9, 7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 7,
+    9, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 7,
+    10, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 8,
+    10, 9, 9, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 8,
+    10, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 8,
+    11, 9, 9, 9, 9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 8,
+    11, 10, 9, 9, 9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 8,
+    11, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 8,
+    11, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 8,
+    12, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 8,
+    8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 4
+};
+
+// Count1 table A, indexed by v * 8 + w * 4 + x * 2 + y
+static const uint8_t quad_a_codes[16] = {
+    1, 5, 4, 5, 6, 5, 4, 4, 7, 3, 6, 0, 7, 2, 3, 1
+};
+static const uint8_t quad_a_lengths[16] = {
+    1, 4, 4, 5, 4, 6, 5, 6, 4, 5, 5, 6, 5, 6, 6, 6
+};
+
+// Synthesis window prototype from its first tap to the centre tap, in
+// units of 2^-16 (the standard's D[] table without the alternating signs)
+static const int32_t synth_window_half[257] = {
+    0, -1, -1, -1, -1, -1, -1, -2, -2, -2, -2, -3, -3, -4, -4, -5,
+    -5, -6, -7, -7, -8, -9, -10, -11, -13, -14, -16, -17, -19, -21, -24, -26,
+    -29, -31, -35, -38, -41, -45, -49, -53, -58, -63, -68, -73, -79, -85, -91, -97,
+    -104, -111, -117, -125, -132, -139, -147, -154, -161, -169, -176, -183, -190, -196, -202, -208,
+    -213, -218, -222, -225, -227, -228, -228, -227, -224, -221, -215, -208, -200, -189, -177, -163,
+    -146, -127, -106, -83, -57, -29, 2, 36, 72, 111, 153, 197, 244, 294, 347, 401,
+    459, 519, 581, 645, 711, 779, 848, 919, 991, 1064, 1137, 1210, 1283, 1356, 1428, 1498,
+    1567, 1634, 1698, 1759, 1817, 1870, 1919, 1962, 2001, 2032, 2057, 2075, 2085, 2087, 2080, 2063,
+    2037, 2000, 1952, 1893, 1822, 1739, 1644, 1535, 1414, 1280, 1131, 970, 794, 605, 402, 185,
+    -45, -288, -545, -814, -1095, -1388, -1692, -2006, -2330, -2663, -3004, -3351, -3705, -4063, -4425, -4788,
+    -5153, -5517, -5879, -6237, -6589, -6935, -7271, -7597, -7910, -8209, -8491, -8755, -8998, -9219, -9416, -9585,
+    -9727, -9838, -9916, -9959, -9966, -9935, -9863, -9750, -9592, -9389, -9139, -8840, -8492, -8092, -7640, -7134,
+    -6574, -5959, -5288, -4561, -3776, -2935, -2037, -1082, -70, 998, 2122, 3300, 4533, 5818, 7154, 8540,
+    9975, 11455, 12980, 14548, 16155, 17799, 19478, 21189, 22929, 24694, 26482, 28289, 30112, 31947, 33791, 35640,
+    37489, 39336, 41176, 43006, 44821, 46617, 48390, 50137, 51853, 53534, 55178, 56778, 58333, 59838, 61289, 62684,
+    64019, 65290, 66494, 67629, 68692, 69679, 70590, 71420, 72169, 72835, 73415, 73908, 74313, 74630, 74856, 74992,
+    75038
+};
+
+typedef struct {
+    const uint16_t *codes;
+    const uint8_t *lengths;
+    uint8_t size;                   // Values per axis; 0 for the all-zero table
+    uint8_t linbits;
+} huff_table_t;
+
+static const huff_table_t huff_tables[32] = {
+    {NULL, NULL, 0, 0},
+    {huff1_codes, huff1_lengths, 2, 0},
+    {huff2_codes, huff2_lengths, 3, 0},
+    {huff3_codes, huff3_lengths, 3, 0},
+    {NULL, NULL, 0, 0},             // Not used
+    {huff5_codes, huff5_lengths, 4, 0},
+    {huff6_codes, huff6_lengths, 4, 0},
+    {huff7_codes, huff7_lengths, 6, 0},
+    {huff8_codes, huff8_lengths, 6, 0},
+    {huff9_codes, huff9_lengths, 6, 0},
+    {huff10_codes, huff10_lengths, 8, 0},
+    {huff11_codes, huff11_lengths, 8, 0},
+    {huff12_codes, huff12_lengths, 8, 0},
+    {huff13_codes, huff13_lengths, 16, 0},
+    {NULL, NULL, 0, 0},             // Not used
+    {huff15_codes, huff15_lengths, 16, 0},
+    {huff16_codes, huff16_lengths, 16, 1},
+    {huff16_codes, huff16_lengths, 16, 2},
+    {huff16_codes, huff16_lengths, 16, 3},
+    {huff16_codes, huff16_lengths, 16, 4},
+    {huff16_codes, huff16_lengths, 16, 6},
+    {huff16_codes, huff16_lengths, 16, 8},
+    {huff16_codes, huff16_lengths, 16, 10},
+    {huff16_codes, huff16_lengths, 16, 13},
+    {huff24_codes, huff24_lengths, 16, 4},
+    {huff24_codes, huff24_lengths, 16, 5},
+    {huff24_codes, huff24_lengths, 16, 6},
+    {huff24_codes, huff24_lengths, 16, 7},
+    {huff24_codes, huff24_lengths, 16, 8},
+    {huff24_codes, huff24_lengths, 16, 9},
+    {huff24_codes, huff24_lengths, 16, 11},
+    {huff24_codes, huff24_lengths, 16, 13}
+};
+
+typedef struct {
+    int part2_3_length;
+    int big_values;
+    int global_gain;
+    int scalefac_compress;
+    bool window_switching;
+    int block_type;                 // 0 normal, 1 start, 2 short, 3 stop
+    bool mixed_block;
+    int table_select[3];
+    int subblock_gain[3];
+    int region0_count;
+    int region1_count;
+    int preflag;
+    int scalefac_scale;
+    int count1_table;
+} granule_info_t;
+
+typedef struct {
+    uint8_t long_sf[22];
+    uint8_t short_sf[13][3];
+} scalefactors_t;
+
+struct mp3_decoder {
+    // Tail of earlier frames' main data followed by the current frame's
+    uint8_t main_data[MAX_RESERVOIR + MAX_FRAME_BYTES + MAIN_DATA_PADDING];
+    size_t main_length;
+
+    // Kept per channel across granules: granule 1 may reuse granule 0's (scfsi)
+    scalefactors_t scalefactors[2];
+    int values[GRANULE_LINES];
+    float spectrum[2][GRANULE_LINES];
+    float scratch[GRANULE_LINES];
+    int8_t intensity_pos[GRANULE_LINES];
+    float subband_samples[2][SUBBAND_LINES][SUBBANDS];
+    float overlap[2][SUBBANDS][SUBBAND_LINES];
+    float synth_history[2][SYNTH_HISTORY];
+    int synth_offset[2];
+
+    // Built once per decoder, as the resampler builds its kernel per call
+    float synth_cos[64][SUBBANDS];
+    float synth_window[512];
+    float imdct_long[36][SUBBAND_LINES];
+    float imdct_short[12][6];
+    float windows[4][36];           // By block type; the short window uses the first 12
+    float alias_cs[8];
+    float alias_ca[8];
+    float intensity_ratio[7][2];
+};
+
+// ---------------------------------------------------------------------------
+// Bitstream
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const uint8_t *data;
+    size_t position;                // In bits
+} bit_reader_t;
+
+// count must be 1..24; reads up to three bytes past the current one
+static uint32_t peek_bits(const bit_reader_t *br, int count) {
+    const uint8_t *p = br->data + (br->position >> 3);
+    uint32_t word = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    word <<= br->position & 7;
+    return word >> (32 - count);
+}
+
+static uint32_t read_bits(bit_reader_t *br, int count) {
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t value = peek_bits(br, count);
+    br->position += (size_t)count;
+    return value;
+}
+
+size_t mp3_parse_header(const uint8_t *data, size_t size, mp3_frame_header_t *header) {
+    if (size < 4 || data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) return 0;
+
+    int version = (data[1] >> 3) & 3;   // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+    int layer = (data[1] >> 1) & 3;     // 1 = Layer III
+    int bitrate_index = data[2] >> 4;
+    int rate_index = (data[2] >> 2) & 3;
+    int padding = (data[2] >> 1) & 1;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return 0;
+    }
+
+    bool mpeg1 = version == 3;
+    uint32_t rate = header_sample_rates[rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    uint32_t bitrate = header_bitrates[mpeg1 ? 0 : 1][bitrate_index] * 1000u;
+
+    header->sample_rate = rate;
+    header->samples = mpeg1 ? 1152 : 576;
+    header->channels = ((data[3] >> 6) == 3) ? 1 : 2;
+    header->mpeg1 = mpeg1;
+    header->frame_bytes = (size_t)((mpeg1 ? 144u : 72u) * bitrate / rate) + (size_t)padding;
+    return header->frame_bytes;
+}
+
+static void read_granule_info(bit_reader_t *br, granule_info_t *g) {
+    g->part2_3_length = (int)read_bits(br, 12);
+    g->big_values = (int)read_bits(br, 9);
+    if (g->big_values > GRANULE_LINES / 2) {
+        g->big_values = GRANULE_LINES / 2; // Corrupt; keep the decode in bounds
+    }
+    g->global_gain = (int)read_bits(br, 8);
+    g->scalefac_compress = (int)read_bits(br, 4);
+    g->window_switching = read_bits(br, 1) != 0;
+    if (g->window_switching) {
+        g->block_type = (int)read_bits(br, 2);
+        g->mixed_block = read_bits(br, 1) != 0;
+        g->table_select[0] = (int)read_bits(br, 5);
+        g->table_select[1] = (int)read_bits(br, 5);
+        g->table_select[2] = 0;
+        for (int w = 0; w < 3; w++) {
+            g->subblock_gain[w] = (int)read_bits(br, 3);
+        }
+        // Implicit with window switching: region 1 starts at line 36 and
+        // runs to the end of the big values
+        g->region0_count = 7;
+        g->region1_count = 0;
+    } else {
+        g->block_type = 0;
+        g->mixed_block = false;
+        for (int r = 0; r < 3; r++) {
+            g->table_select[r] = (int)read_bits(br, 5);
+        }
+        for (int w = 0; w < 3; w++) {
+            g->subblock_gain[w] = 0;
+        }
+        g->region0_count = (int)read_bits(br, 4);
+        g->region1_count = (int)read_bits(br, 3);
+    }
+    g->preflag = (int)read_bits(br, 1);
+    g->scalefac_scale = (int)read_bits(br, 1);
+    g->count1_table = (int)read_bits(br, 1);
+}
+
+static bool is_short_granule(const granule_info_t *g) {
+    return g->window_switching && g->block_type == 2;
+}
+
+static void read_scalefactors(bit_reader_t *br, const granule_info_t *g, const int scfsi[4], int gr,
+                              scalefactors_t *sf) {
+    int slen1 = slen_table[0][g->scalefac_compress];
+    int slen2 = slen_table[1][g->scalefac_compress];
+
+    if (is_short_granule(g)) {
+        int sfb = 0;
+        if (g->mixed_block) {
+            for (; sfb < 8; sfb++) {
+                sf->long_sf[sfb] = (uint8_t)read_bits(br, slen1);
+            }
+            sfb = 3;
+        }
+        for (; sfb < 12; sfb++) {
+            int length = sfb < 6 ? slen1 : slen2;
+            for (int w = 0; w < 3; w++) {
+                sf->short_sf[sfb][w] = (uint8_t)read_bits(br, length);
+            }
+        }
+        for (int w = 0; w < 3; w++) {
+            sf->short_sf[12][w] = 0;
+        }
+        return;
+    }
+
+    // Four groups of long bands; in granule 1 a set scfsi bit means the
+    // group's scalefactors carry over from granule 0
+    static const int group_start[5] = {0, 6, 11, 16, 21};
+    for (int group = 0; group < 4; group++) {
+        if (gr == 1 && scfsi[group]) {
+            continue;
+        }
+        int length = group < 2 ? slen1 : slen2;
+        for (int sfb = group_start[group]; sfb < group_start[group + 1]; sfb++) {
+            sf->long_sf[sfb] = (uint8_t)read_bits(br, length);
+        }
+    }
+    sf->long_sf[21] = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Huffman decoding
+// ---------------------------------------------------------------------------
+
+// Code words are at most 19 bits; the tables are complete prefix codes,
+// so exactly one entry matches the head of the bitstream
+static void huff_pair(bit_reader_t *br, const huff_table_t *table, int *x, int *y) {
+    uint32_t bits = peek_bits(br, 19);
+    int entries = table->size * table->size;
+    for (int i = 0; i < entries; i++) {
+        int length = table->lengths[i];
+        if ((bits >> (19 - length)) == table->codes[i]) {
+            br->position += (size_t)length;
+            *x = i / table->size;
+            *y = i % table->size;
+            return;
+        }
+    }
+    *x = 0;
+    *y = 0;
+}
+
+static int huff_quad(bit_reader_t *br, int count1_table) {
+    if (count1_table) {
+        return 15 - (int)read_bits(br, 4); // Table B: fixed length, inverted
+    }
+    uint32_t bits = peek_bits(br, 6);
+    for (int i = 0; i < 16; i++) {
+        int length = quad_a_lengths[i];
+        if ((bits >> (6 - length)) == quad_a_codes[i]) {
+            br->position += (size_t)length;
+            return i;
+        }
+    }
+    return 0;
+}
+
+static int read_value(bit_reader_t *br, int value, int linbits) {
+    if (linbits && value == 15) {
+        value += (int)read_bits(br, linbits);
+    }
+    if (value && read_bits(br, 1)) {
+        value = -value;
+    }
+    return value;
+}
+
+// Decodes one channel's spectral values into decoder->values; returns the
+// number of lines that may be nonzero
+static size_t decode_huffman(mp3_decoder_t *decoder, bit_reader_t *br, const granule_info_t *g,
+                             int rate_index, size_t end) {
+    int *values = decoder->values;
+    size_t big_end = (size_t)g->big_values * 2;
+    size_t region1;
+    size_t region2;
+    if (g->window_switching) {
+        region1 = 36;
+        region2 = GRANULE_LINES;
+    } else {
+        int r2 = g->region0_count + g->region1_count + 2;
+        region1 = sfb_long[rate_index][g->region0_count + 1];
+        region2 = r2 < 22 ? sfb_long[rate_index][r2] : GRANULE_LINES;
+    }
+
+    size_t i = 0;
+    for (; i < big_end && br->position < end; i += 2) {
+        const huff_table_t *table = &huff_tables[g->table_select[i < region1 ? 0 : (i < region2 ? 1 : 2)]];
+        int x = 0;
+        int y = 0;
+        if (table->size > 0) {
+            huff_pair(br, table, &x, &y);
+            x = read_value(br, x, table->linbits);
+            y = read_value(br, y, table->linbits);
+        }
+        values[i] = x;
+        values[i + 1] = y;
+    }
+
+    // Quadruples of -1..1 until the granule's bits run out
+    size_t count1_start = i;
+    while (i + 4 <= GRANULE_LINES && br->position < end) {
+        int quad = huff_quad(br, g->count1_table);
+        for (int k = 0; k < 4; k++) {
+            values[i + (size_t)k] = read_value(br, (quad >> (3 - k)) & 1, 0);
+        }
+        i += 4;
+    }
+    // A quadruple that straddles the end was decoded from stuffing bits
+    if (br->position > end && i > count1_start) {
+        i -= 4;
+    }
+
+    for (size_t k = i; k < GRANULE_LINES; k++) {
+        values[k] = 0;
+    }
+    return i;
+}
+
+// ---------------------------------------------------------------------------
+// Requantisation and stereo
+// ---------------------------------------------------------------------------
+
+static float dequantize(int value, float gain) {
+    if (value == 0) {
+        return 0.0f;
+    }
+    float magnitude = (float)abs(value);
+    magnitude *= cbrtf(magnitude) * gain;
+    return value < 0 ? -magnitude : magnitude;
+}
+
+static void requantize(const mp3_decoder_t *decoder, const granule_info_t *g, const scalefactors_t *sf,
+                       int rate_index, float *xr) {
+    const int *values = decoder->values;
+    float multiplier = g->scalefac_scale ? 1.0f : 0.5f;
+    float base = 0.25f * (float)(g->global_gain - 210);
+    bool short_blocks = is_short_granule(g);
+    size_t long_end = short_blocks ? (g->mixed_block ? 36 : 0) : GRANULE_LINES;
+
+    size_t i = 0;
+    for (int sfb = 0; i < long_end; sfb++) {
+        int scale = sf->long_sf[sfb] + (g->preflag ? pretab[sfb] : 0);
+        float gain = exp2f(base - multiplier * (float)scale);
+        size_t band_end = sfb_long[rate_index][sfb + 1];
+        if (band_end > long_end) {
+            band_end = long_end;
+        }
+        for (; i < band_end; i++) {
+            xr[i] = dequantize(values[i], gain);
+        }
+    }
+
+    if (short_blocks) {
+        const uint16_t *bands = sfb_short[rate_index];
+        for (int sfb = g->mixed_block ? 3 : 0; sfb < 13; sfb++) {
+            size_t width = (size_t)(bands[sfb + 1] - bands[sfb]);
+            for (int w = 0; w < 3; w++) {
+                float gain = exp2f(base - 2.0f * (float)g->subblock_gain[w] -
+                                   multiplier * (float)sf->short_sf[sfb][w]);
+                for (size_t k = 0; k < width; k++, i++) {
+                    xr[i] = dequantize(values[i], gain);
+                }
+            }
+        }
+    }
+}
+
+static void fill_intensity(int8_t *pos, size_t start, size_t end, int value) {
+    for (size_t i = start; i < end; i++) {
+        pos[i] = (int8_t)value;
+    }
+}
+
+// Intensity stereo covers the bands above the right channel's last
+// nonzero line; those carry a position in the right channel's scalefactors
+static void mark_intensity(mp3_decoder_t *decoder, const granule_info_t *g, const scalefactors_t *sf,
+                           int rate_index) {
+    const float *right = decoder->spectrum[1];
+    int8_t *pos = decoder->intensity_pos;
+    const uint16_t *long_bands = sfb_long[rate_index];
+    const uint16_t *short_bands = sfb_short[rate_index];
+
+    if (!is_short_granule(g)) {
+        int last = GRANULE_LINES - 1;
+        while (last >= 0 && right[last] == 0.0f) {
+            last--;
+        }
+        int sfb = 0;
+        if (last >= 0) {
+            while (long_bands[sfb + 1] <= (uint16_t)last) {
+                sfb++;
+            }
+            sfb++;
+        }
+        for (; sfb < 22; sfb++) {
+            fill_intensity(pos, long_bands[sfb], long_bands[sfb + 1], sf->long_sf[sfb < 21 ? sfb : 20]);
+        }
+        return;
+    }
+
+    int first_short = g->mixed_block ? 3 : 0;
+    bool short_part_empty = true;
+    for (int w = 0; w < 3; w++) {
+        int sfb = 12;
+        for (; sfb >= first_short; sfb--) {
+            size_t width = (size_t)(short_bands[sfb + 1] - short_bands[sfb]);
+            size_t start = 3 * (size_t)short_bands[sfb] + (size_t)w * width;
+            bool nonzero = false;
+            for (size_t k = 0; k < width && !nonzero; k++) {
+                nonzero = right[start + k] != 0.0f;
+            }
+            if (nonzero) {
+                break;
+            }
+        }
+        if (sfb >= first_short) {
+            short_part_empty = false;
+        }
+        for (sfb++; sfb < 13; sfb++) {
+            size_t width = (size_t)(short_bands[sfb + 1] - short_bands[sfb]);
+            size_t start = 3 * (size_t)short_bands[sfb] + (size_t)w * width;
+            fill_intensity(pos, start, start + width, sf->short_sf[sfb < 12 ? sfb : 11][w]);
+        }
+    }
+
+    // Mixed blocks: the long bands take part only if no short band has data
+    if (g->mixed_block && short_part_empty) {
+        int last = 35;
+        while (last >= 0 && right[last] == 0.0f) {
+            last--;
+        }
+        int sfb = 0;
+        if (last >= 0) {
+            while (long_bands[sfb + 1] <= (uint16_t)last) {
+                sfb++;
+            }
+            sfb++;
+        }
+        for (; sfb < 8; sfb++) {
+            fill_intensity(pos, long_bands[sfb], long_bands[sfb + 1], sf->long_sf[sfb]);
+        }
+    }
+}
+
+static void process_stereo(mp3_decoder_t *decoder, const granule_info_t *right_granule, int rate_index,
+                           int mode_extension) {
+    float *left = decoder->spectrum[0];
+    float *right = decoder->spectrum[1];
+    bool mid_side = (mode_extension & 2) != 0;
+    int8_t *pos = decoder->intensity_pos;
+
+    // Position 7 is the "not intensity coded" escape
+    memset(pos, 7, GRANULE_LINES);
+    if (mode_extension & 1) {
+        mark_intensity(decoder, right_granule, &decoder->scalefactors[1], rate_index);
+    }
+
+    const float scale = (float)(1.0 / sqrt(2.0));
+    for (size_t i = 0; i < GRANULE_LINES; i++) {
+        if (pos[i] != 7) {
+            float mono = left[i];
+            left[i] = mono * decoder->intensity_ratio[pos[i]][0];
+            right[i] = mono * decoder->intensity_ratio[pos[i]][1];
+        } else if (mid_side) {
+            float mid = left[i];
+            float side = right[i];
+            left[i] = (mid + side) * scale;
+            right[i] = (mid - side) * scale;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Hybrid filterbank and synthesis
+// ---------------------------------------------------------------------------
+
+// Short block lines arrive window by window within each band; the IMDCT
+// wants them interleaved with the window index fastest
+static void reorder(mp3_decoder_t *decoder, const granule_info_t *g, int rate_index, float *xr) {
+    const uint16_t *bands = sfb_short[rate_index];
+    int first = g->mixed_block ? 3 : 0;
+    float *tmp = decoder->scratch;
+    for (int sfb = first; sfb < 13; sfb++) {
+        size_t start = 3 * (size_t)bands[sfb];
+        size_t width = (size_t)(bands[sfb + 1] - bands[sfb]);
+        for (size_t k = 0; k < width; k++) {
+            for (size_t w = 0; w < 3; w++) {
+                tmp[start + 3 * k + w] = xr[start + w * width + k];
+            }
+        }
+    }
+    size_t offset = 3 * (size_t)bands[first];
+    memcpy(xr + offset, tmp + offset, (GRANULE_LINES - offset) * sizeof(float));
+}
+
+static void reduce_aliasing(const mp3_decoder_t *decoder, const granule_info_t *g, float *xr) {
+    int subbands = is_short_granule(g) ? (g->mixed_block ? 2 : 0) : SUBBANDS;
+    for (int sb = 1; sb < subbands; sb++) {
+        for (int i = 0; i < 8; i++) {
+            float *upper = &xr[sb * SUBBAND_LINES - 1 - i];
+            float *lower = &xr[sb * SUBBAND_LINES + i];
+            float bu = *upper;
+            float bd = *lower;
+            *upper = bu * decoder->alias_cs[i] - bd * decoder->alias_ca[i];
+            *lower = bd * decoder->alias_cs[i] + bu * decoder->alias_ca[i];
+        }
+    }
+}
+
+static void imdct_long(const mp3_decoder_t *decoder, const float *in, int block_type, float *out) {
+    for (int i = 0; i < 36; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < SUBBAND_LINES; k++) {
+            sum += in[k] * decoder->imdct_long[i][k];
+        }
+        out[i] = sum * decoder->windows[block_type][i];
+    }
+}
+
+static void imdct_short(const mp3_decoder_t *decoder, const float *in, float *out) {
+    memset(out, 0, 36 * sizeof(float));
+    for (int w = 0; w < 3; w++) {
+        for (int i = 0; i < 12; i++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 6; k++) {
+                sum += in[3 * k + w] * decoder->imdct_short[i][k];
+            }
+            out[6 + 6 * w + i] += sum * decoder->windows[2][i];
+        }
+    }
+}
+
+static void hybrid(mp3_decoder_t *decoder, int ch, const granule_info_t *g) {
+    const float *xr = decoder->spectrum[ch];
+    for (int sb = 0; sb < SUBBANDS; sb++) {
+        int block_type = g->mixed_block && sb < 2 ? 0 : g->block_type;
+        float out[36];
+        if (block_type == 2) {
+            imdct_short(decoder, xr + sb * SUBBAND_LINES, out);
+        } else {
+            imdct_long(decoder, xr + sb * SUBBAND_LINES, block_type, out);
+        }
+
+        float *previous = decoder->overlap[ch][sb];
+        for (int i = 0; i < SUBBAND_LINES; i++) {
+            float sample = out[i] + previous[i];
+            previous[i] = out[i + SUBBAND_LINES];
+            // Odd subbands are frequency inverted
+            if ((sb & 1) && (i & 1)) {
+                sample = -sample;
+            }
+            decoder->subband_samples[ch][i][sb] = sample;
+        }
+    }
+}
+
+static int16_t to_pcm(float sample) {
+    float scaled = sample * 32768.0f;
+    if (scaled >= 32767.0f) return 32767;
+    if (scaled <= -32768.0f) return -32768;
+    return (int16_t)lrintf(scaled);
+}
+
+static void synthesize(mp3_decoder_t *decoder, int ch, int16_t *pcm, size_t stride) {
+    float *history = decoder->synth_history[ch];
+    for (int t = 0; t < SUBBAND_LINES; t++) {
+        const float *samples = decoder->subband_samples[ch][t];
+        int offset = (decoder->synth_offset[ch] - 64) & (SYNTH_HISTORY - 1);
+        decoder->synth_offset[ch] = offset;
+
+        for (int i = 0; i < 64; i++) {
+            float sum = 0.0f;
+            for (int k = 0; k < SUBBANDS; k++) {
+                sum += decoder->synth_cos[i][k] * samples[k];
+            }
+            history[offset + i] = sum;
+        }
+
+        for (int j = 0; j < SUBBANDS; j++) {
+            float sum = 0.0f;
+            for (int i = 0; i < 8; i++) {
+                sum += history[(offset + 128 * i + j) & (SYNTH_HISTORY - 1)] * decoder->synth_window[64 * i + j];
+                sum += history[(offset + 128 * i + 96 + j) & (SYNTH_HISTORY - 1)] *
+                       decoder->synth_window[64 * i + 32 + j];
+            }
+            pcm[(size_t)(t * SUBBANDS + j) * stride] = to_pcm(sum);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------------------
+
+static void build_tables(mp3_decoder_t *decoder) {
+    for (int i = 0; i < 64; i++) {
+        for (int k = 0; k < SUBBANDS; k++) {
+            decoder->synth_cos[i][k] = (float)cos((16 + i) * (2 * k + 1) * M_PI / 64.0);
+        }
+    }
+
+    // The stored half window is the prototype filter up to its centre; the
+    // standard's D[] flips the sign of every other block of 64
+    for (int i = 0; i < 512; i++) {
+        int32_t tap = synth_window_half[i <= 256 ? i : 512 - i];
+        float value = (float)tap / 65536.0f;
+        decoder->synth_window[i] = ((i / 64) & 1) ? -value : value;
+    }
+
+    for (int i = 0; i < 36; i++) {
+        for (int k = 0; k < SUBBAND_LINES; k++) {
+            decoder->imdct_long[i][k] = (float)cos(M_PI / 72.0 * (2 * i + 1 + 18) * (2 * k + 1));
+        }
+    }
+    for (int i = 0; i < 12; i++) {
+        for (int k = 0; k < 6; k++) {
+            decoder->imdct_short[i][k] = (float)cos(M_PI / 24.0 * (2 * i + 1 + 6) * (2 * k + 1));
+        }
+    }
+
+    for (int i = 0; i < 36; i++) {
+        float normal = (float)sin(M_PI / 36.0 * (i + 0.5));
+        decoder->windows[0][i] = normal;
+
+        // Start: long rising half, flat, short falling half, zeros
+        if (i < 18) decoder->windows[1][i] = normal;
+        else if (i < 24) decoder->windows[1][i] = 1.0f;
+        else if (i < 30) decoder->windows[1][i] = (float)sin(M_PI / 12.0 * (i - 18 + 0.5));
+        else decoder->windows[1][i] = 0.0f;
+
+        // Stop: the start window mirrored
+        if (i < 6) decoder->windows[3][i] = 0.0f;
+        else if (i < 12) decoder->windows[3][i] = (float)sin(M_PI / 12.0 * (i - 6 + 0.5));
+        else if (i < 18) decoder->windows[3][i] = 1.0f;
+        else decoder->windows[3][i] = normal;
+
+        decoder->windows[2][i] = i < 12 ? (float)sin(M_PI / 12.0 * (i + 0.5)) : 0.0f;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        double c = alias_coefficients[i];
+        double norm = sqrt(1.0 + c * c);
+        decoder->alias_cs[i] = (float)(1.0 / norm);
+        decoder->alias_ca[i] = (float)(c / norm);
+    }
+
+    // Left and right share of the mono signal for is_pos 0..6, i.e.
+    // k / (1 + k) and 1 / (1 + k) with k = tan(is_pos * pi / 12)
+    for (int p = 0; p < 7; p++) {
+        double angle = p * M_PI / 12.0;
+        double s = sin(angle);
+        double c = cos(angle);
+        decoder->intensity_ratio[p][0] = (float)(s / (s + c));
+        decoder->intensity_ratio[p][1] = (float)(c / (s + c));
+    }
+}
+
+mp3_decoder_t *mp3_decoder_create(void) {
+    mp3_decoder_t *decoder = calloc(1, sizeof(*decoder));
+    if (!decoder) {
+        return NULL;
+    }
+    build_tables(decoder);
+    return decoder;
+}
+
+void mp3_decoder_reset(mp3_decoder_t *decoder) {
+    if (!decoder) {
+        return;
+    }
+    decoder->main_length = 0;
+    memset(decoder->overlap, 0, sizeof(decoder->overlap));
+    memset(decoder->synth_history, 0, sizeof(decoder->synth_history));
+    decoder->synth_offset[0] = 0;
+    decoder->synth_offset[1] = 0;
+}
+
+void mp3_decoder_destroy(mp3_decoder_t *decoder) {
+    free(decoder);
+}
+
+int mp3_decoder_decode(mp3_decoder_t *decoder, const uint8_t *data, size_t size,
+                       int16_t *pcm, mp3_frame_header_t *header) {
+    if (!decoder || !data || !pcm || !header) {
+        return -1;
+    }
+    size_t frame_bytes = mp3_parse_header(data, size, header);
+    if (frame_bytes == 0 || frame_bytes > size || !header->mpeg1) {
+        return -1;
+    }
+
+    int channels = (int)header->channels;
+    size_t crc_bytes = (data[1] & 1) ? 0 : 2;
+    int rate_index = (data[2] >> 2) & 3;
+    int mode = data[3] >> 6;
+    int mode_extension = (data[3] >> 4) & 3;
+    size_t side_bytes = channels == 1 ? 17 : 32;
+    size_t main_offset = 4 + crc_bytes + side_bytes;
+    if (main_offset > frame_bytes) {
+        return -1;
+    }
+
+    // Side information, copied so the bit reader may peek past its end
+    uint8_t side[48] = {0};
+    memcpy(side, data + 4 + crc_bytes, side_bytes);
+    bit_reader_t br = {side, 0};
+    size_t main_data_begin = read_bits(&br, 9);
+    read_bits(&br, channels == 1 ? 5 : 3); // Private bits
+    int scfsi[2][4];
+    for (int ch = 0; ch < channels; ch++) {
+        for (int group = 0; group < 4; group++) {
+            scfsi[ch][group] = (int)read_bits(&br, 1);
+        }
+    }
+    granule_info_t granules[2][2];
+    for (int gr = 0; gr < 2; gr++) {
+        for (int ch = 0; ch < channels; ch++) {
+            read_granule_info(&br, &granules[gr][ch]);
+        }
+    }
+
+    // Append this frame's main data behind the reservoir the back-pointer
+    // reaches into
+    bool have_reservoir = main_data_begin <= decoder->main_length;
+    size_t keep = decoder->main_length < MAX_RESERVOIR ? decoder->main_length : MAX_RESERVOIR;
+    memmove(decoder->main_data, decoder->main_data + decoder->main_length - keep, keep);
+    size_t main_bytes = frame_bytes - main_offset;
+    memcpy(decoder->main_data + keep, data + main_offset, main_bytes);
+    decoder->main_length = keep + main_bytes;
+    memset(decoder->main_data + decoder->main_length, 0, MAIN_DATA_PADDING);
+
+    size_t samples = header->samples;
+    if (!have_reservoir) {
+        memset(pcm, 0, samples * (size_t)channels * sizeof(int16_t));
+        return (int)samples;
+    }
+
+    br.data = decoder->main_data;
+    br.position = (keep - main_data_begin) * 8;
+    size_t limit = decoder->main_length * 8;
+    for (int gr = 0; gr < 2; gr++) {
+        for (int ch = 0; ch < channels; ch++) {
+            const granule_info_t *g = &granules[gr][ch];
+            size_t end = br.position + (size_t)g->part2_3_length;
+            if (end > limit) {
+                end = limit; // Corrupt length; decode what is there
+            }
+            read_scalefactors(&br, g, scfsi[ch], gr, &decoder->scalefactors[ch]);
+            decode_huffman(decoder, &br, g, rate_index, end);
+            requantize(decoder, g, &decoder->scalefactors[ch], rate_index, decoder->spectrum[ch]);
+            br.position = end;
+        }
+
+        if (channels == 2 && mode == 1 && mode_extension != 0) {
+            process_stereo(decoder, &granules[gr][1], rate_index, mode_extension);
+        }
+
+        for (int ch = 0; ch < channels; ch++) {
+            const granule_info_t *g = &granules[gr][ch];
+            if (is_short_granule(g)) {
+                reorder(decoder, g, rate_index, decoder->spectrum[ch]);
+            }
+            reduce_aliasing(decoder, g, decoder->spectrum[ch]);
+            hybrid(decoder, ch, g);
+            synthesize(decoder, ch, pcm + (size_t)gr * GRANULE_LINES * (size_t)channels + (size_t)ch,
+                       (size_t)channels);
+        }
+    }
+    return (int)samples;
+}
+
+#endif // !__APPLE__
@@ -0,0 +1,43 @@
+#ifndef MP3_DECODER_H
+#define MP3_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// MPEG-1 Layer III decoder for the portable audio loader. Frames are
+// decoded one at a time into interleaved 16-bit PCM; the decoder keeps the
+// bit reservoir, IMDCT overlap and synthesis history between calls, so
+// frames must be fed in stream order (reset before jumping elsewhere).
+// MPEG-2/2.5 low sample rate frames are recognised by the header parser
+// but not decoded.
+
+#define MP3_MAX_FRAME_SAMPLES 1152      // PCM frames per channel per MPEG-1 frame
+
+typedef struct {
+    uint32_t sample_rate;
+    size_t channels;
+    size_t samples;                     // PCM frames per channel
+    size_t frame_bytes;
+    bool mpeg1;
+} mp3_frame_header_t;
+
+typedef struct mp3_decoder mp3_decoder_t;
+
+// Parses the Layer III frame header at data; returns the frame length in
+// bytes, or 0 if data does not start with a valid header
+size_t mp3_parse_header(const uint8_t *data, size_t size, mp3_frame_header_t *header);
+
+mp3_decoder_t *mp3_decoder_create(void);
+void mp3_decoder_reset(mp3_decoder_t *decoder);
+void mp3_decoder_destroy(mp3_decoder_t *decoder);
+
+// Decodes the frame at data (size bytes available) into pcm, which must
+// hold MP3_MAX_FRAME_SAMPLES * 2 samples. Returns PCM frames per channel
+// written, or -1 if data holds no complete decodable frame. A frame whose
+// bit reservoir is missing (the first frames after a reset into the middle
+// of a stream) decodes as silence so the frame count stays exact.
+int mp3_decoder_decode(mp3_decoder_t *decoder, const uint8_t *data, size_t size,
+                       int16_t *pcm, mp3_frame_header_t *header);
+
+#endif // MP3_DECODER_H
@@ -0,0 +1,186 @@
+#ifdef SOUNDBOARD_OFFLINE
+
+// Offline renderer: plays a Standard MIDI File or event log (midi_file.h)
+// through the soundboard and mixer on a virtual sample clock and writes the
+// mix to a WAV file as fast as the CPU allows.
+//
+//   midi_soundboard_render <config.json> <performance> <out.wav> [max tail seconds]
+//
+// Events go through the same parser and dispatch as live input, and each
+// one is sent once the mix has been rendered up to its frame, so it lands
+// on the same sample it would on a device with no jitter. The output only
+// depends on the inputs: rendering twice gives identical files.
+
+#include "midi_soundboard.h"
+#include "bank_loader.h"
+#include "config.h"
+#include "event_dispatch.h"
+#include "midi_file.h"
+#include "midi_queue.h"
+#include "mixer.h"
+#include "monotonic_clock.h"
+#include "page_residency.h"
+#include "wav_writer.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RENDER_BLOCK_FRAMES MIXER_BLOCK_FRAMES
+#define DEFAULT_TAIL_SECONDS 10     // Longest wait for voices to ring out after the last event
+#define MIDI_BATCH_SIZE 64
+
+typedef struct {
+    wav_writer_t wav;
+    uint64_t frame;             // Frames rendered so far
+    size_t peak_voices;
+    int16_t buffer[RENDER_BLOCK_FRAMES];
+} render_state_t;
+
+static int render_frames(render_state_t *state, uint64_t frame_count) {
+    while (frame_count > 0) {
+        size_t block = frame_count < RENDER_BLOCK_FRAMES ? (size_t)frame_count : RENDER_BLOCK_FRAMES;
+        audio_offline_render(state->buffer, block);
+        if (wav_writer_write(&state->wav, state->buffer, block) != 0) {
+            fprintf(stderr, "[RENDER] Failed to write output\n");
+            return -1;
+        }
+        size_t voices = mixer_active_voices();
+        if (voices > state->peak_voices) {
+            state->peak_voices = voices;
+        }
+        state->frame += block;
+        frame_count -= block;
+    }
+    return 0;
+}
+
+// Everything is decoded into memory up front: streams and the cache reload
+// from disk on background threads, which a faster-than-realtime clock
+// would outrun
+static void prepare_config(config_t *config) {
+    config->resident_pages = -1;
+    config->cache_budget_mb = 0;
+    config->stream_threshold_seconds = 0;
+    for (size_t i = 0; i < config->sound_count; i++) {
+        config->sounds[i].stream = STREAM_NEVER;
+    }
+}
+
+static int render_performance(const config_t *config, const midi_file_t *performance,
+                              render_state_t *state, uint32_t tail_seconds) {
+    midi_queue_t queue;
+    if (midi_queue_init(&queue, MIDI_QUEUE_SIZE) != 0) {
+        return -1;
+    }
+    midi_parser_t parser = {0};
+    event_dispatch_t dispatch;
+    event_dispatch_init(&dispatch, config);
+    midi_event_t events[MIDI_BATCH_SIZE];
+
+    int result = 0;
+    for (size_t i = 0; i < performance->event_count && result == 0; i++) {
+        const midi_file_event_t *event = &performance->events[i];
+        uint64_t frame = audio_offline_frame_for_time(event->time_ns);
+        if (frame > state->frame) {
+            result = render_frames(state, frame - state->frame);
+        }
+
+        midi_parser_feed(&parser, event->bytes, event->length, event->time_ns, &queue);
+        size_t count = midi_queue_pop_batch(&queue, events, MIDI_BATCH_SIZE);
+        for (size_t j = 0; j < count; j++) {
+            uint8_t page;
+            event_dispatch(&dispatch, &events[j], &page);
+        }
+    }
+
+    // Play to the end of the performance, then until the last voice has
+    // finished (looped and held sounds are cut off after the tail)
+    uint64_t end_frame = audio_offline_frame_for_time(performance->length_ns);
+    if (result == 0 && end_frame > state->frame) {
+        result = render_frames(state, end_frame - state->frame);
+    }
+    uint64_t tail_end = state->frame + (uint64_t)tail_seconds * SOUNDBOARD_SAMPLE_RATE;
+    while (result == 0 && state->frame < tail_end) {
+        result = render_frames(state, RENDER_BLOCK_FRAMES);
+        if (mixer_active_voices() == 0) {
+            break;
+        }
+    }
+
+    midi_queue_free(&queue);
+    return result;
+}
+
+// Loads every sound, renders the performance and reports the speed
+static int render_to_file(const config_t *config, const midi_file_t *performance, const char *path,
+                          uint32_t tail_seconds) {
+    if (page_residency_start(config) != 0) {
+        printf("Failed to start loading sounds\n");
+        return -1;
+    }
+    bank_loader_wait();
+    page_residency_poll();
+
+    // Static: the block buffer is too big for some default stacks
+    static render_state_t state;
+    if (wav_writer_open(&state.wav, path, SOUNDBOARD_SAMPLE_RATE) != 0) {
+        return -1;
+    }
+
+    uint64_t start_ns = clock_now_ns();
+    int result = render_performance(config, performance, &state, tail_seconds);
+    uint64_t elapsed_ns = clock_now_ns() - start_ns;
+    if (wav_writer_close(&state.wav) != 0 || result != 0) {
+        fprintf(stderr, "[RENDER] Failed to write %s\n", path);
+        return -1;
+    }
+
+    double audio_seconds = (double)state.frame / SOUNDBOARD_SAMPLE_RATE;
+    double wall_seconds = elapsed_ns / 1e9;
+    printf("[RENDER] Wrote %.2f s to %s in %.3f s (%.1fx real time), peak %zu voice(s)\n",
+           audio_seconds, path, wall_seconds,
+           wall_seconds > 0 ? audio_seconds / wall_seconds : 0.0, state.peak_voices);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "Usage: %s <config.json> <performance.mid|events.txt> <out.wav> [max tail seconds]\n",
+                argv[0]);
+        return 2;
+    }
+    uint32_t tail_seconds = argc == 5 ? (uint32_t)strtoul(argv[4], NULL, 10) : DEFAULT_TAIL_SECONDS;
+
+    config_t config;
+    if (config_load(argv[1], &config) != 0) {
+        printf("Failed to load config\n");
+        return 1;
+    }
+    prepare_config(&config);
+
+    midi_file_t performance;
+    if (midi_file_load(argv[2], &performance) != 0) {
+        config_free(&config);
+        return 1;
+    }
+    printf("[RENDER] %s: %zu event(s), %.2f s\n", argv[2], performance.event_count,
+           performance.length_ns / 1e9);
+
+    if (soundboard_init(&config) != 0) {
+        printf("Failed to initialize soundboard\n");
+        midi_file_free(&performance);
+        config_free(&config);
+        return 1;
+    }
+
+    int result = render_to_file(&config, &performance, argv[3], tail_seconds);
+
+    bank_loader_cancel();
+    soundboard_cleanup();
+    bank_loader_cleanup();
+    midi_file_free(&performance);
+    config_free(&config);
+    return result == 0 ? 0 : 1;
+}
+
+#endif // SOUNDBOARD_OFFLINE
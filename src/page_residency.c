@@ -0,0 +1,127 @@
+#include "page_residency.h"
+#include "async_log.h"
+#include "bank_loader.h"
+#include "midi_soundboard.h"
+#include <stdio.h>
+
+typedef struct {
+    const config_t *config;
+    int radius;                  // Neighbours kept on each side (-1 = all pages)
+    uint32_t configured;         // Pages with at least one sound
+    uint32_t resident;           // Pages fully loaded
+    uint32_t loading;            // Pages of the running loader batch
+} residency_t;
+
+static residency_t residency;
+
+static uint32_t page_bit(int page) {
+    return 1u << page;
+}
+
+static uint32_t wanted_pages(void) {
+    if (residency.radius < 0) {
+        return residency.configured;
+    }
+    int current = soundboard_get_current_page();
+    uint32_t wanted = 0;
+    for (int page = current - residency.radius; page <= current + residency.radius; page++) {
+        if (page >= 0 && page < SOUNDBOARD_PAGES) {
+            wanted |= page_bit(page);
+        }
+    }
+    return wanted & residency.configured;
+}
+
+int page_residency_start(const config_t *config) {
+    if (config == NULL) {
+        return -1;
+    }
+
+    residency.config = config;
+    residency.radius = config->resident_pages;
+    residency.configured = 0;
+    residency.resident = 0;
+    residency.loading = 0;
+    for (size_t i = 0; i < config->sound_count; i++) {
+        if (config->sounds[i].page < SOUNDBOARD_PAGES) {
+            residency.configured |= page_bit(config->sounds[i].page);
+        }
+    }
+
+    if (bank_loader_start(config) != 0) {
+        return -1;
+    }
+    uint32_t wanted = wanted_pages();
+    if (bank_loader_load_pages(wanted, soundboard_get_current_page()) != 0) {
+        return -1;
+    }
+    residency.loading = wanted;
+    if (residency.radius >= 0) {
+        printf("[PAGE] Keeping %d page(s) either side of the current page loaded\n", residency.radius);
+    }
+    return 0;
+}
+
+int page_residency_set_page(uint8_t page) {
+    if (page >= SOUNDBOARD_PAGES) {
+        return -1;
+    }
+    if (page == soundboard_get_current_page()) {
+        return 0;
+    }
+
+    soundboard_set_page(page);
+    bool ready = (residency.resident & page_bit(page)) != 0 || (residency.configured & page_bit(page)) == 0;
+    LOG_INFO("[PAGE] Switched to page %u%s\n", page, ready ? "" : " (loading)");
+    page_residency_poll();
+    return 0;
+}
+
+void page_residency_poll(void) {
+    if (residency.config == NULL) {
+        return;
+    }
+
+    if (residency.loading != 0 && bank_loader_done()) {
+        bank_loader_wait();
+        residency.resident |= residency.loading;
+        residency.loading = 0;
+    }
+
+    // Pages that fell out of range go once nothing on them is playing; a
+    // loop left running keeps its page loaded until it is stopped
+    uint32_t wanted = wanted_pages();
+    uint32_t unwanted = residency.resident & ~wanted;
+    for (int page = 0; unwanted != 0 && page < SOUNDBOARD_PAGES; page++) {
+        if ((unwanted & page_bit(page)) == 0) {
+            continue;
+        }
+        int freed = soundboard_unload_page((uint8_t)page);
+        if (freed >= 0) {
+            residency.resident &= ~page_bit(page);
+            LOG_INFO("[PAGE] Unloaded page %d (%d sound(s))\n", page, freed);
+        }
+    }
+
+    // One batch at a time; pages wanted meanwhile are picked up next time
+    uint32_t missing = wanted & ~residency.resident;
+    if (missing != 0 && residency.loading == 0 &&
+        bank_loader_load_pages(missing, soundboard_get_current_page()) == 0) {
+        residency.loading = missing;
+    }
+}
+
+int page_residency_reload(void) {
+    if (residency.config == NULL || residency.loading != 0) {
+        return -1;
+    }
+    // Pages waiting to be unloaded keep their residency so they still go
+    residency.resident &= ~wanted_pages();
+    LOG_INFO("[PAGE] Reloading the sounds of the loaded pages\n");
+    page_residency_poll();
+    return 0;
+}
+
+bool page_residency_is_resident(uint8_t page) {
+    return page < SOUNDBOARD_PAGES && (residency.resident & page_bit(page)) != 0;
+}
@@ -0,0 +1,37 @@
+#ifndef PAGE_RESIDENCY_H
+#define PAGE_RESIDENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+
+// Decides which pages have their sounds in memory. With resident_pages set,
+// only the current page and that many neighbours on each side are kept
+// loaded: switching pages loads the new neighbourhood in the background and
+// unloads pages that fell out of it once none of their voices is playing.
+// Otherwise every page is loaded at startup and stays loaded.
+//
+// Page switches only change which pads respond; they never wait for a load
+// and never touch the audio thread. Pads on a page that is still loading
+// become playable one by one as their files finish.
+
+// Starts loading the initial pages. config must stay valid until
+// bank_loader_cleanup().
+int page_residency_start(const config_t *config);
+
+// Control thread: switches to page and starts loading around it
+int page_residency_set_page(uint8_t page);
+
+// Control thread, called regularly: collects finished loads, starts the
+// next one and unloads pages that are no longer needed
+void page_residency_poll(void);
+
+// Control thread: loads the sounds of every loaded page again, picking up
+// files changed on disk (the config itself is not re-read). Pads keep their
+// current sounds until the new ones are published. Fails (-1) while a
+// batch is loading.
+int page_residency_reload(void);
+
+bool page_residency_is_resident(uint8_t page);
+
+#endif // PAGE_RESIDENCY_H
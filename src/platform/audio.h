@@ -4,21 +4,37 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "../config.h"  // For voice_steal_policy_t
+#include "../mixer.h"   // For voice_handle_t
 
-// Active sound track for mixing
+// Output engine settings
 typedef struct {
-    const int16_t *data;        // Audio data
-    size_t length;              // Total length in samples
-    size_t position;            // Current playback position
-    bool is_active;             // Is this track currently playing
-    bool is_looping;            // Should this track loop
-    bool is_hold;               // Hold mode - stops when note off
-} active_sound_t;
+    uint32_t sample_rate;
+    size_t max_voices;                  // Polyphony (0 = mixer default)
+    voice_steal_policy_t steal_policy;
+    audio_output_t output;              // Ignored where there is only one path
+    uint32_t buffer_frames;             // Frames per buffer (0 = backend default)
+    uint32_t buffer_count;              // Queued buffers (0 = backend default)
+    const char *device;                 // Output device (NULL = backend default)
+} audio_settings_t;
 
 // Platform-specific audio implementation
-int audio_init(uint32_t sample_rate);
-int audio_start_sound(const int16_t *samples, size_t sample_count, bool loop, bool hold);
-int audio_stop_sound(const int16_t *samples);  // Stop by data pointer
+int audio_init(const audio_settings_t *settings);
+voice_handle_t audio_start_sound(const int16_t *samples, size_t sample_count, uint32_t sample_rate,
+                                 float gain, bool loop, bool hold);
+// IMA-ADPCM blocks (adpcm.h), decoded while mixing
+voice_handle_t audio_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t sample_rate,
+                                 float gain, bool loop, bool hold);
+voice_handle_t audio_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold);
+int audio_stop_sound(voice_handle_t voice);
+bool audio_sound_active(voice_handle_t voice);   // Still playing or fading out
+int audio_retrigger_sound(voice_handle_t voice);  // Rewind a playing voice to the start
+int audio_set_sound_gain(voice_handle_t voice, float gain);
+int audio_extend_sound(voice_handle_t voice, const int16_t *samples, size_t sample_count);
+// Starts and stops issued after this take effect at the sample matching
+// timestamp_ns (monotonic, clock_now_ns()) plus a fixed delay of one output
+// buffer. 0 = as soon as possible.
+void audio_schedule(uint64_t timestamp_ns);
 void audio_cleanup(void);
 
 // Legacy function for backward compatibility (now just starts a sound)
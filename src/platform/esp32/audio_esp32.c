@@ -1,10 +1,13 @@
 #ifdef ESP_PLATFORM
 
 #include "../audio.h"
+#include "../../mixer.h"
+#include "../../latency_stats.h"
 #include "driver/i2s.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -13,23 +16,98 @@
 #define I2S_WS_PIN GPIO_NUM_25
 #define I2S_DATA_PIN GPIO_NUM_22
 
+#define DEFAULT_DMA_FRAMES 256      // ~6ms at 44.1kHz
+#define MAX_DMA_FRAMES 1024         // Largest DMA buffer the I2S driver accepts
+#define DEFAULT_DMA_COUNT 4
+#define MAX_DMA_COUNT 8
+#define DEFAULT_VOICES 16           // Each voice slot holds an ADPCM block buffer
+#define RENDER_TASK_CORE 1          // Keep mixing off the core running Wi-Fi/BT
+#define RENDER_TASK_STACK 4096
+#define RENDER_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+
 static uint32_t sample_rate = 44100;
+static uint32_t dma_frames = DEFAULT_DMA_FRAMES;
+static uint32_t dma_count = DEFAULT_DMA_COUNT;
 static bool initialized = false;
-static QueueHandle_t audio_queue = NULL;
 
-int audio_init(uint32_t sr) {
+// The render task mixes one DMA buffer at a time into these and blocks in
+// i2s_write() until the driver has a free DMA buffer, so the DMA rate paces
+// it. Nothing is allocated while it runs.
+static int16_t mix_buffer[MAX_DMA_FRAMES];
+static uint16_t dac_buffer[MAX_DMA_FRAMES];
+static TaskHandle_t render_task_handle = NULL;
+static SemaphoreHandle_t render_task_done = NULL;
+static volatile bool render_running = false;
+
+static void render_task(void *arg) {
+    (void)arg;
+
+    // i2s_write() returns once a DMA buffer is free, so a buffer written
+    // later than the whole ring lasts means the DMA ran dry (an underrun)
+    int64_t start_us = esp_timer_get_time();
+    uint64_t frames = 0;
+    int64_t slack_us = (int64_t)dma_count * dma_frames * 1000000 / sample_rate;
+    while (render_running) {
+        mixer_render(mix_buffer, dma_frames);
+
+        // The built-in DAC takes unsigned samples in the high byte
+        for (uint32_t i = 0; i < dma_frames; i++) {
+            dac_buffer[i] = (uint16_t)(mix_buffer[i] + 32768);
+        }
+
+        size_t bytes_written = 0;
+        i2s_write(I2S_NUM, dac_buffer, dma_frames * sizeof(uint16_t), &bytes_written, portMAX_DELAY);
+
+        frames += dma_frames;
+        int64_t now_us = esp_timer_get_time();
+        if (now_us > start_us + (int64_t)(frames * 1000000 / sample_rate) + slack_us) {
+            latency_stats_count_xrun();
+            start_us = now_us; // Count from here rather than catching up
+            frames = 0;
+        }
+    }
+
+    xSemaphoreGive(render_task_done);
+    vTaskDelete(NULL);
+}
+
+static void stop_render_task(void) {
+    if (render_task_handle == NULL) {
+        return;
+    }
+    // i2s_write() returns within one DMA buffer, so the task sees the flag
+    render_running = false;
+    xSemaphoreTake(render_task_done, portMAX_DELAY);
+    render_task_handle = NULL;
+}
+
+int audio_init(const audio_settings_t *settings) {
     if (initialized) {
         return 0;
     }
-    
-    sample_rate = sr;
-    
-    // Create queue for audio samples
-    audio_queue = xQueueCreate(5, sizeof(size_t)); // Store sample count
-    if (audio_queue == NULL) {
+
+    sample_rate = settings->sample_rate;
+    dma_frames = settings->buffer_frames ? settings->buffer_frames : DEFAULT_DMA_FRAMES;
+    if (dma_frames > MAX_DMA_FRAMES) {
+        dma_frames = MAX_DMA_FRAMES;
+    }
+    dma_count = settings->buffer_count ? settings->buffer_count : DEFAULT_DMA_COUNT;
+    if (dma_count > MAX_DMA_COUNT) {
+        dma_count = MAX_DMA_COUNT;
+    }
+
+    // Must exist before the render task starts
+    size_t voices = settings->max_voices ? settings->max_voices : DEFAULT_VOICES;
+    if (mixer_init(sample_rate, voices, settings->steal_policy) != 0) {
         return -1;
     }
-    
+
+    render_task_done = xSemaphoreCreateBinary();
+    if (render_task_done == NULL) {
+        mixer_cleanup();
+        return -1;
+    }
+
     // Configure I2S
     i2s_config_t i2s_config = {
         .mode = I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN,
@@ -38,83 +116,142 @@ int audio_init(uint32_t sr) {
         .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
         .communication_format = I2S_COMM_FORMAT_STAND_MSB,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 8,
-        .dma_buf_len = 1024,
+        .dma_buf_count = dma_count,
+        .dma_buf_len = dma_frames,
         .use_apll = false,
-        .tx_desc_auto_clear = true,
+        .tx_desc_auto_clear = true, // Silence rather than repeat on an underrun
     };
-    
+
     i2s_pin_config_t pin_config = {
         .bck_io_num = I2S_BCK_PIN,
         .ws_io_num = I2S_WS_PIN,
         .data_out_num = I2S_DATA_PIN,
         .data_in_num = I2S_PIN_NO_CHANGE
     };
-    
+
     esp_err_t err = i2s_driver_install(I2S_NUM, &i2s_config, 0, NULL);
     if (err != ESP_OK) {
-        vQueueDelete(audio_queue);
+        vSemaphoreDelete(render_task_done);
+        mixer_cleanup();
         return -1;
     }
-    
+
     err = i2s_set_pin(I2S_NUM, &pin_config);
     if (err != ESP_OK) {
         i2s_driver_uninstall(I2S_NUM);
-        vQueueDelete(audio_queue);
+        vSemaphoreDelete(render_task_done);
+        mixer_cleanup();
         return -1;
     }
-    
+
     // Enable DAC
     i2s_set_dac_mode(I2S_DAC_CHANNEL_LEFT_EN);
-    
+
+    render_running = true;
+    if (xTaskCreatePinnedToCore(render_task, "audio_render", RENDER_TASK_STACK, NULL, RENDER_TASK_PRIORITY,
+                                &render_task_handle, RENDER_TASK_CORE) != pdPASS) {
+        render_running = false;
+        render_task_handle = NULL;
+        i2s_driver_uninstall(I2S_NUM);
+        vSemaphoreDelete(render_task_done);
+        mixer_cleanup();
+        return -1;
+    }
+
+    // A buffer is mixed one DMA ring ahead of playback, plus one buffer of
+    // scheduling delay for timestamped events
+    double buffer_ms = dma_frames * 1000.0 / sample_rate;
+    printf("[AUDIO] I2S DAC: %u x %u-frame DMA buffers, render task on core %d, "
+           "input-to-output latency %.1f ms (schedule %.1f + DMA %.1f)\n",
+           (unsigned)dma_count, (unsigned)dma_frames, RENDER_TASK_CORE,
+           (dma_count + 1) * buffer_ms, buffer_ms, dma_count * buffer_ms);
+
     initialized = true;
     return 0;
 }
 
-int audio_play_sample(const int16_t *samples, size_t sample_count) {
-    if (!initialized || samples == NULL || sample_count == 0) {
+voice_handle_t audio_start_sound(const int16_t *samples, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_voice(samples, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_adpcm(blocks, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_stream(stream, gain, loop, hold);
+}
+
+int audio_stop_sound(voice_handle_t voice) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_stop_voice(voice);
+}
+
+bool audio_sound_active(voice_handle_t voice) {
+    if (!initialized) {
+        return false;
+    }
+    return mixer_voice_active(voice);
+}
+
+int audio_retrigger_sound(voice_handle_t voice) {
+    if (!initialized) {
         return -1;
     }
-    
-    // Convert int16_t samples to uint8_t for DAC (8-bit)
-    size_t bytes_written = 0;
-    size_t bytes_to_write = sample_count * sizeof(int16_t);
-    
-    // I2S DAC expects 8-bit samples, so we need to convert
-    // For simplicity, we'll use the high byte of each 16-bit sample
-    uint8_t *dac_buffer = malloc(sample_count);
-    if (dac_buffer == NULL) {
+    return mixer_retrigger_voice(voice);
+}
+
+int audio_set_sound_gain(voice_handle_t voice, float gain) {
+    if (!initialized) {
         return -1;
     }
-    
-    for (size_t i = 0; i < sample_count; i++) {
-        // Convert signed 16-bit to unsigned 8-bit (DAC format)
-        int16_t sample = samples[i];
-        // Scale and offset to 0-255 range
-        dac_buffer[i] = (uint8_t)((sample >> 8) + 128);
-    }
-    
-    esp_err_t err = i2s_write(I2S_NUM, dac_buffer, sample_count, &bytes_written, portMAX_DELAY);
-    free(dac_buffer);
-    
-    if (err != ESP_OK || bytes_written != sample_count) {
+    return mixer_set_voice_gain(voice, gain);
+}
+
+int audio_extend_sound(voice_handle_t voice, const int16_t *samples, size_t sample_count) {
+    if (!initialized) {
         return -1;
     }
-    
-    return 0;
+    return mixer_extend_voice(voice, samples, sample_count);
 }
 
-void audio_cleanup(void) {
+void audio_schedule(uint64_t timestamp_ns) {
     if (!initialized) {
         return;
     }
-    
-    if (audio_queue != NULL) {
-        vQueueDelete(audio_queue);
-        audio_queue = NULL;
+    mixer_schedule(timestamp_ns);
+}
+
+int audio_play_sample(const int16_t *samples, size_t sample_count) {
+    // Legacy function - just start a oneshot sound
+    return audio_start_sound(samples, sample_count, sample_rate, 1.0f, false, false) != VOICE_HANDLE_INVALID ? 0 : -1;
+}
+
+void audio_cleanup(void) {
+    if (!initialized) {
+        return;
     }
-    
+
+    // The render task is gone before the mixer it reads is freed
+    stop_render_task();
     i2s_driver_uninstall(I2S_NUM);
+    vSemaphoreDelete(render_task_done);
+    render_task_done = NULL;
+
+    mixer_cleanup();
     initialized = false;
 }
 
@@ -1,10 +1,11 @@
 #ifdef ESP_PLATFORM
 
 #include "../midi.h"
+#include "../../midi_queue.h"
+#include "../../monotonic_clock.h"
 #include "driver/uart.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -12,57 +13,26 @@
 #define BUF_SIZE 1024
 #define MIDI_BAUD_RATE 31250  // Standard MIDI baud rate
 
-static QueueHandle_t midi_queue = NULL;
+// The UART task is the only producer and the main loop the only consumer
+static midi_queue_t event_queue;
 static TaskHandle_t midi_task_handle = NULL;
 static bool initialized = false;
 
 static void midi_task(void *pvParameters) {
     (void)pvParameters;
     uint8_t data[BUF_SIZE];
-    midi_event_t event;
-    uint8_t status_byte = 0;
-    uint8_t note = 0;
-    uint8_t velocity = 0;
-    uint8_t bytes_received = 0;
+    midi_parser_t parser = {0};
     
     while (1) {
         int len = uart_read_bytes(UART_NUM, data, BUF_SIZE, pdMS_TO_TICKS(100));
-        
-        for (int i = 0; i < len; i++) {
-            uint8_t byte = data[i];
-            
-            // Check if it's a status byte (MSB is 1)
-            if (byte & 0x80) {
-                status_byte = byte;
-                bytes_received = 0;
-                
-                // Note On or Note Off
-                if ((status_byte & 0xF0) == 0x90 || (status_byte & 0xF0) == 0x80) {
-                    bytes_received = 1;
-                }
-            } else {
-                // Data byte
-                if ((status_byte & 0xF0) == 0x90 || (status_byte & 0xF0) == 0x80) {
-                    if (bytes_received == 1) {
-                        note = byte;
-                        bytes_received = 2;
-                    } else if (bytes_received == 2) {
-                        velocity = byte;
-                        
-                        event.note = note;
-                        event.velocity = velocity;
-                        event.is_on = ((status_byte & 0xF0) == 0x90) && (velocity > 0);
-                        
-                        xQueueSend(midi_queue, &event, 0);
-                        bytes_received = 0;
-                    }
-                }
-            }
+        if (len > 0) {
+            midi_parser_feed(&parser, data, (size_t)len, clock_now_ns(), &event_queue);
         }
     }
 }
 
-int midi_init(void) {
+int midi_init(const char *source) {
+    (void)source; // Always UART2
     if (initialized) {
         return 0;
     }
@@ -82,8 +52,7 @@ int midi_init(void) {
     ESP_ERROR_CHECK(uart_set_pin(UART_NUM, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
     
     // Create queue for MIDI events
-    midi_queue = xQueueCreate(10, sizeof(midi_event_t));
-    if (midi_queue == NULL) {
+    if (midi_queue_init(&event_queue, MIDI_QUEUE_SIZE) != 0) {
         uart_driver_delete(UART_NUM);
         return -1;
     }
@@ -91,7 +60,7 @@ int midi_init(void) {
     // Create MIDI reading task
     xTaskCreate(midi_task, "midi_task", 4096, NULL, 5, &midi_task_handle);
     if (midi_task_handle == NULL) {
-        vQueueDelete(midi_queue);
+        midi_queue_free(&event_queue);
         uart_driver_delete(UART_NUM);
         return -1;
     }
@@ -105,11 +74,31 @@ int midi_read(midi_event_t *event) {
         return -1;
     }
     
-    if (xQueueReceive(midi_queue, event, pdMS_TO_TICKS(10)) == pdTRUE) {
+    return midi_queue_pop_batch(&event_queue, event, 1) == 1 ? 0 : 1; // 1 = no event available
+}
+
+int midi_wait(uint32_t timeout_ms) {
+    if (!initialized) {
+        return -1;
+    }
+    return midi_queue_wait(&event_queue, timeout_ms) ? 0 : 1;
+}
+
+void midi_wake(void) {
+    if (initialized) {
+        midi_queue_notify(&event_queue);
+    }
+}
+
+size_t midi_read_batch(midi_event_t *events, size_t max) {
+    if (events == NULL || !initialized) {
         return 0;
     }
-    
-    return 1; // No event available
+    return midi_queue_pop_batch(&event_queue, events, max);
+}
+
+uint32_t midi_overflow_count(void) {
+    return initialized ? midi_queue_overflows(&event_queue) : 0;
 }
 
 void midi_cleanup(void) {
@@ -122,10 +111,7 @@ void midi_cleanup(void) {
         midi_task_handle = NULL;
     }
     
-    if (midi_queue != NULL) {
-        vQueueDelete(midi_queue);
-        midi_queue = NULL;
-    }
+    midi_queue_free(&event_queue);
     
     uart_driver_delete(UART_NUM);
     initialized = false;
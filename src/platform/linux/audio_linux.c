@@ -0,0 +1,393 @@
+#ifdef __linux__
+
+#include "../audio.h"
+#include "../../mixer.h"
+#include "../../async_log.h"
+#include "../../latency_stats.h"
+#include "../../monotonic_clock.h"
+#include "../../wav_writer.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+// Output devices (settings->device):
+//   "null"           discards the mix, paced by the monotonic clock
+//   "wav:<path>"     writes the mix to a WAV file, paced the same way
+//   anything else    ALSA PCM name, e.g. "default" or "hw:0,0" (HAVE_ALSA)
+// The default is ALSA "default", or "null" in builds without ALSA.
+
+#define DEFAULT_PERIOD_FRAMES 256   // ~6ms at 44.1kHz
+#define DEFAULT_PERIOD_COUNT 3
+#define MAX_PERIOD_FRAMES 8192
+#define MAX_CHANNELS 8              // The mono mix is copied to every channel
+#define RENDER_PRIORITY 80          // SCHED_FIFO priority of the render thread
+#define ALSA_WAIT_MS 100            // Bounds how long shutdown waits for the thread
+#define WAV_PREFIX "wav:"
+
+typedef enum {
+    SINK_ALSA,
+    SINK_NULL,
+    SINK_WAV
+} sink_t;
+
+static sink_t sink = SINK_NULL;
+static uint32_t sample_rate = 44100;
+static uint32_t period_frames = DEFAULT_PERIOD_FRAMES;
+static uint32_t period_count = DEFAULT_PERIOD_COUNT;
+static bool initialized = false;
+
+// The render thread mixes one period at a time into these; nothing is
+// allocated while it runs
+static int16_t mix_buffer[MAX_PERIOD_FRAMES];
+static pthread_t render_thread;
+static bool render_started = false;
+static _Atomic bool render_running = false;
+
+static wav_writer_t wav = {0};
+#ifdef HAVE_ALSA
+static snd_pcm_t *pcm = NULL;
+static unsigned channels = 1;
+static int16_t out_buffer[MAX_PERIOD_FRAMES * MAX_CHANNELS]; // mix_buffer on every channel
+#endif
+
+// Asks for realtime scheduling; needs CAP_SYS_NICE or an rtprio limit
+static void raise_priority(void) {
+    struct sched_param param = { .sched_priority = RENDER_PRIORITY };
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        fprintf(stderr, "[AUDIO] No realtime priority for the render thread (%s), using normal scheduling\n",
+                strerror(err));
+    }
+}
+
+// Null and WAV sinks: renders one period per period of monotonic time, so
+// scheduled events land where they would on a sound card
+static void *clock_thread(void *arg) {
+    (void)arg;
+    raise_priority();
+
+    uint64_t start_ns = clock_now_ns();
+    uint64_t frames = 0;
+    uint64_t slack_ns = (uint64_t)period_count * period_frames * 1000000000ull / sample_rate;
+    while (render_running) {
+        mixer_render(mix_buffer, period_frames);
+        if (wav.file != NULL) {
+            wav_writer_write(&wav, mix_buffer, period_frames);
+        }
+        frames += period_frames;
+
+        // Fell further behind than the buffers would cover: an xrun on a
+        // real device. Start counting from now rather than catching up.
+        uint64_t deadline_ns = start_ns + frames * 1000000000ull / sample_rate;
+        uint64_t now_ns = clock_now_ns();
+        if (now_ns > deadline_ns + slack_ns) {
+            latency_stats_count_xrun();
+            start_ns = now_ns;
+            frames = 0;
+            continue;
+        }
+        struct timespec deadline = {
+            .tv_sec = (time_t)(deadline_ns / 1000000000ull),
+            .tv_nsec = (long)(deadline_ns % 1000000000ull),
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        }
+    }
+    return NULL;
+}
+
+#ifdef HAVE_ALSA
+// Fills whole periods whenever the device has room for them. The mix is
+// rendered mono and copied to each device channel.
+static void *alsa_thread(void *arg) {
+    (void)arg;
+    raise_priority();
+
+    while (render_running) {
+        snd_pcm_sframes_t avail = snd_pcm_avail(pcm);
+        if (avail < 0) {
+            latency_stats_count_xrun();
+            if (snd_pcm_recover(pcm, (int)avail, 1) < 0) {
+                LOG_ERROR("[AUDIO] ALSA device lost: %s\n", snd_strerror((int)avail));
+                break;
+            }
+            continue;
+        }
+        if ((snd_pcm_uframes_t)avail < period_frames) {
+            snd_pcm_wait(pcm, ALSA_WAIT_MS);
+            continue;
+        }
+
+        while ((snd_pcm_uframes_t)avail >= period_frames && render_running) {
+            mixer_render(mix_buffer, period_frames);
+            const int16_t *out = mix_buffer;
+            if (channels > 1) {
+                for (uint32_t i = 0; i < period_frames; i++) {
+                    for (unsigned c = 0; c < channels; c++) {
+                        out_buffer[i * channels + c] = mix_buffer[i];
+                    }
+                }
+                out = out_buffer;
+            }
+            snd_pcm_sframes_t written = snd_pcm_writei(pcm, out, period_frames);
+            if (written < 0) {
+                latency_stats_count_xrun();
+                snd_pcm_recover(pcm, (int)written, 1);
+                break;
+            }
+            avail -= written;
+        }
+    }
+    return NULL;
+}
+
+static int open_alsa(const char *device) {
+    int err = snd_pcm_open(&pcm, device, SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        fprintf(stderr, "[AUDIO] Failed to open ALSA device %s: %s\n", device, snd_strerror(err));
+        pcm = NULL;
+        return -1;
+    }
+
+    // Mono if the device takes it, at exactly our rate: the bank, its cache
+    // and streamed sounds are all converted to it, so ALSA resamples for a
+    // device that runs at another rate rather than the mixer following it
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_hw_params_malloc(&hw);
+    snd_pcm_uframes_t period = period_frames;
+    snd_pcm_uframes_t buffer = (snd_pcm_uframes_t)period_frames * period_count;
+    channels = 1;
+    err = snd_pcm_hw_params_any(pcm, hw);
+    if (err >= 0) err = snd_pcm_hw_params_set_rate_resample(pcm, hw, 1);
+    if (err >= 0) err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+    if (err >= 0) err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16);
+    if (err >= 0) err = snd_pcm_hw_params_set_channels_near(pcm, hw, &channels);
+    if (err >= 0) {
+        err = snd_pcm_hw_params_set_rate(pcm, hw, sample_rate, 0);
+        if (err < 0) {
+            fprintf(stderr, "[AUDIO] ALSA device %s can't run at %u Hz: %s (try a plug: or default device)\n",
+                    device, sample_rate, snd_strerror(err));
+            snd_pcm_hw_params_free(hw);
+            return -1;
+        }
+    }
+    if (err >= 0) err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, NULL);
+    if (err >= 0) err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &buffer);
+    if (err >= 0) err = snd_pcm_hw_params(pcm, hw);
+    snd_pcm_hw_params_free(hw);
+    if (err < 0 || channels > MAX_CHANNELS || period > MAX_PERIOD_FRAMES) {
+        fprintf(stderr, "[AUDIO] ALSA device %s has no usable 16-bit format: %s\n", device,
+                err < 0 ? snd_strerror(err) : "too many channels or frames");
+        return -1;
+    }
+
+    // Start as soon as the first period is written; wake for each free period
+    snd_pcm_sw_params_t *sw;
+    snd_pcm_sw_params_malloc(&sw);
+    err = snd_pcm_sw_params_current(pcm, sw);
+    if (err >= 0) err = snd_pcm_sw_params_set_start_threshold(pcm, sw, period);
+    if (err >= 0) err = snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+    if (err >= 0) err = snd_pcm_sw_params(pcm, sw);
+    snd_pcm_sw_params_free(sw);
+    if (err < 0) {
+        fprintf(stderr, "[AUDIO] Failed to configure ALSA device %s: %s\n", device, snd_strerror(err));
+        return -1;
+    }
+
+    period_frames = (uint32_t)period;
+    period_count = (uint32_t)(buffer / period);
+
+    // One period of scheduling delay for timestamped events, plus the buffer
+    double period_ms = period_frames * 1000.0 / sample_rate;
+    printf("[AUDIO] ALSA %s: %u x %u-frame periods, %u channel(s) at %u Hz, input-to-output latency %.1f ms "
+           "(schedule %.1f + buffer %.1f)\n",
+           device, period_count, period_frames, channels, sample_rate,
+           (period_count + 1) * period_ms, period_ms, period_count * period_ms);
+    return 0;
+}
+#endif
+
+int audio_init(const audio_settings_t *settings) {
+    if (initialized) {
+        return 0;
+    }
+
+    sample_rate = settings->sample_rate;
+    period_frames = settings->buffer_frames ? settings->buffer_frames : DEFAULT_PERIOD_FRAMES;
+    if (period_frames > MAX_PERIOD_FRAMES) {
+        period_frames = MAX_PERIOD_FRAMES;
+    }
+    period_count = settings->buffer_count ? settings->buffer_count : DEFAULT_PERIOD_COUNT;
+
+    const char *device = settings->device;
+#ifdef HAVE_ALSA
+    if (device == NULL || device[0] == '\0') {
+        device = "default";
+    }
+#else
+    if (device == NULL || device[0] == '\0') {
+        device = "null";
+    }
+#endif
+
+    // Marked initialized first so audio_cleanup() can tear down a partial start
+    initialized = true;
+    int result;
+    if (strcmp(device, "null") == 0) {
+        sink = SINK_NULL;
+        result = 0;
+    } else if (strncmp(device, WAV_PREFIX, strlen(WAV_PREFIX)) == 0) {
+        sink = SINK_WAV;
+        result = wav_writer_open(&wav, device + strlen(WAV_PREFIX), sample_rate);
+    } else {
+#ifdef HAVE_ALSA
+        sink = SINK_ALSA;
+        result = open_alsa(device);
+#else
+        fprintf(stderr, "[AUDIO] Built without ALSA; use \"null\" or \"wav:<path>\" instead of %s\n", device);
+        result = -1;
+#endif
+    }
+
+    // The mixer must exist before the render thread starts
+    if (result == 0 && mixer_init(sample_rate, settings->max_voices, settings->steal_policy) != 0) {
+        result = -1;
+    }
+    if (result == 0) {
+        render_running = true;
+        void *(*thread_main)(void *) = clock_thread;
+#ifdef HAVE_ALSA
+        if (sink == SINK_ALSA) {
+            thread_main = alsa_thread;
+        }
+#endif
+        if (pthread_create(&render_thread, NULL, thread_main, NULL) != 0) {
+            render_running = false;
+            mixer_cleanup();
+            result = -1;
+        } else {
+            render_started = true;
+        }
+    }
+    if (result != 0) {
+        audio_cleanup();
+        return -1;
+    }
+
+    if (sink != SINK_ALSA) {
+        double period_ms = period_frames * 1000.0 / sample_rate;
+        printf("[AUDIO] %s sink: %u-frame periods at %u Hz (%.1f ms)\n",
+               sink == SINK_WAV ? "WAV file" : "Null", period_frames, sample_rate, period_ms);
+    }
+    return 0;
+}
+
+voice_handle_t audio_start_sound(const int16_t *samples, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_voice(samples, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_adpcm(blocks, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_stream(stream, gain, loop, hold);
+}
+
+int audio_stop_sound(voice_handle_t voice) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_stop_voice(voice);
+}
+
+bool audio_sound_active(voice_handle_t voice) {
+    if (!initialized) {
+        return false;
+    }
+    return mixer_voice_active(voice);
+}
+
+int audio_retrigger_sound(voice_handle_t voice) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_retrigger_voice(voice);
+}
+
+int audio_set_sound_gain(voice_handle_t voice, float gain) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_set_voice_gain(voice, gain);
+}
+
+int audio_extend_sound(voice_handle_t voice, const int16_t *samples, size_t sample_count) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_extend_voice(voice, samples, sample_count);
+}
+
+void audio_schedule(uint64_t timestamp_ns) {
+    if (!initialized) {
+        return;
+    }
+    mixer_schedule(timestamp_ns);
+}
+
+int audio_play_sample(const int16_t *samples, size_t sample_count) {
+    // Legacy function - just start a oneshot sound
+    return audio_start_sound(samples, sample_count, sample_rate, 1.0f, false, false) != VOICE_HANDLE_INVALID ? 0 : -1;
+}
+
+void audio_cleanup(void) {
+    if (!initialized) {
+        return;
+    }
+
+    // The render thread is gone before the mixer it reads is freed
+    bool rendered = render_started;
+    if (render_started) {
+        render_running = false;
+        pthread_join(render_thread, NULL);
+        render_started = false;
+    }
+#ifdef HAVE_ALSA
+    if (pcm != NULL) {
+        snd_pcm_drop(pcm);
+        snd_pcm_close(pcm);
+        pcm = NULL;
+    }
+#endif
+    if (wav.file != NULL) {
+        wav_writer_close(&wav);
+        printf("[AUDIO] Wrote %.1f s of output\n", (double)wav.frames / sample_rate);
+    }
+
+    if (rendered) {
+        mixer_cleanup();
+    }
+    initialized = false;
+}
+
+#endif // __linux__
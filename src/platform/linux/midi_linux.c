@@ -0,0 +1,380 @@
+#ifdef __linux__
+
+#include "../midi.h"
+#include "../../async_log.h"
+#include "../../midi_queue.h"
+#include "../../monotonic_clock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+// MIDI sources (midi_init()'s source):
+//   "seq"            ALSA sequencer port connected to every readable port (HAVE_ALSA)
+//   "/path"          raw MIDI bytes from a file, character device (/dev/midi1,
+//                    /dev/snd/midiC1D0) or FIFO; a missing path is created
+//                    as a FIFO that other processes can write MIDI bytes to
+//   anything else    ALSA raw MIDI device, e.g. "hw:1,0,0" (HAVE_ALSA)
+//   "none"           no input
+// The default is "seq", or DEFAULT_FIFO_PATH in builds without ALSA.
+
+#define DEFAULT_FIFO_PATH "/tmp/midi_soundboard.fifo"
+#define MAX_POLL_FDS 8
+#define READ_CHUNK 256
+
+typedef enum {
+    SOURCE_NONE,
+    SOURCE_FILE,
+    SOURCE_SEQ,
+    SOURCE_RAWMIDI
+} source_kind_t;
+
+// All input is read on one thread, so the queue has exactly one producer
+static midi_queue_t event_queue;
+static midi_parser_t parser;
+static source_kind_t source_kind = SOURCE_NONE;
+static int source_fd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static pthread_t reader_thread;
+static bool reader_started = false;
+static bool initialized = false;
+#ifdef HAVE_ALSA
+static snd_seq_t *seq = NULL;
+static snd_midi_event_t *seq_decoder = NULL;
+static snd_rawmidi_t *rawmidi = NULL;
+#endif
+
+static int open_file(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        if (mkfifo(path, 0666) != 0) {
+            fprintf(stderr, "[MIDI] Failed to create FIFO %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        printf("[MIDI] Created FIFO %s\n", path);
+        st.st_mode = S_IFIFO;
+    }
+
+    // A FIFO is also opened for writing so it never reports end of file
+    // when a writer goes away
+    int flags = S_ISFIFO(st.st_mode) ? O_RDWR : O_RDONLY;
+    source_fd = open(path, flags | O_NONBLOCK | O_CLOEXEC);
+    if (source_fd < 0) {
+        fprintf(stderr, "[MIDI] Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    source_kind = SOURCE_FILE;
+    printf("[MIDI] Reading raw MIDI from %s\n", path);
+    return 0;
+}
+
+#ifdef HAVE_ALSA
+// Subscribes our port to every readable port of the other clients, like
+// the Mac OS backend connecting to every source
+static int connect_seq_ports(int port) {
+    snd_seq_client_info_t *client_info;
+    snd_seq_port_info_t *port_info;
+    if (snd_seq_client_info_malloc(&client_info) < 0) {
+        return 0;
+    }
+    if (snd_seq_port_info_malloc(&port_info) < 0) {
+        snd_seq_client_info_free(client_info);
+        return 0;
+    }
+
+    unsigned wanted = SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ;
+    int connected = 0;
+    snd_seq_client_info_set_client(client_info, -1);
+    while (snd_seq_query_next_client(seq, client_info) >= 0) {
+        int client = snd_seq_client_info_get_client(client_info);
+        if (client == SND_SEQ_CLIENT_SYSTEM || client == snd_seq_client_id(seq)) {
+            continue;
+        }
+        snd_seq_port_info_set_client(port_info, client);
+        snd_seq_port_info_set_port(port_info, -1);
+        while (snd_seq_query_next_port(seq, port_info) >= 0) {
+            unsigned caps = snd_seq_port_info_get_capability(port_info);
+            if ((caps & wanted) != wanted || (caps & SND_SEQ_PORT_CAP_NO_EXPORT) != 0) {
+                continue;
+            }
+            int source_port = snd_seq_port_info_get_port(port_info);
+            if (snd_seq_connect_from(seq, port, client, source_port) == 0) {
+                printf("[MIDI] Connected to %d:%d %s\n", client, source_port, snd_seq_port_info_get_name(port_info));
+                connected++;
+            }
+        }
+    }
+
+    snd_seq_port_info_free(port_info);
+    snd_seq_client_info_free(client_info);
+    return connected;
+}
+
+static int open_seq(void) {
+    int err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+    if (err < 0) {
+        fprintf(stderr, "[MIDI] Failed to open the ALSA sequencer: %s\n", snd_strerror(err));
+        seq = NULL;
+        return -1;
+    }
+    snd_seq_set_client_name(seq, "MIDI Soundboard");
+    int port = snd_seq_create_simple_port(seq, "Input", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                                          SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    // Events are turned back into complete messages (no running status)
+    // for the shared parser
+    if (port < 0 || snd_midi_event_new(READ_CHUNK, &seq_decoder) < 0) {
+        fprintf(stderr, "[MIDI] Failed to create the sequencer port\n");
+        return -1;
+    }
+    snd_midi_event_no_status(seq_decoder, 1);
+    source_kind = SOURCE_SEQ;
+
+    int connected = connect_seq_ports(port);
+    printf("[MIDI] Sequencer port %d:%d connected to %d source(s)%s\n", snd_seq_client_id(seq), port,
+           connected, connected == 0 ? "; connect one with aconnect" : "");
+    return 0;
+}
+
+static int open_rawmidi(const char *name) {
+    int err = snd_rawmidi_open(&rawmidi, NULL, name, SND_RAWMIDI_NONBLOCK);
+    if (err < 0) {
+        fprintf(stderr, "[MIDI] Failed to open raw MIDI device %s: %s\n", name, snd_strerror(err));
+        rawmidi = NULL;
+        return -1;
+    }
+    source_kind = SOURCE_RAWMIDI;
+    printf("[MIDI] Reading raw MIDI device %s\n", name);
+    return 0;
+}
+#endif
+
+// Poll descriptors of the open source, after the stop pipe's
+static int source_poll_fds(struct pollfd *fds, int max) {
+    switch (source_kind) {
+    case SOURCE_FILE:
+        fds[0] = (struct pollfd){ .fd = source_fd, .events = POLLIN };
+        return 1;
+#ifdef HAVE_ALSA
+    case SOURCE_SEQ:
+        return snd_seq_poll_descriptors(seq, fds, (unsigned)max, POLLIN);
+    case SOURCE_RAWMIDI:
+        return snd_rawmidi_poll_descriptors(rawmidi, fds, (unsigned)max);
+#endif
+    default:
+        (void)max;
+        return 0;
+    }
+}
+
+// Reads everything available; returns -1 once the source is finished
+static int read_source(void) {
+    uint8_t bytes[READ_CHUNK];
+    uint64_t now_ns = clock_now_ns();
+    switch (source_kind) {
+    case SOURCE_FILE:
+        for (;;) {
+            ssize_t got = read(source_fd, bytes, sizeof(bytes));
+            if (got > 0) {
+                midi_parser_feed(&parser, bytes, (size_t)got, now_ns, &event_queue);
+                continue;
+            }
+            if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+                return 0;
+            }
+            LOG_INFO("[MIDI] End of input\n");
+            return -1;
+        }
+#ifdef HAVE_ALSA
+    case SOURCE_SEQ: {
+        snd_seq_event_t *event;
+        while (snd_seq_event_input(seq, &event) >= 0) {
+            long length = snd_midi_event_decode(seq_decoder, bytes, sizeof(bytes), event);
+            if (length > 0) {
+                midi_parser_feed(&parser, bytes, (size_t)length, now_ns, &event_queue);
+            }
+        }
+        return 0;
+    }
+    case SOURCE_RAWMIDI:
+        for (;;) {
+            ssize_t got = snd_rawmidi_read(rawmidi, bytes, sizeof(bytes));
+            if (got > 0) {
+                midi_parser_feed(&parser, bytes, (size_t)got, now_ns, &event_queue);
+                continue;
+            }
+            if (got == -EAGAIN || got == 0) {
+                return 0;
+            }
+            LOG_ERROR("[MIDI] Raw MIDI device lost: %s\n", snd_strerror((int)got));
+            return -1;
+        }
+#endif
+    default:
+        return -1;
+    }
+}
+
+// Sleeps in poll() until input arrives or midi_cleanup() writes to the
+// stop pipe. Events are stamped with the time the bytes were read.
+static void *reader_main(void *arg) {
+    (void)arg;
+    struct pollfd fds[1 + MAX_POLL_FDS];
+    fds[0] = (struct pollfd){ .fd = stop_pipe[0], .events = POLLIN };
+    int count = 1 + source_poll_fds(&fds[1], MAX_POLL_FDS);
+
+    for (;;) {
+        if (poll(fds, (nfds_t)count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents != 0 || read_source() != 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void close_source(void) {
+    if (source_fd >= 0) {
+        close(source_fd);
+        source_fd = -1;
+    }
+#ifdef HAVE_ALSA
+    if (seq_decoder != NULL) {
+        snd_midi_event_free(seq_decoder);
+        seq_decoder = NULL;
+    }
+    if (seq != NULL) {
+        snd_seq_close(seq);
+        seq = NULL;
+    }
+    if (rawmidi != NULL) {
+        snd_rawmidi_close(rawmidi);
+        rawmidi = NULL;
+    }
+#endif
+    source_kind = SOURCE_NONE;
+}
+
+int midi_init(const char *source) {
+    if (initialized) {
+        return 0;
+    }
+
+    // Must exist before the reader thread starts
+    if (midi_queue_init(&event_queue, MIDI_QUEUE_SIZE) != 0) {
+        fprintf(stderr, "[MIDI] Failed to allocate event queue\n");
+        return -1;
+    }
+    memset(&parser, 0, sizeof(parser));
+
+    if (source == NULL || source[0] == '\0') {
+#ifdef HAVE_ALSA
+        source = "seq";
+#else
+        source = DEFAULT_FIFO_PATH;
+#endif
+    }
+
+    int result;
+    if (strcmp(source, "none") == 0) {
+        printf("[MIDI] No MIDI input\n");
+        result = 0;
+    } else if (source[0] == '/' || source[0] == '.') {
+        result = open_file(source);
+    } else {
+#ifdef HAVE_ALSA
+        result = strcmp(source, "seq") == 0 ? open_seq() : open_rawmidi(source);
+#else
+        fprintf(stderr, "[MIDI] Built without ALSA; use a file or FIFO path instead of %s\n", source);
+        result = -1;
+#endif
+    }
+
+    if (result == 0 && source_kind != SOURCE_NONE) {
+        if (pipe(stop_pipe) != 0 || pthread_create(&reader_thread, NULL, reader_main, NULL) != 0) {
+            fprintf(stderr, "[MIDI] Failed to start the input thread\n");
+            result = -1;
+        } else {
+            reader_started = true;
+        }
+    }
+    if (result != 0) {
+        close_source();
+        for (int i = 0; i < 2; i++) {
+            if (stop_pipe[i] >= 0) {
+                close(stop_pipe[i]);
+                stop_pipe[i] = -1;
+            }
+        }
+        midi_queue_free(&event_queue);
+        return -1;
+    }
+
+    initialized = true;
+    return 0;
+}
+
+int midi_read(midi_event_t *event) {
+    if (event == NULL) {
+        return -1;
+    }
+
+    return midi_queue_pop_batch(&event_queue, event, 1) == 1 ? 0 : 1; // 1 = no event available
+}
+
+int midi_wait(uint32_t timeout_ms) {
+    return midi_queue_wait(&event_queue, timeout_ms) ? 0 : 1;
+}
+
+void midi_wake(void) {
+    if (initialized) {
+        midi_queue_notify(&event_queue);
+    }
+}
+
+size_t midi_read_batch(midi_event_t *events, size_t max) {
+    if (events == NULL) {
+        return 0;
+    }
+    return midi_queue_pop_batch(&event_queue, events, max);
+}
+
+uint32_t midi_overflow_count(void) {
+    return midi_queue_overflows(&event_queue);
+}
+
+void midi_cleanup(void) {
+    if (!initialized) {
+        return;
+    }
+
+    // The reader is gone before the queue it feeds is freed
+    if (reader_started) {
+        ssize_t ignored = write(stop_pipe[1], "", 1);
+        (void)ignored;
+        pthread_join(reader_thread, NULL);
+        reader_started = false;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (stop_pipe[i] >= 0) {
+            close(stop_pipe[i]);
+            stop_pipe[i] = -1;
+        }
+    }
+    close_source();
+    midi_queue_free(&event_queue);
+    initialized = false;
+}
+
+#endif // __linux__
@@ -1,97 +1,157 @@
 #ifdef __APPLE__
 
 #include "../audio.h"
+#include "../../mixer.h"
+#include "../../latency_stats.h"
 #include <CoreAudio/CoreAudio.h>
 #include <AudioToolbox/AudioToolbox.h>
+#include <AudioUnit/AudioUnit.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <pthread.h>
 
-#define MAX_ACTIVE_SOUNDS 10
-#define BUFFER_SIZE_SAMPLES 4096  // ~93ms at 44.1kHz
+#define DEFAULT_UNIT_FRAMES 256     // ~6ms at 44.1kHz
+#define DEFAULT_QUEUE_FRAMES 4096   // ~93ms at 44.1kHz
+#define DEFAULT_QUEUE_COUNT 3
+#define MAX_QUEUE_BUFFERS 8
+#define AUDIO_ELEMENT_MAIN 0        // kAudioObjectPropertyElementMain (Master before macOS 12)
 
+static audio_output_t output = AUDIO_OUTPUT_UNIT;
+static AudioUnit output_unit = NULL;
 static AudioQueueRef audio_queue = NULL;
-static AudioQueueBufferRef buffers[3];
+static AudioQueueBufferRef buffers[MAX_QUEUE_BUFFERS];
+static uint32_t buffer_count = 0;
+static uint32_t buffer_frames = 0;
 static uint32_t sample_rate = 44100;
 static bool initialized = false;
-static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-// Active sounds being mixed
-static active_sound_t active_sounds[MAX_ACTIVE_SOUNDS] = {0};
-
-static void mix_audio(int16_t *output, size_t sample_count) {
-    memset(output, 0, sample_count * sizeof(int16_t));
-    
-    pthread_mutex_lock(&queue_mutex);
-    
-    for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-        active_sound_t *sound = &active_sounds[i];
-        if (!sound->is_active) continue;
-        
-        for (size_t j = 0; j < sample_count; j++) {
-            if (sound->position >= sound->length) {
-                if (sound->is_looping) {
-                    sound->position = 0; // Loop back
-                } else {
-                    sound->is_active = false; // Sound finished
-                    break;
-                }
-            }
-            
-            if (sound->is_active && sound->position < sound->length) {
-                // Mix samples (simple addition with clipping)
-                int32_t mixed = (int32_t)output[j] + (int32_t)sound->data[sound->position];
-                output[j] = (int16_t)(mixed > 32767 ? 32767 : (mixed < -32768 ? -32768 : mixed));
-                sound->position++;
-            }
-        }
-    }
-    
-    pthread_mutex_unlock(&queue_mutex);
-}
+// Device sample time the next unit callback should start at (-1 = none
+// yet). A later start means the device played silence in between.
+static Float64 next_sample_time = -1;
 
 static void audio_callback(void *user_data, AudioQueueRef queue, AudioQueueBufferRef buffer) {
     (void)user_data;
-    (void)queue;
     
     // Mix all active sounds
-    mix_audio((int16_t *)buffer->mAudioData, buffer->mAudioDataByteSize / sizeof(int16_t));
+    mixer_render((int16_t *)buffer->mAudioData, buffer->mAudioDataByteSize / sizeof(int16_t));
     
     // Enqueue the buffer back
     AudioQueueEnqueueBuffer(queue, buffer, 0, NULL);
 }
 
-int audio_init(uint32_t sr) {
-    if (initialized) {
+// Runs on the device's realtime I/O thread for every hardware buffer
+static OSStatus unit_callback(void *user_data, AudioUnitRenderActionFlags *flags,
+                              const AudioTimeStamp *timestamp, UInt32 bus, UInt32 frame_count,
+                              AudioBufferList *data) {
+    (void)user_data;
+    (void)flags;
+    (void)bus;
+    
+    if (timestamp->mFlags & kAudioTimeStampSampleTimeValid) {
+        if (next_sample_time >= 0 && timestamp->mSampleTime > next_sample_time) {
+            latency_stats_count_xrun();
+        }
+        next_sample_time = timestamp->mSampleTime + frame_count;
+    }
+    
+    mixer_render((int16_t *)data->mBuffers[0].mData, frame_count);
+    return noErr;
+}
+
+static UInt32 device_property(AudioDeviceID device, AudioObjectPropertySelector selector,
+                              AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress address = { selector, scope, AUDIO_ELEMENT_MAIN };
+    UInt32 value = 0;
+    UInt32 size = sizeof(value);
+    if (AudioObjectGetPropertyData(device, &address, 0, NULL, &size, &value) != noErr) {
         return 0;
     }
+    return value;
+}
+
+static int start_unit(const AudioStreamBasicDescription *format) {
+    AudioComponentDescription description = {
+        .componentType = kAudioUnitType_Output,
+        .componentSubType = kAudioUnitSubType_DefaultOutput,
+        .componentManufacturer = kAudioUnitManufacturer_Apple,
+    };
+    AudioComponent component = AudioComponentFindNext(NULL, &description);
+    if (component == NULL || AudioComponentInstanceNew(component, &output_unit) != noErr) {
+        fprintf(stderr, "Failed to open the default output unit\n");
+        output_unit = NULL;
+        return -1;
+    }
     
-    sample_rate = sr;
+    // The unit converts our mono int16 to the device format. Rate conversion
+    // can ask for somewhat more than one device buffer per callback.
+    AURenderCallbackStruct callback = { .inputProc = unit_callback };
+    UInt32 max_frames = buffer_frames * 2 > 4096 ? buffer_frames * 2 : 4096;
+    if (AudioUnitSetProperty(output_unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0,
+                             format, sizeof(*format)) != noErr ||
+        AudioUnitSetProperty(output_unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                             &max_frames, sizeof(max_frames)) != noErr ||
+        AudioUnitSetProperty(output_unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                             &callback, sizeof(callback)) != noErr) {
+        fprintf(stderr, "Failed to configure the output unit\n");
+        return -1;
+    }
     
-    AudioStreamBasicDescription format = {0};
-    format.mSampleRate = sample_rate;
-    format.mFormatID = kAudioFormatLinearPCM;
-    format.mFormatFlags = kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
-    format.mBytesPerPacket = 2;
-    format.mFramesPerPacket = 1;
-    format.mBytesPerFrame = 2;
-    format.mChannelsPerFrame = 1;
-    format.mBitsPerChannel = 16;
+    // Ask the device for our buffer size; it may pick the nearest it supports
+    AudioDeviceID device = 0;
+    UInt32 size = sizeof(device);
+    if (AudioUnitGetProperty(output_unit, kAudioOutputUnitProperty_CurrentDevice, kAudioUnitScope_Global, 0,
+                             &device, &size) == noErr) {
+        AudioObjectPropertyAddress address = {
+            kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, AUDIO_ELEMENT_MAIN
+        };
+        UInt32 frames = buffer_frames;
+        if (AudioObjectSetPropertyData(device, &address, 0, NULL, sizeof(frames), &frames) != noErr) {
+            fprintf(stderr, "[AUDIO] Device refused a %u-frame buffer\n", buffer_frames);
+        }
+    }
     
-    OSStatus status = AudioQueueNewOutput(&format, audio_callback, NULL, NULL, NULL, 0, &audio_queue);
+    if (AudioUnitInitialize(output_unit) != noErr || AudioOutputUnitStart(output_unit) != noErr) {
+        fprintf(stderr, "Failed to start the output unit\n");
+        return -1;
+    }
+    
+    // Report what we actually got: one buffer of scheduling delay for
+    // timestamped events, plus the device buffer, its latency and the HAL's
+    // safety offset
+    UInt32 device_frames = device_property(device, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal);
+    UInt32 device_latency = device_property(device, kAudioDevicePropertyLatency, kAudioObjectPropertyScopeOutput);
+    UInt32 safety_offset = device_property(device, kAudioDevicePropertySafetyOffset, kAudioObjectPropertyScopeOutput);
+    Float64 device_rate = 0;
+    AudioObjectPropertyAddress rate_address = {
+        kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, AUDIO_ELEMENT_MAIN
+    };
+    size = sizeof(device_rate);
+    if (AudioObjectGetPropertyData(device, &rate_address, 0, NULL, &size, &device_rate) != noErr ||
+        device_rate <= 0) {
+        device_rate = sample_rate;
+    }
+    double buffer_ms = device_frames * 1000.0 / device_rate;
+    double device_ms = (device_latency + safety_offset) * 1000.0 / device_rate;
+    printf("[AUDIO] Output unit: %u-frame buffer at %.0f Hz, input-to-output latency %.1f ms "
+           "(schedule %.1f + buffer %.1f + device %.1f)\n",
+           (unsigned)device_frames, device_rate, 2 * buffer_ms + device_ms, buffer_ms, buffer_ms, device_ms);
+    return 0;
+}
+
+static int start_queue(const AudioStreamBasicDescription *format) {
+    OSStatus status = AudioQueueNewOutput(format, audio_callback, NULL, NULL, NULL, 0, &audio_queue);
     if (status != noErr) {
         fprintf(stderr, "Failed to create audio queue\n");
+        audio_queue = NULL;
         return -1;
     }
     
     // Allocate buffers
-    UInt32 buffer_size = BUFFER_SIZE_SAMPLES * sizeof(int16_t);
-    for (int i = 0; i < 3; i++) {
+    UInt32 buffer_size = buffer_frames * sizeof(int16_t);
+    for (uint32_t i = 0; i < buffer_count; i++) {
         status = AudioQueueAllocateBuffer(audio_queue, buffer_size, &buffers[i]);
         if (status != noErr) {
-            fprintf(stderr, "Failed to allocate audio buffer %d\n", i);
-            audio_cleanup();
+            fprintf(stderr, "Failed to allocate audio buffer %u\n", i);
             return -1;
         }
         
@@ -103,89 +163,128 @@ int audio_init(uint32_t sr) {
     status = AudioQueueStart(audio_queue, NULL);
     if (status != noErr) {
         fprintf(stderr, "Failed to start audio queue\n");
-        audio_cleanup();
         return -1;
     }
     
-    memset(active_sounds, 0, sizeof(active_sounds));
-    initialized = true;
+    // A buffer is rendered one full queue ahead of playback, plus one
+    // buffer of scheduling delay for timestamped events
+    double buffer_ms = buffer_frames * 1000.0 / sample_rate;
+    printf("[AUDIO] Audio queue: %u x %u-frame buffers, input-to-output latency %.1f ms "
+           "(schedule %.1f + queue %.1f)\n",
+           buffer_count, buffer_frames, (buffer_count + 1) * buffer_ms, buffer_ms, buffer_count * buffer_ms);
     return 0;
 }
 
-int audio_start_sound(const int16_t *samples, size_t sample_count, bool loop, bool hold) {
-    if (!initialized || samples == NULL || sample_count == 0) {
-        return -1;
+int audio_init(const audio_settings_t *settings) {
+    if (initialized) {
+        return 0;
     }
     
-    pthread_mutex_lock(&queue_mutex);
-    
-    // Find an empty slot or reuse an existing one with the same data
-    int slot = -1;
-    for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-        if (active_sounds[i].data == samples) {
-            // Same sound - restart it
-            slot = i;
-            break;
-        }
-        if (slot == -1 && !active_sounds[i].is_active) {
-            slot = i;
-        }
+    sample_rate = settings->sample_rate;
+    output = settings->output;
+    buffer_frames = settings->buffer_frames;
+    if (buffer_frames == 0) {
+        buffer_frames = output == AUDIO_OUTPUT_QUEUE ? DEFAULT_QUEUE_FRAMES : DEFAULT_UNIT_FRAMES;
+    }
+    buffer_count = settings->buffer_count ? settings->buffer_count : DEFAULT_QUEUE_COUNT;
+    if (buffer_count > MAX_QUEUE_BUFFERS) {
+        buffer_count = MAX_QUEUE_BUFFERS;
     }
     
-    if (slot == -1) {
-        // All slots full - find oldest sound to replace
-        slot = 0;
-        for (int i = 1; i < MAX_ACTIVE_SOUNDS; i++) {
-            if (active_sounds[i].position > active_sounds[slot].position) {
-                slot = i;
-            }
-        }
+    // Must exist before the first callback can run
+    if (mixer_init(sample_rate, settings->max_voices, settings->steal_policy) != 0) {
+        return -1;
     }
+    next_sample_time = -1;
     
-    active_sound_t *sound = &active_sounds[slot];
-    sound->data = samples;
-    sound->length = sample_count;
-    sound->position = 0;
-    sound->is_active = true;
-    sound->is_looping = loop;
-    sound->is_hold = hold;
+    AudioStreamBasicDescription format = {0};
+    format.mSampleRate = sample_rate;
+    format.mFormatID = kAudioFormatLinearPCM;
+    format.mFormatFlags = kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
+    format.mBytesPerPacket = 2;
+    format.mFramesPerPacket = 1;
+    format.mBytesPerFrame = 2;
+    format.mChannelsPerFrame = 1;
+    format.mBitsPerChannel = 16;
     
-    pthread_mutex_unlock(&queue_mutex);
+    // Marked initialized first so audio_cleanup() can tear down a partial start
+    initialized = true;
+    int result = output == AUDIO_OUTPUT_QUEUE ? start_queue(&format) : start_unit(&format);
+    if (result != 0) {
+        audio_cleanup();
+        return -1;
+    }
     return 0;
 }
 
-int audio_stop_sound(const int16_t *samples) {
-    if (!initialized || samples == NULL) {
+voice_handle_t audio_start_sound(const int16_t *samples, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_voice(samples, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_adpcm(blocks, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_stream(stream, gain, loop, hold);
+}
+
+int audio_stop_sound(voice_handle_t voice) {
+    if (!initialized) {
         return -1;
     }
-    
-    pthread_mutex_lock(&queue_mutex);
-    
-    for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-        if (active_sounds[i].data == samples && active_sounds[i].is_active) {
-            if (active_sounds[i].is_hold) {
-                // For hold mode, stop immediately
-                active_sounds[i].is_active = false;
-            } else if (active_sounds[i].is_looping) {
-                // For loop mode, stop immediately (toggle off)
-                active_sounds[i].is_active = false;
-                active_sounds[i].is_looping = false;
-            } else {
-                // For oneshot mode, stop immediately
-                active_sounds[i].is_active = false;
-            }
-            pthread_mutex_unlock(&queue_mutex);
-            return 0;
-        }
+    return mixer_stop_voice(voice);
+}
+
+bool audio_sound_active(voice_handle_t voice) {
+    if (!initialized) {
+        return false;
     }
-    
-    pthread_mutex_unlock(&queue_mutex);
-    return -1; // Sound not found
+    return mixer_voice_active(voice);
+}
+
+int audio_retrigger_sound(voice_handle_t voice) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_retrigger_voice(voice);
+}
+
+int audio_set_sound_gain(voice_handle_t voice, float gain) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_set_voice_gain(voice, gain);
+}
+
+int audio_extend_sound(voice_handle_t voice, const int16_t *samples, size_t sample_count) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_extend_voice(voice, samples, sample_count);
+}
+
+void audio_schedule(uint64_t timestamp_ns) {
+    if (!initialized) {
+        return;
+    }
+    mixer_schedule(timestamp_ns);
 }
 
 int audio_play_sample(const int16_t *samples, size_t sample_count) {
     // Legacy function - just start a oneshot sound
-    return audio_start_sound(samples, sample_count, false, false);
+    return audio_start_sound(samples, sample_count, sample_rate, 1.0f, false, false) != VOICE_HANDLE_INVALID ? 0 : -1;
 }
 
 void audio_cleanup(void) {
@@ -193,12 +292,20 @@ void audio_cleanup(void) {
         return;
     }
     
+    if (output_unit != NULL) {
+        AudioOutputUnitStop(output_unit);
+        AudioUnitUninitialize(output_unit);
+        AudioComponentInstanceDispose(output_unit);
+        output_unit = NULL;
+    }
+    
     if (audio_queue != NULL) {
         AudioQueueStop(audio_queue, true);
         
-        for (int i = 0; i < 3; i++) {
+        for (uint32_t i = 0; i < buffer_count; i++) {
             if (buffers[i] != NULL) {
                 AudioQueueFreeBuffer(audio_queue, buffers[i]);
+                buffers[i] = NULL;
             }
         }
         
@@ -206,8 +313,8 @@ void audio_cleanup(void) {
         audio_queue = NULL;
     }
     
-    memset(active_sounds, 0, sizeof(active_sounds));
-    pthread_mutex_destroy(&queue_mutex);
+    // Both outputs stop synchronously, so the render thread is gone
+    mixer_cleanup();
     initialized = false;
 }
 
@@ -1,10 +1,13 @@
 #ifdef __APPLE__
 
 #include "../midi.h"
+#include "../../midi_queue.h"
+#include "../../monotonic_clock.h"
 #include <CoreMIDI/CoreMIDI.h>
+#include <mach/mach_time.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <string.h>
 
 #define MAX_MIDI_SOURCES 32
 
@@ -12,46 +15,54 @@ static MIDIClientRef midi_client = 0;
 static MIDIPortRef input_port = 0;
 static MIDIEndpointRef sources[MAX_MIDI_SOURCES] = {0};
 static ItemCount source_count = 0;
-static midi_event_t pending_event = {0};
-static bool has_pending_event = false;
-static pthread_mutex_t event_mutex = PTHREAD_MUTEX_INITIALIZER;
+// CoreMIDI delivers every source on the port's single input thread, so the
+// queue has exactly one producer. Each source keeps its own running status.
+static midi_queue_t event_queue;
+static midi_parser_t parsers[MAX_MIDI_SOURCES];
+static mach_timebase_info_data_t timebase;
+
+// Converts a packet's host time stamp (mach_absolute_time() units; 0 = now)
+// to the clock_now_ns() timebase the rest of the app uses
+static uint64_t packet_time_ns(MIDITimeStamp stamp) {
+    uint64_t now_ns = clock_now_ns();
+    uint64_t host_now = mach_absolute_time();
+    if (stamp == 0 || stamp >= host_now) {
+        return now_ns;
+    }
+    uint64_t age_ns = (host_now - stamp) * timebase.numer / timebase.denom;
+    return age_ns < now_ns ? now_ns - age_ns : now_ns;
+}
 
 static void midi_read_proc(const MIDIPacketList *pktlist, void *refCon, void *connRefCon) {
     (void)refCon;
-    (void)connRefCon;
     
+    midi_parser_t *parser = &parsers[(uintptr_t)connRefCon];
     const MIDIPacket *packet = &pktlist->packet[0];
     
     for (UInt32 i = 0; i < pktlist->numPackets; i++) {
-        if (packet->length >= 3) {
-            uint8_t status = packet->data[0];
-            uint8_t note = packet->data[1];
-            uint8_t velocity = packet->data[2];
-            
-            // Check if it's a note on or note off message
-            uint8_t message_type = status & 0xF0;
-            
-            if (message_type == 0x90 || message_type == 0x80) {
-                // Thread-safe write to pending event
-                pthread_mutex_lock(&event_mutex);
-                pending_event.note = note;
-                pending_event.velocity = velocity;
-                pending_event.is_on = (message_type == 0x90 && velocity > 0);
-                has_pending_event = true;
-                pthread_mutex_unlock(&event_mutex);
-            }
-        }
-        
+        // A packet may hold several messages; all of them are queued
+        midi_parser_feed(parser, packet->data, packet->length, packet_time_ns(packet->timeStamp),
+                         &event_queue);
         packet = MIDIPacketNext(packet);
     }
 }
 
-int midi_init(void) {
+int midi_init(const char *source) {
+    (void)source; // Every CoreMIDI source is connected
     OSStatus status;
     
+    // Must exist before the first callback
+    if (midi_queue_init(&event_queue, MIDI_QUEUE_SIZE) != 0) {
+        fprintf(stderr, "[MIDI] Failed to allocate event queue\n");
+        return -1;
+    }
+    memset(parsers, 0, sizeof(parsers));
+    mach_timebase_info(&timebase);
+    
     status = MIDIClientCreate(CFSTR("MIDI Soundboard"), NULL, NULL, &midi_client);
     if (status != noErr) {
         fprintf(stderr, "Failed to create MIDI client\n");
+        midi_queue_free(&event_queue);
         return -1;
     }
     
@@ -59,6 +70,7 @@ int midi_init(void) {
     if (status != noErr) {
         fprintf(stderr, "Failed to create MIDI input port\n");
         MIDIClientDispose(midi_client);
+        midi_queue_free(&event_queue);
         return -1;
     }
     
@@ -70,6 +82,7 @@ int midi_init(void) {
         fprintf(stderr, "[MIDI] ERROR: No MIDI sources found\n");
         MIDIPortDispose(input_port);
         MIDIClientDispose(midi_client);
+        midi_queue_free(&event_queue);
         return -1;
     }
     
@@ -94,7 +107,8 @@ int midi_init(void) {
         
         printf("[MIDI] Connecting to source %u: %s\n", (unsigned int)i, nameBuf);
         
-        status = MIDIPortConnectSource(input_port, src, NULL);
+        // The connection refCon selects this source's parser
+        status = MIDIPortConnectSource(input_port, src, (void *)(uintptr_t)source_count);
         if (status != noErr) {
             fprintf(stderr, "[MIDI] WARNING: Failed to connect to source %u: %s (status=%d)\n", 
                     (unsigned int)i, nameBuf, (int)status);
@@ -113,6 +127,7 @@ int midi_init(void) {
         fprintf(stderr, "[MIDI] ERROR: Failed to connect to any MIDI sources\n");
         MIDIPortDispose(input_port);
         MIDIClientDispose(midi_client);
+        midi_queue_free(&event_queue);
         return -1;
     }
     
@@ -125,16 +140,26 @@ int midi_read(midi_event_t *event) {
         return -1;
     }
     
-    pthread_mutex_lock(&event_mutex);
-    if (has_pending_event) {
-        *event = pending_event;
-        has_pending_event = false;
-        pthread_mutex_unlock(&event_mutex);
+    return midi_queue_pop_batch(&event_queue, event, 1) == 1 ? 0 : 1; // 1 = no event available
+}
+
+int midi_wait(uint32_t timeout_ms) {
+    return midi_queue_wait(&event_queue, timeout_ms) ? 0 : 1;
+}
+
+void midi_wake(void) {
+    midi_queue_notify(&event_queue);
+}
+
+size_t midi_read_batch(midi_event_t *events, size_t max) {
+    if (events == NULL) {
         return 0;
     }
-    pthread_mutex_unlock(&event_mutex);
-    
-    return 1; // No event available
+    return midi_queue_pop_batch(&event_queue, events, max);
+}
+
+uint32_t midi_overflow_count(void) {
+    return midi_queue_overflows(&event_queue);
 }
 
 void midi_cleanup(void) {
@@ -164,11 +189,8 @@ void midi_cleanup(void) {
     }
     source_count = 0;
     
-    pthread_mutex_lock(&event_mutex);
-    has_pending_event = false;
-    pthread_mutex_unlock(&event_mutex);
-    
-    pthread_mutex_destroy(&event_mutex);
+    // Disposing the client stops the callbacks
+    midi_queue_free(&event_queue);
 }
 
 #endif // __APPLE__
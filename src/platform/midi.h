@@ -3,9 +3,20 @@
 
 #include "../midi_soundboard.h"
 
-// Platform-specific MIDI implementation
-int midi_init(void);
+// Platform-specific MIDI implementation. source names the input where the
+// backend has a choice (NULL = backend default).
+int midi_init(const char *source);
 int midi_read(midi_event_t *event);
+// Sleeps until MIDI input arrives or timeout_ms passes. Returns 0 if events
+// may be ready, 1 on timeout.
+int midi_wait(uint32_t timeout_ms);
+// Wakes a midi_wait() in progress (or the next one) early, for work queued
+// by another thread. Safe to call from any thread.
+void midi_wake(void);
+// Drains up to max queued events in arrival order; returns the count
+size_t midi_read_batch(midi_event_t *events, size_t max);
+// Events dropped because the main loop fell behind
+uint32_t midi_overflow_count(void);
 void midi_cleanup(void);
 
 #endif // PLATFORM_MIDI_H
@@ -0,0 +1,120 @@
+#ifdef SOUNDBOARD_OFFLINE
+
+#include "../audio.h"
+#include "audio_offline.h"
+#include "../../mixer.h"
+#include <stdio.h>
+
+static uint32_t sample_rate = 44100;
+static bool initialized = false;
+
+int audio_init(const audio_settings_t *settings) {
+    if (initialized) {
+        return 0;
+    }
+
+    // Buffer sizes and the output device don't apply; the renderer picks
+    // its own block size
+    sample_rate = settings->sample_rate;
+    if (mixer_init(sample_rate, settings->max_voices, settings->steal_policy) != 0) {
+        return -1;
+    }
+    printf("[AUDIO] Offline: rendering at %u Hz on a virtual clock\n", sample_rate);
+    initialized = true;
+    return 0;
+}
+
+uint64_t audio_offline_frame_for_time(uint64_t timestamp_ns) {
+    // Split so hours of timestamps can't overflow the multiplication
+    return timestamp_ns / 1000000000ull * sample_rate +
+           timestamp_ns % 1000000000ull * sample_rate / 1000000000ull;
+}
+
+void audio_offline_render(int16_t *output, size_t frame_count) {
+    if (!initialized) {
+        return;
+    }
+    mixer_render(output, frame_count);
+}
+
+voice_handle_t audio_start_sound(const int16_t *samples, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_voice(samples, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_adpcm(const uint8_t *blocks, size_t sample_count, uint32_t source_rate,
+                                 float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_adpcm(blocks, sample_count, source_rate, gain, loop, hold);
+}
+
+voice_handle_t audio_start_stream(sound_stream_t *stream, float gain, bool loop, bool hold) {
+    if (!initialized) {
+        return VOICE_HANDLE_INVALID;
+    }
+    return mixer_start_stream(stream, gain, loop, hold);
+}
+
+int audio_stop_sound(voice_handle_t voice) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_stop_voice(voice);
+}
+
+bool audio_sound_active(voice_handle_t voice) {
+    if (!initialized) {
+        return false;
+    }
+    return mixer_voice_active(voice);
+}
+
+int audio_retrigger_sound(voice_handle_t voice) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_retrigger_voice(voice);
+}
+
+int audio_set_sound_gain(voice_handle_t voice, float gain) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_set_voice_gain(voice, gain);
+}
+
+int audio_extend_sound(voice_handle_t voice, const int16_t *samples, size_t sample_count) {
+    if (!initialized) {
+        return -1;
+    }
+    return mixer_extend_voice(voice, samples, sample_count);
+}
+
+void audio_schedule(uint64_t timestamp_ns) {
+    if (!initialized) {
+        return;
+    }
+    // Virtual time: no render-call delay is needed, the caller renders up
+    // to each event before sending it
+    mixer_schedule_frame(timestamp_ns != 0 ? audio_offline_frame_for_time(timestamp_ns) : 0);
+}
+
+int audio_play_sample(const int16_t *samples, size_t sample_count) {
+    // Legacy function - just start a oneshot sound
+    return audio_start_sound(samples, sample_count, sample_rate, 1.0f, false, false) != VOICE_HANDLE_INVALID ? 0 : -1;
+}
+
+void audio_cleanup(void) {
+    if (!initialized) {
+        return;
+    }
+    mixer_cleanup();
+    initialized = false;
+}
+
+#endif // SOUNDBOARD_OFFLINE
@@ -0,0 +1,19 @@
+#ifndef PLATFORM_AUDIO_OFFLINE_H
+#define PLATFORM_AUDIO_OFFLINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Offline backend (SOUNDBOARD_OFFLINE): there is no device and no render
+// thread. The caller drives the mixer with audio_offline_render() and
+// timestamps are virtual, in nanoseconds from frame 0 rather than on the
+// monotonic clock, so a performance renders identically every time.
+
+// Output frame that timestamp_ns falls on
+uint64_t audio_offline_frame_for_time(uint64_t timestamp_ns);
+
+// Mixes the next frame_count frames; called from the control thread, which
+// takes the render thread's place
+void audio_offline_render(int16_t *output, size_t frame_count);
+
+#endif // PLATFORM_AUDIO_OFFLINE_H
@@ -0,0 +1,38 @@
+#ifdef SOUNDBOARD_OFFLINE
+
+#include "../midi.h"
+
+// The offline renderer reads its events from a file and dispatches them
+// itself, so there is no live input
+
+int midi_init(const char *source) {
+    (void)source;
+    return 0;
+}
+
+int midi_read(midi_event_t *event) {
+    return event == NULL ? -1 : 1; // 1 = no event available
+}
+
+int midi_wait(uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return 1;
+}
+
+void midi_wake(void) {
+}
+
+size_t midi_read_batch(midi_event_t *events, size_t max) {
+    (void)events;
+    (void)max;
+    return 0;
+}
+
+uint32_t midi_overflow_count(void) {
+    return 0;
+}
+
+void midi_cleanup(void) {
+}
+
+#endif // SOUNDBOARD_OFFLINE
@@ -1,13 +1,21 @@
 #ifndef PLATFORM_H
 #define PLATFORM_H
 
-// Platform detection and header includes
-#if defined(__APPLE__)
+// Platform detection and header includes. The offline renderer replaces the
+// device backends on any host.
+#if defined(SOUNDBOARD_OFFLINE)
+    #include "midi.h"
+    #include "audio.h"
+    #include "offline/audio_offline.h"
+#elif defined(__APPLE__)
     #include "midi.h"
     #include "audio.h"
 #elif defined(ESP_PLATFORM)
     #include "midi.h"
     #include "audio.h"
+#elif defined(__linux__)
+    #include "midi.h"
+    #include "audio.h"
 #else
     #error "Unsupported platform"
 #endif
@@ -0,0 +1,83 @@
+#include "resampler.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define SINC_HALF_TAPS 16           // Taps on each side of the interpolation point
+#define SINC_TAPS (2 * SINC_HALF_TAPS)
+#define SINC_PHASES 256             // Fractional positions in the polyphase table
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Row p holds the kernel evaluated at (k - p / SINC_PHASES) for
+// k = -SINC_HALF_TAPS + 1 .. SINC_HALF_TAPS.
+static void build_table(float table[SINC_PHASES + 1][SINC_TAPS], double cutoff) {
+    for (int p = 0; p <= SINC_PHASES; p++) {
+        double frac = (double)p / SINC_PHASES;
+        for (int t = 0; t < SINC_TAPS; t++) {
+            double x = (double)(t - SINC_HALF_TAPS + 1) - frac;
+            double sinc = x == 0.0 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+            double w = (x + SINC_HALF_TAPS) / (2.0 * SINC_HALF_TAPS); // 0..1 across the window
+            double window = 0.42 - 0.5 * cos(2.0 * M_PI * w) + 0.08 * cos(4.0 * M_PI * w);
+            if (w < 0.0 || w > 1.0) {
+                window = 0.0;
+            }
+            table[p][t] = (float)(cutoff * sinc * window);
+        }
+    }
+}
+
+int resample_sinc(const int16_t *in, size_t in_count, uint32_t in_rate, uint32_t out_rate,
+                  int16_t **out, size_t *out_count) {
+    if (in == NULL || in_count == 0 || in_rate == 0 || out_rate == 0 || out == NULL || out_count == NULL) {
+        return -1;
+    }
+
+    size_t count = (size_t)(((uint64_t)in_count * out_rate + in_rate - 1) / in_rate);
+    int16_t *buffer = malloc(count * sizeof(int16_t));
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    // Below the source rate the kernel's cutoff must drop to the new Nyquist
+    double cutoff = out_rate < in_rate ? (double)out_rate / in_rate : 1.0;
+    cutoff *= 0.97; // Leave room for the transition band
+
+    float (*table)[SINC_TAPS] = malloc(sizeof(float[SINC_PHASES + 1][SINC_TAPS]));
+    if (table == NULL) {
+        free(buffer);
+        return -1;
+    }
+    build_table(table, cutoff);
+
+    for (size_t n = 0; n < count; n++) {
+        // Exact rational source position: index + rem / out_rate
+        uint64_t num = (uint64_t)n * in_rate;
+        int64_t index = (int64_t)(num / out_rate);
+        double frac = (double)(num % out_rate) / out_rate;
+
+        double phase = frac * SINC_PHASES;
+        int p = (int)phase;
+        float mix = (float)(phase - p);
+        const float *row0 = table[p];
+        const float *row1 = table[p + 1];
+
+        float acc = 0.0f;
+        int64_t first = index - SINC_HALF_TAPS + 1;
+        for (int t = 0; t < SINC_TAPS; t++) {
+            int64_t k = first + t;
+            if (k < 0 || k >= (int64_t)in_count) continue;
+            float h = row0[t] + (row1[t] - row0[t]) * mix;
+            acc += (float)in[k] * h;
+        }
+
+        acc = acc > 32767.0f ? 32767.0f : (acc < -32768.0f ? -32768.0f : acc);
+        buffer[n] = (int16_t)lrintf(acc);
+    }
+
+    free(table);
+    *out = buffer;
+    *out_count = count;
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// High-quality offline sample-rate conversion (windowed sinc, Blackman window,
+// polyphase table with linear phase interpolation). Used at load time for
+// sounds configured with "resample": "load".
+// On success *out is a newly malloc'd buffer of *out_count samples.
+int resample_sinc(const int16_t *in, size_t in_count, uint32_t in_rate, uint32_t out_rate,
+                  int16_t **out, size_t *out_count);
+
+#endif // RESAMPLER_H
@@ -0,0 +1,412 @@
+#include "sample_cache.h"
+#include "async_log.h"
+#include "resampler.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define RELOAD_QUEUE_SIZE 64
+// Extra source frames decoded past the attack so the resampler's filter
+// sees the same input it does for the whole sound
+#define ATTACK_MARGIN_FRAMES 64
+
+typedef struct {
+    soundbite_t *soundbite;
+    audio_data_t audio;
+    int result;
+} reload_t;
+
+// cache_mutex guards everything below. The reload thread holds it only to
+// take requests and hand back results, never while decoding.
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reload_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t reload_thread;
+static bool reload_running = false;
+static bool reload_stop = false;
+
+static size_t budget_bytes = 0;
+static uint32_t attack_ms = SAMPLE_CACHE_DEFAULT_ATTACK_MS;
+static size_t resident_bytes = 0;
+static soundbite_t **tracked = NULL;
+static size_t tracked_count = 0;
+static size_t tracked_capacity = 0;
+static uint64_t use_clock = 0;
+static sample_cache_stats_t counters;
+
+// Requests are taken in order; finished reloads wait for sample_cache_poll()
+static reload_t requests[RELOAD_QUEUE_SIZE];
+static size_t request_count = 0;
+static reload_t done[RELOAD_QUEUE_SIZE];
+static size_t done_count = 0;
+static size_t reloading = 0;            // Requested and not yet attached
+
+// ---------------------------------------------------------------------------
+// Reload thread
+// ---------------------------------------------------------------------------
+
+static void *reload_thread_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&cache_mutex);
+    while (!reload_stop) {
+        if (request_count == 0 || done_count == RELOAD_QUEUE_SIZE) {
+            pthread_cond_wait(&reload_wake, &cache_mutex);
+            continue;
+        }
+        reload_t job = requests[0];
+        request_count--;
+        memmove(requests, requests + 1, request_count * sizeof(requests[0]));
+
+        // A soundbite with a reload pending is neither evicted nor freed, so
+        // its path stays valid while we decode
+        pthread_mutex_unlock(&cache_mutex);
+        job.result = sample_cache_decode(job.soundbite->source_path, job.soundbite->resample, 0, &job.audio);
+        pthread_mutex_lock(&cache_mutex);
+
+        done[done_count++] = job;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+int sample_cache_init(size_t budget, uint32_t attack) {
+    pthread_mutex_lock(&cache_mutex);
+    budget_bytes = budget;
+    attack_ms = attack > 0 ? attack : SAMPLE_CACHE_DEFAULT_ATTACK_MS;
+    resident_bytes = 0;
+    use_clock = 0;
+    memset(&counters, 0, sizeof(counters));
+    request_count = 0;
+    done_count = 0;
+    reloading = 0;
+    reload_stop = false;
+    int result = 0;
+    if (budget_bytes > 0 && !reload_running) {
+        if (pthread_create(&reload_thread, NULL, reload_thread_main, NULL) == 0) {
+            reload_running = true;
+        } else {
+            fprintf(stderr, "[CACHE] Failed to start the reload thread\n");
+            budget_bytes = 0;
+            result = -1;
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+
+    if (budget_bytes > 0) {
+        printf("[CACHE] Budget %zu MB, %u ms attacks kept in memory\n", budget_bytes >> 20, attack_ms);
+    }
+    return result;
+}
+
+void sample_cache_shutdown(void) {
+    pthread_mutex_lock(&cache_mutex);
+    reload_stop = true;
+    pthread_cond_signal(&reload_wake);
+    bool running = reload_running;
+    pthread_mutex_unlock(&cache_mutex);
+    if (running) {
+        pthread_join(reload_thread, NULL);
+    }
+
+    pthread_mutex_lock(&cache_mutex);
+    reload_running = false;
+    for (size_t i = 0; i < done_count; i++) {
+        audio_free(&done[i].audio);
+        done[i].soundbite->reload_pending = false;
+    }
+    for (size_t i = 0; i < request_count; i++) {
+        requests[i].soundbite->reload_pending = false;
+    }
+    done_count = 0;
+    request_count = 0;
+    reloading = 0;
+    free(tracked);
+    tracked = NULL;
+    tracked_count = 0;
+    tracked_capacity = 0;
+    budget_bytes = 0;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+bool sample_cache_enabled(void) {
+    pthread_mutex_lock(&cache_mutex);
+    bool enabled = budget_bytes > 0;
+    pthread_mutex_unlock(&cache_mutex);
+    return enabled;
+}
+
+size_t sample_cache_attack_frames(uint32_t sample_rate) {
+    return (size_t)sample_rate * attack_ms / 1000;
+}
+
+// ---------------------------------------------------------------------------
+// Loader threads
+// ---------------------------------------------------------------------------
+
+bool sample_cache_reserve(size_t bytes) {
+    pthread_mutex_lock(&cache_mutex);
+    bool fits = budget_bytes > 0 && resident_bytes + bytes <= budget_bytes;
+    if (fits) {
+        resident_bytes += bytes;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return fits;
+}
+
+void sample_cache_unreserve(size_t bytes) {
+    pthread_mutex_lock(&cache_mutex);
+    resident_bytes -= bytes < resident_bytes ? bytes : resident_bytes;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+// Decodes the source frames behind max_frames of output
+static int decode_start(const char *path, resample_mode_t resample, size_t max_frames, audio_data_t *audio) {
+    audio_decoder_t *decoder;
+    audio_stream_info_t info;
+    if (audio_decoder_open(path, &decoder, &info) != 0) {
+        return -1;
+    }
+    if (resample == RESAMPLE_AT_LOAD && info.sample_rate != SOUNDBOARD_SAMPLE_RATE) {
+        max_frames = (size_t)((uint64_t)max_frames * info.sample_rate / SOUNDBOARD_SAMPLE_RATE) +
+                     ATTACK_MARGIN_FRAMES;
+    }
+    if (info.frame_count > 0 && max_frames > info.frame_count) {
+        max_frames = info.frame_count;
+    }
+
+    int16_t *data = malloc(max_frames * sizeof(int16_t));
+    if (data == NULL) {
+        audio_decoder_close(decoder);
+        return -1;
+    }
+    size_t got = 0;
+    while (got < max_frames) {
+        size_t n = audio_decoder_read(decoder, data + got, max_frames - got);
+        if (n == 0) {
+            break;
+        }
+        got += n;
+    }
+    audio_decoder_close(decoder);
+    if (got == 0) {
+        free(data);
+        return -1;
+    }
+
+    audio->data = data;
+    audio->sample_count = got;
+    audio->sample_rate = info.sample_rate;
+    audio->channels = 1;
+    return 0;
+}
+
+int sample_cache_decode(const char *path, resample_mode_t resample, size_t max_frames, audio_data_t *audio) {
+    if (path == NULL || audio == NULL) {
+        return -1;
+    }
+    memset(audio, 0, sizeof(*audio));
+
+    int result = max_frames == 0 ? audio_load_file(path, audio) : decode_start(path, resample, max_frames, audio);
+    if (result != 0) {
+        return -1;
+    }
+
+    if (resample == RESAMPLE_AT_LOAD && audio->sample_rate != SOUNDBOARD_SAMPLE_RATE) {
+        int16_t *converted;
+        size_t converted_count;
+        if (resample_sinc(audio->data, audio->sample_count, audio->sample_rate, SOUNDBOARD_SAMPLE_RATE,
+                          &converted, &converted_count) != 0) {
+            audio_free(audio);
+            return -1;
+        }
+        free(audio->data);
+        audio->data = converted;
+        audio->sample_count = converted_count;
+        audio->sample_rate = SOUNDBOARD_SAMPLE_RATE;
+    }
+
+    // The buffer is left at its decoded size; only the count is trimmed
+    if (max_frames > 0 && audio->sample_count > max_frames) {
+        audio->sample_count = max_frames;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Soundboard
+// ---------------------------------------------------------------------------
+
+// Returns tracked_count if sb isn't tracked
+static size_t find_tracked(const soundbite_t *sb) {
+    size_t i = 0;
+    while (i < tracked_count && tracked[i] != sb) {
+        i++;
+    }
+    return i;
+}
+
+void sample_cache_track(soundbite_t *sb) {
+    if (sb == NULL || !sb->evictable) {
+        return;
+    }
+    pthread_mutex_lock(&cache_mutex);
+    if (tracked_count == tracked_capacity) {
+        size_t capacity = tracked_capacity ? tracked_capacity * 2 : 128;
+        soundbite_t **grown = realloc(tracked, capacity * sizeof(*grown));
+        if (grown == NULL) {
+            // Untracked sounds are never evicted; their bytes stay charged
+            pthread_mutex_unlock(&cache_mutex);
+            return;
+        }
+        tracked = grown;
+        tracked_capacity = capacity;
+    }
+    tracked[tracked_count++] = sb;
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+void sample_cache_forget(soundbite_t *sb) {
+    if (sb == NULL || !sb->evictable) {
+        return;
+    }
+    pthread_mutex_lock(&cache_mutex);
+    size_t index = find_tracked(sb);
+    if (index < tracked_count) {
+        tracked[index] = tracked[--tracked_count];
+        if (sb->body != NULL) {
+            resident_bytes -= sb->cache_bytes < resident_bytes ? sb->cache_bytes : resident_bytes;
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+// ---------------------------------------------------------------------------
+// Control thread
+// ---------------------------------------------------------------------------
+
+void sample_cache_touch(soundbite_t *sb) {
+    if (sb == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache_mutex);
+    sb->last_used = ++use_clock;
+    if (sb->evictable) {
+        if (sb->body != NULL) {
+            counters.hits++;
+        } else {
+            counters.misses++;
+            if (!sb->reload_pending && request_count < RELOAD_QUEUE_SIZE) {
+                requests[request_count++] = (reload_t){ .soundbite = sb };
+                sb->reload_pending = true;
+                reloading++;
+                pthread_cond_signal(&reload_wake);
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+static bool voices_active(const soundbite_t *sb) {
+    for (int i = 0; i < SOUNDBITE_MAX_INSTANCES; i++) {
+        if (sb->voices[i] != VOICE_HANDLE_INVALID && audio_sound_active(sb->voices[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void attach_body(soundbite_t *sb, audio_data_t *audio) {
+    sb->body = audio->data;
+    sb->cache_bytes = audio->sample_count * sizeof(int16_t);
+    sb->data = sb->body;
+    sb->length = audio->sample_count;
+    resident_bytes += sb->cache_bytes;
+    counters.reloads++;
+
+    // Voices started on the attack carry on into the body
+    for (int i = 0; i < SOUNDBITE_MAX_INSTANCES; i++) {
+        if (sb->voices[i] != VOICE_HANDLE_INVALID && audio_sound_active(sb->voices[i])) {
+            audio_extend_sound(sb->voices[i], sb->body, sb->length);
+        }
+    }
+}
+
+static void evict_body(soundbite_t *sb) {
+    sb->data = sb->attack;
+    sb->length = sb->attack_length;
+    free(sb->body);
+    sb->body = NULL;
+    resident_bytes -= sb->cache_bytes < resident_bytes ? sb->cache_bytes : resident_bytes;
+    counters.evictions++;
+}
+
+void sample_cache_poll(void) {
+    pthread_mutex_lock(&cache_mutex);
+    if (budget_bytes == 0) {
+        pthread_mutex_unlock(&cache_mutex);
+        return;
+    }
+
+    bool drained = done_count > 0;
+    for (size_t i = 0; i < done_count; i++) {
+        reload_t *reload = &done[i];
+        soundbite_t *sb = reload->soundbite;
+        sb->reload_pending = false;
+        reloading--;
+        if (find_tracked(sb) == tracked_count || reload->result != 0 || sb->body != NULL ||
+            reload->audio.sample_count <= sb->attack_length) {
+            if (reload->result != 0) {
+                LOG_ERROR("[CACHE] Failed to reload %s\n", sb->source_path);
+            }
+            audio_free(&reload->audio);
+            continue;
+        }
+        attach_body(sb, &reload->audio);
+    }
+    done_count = 0;
+    if (drained) {
+        pthread_cond_signal(&reload_wake);
+    }
+
+    // Least recently played first; a body still under a voice stays
+    while (resident_bytes > budget_bytes) {
+        soundbite_t *victim = NULL;
+        for (size_t i = 0; i < tracked_count; i++) {
+            soundbite_t *sb = tracked[i];
+            if (sb->body == NULL || sb->reload_pending || voices_active(sb)) {
+                continue;
+            }
+            if (victim == NULL || sb->last_used < victim->last_used) {
+                victim = sb;
+            }
+        }
+        if (victim == NULL) {
+            break;
+        }
+        evict_body(victim);
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+bool sample_cache_reloading(void) {
+    pthread_mutex_lock(&cache_mutex);
+    bool pending = reloading > 0;
+    pthread_mutex_unlock(&cache_mutex);
+    return pending;
+}
+
+void sample_cache_get_stats(sample_cache_stats_t *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache_mutex);
+    *stats = counters;
+    stats->resident_bytes = resident_bytes;
+    stats->budget_bytes = budget_bytes;
+    pthread_mutex_unlock(&cache_mutex);
+}
@@ -0,0 +1,64 @@
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "audio_loader.h"
+#include "midi_soundboard.h"
+
+// Memory budget for decoded sounds. With a budget set, the loader decodes
+// whole sounds only while they fit and keeps just the attack (the first
+// cache_attack_ms) of the rest. Playing a sound whose body is not in memory
+// starts it on the attack and reloads the body on a background thread; the
+// voice is switched over to the body once it arrives. When the budget is
+// exceeded, the least recently played bodies that no voice is using are
+// evicted back to their attack.
+//
+// Sounds played from the mapped sound bank or streamed from disk are backed
+// by files and are not counted. Without a budget nothing is evicted.
+
+#define SAMPLE_CACHE_DEFAULT_ATTACK_MS 200
+
+typedef struct {
+    uint32_t hits;               // Plays with the body in memory
+    uint32_t misses;             // Plays that started on the attack
+    uint32_t evictions;
+    uint32_t reloads;            // Bodies brought back after a miss
+    size_t resident_bytes;
+    size_t budget_bytes;
+} sample_cache_stats_t;
+
+// budget_bytes of 0 turns the cache off
+int sample_cache_init(size_t budget_bytes, uint32_t attack_ms);
+// Stops the reload thread; call before the soundbites are freed
+void sample_cache_shutdown(void);
+bool sample_cache_enabled(void);
+size_t sample_cache_attack_frames(uint32_t sample_rate);
+
+// Loader threads: claims bytes of the budget for a whole sound. Returns false
+// if it doesn't fit.
+bool sample_cache_reserve(size_t bytes);
+void sample_cache_unreserve(size_t bytes);
+
+// Decodes path and converts it to the output rate if resample asks for it.
+// max_frames > 0 stops after that many frames of output.
+int sample_cache_decode(const char *path, resample_mode_t resample, size_t max_frames, audio_data_t *audio);
+
+// Soundboard: sb was registered / is being replaced or freed
+void sample_cache_track(soundbite_t *sb);
+void sample_cache_forget(soundbite_t *sb);
+
+// Control thread: sb is about to be played. Counts a hit or a miss and
+// queues the reload on a miss.
+void sample_cache_touch(soundbite_t *sb);
+// Control thread, called regularly: attaches reloaded bodies (moving their
+// playing voices over) and evicts down to the budget
+void sample_cache_poll(void);
+// Control thread: true while a reload is waiting to be attached by
+// sample_cache_poll(); the caller should poll again soon
+bool sample_cache_reloading(void);
+
+void sample_cache_get_stats(sample_cache_stats_t *stats);
+
+#endif // SAMPLE_CACHE_H
@@ -0,0 +1,340 @@
+#include "sound_stream.h"
+#include "async_log.h"
+#include "audio_loader.h"
+#include "monotonic_clock.h"
+#include "spsc_ring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STREAM_MAX 32
+#define IO_IDLE_NS 5000000          // Re-check interval while every ring is full
+#define UNDERRUN_REPORT_NS 1000000000ull
+
+typedef struct {
+    uint32_t epoch;
+    uint32_t frames;
+    int16_t samples[STREAM_CHUNK_FRAMES];
+} stream_chunk_t;
+
+struct sound_stream {
+    char *path;
+    int16_t *head;
+    size_t head_length;
+    size_t length;               // Total frames, head included
+    uint32_t sample_rate;
+    spsc_ring_t ring;            // I/O thread -> render thread
+
+    // Written by the control thread, read by the I/O thread
+    _Atomic uint32_t epoch;
+    _Atomic bool loop;
+    _Atomic bool active;
+
+    // I/O thread only
+    audio_decoder_t *decoder;
+    uint32_t io_epoch;
+    size_t io_position;          // Next frame to read ahead
+    uint32_t reported_underruns;
+    uint64_t reported_ns;
+
+    // Render thread only
+    stream_chunk_t current;
+    size_t current_offset;
+    bool has_current;
+
+    _Atomic uint32_t underruns;
+};
+
+// The I/O thread holds registry_mutex while it services streams, so
+// sound_stream_close() can't pull a stream out from under it. The control
+// and render threads never take it.
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t io_wake = PTHREAD_COND_INITIALIZER;
+static sound_stream_t *registry[STREAM_MAX];
+static size_t registry_count = 0;
+static pthread_t io_thread;
+static bool io_running = false;
+static bool io_stop = false;
+
+// ---------------------------------------------------------------------------
+// I/O thread
+// ---------------------------------------------------------------------------
+
+// Reads one chunk ahead if the stream needs it; returns true if it did
+static bool service_stream(sound_stream_t *stream) {
+    uint32_t underruns = atomic_load_explicit(&stream->underruns, memory_order_relaxed);
+    if (underruns != stream->reported_underruns) {
+        uint64_t now = clock_now_ns();
+        if (now - stream->reported_ns >= UNDERRUN_REPORT_NS) {
+            LOG_WARN("[STREAM] %u underrun(s) on %s\n", underruns, stream->path);
+            stream->reported_underruns = underruns;
+            stream->reported_ns = now;
+        }
+    }
+
+    uint32_t epoch = atomic_load(&stream->epoch);
+    if (epoch != stream->io_epoch) {
+        // New voice: it plays the head from memory while we refill from there
+        stream->io_epoch = epoch;
+        stream->io_position = stream->head_length;
+        if (audio_decoder_seek(stream->decoder, stream->head_length) != 0) {
+            LOG_ERROR("[STREAM] Failed to seek %s\n", stream->path);
+            atomic_store(&stream->active, false);
+        }
+    }
+
+    if (!atomic_load(&stream->active) || spsc_ring_count(&stream->ring) >= stream->ring.capacity) {
+        return false;
+    }
+
+    if (stream->io_position >= stream->length) {
+        if (!atomic_load(&stream->loop)) {
+            return false; // Everything up to the end is queued
+        }
+        // Next pass of the loop; the voice wraps to the head by itself
+        if (audio_decoder_seek(stream->decoder, stream->head_length) != 0) {
+            LOG_ERROR("[STREAM] Failed to seek %s\n", stream->path);
+            atomic_store(&stream->active, false);
+            return false;
+        }
+        stream->io_position = stream->head_length;
+    }
+
+    stream_chunk_t chunk;
+    size_t want = stream->length - stream->io_position;
+    if (want > STREAM_CHUNK_FRAMES) {
+        want = STREAM_CHUNK_FRAMES;
+    }
+    size_t got = 0;
+    while (got < want) {
+        size_t n = audio_decoder_read(stream->decoder, chunk.samples + got, want - got);
+        if (n == 0) {
+            break;
+        }
+        got += n;
+    }
+    // Compressed formats may decode slightly short of the reported length;
+    // pad so the voice's timeline always matches
+    memset(chunk.samples + got, 0, (want - got) * sizeof(int16_t));
+
+    chunk.epoch = epoch;
+    chunk.frames = (uint32_t)want;
+    stream->io_position += want;
+    spsc_ring_push(&stream->ring, &chunk); // Checked for space above; only we push
+    return true;
+}
+
+static void *io_thread_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&registry_mutex);
+    while (!io_stop) {
+        bool busy = false;
+        for (size_t i = 0; i < registry_count; i++) {
+            busy |= service_stream(registry[i]);
+        }
+
+        if (busy) {
+            // Let open/close in between passes
+            pthread_mutex_unlock(&registry_mutex);
+            pthread_mutex_lock(&registry_mutex);
+        } else {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += IO_IDLE_NS;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&io_wake, &registry_mutex, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Loader / control thread
+// ---------------------------------------------------------------------------
+
+static void free_stream(sound_stream_t *stream) {
+    audio_decoder_close(stream->decoder);
+    spsc_ring_free(&stream->ring);
+    free(stream->head);
+    free(stream->path);
+    free(stream);
+}
+
+sound_stream_t *sound_stream_open(const char *path) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    sound_stream_t *stream = calloc(1, sizeof(*stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    audio_stream_info_t info;
+    if (audio_decoder_open(path, &stream->decoder, &info) != 0) {
+        free(stream);
+        return NULL;
+    }
+
+    stream->path = strdup(path);
+    stream->sample_rate = info.sample_rate;
+    stream->length = info.frame_count;
+    stream->head_length = (size_t)info.sample_rate * STREAM_HEAD_MS / 1000;
+    if (stream->path == NULL || stream->head_length == 0 || stream->length <= stream->head_length) {
+        free_stream(stream);
+        return NULL;
+    }
+
+    stream->head = malloc(stream->head_length * sizeof(int16_t));
+    if (stream->head == NULL ||
+        spsc_ring_init(&stream->ring, sizeof(stream_chunk_t), STREAM_RING_CHUNKS) != 0) {
+        free_stream(stream);
+        return NULL;
+    }
+
+    size_t got = 0;
+    while (got < stream->head_length) {
+        size_t n = audio_decoder_read(stream->decoder, stream->head + got, stream->head_length - got);
+        if (n == 0) {
+            break;
+        }
+        got += n;
+    }
+    if (got < stream->head_length) {
+        fprintf(stderr, "[STREAM] Failed to read the start of %s\n", path);
+        free_stream(stream);
+        return NULL;
+    }
+    stream->io_position = stream->head_length;
+
+    pthread_mutex_lock(&registry_mutex);
+    int result = -1;
+    if (registry_count < STREAM_MAX) {
+        if (!io_running && pthread_create(&io_thread, NULL, io_thread_main, NULL) == 0) {
+            io_running = true;
+        }
+        if (io_running) {
+            registry[registry_count++] = stream;
+            result = 0;
+        }
+    } else {
+        fprintf(stderr, "[STREAM] Too many streamed sounds (max %d)\n", STREAM_MAX);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    if (result != 0) {
+        free_stream(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+void sound_stream_close(sound_stream_t *stream) {
+    if (stream == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    for (size_t i = 0; i < registry_count; i++) {
+        if (registry[i] == stream) {
+            registry[i] = registry[--registry_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    free_stream(stream);
+}
+
+void sound_stream_shutdown(void) {
+    pthread_mutex_lock(&registry_mutex);
+    bool running = io_running;
+    io_stop = true;
+    pthread_cond_signal(&io_wake);
+    pthread_mutex_unlock(&registry_mutex);
+
+    if (running) {
+        pthread_join(io_thread, NULL);
+    }
+    io_running = false;
+    io_stop = false;
+}
+
+const int16_t *sound_stream_head(const sound_stream_t *stream) {
+    return stream->head;
+}
+
+size_t sound_stream_head_length(const sound_stream_t *stream) {
+    return stream->head_length;
+}
+
+size_t sound_stream_length(const sound_stream_t *stream) {
+    return stream->length;
+}
+
+uint32_t sound_stream_sample_rate(const sound_stream_t *stream) {
+    return stream->sample_rate;
+}
+
+uint32_t sound_stream_begin(sound_stream_t *stream, bool loop) {
+    atomic_store(&stream->loop, loop);
+    atomic_store(&stream->active, true);
+    uint32_t epoch = atomic_fetch_add(&stream->epoch, 1) + 1;
+    pthread_cond_signal(&io_wake); // Start reading ahead without waiting out the idle interval
+    return epoch;
+}
+
+void sound_stream_end(sound_stream_t *stream) {
+    atomic_store(&stream->active, false);
+}
+
+uint32_t sound_stream_underruns(sound_stream_t *stream) {
+    return atomic_load(&stream->underruns);
+}
+
+// ---------------------------------------------------------------------------
+// Render thread
+// ---------------------------------------------------------------------------
+
+size_t sound_stream_prime(sound_stream_t *stream, uint32_t epoch) {
+    for (;;) {
+        if (stream->has_current) {
+            int32_t age = (int32_t)(epoch - stream->current.epoch);
+            if (age < 0) {
+                return 0; // A newer voice owns the stream
+            }
+            if (age == 0 && stream->current_offset < stream->current.frames) {
+                return stream->current.frames - stream->current_offset;
+            }
+            stream->has_current = false; // Used up, or left over from an earlier voice
+        }
+        if (!spsc_ring_pop(&stream->ring, &stream->current)) {
+            return 0;
+        }
+        stream->has_current = true;
+        stream->current_offset = 0;
+    }
+}
+
+size_t sound_stream_peek(sound_stream_t *stream, uint32_t epoch, const int16_t **samples) {
+    size_t available = sound_stream_prime(stream, epoch);
+    if (available == 0) {
+        if (!stream->has_current) {
+            atomic_fetch_add_explicit(&stream->underruns, 1, memory_order_relaxed);
+        }
+        return 0;
+    }
+    *samples = stream->current.samples + stream->current_offset;
+    return available;
+}
+
+void sound_stream_advance(sound_stream_t *stream, size_t frames) {
+    stream->current_offset += frames;
+}
@@ -0,0 +1,53 @@
+#ifndef SOUND_STREAM_H
+#define SOUND_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Disk-streamed sound for long loops and backing tracks. The first
+// STREAM_HEAD_MS are decoded up front so the attack is instant; the rest is
+// read ahead by a background I/O thread into a wait-free ring that the
+// render thread consumes. Only one voice plays a stream at a time.
+//
+// Each start begins a new epoch. The I/O thread refills the ring from the
+// end of the head for that epoch and the render thread discards chunks
+// left over from earlier ones, so a restart never plays stale audio.
+
+#define STREAM_HEAD_MS 500
+#define STREAM_CHUNK_FRAMES 512
+#define STREAM_RING_CHUNKS 128      // ~1.5 s of read-ahead at 44.1 kHz
+
+typedef struct sound_stream sound_stream_t;
+
+// Loader: opens path and decodes the head. Fails for files that are not
+// longer than the head.
+sound_stream_t *sound_stream_open(const char *path);
+// Render thread must no longer be using the stream
+void sound_stream_close(sound_stream_t *stream);
+// Stops the I/O thread once every stream is closed
+void sound_stream_shutdown(void);
+
+const int16_t *sound_stream_head(const sound_stream_t *stream);
+size_t sound_stream_head_length(const sound_stream_t *stream);
+size_t sound_stream_length(const sound_stream_t *stream);
+uint32_t sound_stream_sample_rate(const sound_stream_t *stream);
+
+// Control thread: starts reading ahead for a new voice and returns the
+// epoch that voice must pass to the render calls
+uint32_t sound_stream_begin(sound_stream_t *stream, bool loop);
+// Control thread: stops reading ahead (voice stopped)
+void sound_stream_end(sound_stream_t *stream);
+
+// Render thread: frames past the head are consumed in place from the ring.
+// peek returns the contiguous frames available for epoch (0 on underrun or
+// if a newer epoch has started) and drops chunks of earlier epochs. prime
+// does the same without counting an underrun; voices still in the head call
+// it so leftovers from a previous voice never block the read-ahead.
+size_t sound_stream_prime(sound_stream_t *stream, uint32_t epoch);
+size_t sound_stream_peek(sound_stream_t *stream, uint32_t epoch, const int16_t **samples);
+void sound_stream_advance(sound_stream_t *stream, size_t frames);
+
+uint32_t sound_stream_underruns(sound_stream_t *stream);
+
+#endif // SOUND_STREAM_H
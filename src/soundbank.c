@@ -0,0 +1,393 @@
+#include "soundbank.h"
+#include "adpcm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef ESP_PLATFORM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include "esp_partition.h"
+#endif
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static size_t align_up(size_t value) {
+    return (value + SOUNDBANK_ALIGN - 1) & ~(size_t)(SOUNDBANK_ALIGN - 1);
+}
+
+// Sounds without data or with names that don't fit the table are left out
+static bool item_included(const soundbank_item_t *item) {
+    return (item->samples != NULL || item->adpcm != NULL) && item->sample_count > 0 &&
+           item->sound->filename != NULL && strlen(item->sound->filename) < SOUNDBANK_NAME_MAX;
+}
+
+static size_t item_bytes(const soundbank_item_t *item) {
+    return item->adpcm != NULL ? adpcm_encoded_size(item->sample_count) : item->sample_count * sizeof(int16_t);
+}
+
+size_t soundbank_entry_bytes(const soundbank_entry_t *entry) {
+    return entry->storage == STORAGE_ADPCM ? adpcm_encoded_size(entry->sample_count)
+                                           : entry->sample_count * sizeof(int16_t);
+}
+
+// Whether count frames in the given storage fit in space bytes, without
+// overflowing on corrupt counts
+static bool data_fits(uint8_t storage, uint64_t count, size_t space) {
+    if (storage == STORAGE_ADPCM) {
+        uint64_t blocks = count / ADPCM_BLOCK_FRAMES + (count % ADPCM_BLOCK_FRAMES != 0);
+        return blocks <= space / ADPCM_BLOCK_BYTES;
+    }
+    return storage == STORAGE_PCM && count <= space / sizeof(int16_t);
+}
+
+int soundbank_parse(const void *data, size_t size, soundbank_t *bank) {
+    if (data == NULL || bank == NULL || size < sizeof(soundbank_header_t)) {
+        return -1;
+    }
+
+    const soundbank_header_t *header = data;
+    if (memcmp(header->magic, SOUNDBANK_MAGIC, 4) != 0 || header->version != SOUNDBANK_VERSION ||
+        header->file_size != size) {
+        return -1;
+    }
+
+    size_t table_end = sizeof(*header) + (size_t)header->entry_count * sizeof(soundbank_entry_t);
+    if (header->entry_count > size / sizeof(soundbank_entry_t) || table_end > size) {
+        return -1;
+    }
+
+    const soundbank_entry_t *entries = (const soundbank_entry_t *)(header + 1);
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const soundbank_entry_t *entry = &entries[i];
+        if (entry->data_offset % SOUNDBANK_ALIGN != 0 || entry->data_offset < table_end ||
+            entry->data_offset > size || !data_fits(entry->storage, entry->sample_count, size - entry->data_offset) ||
+            memchr(entry->filename, '\0', sizeof(entry->filename)) == NULL) {
+            return -1;
+        }
+    }
+
+    memset(bank, 0, sizeof(*bank));
+    bank->base = data;
+    bank->size = size;
+    bank->header = header;
+    bank->entries = entries;
+    return 0;
+}
+
+int soundbank_open(const char *path, soundbank_t *bank) {
+#ifdef ESP_PLATFORM
+    (void)path;
+    (void)bank;
+    return -1; // Banks live in a flash partition on ESP32
+#else
+    if (path == NULL || bank == NULL) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(soundbank_header_t)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+
+    if (soundbank_parse(mapping, size, bank) != 0) {
+        fprintf(stderr, "[BANK] Ignoring invalid sound bank: %s\n", path);
+        munmap(mapping, size);
+        return -1;
+    }
+    bank->mapping = mapping;
+    return 0;
+#endif
+}
+
+int soundbank_open_partition(const char *label, soundbank_t *bank) {
+#ifndef ESP_PLATFORM
+    (void)label;
+    (void)bank;
+    return -1; // Only ESP32 builds have flash partitions
+#else
+    if (label == NULL || bank == NULL) {
+        return -1;
+    }
+
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SOUNDBANK_PARTITION_SUBTYPE, label);
+    if (partition == NULL) {
+        fprintf(stderr, "[BANK] No '%s' data partition (see partitions.csv)\n", label);
+        return -1;
+    }
+
+    // Map only what the bank uses; the data window of the flash cache is
+    // shared with the app's constants
+    soundbank_header_t header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK ||
+        memcmp(header.magic, SOUNDBANK_MAGIC, 4) != 0 || header.file_size < sizeof(header) ||
+        header.file_size > partition->size) {
+        fprintf(stderr, "[BANK] Partition '%s' holds no sound bank; flash one built with soundbank_pack\n", label);
+        return -1;
+    }
+
+    const void *data;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, (size_t)header.file_size, ESP_PARTITION_MMAP_DATA,
+                                       &data, &handle);
+    if (err != ESP_OK) {
+        fprintf(stderr, "[BANK] Failed to map %llu KiB of partition '%s': %s\n",
+                (unsigned long long)header.file_size / 1024, label, esp_err_to_name(err));
+        return -1;
+    }
+
+    if (soundbank_parse(data, (size_t)header.file_size, bank) != 0) {
+        fprintf(stderr, "[BANK] Ignoring invalid sound bank in partition '%s'\n", label);
+        esp_partition_munmap(handle);
+        return -1;
+    }
+    bank->flash_mapped = true;
+    bank->flash_handle = (uint32_t)handle;
+
+    printf("[BANK] Mapped %u sound(s) from partition '%s' at 0x%06x (%llu KiB)\n",
+           (unsigned)bank->header->entry_count, label, (unsigned)partition->address,
+           (unsigned long long)header.file_size / 1024);
+    return 0;
+#endif
+}
+
+void soundbank_close(soundbank_t *bank) {
+    if (bank == NULL) {
+        return;
+    }
+#ifndef ESP_PLATFORM
+    if (bank->mapping) {
+        munmap(bank->mapping, bank->size);
+    }
+#else
+    if (bank->flash_mapped) {
+        esp_partition_munmap((esp_partition_mmap_handle_t)bank->flash_handle);
+    }
+#endif
+    memset(bank, 0, sizeof(*bank));
+}
+
+int soundbank_config(const soundbank_t *bank, config_t *config) {
+    if (bank == NULL || bank->header == NULL || config == NULL) {
+        return -1;
+    }
+
+    config_init(config);
+    size_t count = bank->header->entry_count;
+    config->sounds = calloc(count ? count : 1, sizeof(*config->sounds));
+    config->base_path = strdup("");
+    if (config->sounds == NULL || config->base_path == NULL) {
+        config_free(config);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const soundbank_entry_t *entry = &bank->entries[i];
+        sound_config_t *sound = &config->sounds[i];
+        sound->filename = strdup(entry->filename);
+        if (sound->filename == NULL) {
+            config_free(config);
+            return -1;
+        }
+        config->sound_count++;
+        sound->page = entry->page;
+        sound->note = entry->note;
+        sound->volume_offset = entry->volume_offset;
+        sound->color_r = entry->color_r;
+        sound->color_g = entry->color_g;
+        sound->color_b = entry->color_b;
+        sound->mode = entry->mode <= SOUND_MODE_HOLD ? (sound_mode_t)entry->mode : SOUND_MODE_ONESHOT;
+        sound->max_instances = entry->max_instances;
+        sound->resample = (resample_mode_t)entry->resample;
+        sound->stream = STREAM_NEVER; // The bank is the only copy
+        sound->storage = (sample_storage_t)entry->storage;
+        sound->velocity_curve = entry->velocity_curve < VELOCITY_CURVE_COUNT ?
+                                (velocity_curve_t)entry->velocity_curve : VELOCITY_LINEAR;
+    }
+    return 0;
+}
+
+const soundbank_entry_t *soundbank_find(const soundbank_t *bank, const sound_config_t *sound) {
+    if (bank == NULL || bank->header == NULL || sound == NULL || sound->filename == NULL) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < bank->header->entry_count; i++) {
+        const soundbank_entry_t *entry = &bank->entries[i];
+        if (entry->page == sound->page && entry->note == sound->note &&
+            strcmp(entry->filename, sound->filename) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+const int16_t *soundbank_samples(const soundbank_t *bank, const soundbank_entry_t *entry) {
+    return (const int16_t *)(bank->base + entry->data_offset);
+}
+
+const uint8_t *soundbank_adpcm(const soundbank_t *bank, const soundbank_entry_t *entry) {
+    return bank->base + entry->data_offset;
+}
+
+static int hash_file(const char *path, uint64_t *hash) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    uint8_t chunk[16384];
+    uint64_t h = FNV_OFFSET;
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            h = (h ^ chunk[i]) * FNV_PRIME;
+        }
+    }
+    int result = ferror(file) ? -1 : 0;
+    fclose(file);
+
+    *hash = h;
+    return result;
+}
+
+int soundbank_source_stat(const char *path, soundbank_source_t *source, bool with_hash) {
+    struct stat st;
+    if (path == NULL || source == NULL || stat(path, &st) != 0) {
+        return -1;
+    }
+
+    memset(source, 0, sizeof(*source));
+    source->size = (uint64_t)st.st_size;
+    source->mtime = (int64_t)st.st_mtime;
+    if (with_hash && hash_file(path, &source->hash) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+bool soundbank_source_fresh(const soundbank_source_t *cached, const char *path) {
+    soundbank_source_t current;
+    if (cached == NULL || soundbank_source_stat(path, &current, false) != 0) {
+        return false;
+    }
+    if (current.size != cached->size) {
+        return false;
+    }
+    if (current.mtime == cached->mtime) {
+        return true;
+    }
+    uint64_t hash;
+    return hash_file(path, &hash) == 0 && hash == cached->hash;
+}
+
+int soundbank_write(const char *path, const soundbank_item_t *items, size_t count, uint32_t output_rate) {
+    if (path == NULL || items == NULL) {
+        return -1;
+    }
+
+    size_t entry_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (item_included(&items[i])) {
+            entry_count++;
+        }
+    }
+
+    soundbank_entry_t *entries = calloc(entry_count ? entry_count : 1, sizeof(*entries));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    // Lay out the sample data after the table
+    size_t offset = align_up(sizeof(soundbank_header_t) + entry_count * sizeof(*entries));
+    size_t e = 0;
+    for (size_t i = 0; i < count; i++) {
+        const soundbank_item_t *item = &items[i];
+        if (!item_included(item)) {
+            continue;
+        }
+        soundbank_entry_t *entry = &entries[e++];
+        strcpy(entry->filename, item->sound->filename);
+        entry->source = item->source;
+        entry->data_offset = offset;
+        entry->sample_count = item->sample_count;
+        entry->sample_rate = item->sample_rate;
+        entry->volume_offset = item->sound->volume_offset;
+        entry->page = item->sound->page;
+        entry->note = item->sound->note;
+        entry->mode = (uint8_t)item->sound->mode;
+        entry->resample = (uint8_t)item->sound->resample;
+        entry->max_instances = item->sound->max_instances;
+        entry->color_r = item->sound->color_r;
+        entry->color_g = item->sound->color_g;
+        entry->color_b = item->sound->color_b;
+        entry->storage = item->adpcm != NULL ? STORAGE_ADPCM : STORAGE_PCM;
+        entry->velocity_curve = (uint8_t)item->sound->velocity_curve;
+        offset = align_up(offset + item_bytes(item));
+    }
+
+    soundbank_header_t header = {
+        .version = SOUNDBANK_VERSION,
+        .entry_count = (uint32_t)entry_count,
+        .output_rate = output_rate,
+        .file_size = offset,
+    };
+    memcpy(header.magic, SOUNDBANK_MAGIC, 4);
+
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "[BANK] Failed to create %s\n", tmp_path);
+        free(entries);
+        return -1;
+    }
+
+    static const uint8_t padding[SOUNDBANK_ALIGN] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(entries, sizeof(*entries), entry_count, file) == entry_count;
+    size_t written = sizeof(header) + entry_count * sizeof(*entries);
+    e = 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        const soundbank_item_t *item = &items[i];
+        if (!item_included(item)) {
+            continue;
+        }
+        const soundbank_entry_t *entry = &entries[e++];
+        const void *data = item->adpcm != NULL ? (const void *)item->adpcm : (const void *)item->samples;
+        size_t bytes = item_bytes(item);
+        ok = fwrite(padding, 1, entry->data_offset - written, file) == entry->data_offset - written &&
+             fwrite(data, 1, bytes, file) == bytes;
+        written = entry->data_offset + bytes;
+    }
+    if (ok && written < offset) {
+        ok = fwrite(padding, 1, offset - written, file) == offset - written;
+    }
+    ok = fclose(file) == 0 && ok;
+    free(entries);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "[BANK] Failed to write %s\n", path);
+        remove(tmp_path);
+        return -1;
+    }
+
+    printf("[BANK] Wrote %zu sound(s) to %s (%zu KiB)\n", entry_count, path, offset / 1024);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#ifndef SOUNDBANK_H
+#define SOUNDBANK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "config.h"
+
+// Compiled sound bank: the decoded, rate-converted samples of every sound
+// in a config, laid out so it can be memory-mapped and played in place.
+// The desktop builds keep one as a decode cache next to the sounds; on
+// ESP32 it is packed on the host (tools/soundbank_pack.c) and flashed to a
+// data partition, which is the only copy of the sounds.
+//
+//   soundbank_header_t
+//   soundbank_entry_t[entry_count]     page/note/mode/gain/color table
+//   sample data                        int16 mono PCM or IMA-ADPCM blocks
+//                                      (adpcm.h), SOUNDBANK_ALIGN aligned
+//
+// All fields are little-endian (the byte order of every supported target).
+
+#define SOUNDBANK_MAGIC "MSBK"
+#define SOUNDBANK_VERSION 2
+#define SOUNDBANK_ALIGN 64           // PCM block alignment in bytes
+#define SOUNDBANK_NAME_MAX 192       // Including the terminator
+#define SOUNDBANK_CACHE_NAME "soundbank.cache"
+#define SOUNDBANK_PARTITION_LABEL "soundbank"
+#define SOUNDBANK_PARTITION_SUBTYPE 0x40 // Custom data subtype, see partitions.csv
+
+// Identity of the source file an entry was built from
+typedef struct {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;               // FNV-1a 64 of the file contents
+} soundbank_source_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t output_rate;        // Rate sounds converted at load were converted to
+    uint64_t file_size;          // Total size, to detect truncated files
+} soundbank_header_t;
+
+typedef struct {
+    char filename[SOUNDBANK_NAME_MAX];
+    soundbank_source_t source;
+    uint64_t data_offset;        // From the start of the bank
+    uint64_t sample_count;
+    uint32_t sample_rate;        // Rate of the stored PCM
+    float volume_offset;
+    uint8_t page;
+    uint8_t note;
+    uint8_t mode;                // sound_mode_t
+    uint8_t resample;            // resample_mode_t the PCM was produced with
+    uint8_t max_instances;
+    uint8_t color_r, color_g, color_b;
+    uint8_t storage;             // sample_storage_t of the data
+    uint8_t velocity_curve;      // velocity_curve_t
+    uint8_t reserved[6];
+} soundbank_entry_t;
+
+typedef struct {
+    const uint8_t *base;
+    size_t size;
+    const soundbank_header_t *header;
+    const soundbank_entry_t *entries;
+    void *mapping;               // Non-NULL if the bank owns a file mapping
+    bool flash_mapped;           // The bank owns a flash partition mapping
+    uint32_t flash_handle;       // esp_partition_mmap_handle_t of that mapping
+} soundbank_t;
+
+// One decoded sound handed to soundbank_write()
+typedef struct {
+    const sound_config_t *sound;
+    const int16_t *samples;      // NULL to leave the sound out
+    const uint8_t *adpcm;        // IMA-ADPCM blocks stored instead of samples, or NULL
+    size_t sample_count;
+    uint32_t sample_rate;
+    soundbank_source_t source;
+} soundbank_item_t;
+
+// Validates a bank already in memory (e.g. a flash partition); no copy is made
+int soundbank_parse(const void *data, size_t size, soundbank_t *bank);
+
+// Memory-maps a bank file read-only. Untouched PCM pages cost no RAM.
+int soundbank_open(const char *path, soundbank_t *bank);
+void soundbank_close(soundbank_t *bank);
+
+// ESP32: maps the bank in the data partition with the given label through
+// the flash cache. Samples are read straight from flash; nothing is copied
+// to RAM. Fails on other platforms.
+int soundbank_open_partition(const char *label, soundbank_t *bank);
+
+// Builds a config listing every sound in the bank with its pad settings,
+// for targets where the bank is all there is (no config file or sounds
+// folder). Engine settings are left at their defaults. Free with
+// config_free().
+int soundbank_config(const soundbank_t *bank, config_t *config);
+
+// Entry built from the same file for the same page/note, or NULL
+const soundbank_entry_t *soundbank_find(const soundbank_t *bank, const sound_config_t *sound);
+const int16_t *soundbank_samples(const soundbank_t *bank, const soundbank_entry_t *entry);
+// Blocks of an entry with storage STORAGE_ADPCM
+const uint8_t *soundbank_adpcm(const soundbank_t *bank, const soundbank_entry_t *entry);
+// Bytes of sample data the entry takes in the bank (before alignment)
+size_t soundbank_entry_bytes(const soundbank_entry_t *entry);
+
+// Reads size and mtime; the content hash too if with_hash is set
+int soundbank_source_stat(const char *path, soundbank_source_t *source, bool with_hash);
+
+// True if the source file still matches the entry. Size and mtime are checked
+// first; a touched file whose contents are unchanged is accepted by hash.
+bool soundbank_source_fresh(const soundbank_source_t *cached, const char *path);
+
+// Writes a new bank next to path and renames it into place, so a mapping of
+// the previous bank stays valid
+int soundbank_write(const char *path, const soundbank_item_t *items, size_t count, uint32_t output_rate);
+
+#endif // SOUNDBANK_H
@@ -0,0 +1,68 @@
+#include "spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_ring_init(spsc_ring_t *ring, size_t item_size, size_t capacity) {
+    if (ring == NULL || item_size == 0 || capacity == 0) {
+        return -1;
+    }
+
+    size_t cap = 1;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    ring->buffer = calloc(cap, item_size);
+    if (ring->buffer == NULL) {
+        return -1;
+    }
+
+    ring->item_size = item_size;
+    ring->capacity = cap;
+    ring->mask = cap - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+void spsc_ring_free(spsc_ring_t *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    free(ring->buffer);
+    ring->buffer = NULL;
+    ring->capacity = 0;
+    ring->mask = 0;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *item) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= ring->capacity) {
+        return false; // Full
+    }
+
+    memcpy(ring->buffer + (head & ring->mask) * ring->item_size, item, ring->item_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void *item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail == head) {
+        return false; // Empty
+    }
+
+    memcpy(item, ring->buffer + (tail & ring->mask) * ring->item_size, ring->item_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+size_t spsc_ring_count(spsc_ring_t *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,35 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Wait-free single-producer/single-consumer ring of fixed-size items.
+// Exactly one thread may push and exactly one (other) thread may pop;
+// neither side ever blocks or takes a lock, so it is safe to use from
+// real-time audio and MIDI callbacks.
+typedef struct {
+    uint8_t *buffer;            // capacity * item_size bytes
+    size_t item_size;           // Size of one item in bytes
+    size_t capacity;            // Number of items (power of two)
+    size_t mask;                // capacity - 1
+    _Atomic size_t head;        // Next slot to write (producer owned)
+    _Atomic size_t tail;        // Next slot to read (consumer owned)
+} spsc_ring_t;
+
+// Capacity is rounded up to a power of two. Allocates once; never on push/pop.
+int spsc_ring_init(spsc_ring_t *ring, size_t item_size, size_t capacity);
+void spsc_ring_free(spsc_ring_t *ring);
+
+// Producer side: returns false if the ring is full.
+bool spsc_ring_push(spsc_ring_t *ring, const void *item);
+
+// Consumer side: returns false if the ring is empty.
+bool spsc_ring_pop(spsc_ring_t *ring, void *item);
+
+// Approximate fill level (exact when called from either owning thread).
+size_t spsc_ring_count(spsc_ring_t *ring);
+
+#endif // SPSC_RING_H
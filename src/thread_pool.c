@@ -0,0 +1,91 @@
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define THREAD_POOL_MAX_THREADS 32
+
+struct thread_pool {
+    thread_pool_job_fn fn;
+    void *ctx;
+    size_t job_count;
+    _Atomic size_t next_job;
+    pthread_t threads[THREAD_POOL_MAX_THREADS];
+    size_t thread_count;
+};
+
+static void *worker_main(void *arg) {
+    thread_pool_t *pool = arg;
+    for (;;) {
+        size_t index = atomic_fetch_add(&pool->next_job, 1);
+        if (index >= pool->job_count) {
+            break;
+        }
+        pool->fn(index, pool->ctx);
+    }
+    return NULL;
+}
+
+size_t thread_pool_default_threads(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+thread_pool_t *thread_pool_start(size_t job_count, thread_pool_job_fn fn, void *ctx, size_t max_threads) {
+    if (fn == NULL) {
+        return NULL;
+    }
+
+    thread_pool_t *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->job_count = job_count;
+    atomic_init(&pool->next_job, 0);
+
+    size_t wanted = max_threads ? max_threads : thread_pool_default_threads();
+    if (wanted > job_count) {
+        wanted = job_count;
+    }
+    if (wanted > THREAD_POOL_MAX_THREADS) {
+        wanted = THREAD_POOL_MAX_THREADS;
+    }
+
+    for (size_t i = 0; i < wanted; i++) {
+        if (pthread_create(&pool->threads[pool->thread_count], NULL, worker_main, pool) != 0) {
+            break; // Fewer workers is fine; the others pick up the slack
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0 && job_count > 0) {
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void thread_pool_wait(thread_pool_t *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool);
+}
+
+int thread_pool_run(size_t job_count, thread_pool_job_fn fn, void *ctx, size_t max_threads) {
+    if (job_count == 0) {
+        return 0;
+    }
+    thread_pool_t *pool = thread_pool_start(job_count, fn, ctx, max_threads);
+    if (pool == NULL) {
+        return -1;
+    }
+    thread_pool_wait(pool);
+    return 0;
+}
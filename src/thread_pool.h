@@ -0,0 +1,24 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+// Runs fn(index, ctx) for every index in [0, job_count) across worker
+// threads. Jobs must be independent and are picked up in index order.
+typedef void (*thread_pool_job_fn)(size_t index, void *ctx);
+
+typedef struct thread_pool thread_pool_t;
+
+// Starts workers in the background and returns immediately (NULL on failure)
+thread_pool_t *thread_pool_start(size_t job_count, thread_pool_job_fn fn, void *ctx, size_t max_threads);
+
+// Waits for every job to finish and frees the pool
+void thread_pool_wait(thread_pool_t *pool);
+
+// Blocking convenience wrapper: start + wait
+int thread_pool_run(size_t job_count, thread_pool_job_fn fn, void *ctx, size_t max_threads);
+
+// Number of online CPUs (at least 1)
+size_t thread_pool_default_threads(void);
+
+#endif // THREAD_POOL_H
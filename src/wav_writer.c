@@ -0,0 +1,69 @@
+#include "wav_writer.h"
+#include <string.h>
+
+static void put_le(uint8_t *out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// Header for frames frames, written at the start of the file
+static int write_header(wav_writer_t *writer) {
+    uint64_t bytes = writer->frames * sizeof(int16_t);
+    uint32_t data_bytes = bytes > UINT32_MAX - 36 ? UINT32_MAX - 36 : (uint32_t)bytes;
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    put_le(header + 4, 36 + data_bytes, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, 16, 4);                         // fmt chunk size
+    put_le(header + 20, 1, 2);                          // PCM
+    put_le(header + 22, 1, 2);                          // Mono
+    put_le(header + 24, writer->sample_rate, 4);
+    put_le(header + 28, writer->sample_rate * 2, 4);    // Bytes per second
+    put_le(header + 32, 2, 2);                          // Bytes per frame
+    put_le(header + 34, 16, 2);                         // Bits per sample
+    memcpy(header + 36, "data", 4);
+    put_le(header + 40, data_bytes, 4);
+    if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+        fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        return -1;
+    }
+    return 0;
+}
+
+int wav_writer_open(wav_writer_t *writer, const char *path, uint32_t sample_rate) {
+    writer->file = fopen(path, "wb");
+    writer->sample_rate = sample_rate;
+    writer->frames = 0;
+    if (writer->file == NULL) {
+        fprintf(stderr, "[WAV] Failed to create %s\n", path);
+        return -1;
+    }
+    if (write_header(writer) != 0) { // Sizes are filled in on close
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int wav_writer_write(wav_writer_t *writer, const int16_t *samples, size_t frame_count) {
+    if (writer->file == NULL) {
+        return -1;
+    }
+    size_t written = fwrite(samples, sizeof(int16_t), frame_count, writer->file);
+    writer->frames += written;
+    return written == frame_count ? 0 : -1;
+}
+
+int wav_writer_close(wav_writer_t *writer) {
+    if (writer->file == NULL) {
+        return 0;
+    }
+    int result = write_header(writer);
+    if (fclose(writer->file) != 0) {
+        result = -1;
+    }
+    writer->file = NULL;
+    return result;
+}
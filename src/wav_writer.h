@@ -0,0 +1,22 @@
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Streams 16-bit mono PCM to a WAV file. The header is written up front with
+// zero sizes and patched by wav_writer_close(), so the file is only complete
+// once it has been closed.
+typedef struct {
+    FILE *file;
+    uint32_t sample_rate;
+    uint64_t frames;            // Frames written so far
+} wav_writer_t;
+
+int wav_writer_open(wav_writer_t *writer, const char *path, uint32_t sample_rate);
+int wav_writer_write(wav_writer_t *writer, const int16_t *samples, size_t frame_count);
+// Fills in the sizes and closes the file; a no-op if it is not open
+int wav_writer_close(wav_writer_t *writer);
+
+#endif // WAV_WRITER_H
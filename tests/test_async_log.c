@@ -0,0 +1,137 @@
+// Async log formatting: a message must come out as snprintf() would have
+// written it, whether it went through a ring and the writer thread or was
+// written directly (before async_log_start()). %s arguments longer than the
+// record's text room are cut, and lines longer than a record's line.
+
+#include "async_log.h"
+#include "test_common.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EXPECTED_BYTES 8192
+#define SHARED_STRING 60            // Two of these overflow ASYNC_LOG_TEXT_BYTES
+
+static char expected[EXPECTED_BYTES];
+static size_t expected_length;
+static char output[EXPECTED_BYTES];
+static char long_string[2 * ASYNC_LOG_TEXT_BYTES];
+static char path[] = "/tmp/soundboard_test_XXXXXX";
+static int saved_stdout = -1;
+
+// Appends what snprintf() makes of a line, cut as a log line is
+static void expect(const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
+
+static void expect(const char *format, ...) {
+    char line[ASYNC_LOG_LINE_BYTES];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    size_t length = strlen(line);
+    if (expected_length + length < sizeof(expected)) {
+        memcpy(expected + expected_length, line, length + 1);
+        expected_length += length;
+    }
+}
+
+// Logs a message and records what it should print
+#define LOG_AND_EXPECT(...) do { \
+        LOG_INFO(__VA_ARGS__); \
+        expect(__VA_ARGS__); \
+    } while (0)
+
+// Every message each case logs; strings that fit the record are compared
+// with snprintf() as is, and the rest with what fits
+static void log_messages(void) {
+    int value = 7;
+    LOG_AND_EXPECT("[TEST] %d %u %zu %lld %llx\n", -42, 4000000000u, (size_t)123456789,
+                   -9000000000000ll, 0xfedcba9876543210ull);
+    LOG_AND_EXPECT("[TEST] %c%c %s %p %p\n", 'o', 'k', "text", (void *)&value, (void *)NULL);
+    LOG_AND_EXPECT("[TEST] %.3f %e %g %10.2f|\n", 3.14159265, -1.5e-7, 0.0001, 2.5);
+    LOG_AND_EXPECT("[TEST] |%-8s|%8s|%.2s|%-6d|%06d|%+d|%x|%#o|\n", "left", "right", "cut", 12, -34, 5, 255u, 8u);
+    LOG_AND_EXPECT("[TEST] 100%% %hhd %hu %ld %jd %td\n", (signed char)-5, (unsigned short)65535,
+                   -123456789l, (intmax_t)-1, (ptrdiff_t)-2);
+    LOG_AND_EXPECT("[TEST] |%*d|%-*d|%.*f|\n", 6, 42, 5, 7, 2, 1.23456);
+    LOG_AND_EXPECT("[TEST] |%*.*s|%.*d|%*d|\n", 8, 3, "abcdef", -1, 9, -4, 1);
+
+    // The text room is shared: the second string gets what the first left
+    size_t second = ASYNC_LOG_TEXT_BYTES - (SHARED_STRING + 1) - 1;
+    LOG_INFO("[TEST] %s\n", long_string);
+    expect("[TEST] %.*s\n", ASYNC_LOG_TEXT_BYTES - 1, long_string);
+    LOG_INFO("[TEST] %.*s %.*s\n", SHARED_STRING, long_string, SHARED_STRING, long_string + 1);
+    expect("[TEST] %.*s %.*s\n", SHARED_STRING, long_string, (int)second, long_string + 1);
+
+    // Past the line size, the rest of the message is lost
+    LOG_AND_EXPECT("[TEST] %0600d\n", 1);
+    LOG_AND_EXPECT("\n");
+}
+
+static void capture_stdout(void) {
+    fflush(stdout);
+    int fd = mkstemp(path);
+    saved_stdout = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+    expected_length = 0;
+    expected[0] = '\0';
+}
+
+// Puts stdout back and reads what was written to it
+static size_t release_stdout(void) {
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    FILE *file = fopen(path, "rb");
+    size_t length = file != NULL ? fread(output, 1, sizeof(output) - 1, file) : 0;
+    output[length] = '\0';
+    if (file != NULL) {
+        fclose(file);
+    }
+    unlink(path);
+    memcpy(path + strlen(path) - 6, "XXXXXX", 6);
+    return length;
+}
+
+static void check_output(size_t length) {
+    CHECK(length == expected_length);
+    CHECK(memcmp(output, expected, expected_length) == 0);
+    if (length != expected_length || memcmp(output, expected, expected_length) != 0) {
+        fprintf(stderr, "expected:\n%s\ngot:\n%s\n", expected, output);
+    }
+}
+
+// No writer thread: the calling thread formats and writes
+static void test_direct(void) {
+    capture_stdout();
+    log_messages();
+    check_output(release_stdout());
+}
+
+// Through a ring: formatted later, by the writer thread
+static void test_queued(void) {
+    capture_stdout();
+    CHECK(async_log_start() == 0);
+    log_messages();
+    async_log_stop();
+    check_output(release_stdout());
+    CHECK(async_log_dropped() == 0);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(long_string) - 1; i++) {
+        long_string[i] = (char)('a' + i % 26);
+    }
+    async_log_set_level(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_direct);
+    RUN_TEST(test_queued);
+    return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+
+// Minimal checks for the programs under tests/: each one runs its cases,
+// prints one line per case and exits nonzero if any check failed.
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define RUN_TEST(fn) do { \
+    int before = test_failures; \
+    fn(); \
+    printf("[TEST] %-40s %s\n", #fn, test_failures == before ? "ok" : "FAILED"); \
+} while (0)
+
+#endif // TEST_COMMON_H
@@ -0,0 +1,176 @@
+// MIDI queue under a flood: a producer thread pushes events as fast as it
+// can while the consumer drains them the way the main loop does, and every
+// event must come out exactly once and in order. A full queue refuses and
+// counts new events rather than overwriting queued ones.
+//
+// Built from midi_queue.c and its ring alone (see the Makefile).
+
+#include "midi_queue.h"
+#include "test_common.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define FLOOD_EVENTS 1000000
+#define PARSER_MESSAGES 200000
+#define PACKET_MESSAGES 16
+#define BATCH 64
+#define WAIT_MS 100
+
+typedef struct {
+    midi_queue_t queue;
+    size_t refused;             // Pushes the producer had to retry
+} flood_t;
+
+// The sequence number rides in the timestamp; note and velocity are
+// derived from it so a torn or mixed-up event shows too
+static midi_event_t flood_event(uint64_t sequence) {
+    return (midi_event_t){
+        .type = MIDI_EVENT_NOTE,
+        .note = (uint8_t)(sequence % 128),
+        .velocity = (uint8_t)(sequence / 128 % 128),
+        .is_on = sequence % 2 == 0,
+        .timestamp_ns = sequence,
+    };
+}
+
+static void *flood_producer(void *arg) {
+    flood_t *flood = arg;
+    for (uint64_t sequence = 0; sequence < FLOOD_EVENTS; sequence++) {
+        midi_event_t event = flood_event(sequence);
+        while (!midi_queue_push(&flood->queue, &event)) {
+            flood->refused++;
+            midi_queue_notify(&flood->queue);
+            sched_yield();
+        }
+        if (sequence % BATCH == BATCH - 1) {
+            midi_queue_notify(&flood->queue);
+        }
+    }
+    midi_queue_notify(&flood->queue);
+    return NULL;
+}
+
+static void test_flood_is_lossless_and_ordered(void) {
+    flood_t flood = {0};
+    CHECK(midi_queue_init(&flood.queue, MIDI_QUEUE_SIZE) == 0);
+    pthread_t producer;
+    CHECK(pthread_create(&producer, NULL, flood_producer, &flood) == 0);
+
+    midi_event_t events[BATCH];
+    uint64_t next = 0;
+    size_t mismatches = 0;
+    int idle_waits = 0;
+    while (next < FLOOD_EVENTS && idle_waits < 50) {
+        midi_queue_wait(&flood.queue, WAIT_MS);
+        size_t count = midi_queue_pop_batch(&flood.queue, events, BATCH);
+        idle_waits = count == 0 ? idle_waits + 1 : 0;
+        for (size_t i = 0; i < count; i++, next++) {
+            midi_event_t want = flood_event(next);
+            mismatches += events[i].timestamp_ns != want.timestamp_ns || events[i].note != want.note ||
+                          events[i].velocity != want.velocity || events[i].is_on != want.is_on;
+        }
+    }
+    pthread_join(producer, NULL);
+
+    CHECK(next == FLOOD_EVENTS);
+    CHECK(mismatches == 0);
+    CHECK(midi_queue_pop_batch(&flood.queue, events, BATCH) == 0);
+    // Every refusal was counted, and nothing else was
+    CHECK(midi_queue_overflows(&flood.queue) == flood.refused);
+    midi_queue_free(&flood.queue);
+}
+
+// Raw bytes through the parser: note on with explicit status, then note
+// off and control change messages under running status, with a realtime
+// clock byte in the middle of a message
+static size_t build_packet(uint8_t *bytes, uint32_t first) {
+    size_t length = 0;
+    bytes[length++] = 0x90;
+    for (uint32_t m = 0; m < PACKET_MESSAGES; m++) {
+        uint32_t message = first + m;
+        if (m == PACKET_MESSAGES / 2) {
+            bytes[length++] = 0xB0;
+        }
+        bytes[length++] = (uint8_t)(message % 128);
+        if (m == 3) {
+            bytes[length++] = 0xF8;
+        }
+        bytes[length++] = (uint8_t)(message / 128 % 127 + 1);
+    }
+    return length;
+}
+
+static void *parser_producer(void *arg) {
+    midi_queue_t *queue = arg;
+    midi_parser_t parser = {0};
+    uint8_t bytes[3 * PACKET_MESSAGES + 4];
+    for (uint32_t first = 0; first < PARSER_MESSAGES; first += PACKET_MESSAGES) {
+        // A packet is pushed whole; wait for room like a driver that
+        // never gets ahead of the main loop
+        while (spsc_ring_count(&queue->ring) + PACKET_MESSAGES > queue->ring.capacity) {
+            sched_yield();
+        }
+        size_t length = build_packet(bytes, first);
+        midi_parser_feed(&parser, bytes, length, first, queue);
+    }
+    return NULL;
+}
+
+static void test_parser_flood(void) {
+    midi_queue_t queue;
+    CHECK(midi_queue_init(&queue, MIDI_QUEUE_SIZE) == 0);
+    pthread_t producer;
+    CHECK(pthread_create(&producer, NULL, parser_producer, &queue) == 0);
+
+    midi_event_t events[BATCH];
+    uint32_t next = 0;
+    size_t mismatches = 0;
+    int idle_waits = 0;
+    while (next < PARSER_MESSAGES && idle_waits < 50) {
+        midi_queue_wait(&queue, WAIT_MS);
+        size_t count = midi_queue_pop_batch(&queue, events, BATCH);
+        idle_waits = count == 0 ? idle_waits + 1 : 0;
+        for (size_t i = 0; i < count; i++, next++) {
+            bool control = next % PACKET_MESSAGES >= PACKET_MESSAGES / 2;
+            mismatches += events[i].type != (control ? MIDI_EVENT_CONTROL : MIDI_EVENT_NOTE) ||
+                          events[i].note != next % 128 || events[i].velocity != next / 128 % 127 + 1 ||
+                          events[i].timestamp_ns != next - next % PACKET_MESSAGES ||
+                          (!control && !events[i].is_on);
+        }
+    }
+    pthread_join(producer, NULL);
+
+    CHECK(next == PARSER_MESSAGES);
+    CHECK(mismatches == 0);
+    CHECK(midi_queue_overflows(&queue) == 0);
+    midi_queue_free(&queue);
+}
+
+// With no consumer, the events that fit are kept in order and the rest are
+// refused and counted
+static void test_full_queue_refuses_new_events(void) {
+    midi_queue_t queue;
+    CHECK(midi_queue_init(&queue, 16) == 0);
+    size_t accepted = 0;
+    for (uint64_t sequence = 0; sequence < 40; sequence++) {
+        midi_event_t event = flood_event(sequence);
+        accepted += midi_queue_push(&queue, &event);
+    }
+    CHECK(accepted == queue.ring.capacity);
+    CHECK(midi_queue_overflows(&queue) == 40 - accepted);
+
+    midi_event_t events[BATCH];
+    size_t count = midi_queue_pop_batch(&queue, events, BATCH);
+    CHECK(count == accepted);
+    for (size_t i = 0; i < count; i++) {
+        CHECK(events[i].timestamp_ns == i);
+    }
+    midi_queue_free(&queue);
+}
+
+int main(void) {
+    RUN_TEST(test_flood_is_lossless_and_ordered);
+    RUN_TEST(test_parser_flood);
+    RUN_TEST(test_full_queue_refuses_new_events);
+    return test_failures == 0 ? 0 : 1;
+}
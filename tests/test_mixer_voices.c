@@ -0,0 +1,116 @@
+// Voice pool limits: starts must stay inside the pool however fast voices
+// are started, stopped and stolen.
+
+#include "mixer.h"
+#include "test_common.h"
+
+#define SAMPLE_RATE 44100
+#define PADS 10
+#define TONE_FRAMES 4410
+
+static int16_t tone[TONE_FRAMES];
+static int16_t output[MIXER_BLOCK_FRAMES];
+
+// The pool mixer_init() sizes for a voice limit: the limit plus a fade reserve
+static size_t pool_size(size_t max_voices) {
+    return max_voices + max_voices / 4 + 4;
+}
+
+// One voice, ten hold pads tapped faster than a fade: every release leaves
+// a fading voice behind until the reserve is full of them
+static void test_hold_taps_fill_fade_reserve(void) {
+    CHECK(mixer_init(SAMPLE_RATE, 1, VOICE_STEAL_OLDEST) == 0);
+
+    voice_handle_t last = VOICE_HANDLE_INVALID;
+    for (int pad = 0; pad < PADS; pad++) {
+        last = mixer_start_voice(tone, TONE_FRAMES, 0, 1.0f, false, true);
+        CHECK(last != VOICE_HANDLE_INVALID);
+        CHECK(mixer_stop_voice(last) == 0);
+    }
+    // All twenty commands land in the same render call
+    mixer_render(output, 64);
+    CHECK(mixer_active_voices() <= pool_size(1));
+    CHECK(mixer_voice_active(last));
+
+    // And the pool drains once the fades finish
+    for (int i = 0; i < 8; i++) {
+        mixer_render(output, 64);
+    }
+    CHECK(mixer_active_voices() == 0);
+    mixer_cleanup();
+}
+
+// The same taps spread over 0.1 s of render calls
+static void test_hold_taps_across_renders(void) {
+    CHECK(mixer_init(SAMPLE_RATE, 1, VOICE_STEAL_OLDEST) == 0);
+
+    for (int pad = 0; pad < PADS; pad++) {
+        voice_handle_t voice = mixer_start_voice(tone, TONE_FRAMES, 0, 1.0f, false, true);
+        mixer_render(output, 16);
+        CHECK(mixer_stop_voice(voice) == 0);
+        mixer_render(output, 16);
+        CHECK(mixer_active_voices() <= pool_size(1));
+    }
+    for (int i = 0; i < 4; i++) {
+        mixer_render(output, MIXER_BLOCK_FRAMES);
+    }
+    CHECK(mixer_active_voices() == 0);
+    mixer_cleanup();
+}
+
+// Held pads without releases: stealing fades the oldest into the reserve,
+// then hard-cuts once the reserve is used up. Presses are a few frames
+// apart so "oldest" is well defined.
+static void test_held_pads_steal(void) {
+    CHECK(mixer_init(SAMPLE_RATE, 2, VOICE_STEAL_OLDEST) == 0);
+
+    voice_handle_t handles[PADS];
+    for (int pad = 0; pad < PADS; pad++) {
+        handles[pad] = mixer_start_voice(tone, TONE_FRAMES, 0, 1.0f, false, true);
+        CHECK(handles[pad] != VOICE_HANDLE_INVALID);
+        mixer_render(output, 8);
+    }
+    CHECK(mixer_active_voices() <= pool_size(2));
+    CHECK(mixer_voice_active(handles[PADS - 1]));
+    CHECK(mixer_voice_active(handles[PADS - 2]));
+
+    mixer_render(output, MIXER_FADE_FRAMES);
+    CHECK(mixer_active_voices() == 2);
+    mixer_cleanup();
+}
+
+// Fades that run to the end free their place in the voice limit: after a
+// stopped voice has faded out, a full set of new voices all play
+static void test_finished_fades_free_voices(void) {
+    CHECK(mixer_init(SAMPLE_RATE, 4, VOICE_STEAL_OLDEST) == 0);
+
+    voice_handle_t stopped = mixer_start_voice(tone, TONE_FRAMES, 0, 1.0f, true, false);
+    mixer_render(output, 64);
+    CHECK(mixer_stop_voice(stopped) == 0);
+    mixer_render(output, MIXER_FADE_FRAMES + 64);
+    CHECK(mixer_active_voices() == 0);
+
+    voice_handle_t handles[4];
+    for (int i = 0; i < 4; i++) {
+        handles[i] = mixer_start_voice(tone, TONE_FRAMES, 0, 1.0f, true, false);
+        CHECK(handles[i] != VOICE_HANDLE_INVALID);
+    }
+    mixer_render(output, 64);
+    CHECK(mixer_active_voices() == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(mixer_voice_active(handles[i]));
+    }
+    mixer_cleanup();
+}
+
+int main(void) {
+    for (int i = 0; i < TONE_FRAMES; i++) {
+        tone[i] = (int16_t)((i % 100) * 200 - 10000);
+    }
+
+    RUN_TEST(test_hold_taps_fill_fade_reserve);
+    RUN_TEST(test_hold_taps_across_renders);
+    RUN_TEST(test_held_pads_steal);
+    RUN_TEST(test_finished_fades_free_voices);
+    return test_failures == 0 ? 0 : 1;
+}
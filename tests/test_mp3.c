@@ -0,0 +1,123 @@
+// MP3 through the portable decoder (mp3_decoder.c): the bundled typewriter
+// sample must decode to the same frames every time, whole or streamed in
+// odd-sized reads, and MPEG-2/2.5 files must be refused rather than played
+// at the wrong rate. Mac OS decodes MP3 with ExtAudioFile, so there is
+// nothing to check there.
+//
+//   test_mp3 [path to the typewriter MP3]
+
+#include "audio_loader.h"
+#include "test_common.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_FILE "sounds/138049__pakasit21__typewriter.mp3"
+#define EXPECTED_RATE 44100
+#define EXPECTED_FRAMES 314496
+// FNV-1a over every decoded sample; changes whenever the decoder's output does
+#define EXPECTED_CHECKSUM 0xd1532edfd1ca65f5ull
+#define READ_FRAMES 1000            // Not a multiple of the 1152-frame MP3 frame
+
+#ifndef __APPLE__
+
+static const char *file = DEFAULT_FILE;
+
+static uint64_t checksum(const int16_t *samples, size_t count) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; i++) {
+        hash ^= (uint16_t)samples[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void test_whole_file(void) {
+    audio_data_t audio;
+    CHECK(audio_load_file(file, &audio) == 0);
+    CHECK(audio.sample_rate == EXPECTED_RATE);
+    CHECK(audio.channels == 1);
+    CHECK(audio.sample_count == EXPECTED_FRAMES);
+    CHECK(audio.data != NULL && checksum(audio.data, audio.sample_count) == EXPECTED_CHECKSUM);
+    audio_free(&audio);
+}
+
+// Small reads straddle MP3 frame boundaries and land on the same samples
+static void test_streamed_reads(void) {
+    audio_decoder_t *decoder;
+    audio_stream_info_t info;
+    CHECK(audio_decoder_open(file, &decoder, &info) == 0);
+    if (decoder == NULL) {
+        return;
+    }
+    CHECK(info.sample_rate == EXPECTED_RATE);
+    CHECK(info.frame_count >= EXPECTED_FRAMES);
+
+    int16_t *samples = malloc(info.frame_count * sizeof(int16_t));
+    size_t total = 0;
+    while (samples != NULL && total < info.frame_count) {
+        size_t want = info.frame_count - total < READ_FRAMES ? info.frame_count - total : READ_FRAMES;
+        size_t got = audio_decoder_read(decoder, samples + total, want);
+        if (got == 0) {
+            break;
+        }
+        total += got;
+    }
+    CHECK(total == EXPECTED_FRAMES);
+    CHECK(samples != NULL && checksum(samples, total) == EXPECTED_CHECKSUM);
+
+    // A seek restarts decoding from the top and skips to the frame
+    int16_t after_seek[READ_FRAMES];
+    size_t frame = EXPECTED_FRAMES / 2 + 7;
+    CHECK(audio_decoder_seek(decoder, frame) == 0);
+    CHECK(audio_decoder_read(decoder, after_seek, READ_FRAMES) == READ_FRAMES);
+    CHECK(samples != NULL && memcmp(after_seek, samples + frame, sizeof(after_seek)) == 0);
+
+    free(samples);
+    audio_decoder_close(decoder);
+}
+
+// A run of MPEG-2 Layer III frame headers (22.05 kHz, 64 kbit/s, mono)
+static void test_mpeg2_refused(void) {
+    char path[] = "/tmp/soundboard_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    uint8_t frame[208] = {0xff, 0xf3, 0x80, 0xc4};  // 72 * 64000 / 22050 bytes
+    bool written = true;
+    for (int i = 0; i < 16; i++) {
+        written = written && write(fd, frame, sizeof(frame)) == (ssize_t)sizeof(frame);
+    }
+    close(fd);
+    CHECK(written);
+
+    char mp3_path[64];
+    snprintf(mp3_path, sizeof(mp3_path), "%s.mp3", path);
+    CHECK(rename(path, mp3_path) == 0);
+    audio_data_t audio;
+    CHECK(audio_load_file(mp3_path, &audio) != 0);
+    unlink(mp3_path);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        file = argv[1];
+    }
+
+    RUN_TEST(test_whole_file);
+    RUN_TEST(test_streamed_reads);
+    RUN_TEST(test_mpeg2_refused);
+    return test_failures == 0 ? 0 : 1;
+}
+
+#else
+
+int main(void) {
+    printf("[TEST] %-40s %s\n", "test_mp3", "skipped (ExtAudioFile decodes MP3)");
+    return 0;
+}
+
+#endif // !__APPLE__
@@ -0,0 +1,185 @@
+// Trigger-to-onset timing through the offline renderer: an event log is
+// rendered with midi_soundboard_render and each note's first non-zero
+// sample must sit exactly on the frame its timestamp maps to, whatever
+// its offset inside the render block. A stop sent to the mixer after a
+// scheduled start must not overtake it.
+//
+//   test_onset [path to midi_soundboard_render]
+
+#include "audio_loader.h"
+#include "mixer.h"
+#include "soundbank.h"
+#include "test_common.h"
+#include "wav_writer.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 44100
+#define DEFAULT_RENDERER "./midi_soundboard_render"
+#define CLICK_FRAMES 64
+#define CLICK_LEVEL 8000
+#define STOP_CALL_FRAMES 4096       // Render calls span several mixer blocks
+
+// Onsets at the start of a render block, inside one, on its last frame,
+// on the next block edge and long after the previous note has ended
+static const size_t onset_frames[] = {
+    0, 500, MIXER_BLOCK_FRAMES - 1, 2 * MIXER_BLOCK_FRAMES, 7777, SAMPLE_RATE + 333
+};
+#define ONSET_COUNT (sizeof(onset_frames) / sizeof(onset_frames[0]))
+
+static const char *renderer = DEFAULT_RENDERER;
+static char dir[64];
+
+static void file_path(char *path, size_t size, const char *name) {
+    snprintf(path, size, "%s/%s", dir, name);
+}
+
+static int write_text(const char *name, const char *text) {
+    char path[128];
+    file_path(path, sizeof(path), name);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    int result = fputs(text, file) < 0 ? -1 : 0;
+    return fclose(file) != 0 ? -1 : result;
+}
+
+// A short oneshot block of DC: non-zero from its very first sample
+static int write_click(void) {
+    char path[128];
+    file_path(path, sizeof(path), "click.wav");
+    int16_t click[CLICK_FRAMES];
+    for (size_t i = 0; i < CLICK_FRAMES; i++) {
+        click[i] = CLICK_LEVEL;
+    }
+    wav_writer_t wav;
+    if (wav_writer_open(&wav, path, SAMPLE_RATE) != 0) {
+        return -1;
+    }
+    int result = wav_writer_write(&wav, click, CLICK_FRAMES);
+    return wav_writer_close(&wav) != 0 ? -1 : result;
+}
+
+// Each note is timed half a frame past its onset frame, so rounding of the
+// decimal timestamp can't move it to a neighbouring frame
+static int write_events(void) {
+    char text[1024];
+    size_t length = snprintf(text, sizeof(text), "# seconds  message\n");
+    for (size_t i = 0; i < ONSET_COUNT; i++) {
+        length += snprintf(text + length, sizeof(text) - length, "%.9f 90 24 7f\n",
+                           ((double)onset_frames[i] + 0.5) / SAMPLE_RATE);
+    }
+    return write_text("events.txt", text);
+}
+
+static int render(void) {
+    char config[128], events[128], out[128], command[1024];
+    file_path(config, sizeof(config), "config.json");
+    file_path(events, sizeof(events), "events.txt");
+    file_path(out, sizeof(out), "out.wav");
+    snprintf(command, sizeof(command), "'%s' '%s' '%s' '%s' > /dev/null", renderer, config, events, out);
+    return system(command) == 0 ? 0 : -1;
+}
+
+static void test_onsets_land_on_their_frames(void) {
+    char out[128];
+    file_path(out, sizeof(out), "out.wav");
+    audio_data_t audio = {0};
+    CHECK(audio_load_file(out, &audio) == 0);
+    if (audio.data == NULL) {
+        return;
+    }
+    CHECK(audio.sample_rate == SAMPLE_RATE);
+
+    // Rising edges out of silence, in order
+    size_t found = 0;
+    for (size_t i = 0; i < audio.sample_count; i++) {
+        bool rising = audio.data[i] != 0 && (i == 0 || audio.data[i - 1] == 0);
+        if (!rising) {
+            continue;
+        }
+        if (found < ONSET_COUNT && i != onset_frames[found]) {
+            fprintf(stderr, "onset %zu at frame %zu, expected %zu\n", found, i, onset_frames[found]);
+        }
+        CHECK(found < ONSET_COUNT && i == onset_frames[found]);
+        found++;
+    }
+    CHECK(found == ONSET_COUNT);
+    audio_free(&audio);
+}
+
+// A looping voice would play forever if its stop ran before its start
+static void test_stop_waits_for_scheduled_start(void) {
+    static int16_t click[CLICK_FRAMES];
+    static int16_t output[2 * STOP_CALL_FRAMES];
+    for (size_t i = 0; i < CLICK_FRAMES; i++) {
+        click[i] = CLICK_LEVEL;
+    }
+    CHECK(mixer_init(SAMPLE_RATE, 8, VOICE_STEAL_OLDEST) == 0);
+    mixer_schedule_frame(3000);
+    voice_handle_t voice = mixer_start_voice(click, CLICK_FRAMES, 0, 1.0f, true, false);
+    CHECK(voice != VOICE_HANDLE_INVALID);
+    mixer_schedule_frame(0);
+    CHECK(mixer_stop_voice(voice) == 0);
+    mixer_render(output, STOP_CALL_FRAMES);
+    mixer_render(output + STOP_CALL_FRAMES, STOP_CALL_FRAMES);
+
+    size_t first = 2 * STOP_CALL_FRAMES;
+    for (size_t i = 0; i < 2 * STOP_CALL_FRAMES && first == 2 * STOP_CALL_FRAMES; i++) {
+        if (output[i] != 0) {
+            first = i;
+        }
+    }
+    CHECK(first == 3000);
+    CHECK(mixer_active_voices() == 0);
+    mixer_cleanup();
+}
+
+static void remove_files(void) {
+    static const char *names[] = {"config.json", "events.txt", "click.wav", "out.wav", SOUNDBANK_CACHE_NAME};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        char path[128];
+        file_path(path, sizeof(path), names[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        renderer = argv[1];
+    }
+    // Back-to-back clicks would merge into one edge
+    for (size_t i = 1; i < ONSET_COUNT; i++) {
+        if (onset_frames[i] < onset_frames[i - 1] + CLICK_FRAMES + 1) {
+            fprintf(stderr, "test_onset: onsets %zu and %zu overlap\n", i - 1, i);
+            return 1;
+        }
+    }
+
+    snprintf(dir, sizeof(dir), "/tmp/soundboard_test_XXXXXX");
+    int result = mkdtemp(dir) == NULL ? -1 : 0;
+    if (result == 0) {
+        result = write_text("config.json",
+                            "{\"sounds\": [{\"filename\": \"click.wav\", \"page\": 0, \"note\": 36, "
+                            "\"mode\": \"oneshot\"}]}\n");
+    }
+    if (result == 0) {
+        result = write_click();
+    }
+    if (result == 0) {
+        result = write_events();
+    }
+    if (result == 0 && render() != 0) {
+        fprintf(stderr, "test_onset: %s failed\n", renderer);
+        result = -1;
+    }
+    if (result == 0) {
+        RUN_TEST(test_onsets_land_on_their_frames);
+    }
+    RUN_TEST(test_stop_waits_for_scheduled_start);
+
+    remove_files();
+    return result == 0 && test_failures == 0 ? 0 : 1;
+}
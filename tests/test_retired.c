@@ -0,0 +1,100 @@
+// Soundbites replaced by a reload: kept while a voice still plays them,
+// freed by soundboard_free_retired() once every such voice has finished.
+// Runs on the offline backend, which renders only when asked to.
+
+#include "midi_soundboard.h"
+#include "platform/platform.h"
+#include "test_common.h"
+#include <stdlib.h>
+
+#define SOUND_FRAMES 4096
+#define PAGE 0
+
+static int16_t output[MIXER_BLOCK_FRAMES];
+
+static int16_t *make_sound(void) {
+    int16_t *data = malloc(SOUND_FRAMES * sizeof(int16_t));
+    for (size_t i = 0; data != NULL && i < SOUND_FRAMES; i++) {
+        data[i] = 1000;
+    }
+    return data;
+}
+
+// Loads a sound onto the pad, replacing whatever it had
+static int adopt(uint8_t note, sound_mode_t mode) {
+    int16_t *data = make_sound();
+    if (data == NULL || soundboard_adopt_soundbite(PAGE, note, data, SOUND_FRAMES, SOUNDBOARD_SAMPLE_RATE,
+                                                   0.0f, mode, 0) != 0) {
+        free(data);
+        return -1;
+    }
+    return 0;
+}
+
+// At least one block, so queued starts and stops are applied first
+static void render_until_silent(void) {
+    int blocks = 0;
+    do {
+        audio_offline_render(output, MIXER_BLOCK_FRAMES);
+    } while (++blocks < 64 && mixer_active_voices() > 0);
+}
+
+// A oneshot replaced mid-note is freed once the note has played out
+static void test_replaced_oneshot_freed_when_done(void) {
+    CHECK(adopt(36, SOUND_MODE_ONESHOT) == 0);
+    CHECK(soundboard_play_note(PAGE, 36, 127, 0) == 0);
+    audio_offline_render(output, 64);
+    CHECK(mixer_active_voices() == 1);
+
+    CHECK(adopt(36, SOUND_MODE_ONESHOT) == 0);
+    CHECK(soundboard_free_retired() == 0);
+    CHECK(mixer_active_voices() == 1);
+
+    render_until_silent();
+    CHECK(mixer_active_voices() == 0);
+    CHECK(soundboard_free_retired() == 1);
+    CHECK(soundboard_free_retired() == 0);
+}
+
+// A start still queued for the mixer counts as playing
+static void test_queued_start_keeps_soundbite(void) {
+    CHECK(adopt(37, SOUND_MODE_ONESHOT) == 0);
+    CHECK(soundboard_play_note(PAGE, 37, 127, 0) == 0);
+    CHECK(adopt(37, SOUND_MODE_ONESHOT) == 0);
+    CHECK(soundboard_free_retired() == 0);
+
+    render_until_silent();
+    CHECK(soundboard_free_retired() == 1);
+}
+
+// A loop keeps its replaced soundbite until it is stopped; replacements
+// that never played are freed straight away
+static void test_replaced_loop_kept_until_stopped(void) {
+    CHECK(adopt(38, SOUND_MODE_LOOP) == 0);
+    CHECK(soundboard_play_note(PAGE, 38, 127, 0) == 0);
+    CHECK(adopt(38, SOUND_MODE_LOOP) == 0);
+    CHECK(adopt(38, SOUND_MODE_LOOP) == 0);
+    for (int i = 0; i < 8; i++) {
+        audio_offline_render(output, MIXER_BLOCK_FRAMES);
+    }
+    CHECK(soundboard_free_retired() == 1);
+    CHECK(mixer_active_voices() == 1);
+
+    CHECK(soundboard_stop_all() == 1);
+    render_until_silent();
+    CHECK(soundboard_free_retired() == 1);
+}
+
+int main(void) {
+    if (soundboard_init(NULL) != 0) {
+        fprintf(stderr, "test_retired: soundboard_init failed\n");
+        return 1;
+    }
+
+    RUN_TEST(test_replaced_oneshot_freed_when_done);
+    RUN_TEST(test_queued_start_keeps_soundbite);
+    RUN_TEST(test_replaced_loop_kept_until_stopped);
+
+    soundboard_cleanup();
+    return test_failures == 0 ? 0 : 1;
+}
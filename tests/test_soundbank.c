@@ -0,0 +1,238 @@
+// Sound bank round trip: what soundbank_write() stores must come back
+// unchanged through soundbank_open(), soundbank_find() and
+// soundbank_config(), PCM and ADPCM alike, and damaged files must be
+// refused rather than mapped.
+
+#include "adpcm.h"
+#include "soundbank.h"
+#include "test_common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 44100
+#define SOUND_COUNT 4
+#define PCM_FRAMES 10000
+#define ADPCM_FRAMES 5000           // Not a whole number of ADPCM blocks
+
+static char dir[64];
+static char path[96];
+static int16_t pcm[PCM_FRAMES];
+static int16_t adpcm_source[ADPCM_FRAMES];
+static uint8_t *adpcm_blocks;
+static char long_name[SOUNDBANK_NAME_MAX + 8];
+
+// Every field soundbank_write() copies from the config has a distinct value
+static sound_config_t sounds[SOUND_COUNT] = {
+    {.filename = "kick.wav", .page = 0, .note = 36, .volume_offset = -0.25f,
+     .color_r = 255, .color_g = 10, .color_b = 20, .mode = SOUND_MODE_ONESHOT, .max_instances = 3,
+     .resample = RESAMPLE_AT_LOAD, .storage = STORAGE_PCM, .velocity_curve = VELOCITY_SOFT},
+    {.filename = "pad.mp3", .page = 7, .note = 100, .volume_offset = 0.5f,
+     .color_r = 1, .color_g = 2, .color_b = 3, .mode = SOUND_MODE_HOLD, .max_instances = 1,
+     .resample = RESAMPLE_REALTIME, .storage = STORAGE_ADPCM, .velocity_curve = VELOCITY_FIXED},
+    {.filename = "missing.wav", .page = 1, .note = 40},  // No data: left out
+    {.filename = long_name, .page = 2, .note = 41},     // Name too long: left out
+};
+
+static soundbank_item_t items[SOUND_COUNT];
+
+static int make_items(void) {
+    for (size_t i = 0; i < PCM_FRAMES; i++) {
+        pcm[i] = (int16_t)(i * 7919u);
+    }
+    for (size_t i = 0; i < ADPCM_FRAMES; i++) {
+        adpcm_source[i] = (int16_t)((int32_t)(i % 200) * 150 - 15000);
+    }
+    memset(long_name, 'x', sizeof(long_name) - 1);
+    if (adpcm_encode(adpcm_source, ADPCM_FRAMES, &adpcm_blocks) != 0) {
+        return -1;
+    }
+
+    items[0] = (soundbank_item_t){
+        .sound = &sounds[0], .samples = pcm, .sample_count = PCM_FRAMES, .sample_rate = SAMPLE_RATE,
+        .source = {.size = 123456, .mtime = 1700000000, .hash = 0x0123456789abcdefull},
+    };
+    items[1] = (soundbank_item_t){
+        .sound = &sounds[1], .adpcm = adpcm_blocks, .sample_count = ADPCM_FRAMES, .sample_rate = 22050,
+        .source = {.size = 42, .mtime = -5, .hash = ~0ull},
+    };
+    items[2] = (soundbank_item_t){.sound = &sounds[2], .sample_count = PCM_FRAMES};
+    items[3] = (soundbank_item_t){.sound = &sounds[3], .samples = pcm, .sample_count = PCM_FRAMES};
+    return 0;
+}
+
+static void test_write_then_open(void) {
+    CHECK(soundbank_write(path, items, SOUND_COUNT, SAMPLE_RATE) == 0);
+    CHECK(access(path, F_OK) == 0);
+
+    soundbank_t bank = {0};
+    CHECK(soundbank_open(path, &bank) == 0);
+    if (bank.header == NULL) {
+        return;
+    }
+    CHECK(bank.header->entry_count == 2);
+    CHECK(bank.header->output_rate == SAMPLE_RATE);
+    CHECK(bank.header->file_size == bank.size);
+    CHECK(bank.size % SOUNDBANK_ALIGN == 0);
+
+    for (size_t i = 0; i < 2; i++) {
+        const soundbank_entry_t *entry = soundbank_find(&bank, &sounds[i]);
+        CHECK(entry != NULL);
+        if (entry == NULL) {
+            continue;
+        }
+        const soundbank_item_t *item = &items[i];
+        CHECK(entry->data_offset % SOUNDBANK_ALIGN == 0);
+        CHECK(entry->sample_count == item->sample_count);
+        CHECK(entry->sample_rate == item->sample_rate);
+        CHECK(memcmp(&entry->source, &item->source, sizeof(entry->source)) == 0);
+        CHECK(entry->volume_offset == item->sound->volume_offset);
+        CHECK(entry->mode == item->sound->mode);
+        CHECK(entry->max_instances == item->sound->max_instances);
+        CHECK(entry->resample == item->sound->resample);
+        CHECK(entry->velocity_curve == item->sound->velocity_curve);
+        CHECK(entry->color_r == item->sound->color_r && entry->color_g == item->sound->color_g &&
+              entry->color_b == item->sound->color_b);
+    }
+
+    const soundbank_entry_t *kick = soundbank_find(&bank, &sounds[0]);
+    const soundbank_entry_t *pad = soundbank_find(&bank, &sounds[1]);
+    if (kick != NULL && pad != NULL) {
+        CHECK(kick->storage == STORAGE_PCM);
+        CHECK(soundbank_entry_bytes(kick) == PCM_FRAMES * sizeof(int16_t));
+        CHECK(memcmp(soundbank_samples(&bank, kick), pcm, PCM_FRAMES * sizeof(int16_t)) == 0);
+        CHECK(pad->storage == STORAGE_ADPCM);
+        CHECK(soundbank_entry_bytes(pad) == adpcm_encoded_size(ADPCM_FRAMES));
+        CHECK(memcmp(soundbank_adpcm(&bank, pad), adpcm_blocks, adpcm_encoded_size(ADPCM_FRAMES)) == 0);
+    }
+
+    // Lookups match file, page and note together
+    sound_config_t moved = sounds[0];
+    moved.note++;
+    CHECK(soundbank_find(&bank, &moved) == NULL);
+    moved = sounds[0];
+    moved.filename = "snare.wav";
+    CHECK(soundbank_find(&bank, &moved) == NULL);
+    CHECK(soundbank_find(&bank, &sounds[2]) == NULL);
+    CHECK(soundbank_find(&bank, &sounds[3]) == NULL);
+
+    soundbank_close(&bank);
+    CHECK(bank.header == NULL);
+}
+
+// A config built from the bank plays the same pads the same way
+static void test_config_from_bank(void) {
+    soundbank_t bank = {0};
+    CHECK(soundbank_open(path, &bank) == 0);
+    if (bank.header == NULL) {
+        return;
+    }
+    config_t config;
+    CHECK(soundbank_config(&bank, &config) == 0);
+    CHECK(config.sound_count == 2);
+    for (size_t i = 0; i < config.sound_count && i < 2; i++) {
+        const sound_config_t *sound = &config.sounds[i];
+        const sound_config_t *want = &sounds[i];
+        CHECK(strcmp(sound->filename, want->filename) == 0);
+        CHECK(sound->page == want->page && sound->note == want->note);
+        CHECK(sound->volume_offset == want->volume_offset);
+        CHECK(sound->color_r == want->color_r && sound->color_g == want->color_g &&
+              sound->color_b == want->color_b);
+        CHECK(sound->mode == want->mode);
+        CHECK(sound->max_instances == want->max_instances);
+        CHECK(sound->resample == want->resample);
+        CHECK(sound->storage == want->storage);
+        CHECK(sound->velocity_curve == want->velocity_curve);
+        CHECK(sound->stream == STREAM_NEVER);
+        CHECK(soundbank_find(&bank, sound) != NULL);
+    }
+    config_free(&config);
+    soundbank_close(&bank);
+}
+
+// The bank is written as a whole, readable from a copy in memory
+static void test_parse_in_memory(void) {
+    FILE *file = fopen(path, "rb");
+    CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    rewind(file);
+    uint8_t *data = malloc(size);
+    CHECK(data != NULL && fread(data, 1, size, file) == size);
+    fclose(file);
+    if (data == NULL) {
+        return;
+    }
+
+    soundbank_t bank;
+    CHECK(soundbank_parse(data, size, &bank) == 0);
+    CHECK(bank.mapping == NULL);
+    CHECK(soundbank_find(&bank, &sounds[0]) != NULL);
+
+    // Truncated
+    CHECK(soundbank_parse(data, size - SOUNDBANK_ALIGN, &bank) != 0);
+    CHECK(soundbank_parse(data, sizeof(soundbank_header_t) - 1, &bank) != 0);
+
+    // Bad magic or version
+    data[0] ^= 0xff;
+    CHECK(soundbank_parse(data, size, &bank) != 0);
+    data[0] ^= 0xff;
+    soundbank_header_t *header = (soundbank_header_t *)data;
+    header->version++;
+    CHECK(soundbank_parse(data, size, &bank) != 0);
+    header->version--;
+
+    // Sample data past the end of the file
+    soundbank_entry_t *entry = (soundbank_entry_t *)(header + 1);
+    uint64_t count = entry->sample_count;
+    entry->sample_count = size;
+    CHECK(soundbank_parse(data, size, &bank) != 0);
+    entry->sample_count = count;
+
+    // Unterminated file name
+    char name[SOUNDBANK_NAME_MAX];
+    memcpy(name, entry->filename, sizeof(name));
+    memset(entry->filename, 'x', sizeof(name));
+    CHECK(soundbank_parse(data, size, &bank) != 0);
+    memcpy(entry->filename, name, sizeof(name));
+    CHECK(soundbank_parse(data, size, &bank) == 0);
+    free(data);
+}
+
+// A file cut short on disk is refused, not mapped
+static void test_open_refuses_truncated_file(void) {
+    soundbank_t bank;
+    FILE *file = fopen(path, "rb");
+    CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    CHECK(truncate(path, size - 1) == 0);
+    CHECK(soundbank_open(path, &bank) != 0);
+    CHECK(soundbank_open("/nonexistent/soundbank.cache", &bank) != 0);
+}
+
+int main(void) {
+    snprintf(dir, sizeof(dir), "/tmp/soundboard_test_XXXXXX");
+    if (mkdtemp(dir) == NULL || make_items() != 0) {
+        fprintf(stderr, "test_soundbank: setup failed\n");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, SOUNDBANK_CACHE_NAME);
+
+    RUN_TEST(test_write_then_open);
+    RUN_TEST(test_config_from_bank);
+    RUN_TEST(test_parse_in_memory);
+    RUN_TEST(test_open_refuses_truncated_file);
+
+    free(adpcm_blocks);
+    unlink(path);
+    rmdir(dir);
+    return test_failures == 0 ? 0 : 1;
+}
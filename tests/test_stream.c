@@ -0,0 +1,214 @@
+// Disk streaming of a large generated WAV: every frame past the head must
+// arrive from the read-ahead ring in order, loops must wrap back to the end
+// of the head, and a streamed voice must play the file sample for sample
+// through the mixer without underruns.
+
+#include "mixer.h"
+#include "sound_stream.h"
+#include "test_common.h"
+#include "wav_writer.h"
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 44100
+#define FILE_SECONDS 90
+#define FILE_FRAMES ((size_t)SAMPLE_RATE * FILE_SECONDS)
+#define MIXER_SECONDS 20
+#define WAIT_NS 100000              // Render thread back-off while the ring is empty
+#define WAIT_LIMIT 100000           // 10 s of waiting for one chunk means the I/O thread is stuck
+
+static char dir[64];
+static char path[96];
+static int16_t output[MIXER_BLOCK_FRAMES];
+
+// A sample that depends on its position, so a dropped, repeated or
+// misplaced chunk can't go unnoticed
+static int16_t expected(size_t frame) {
+    return (int16_t)((int32_t)((uint32_t)(frame * 2654435761u) >> 18) - 8192);
+}
+
+static int write_file(void) {
+    snprintf(dir, sizeof(dir), "/tmp/soundboard_test_XXXXXX");
+    if (mkdtemp(dir) == NULL) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/long.wav", dir);
+
+    wav_writer_t wav;
+    if (wav_writer_open(&wav, path, SAMPLE_RATE) != 0) {
+        return -1;
+    }
+    int16_t block[4096];
+    for (size_t frame = 0; frame < FILE_FRAMES; frame += 4096) {
+        size_t count = FILE_FRAMES - frame < 4096 ? FILE_FRAMES - frame : 4096;
+        for (size_t i = 0; i < count; i++) {
+            block[i] = expected(frame + i);
+        }
+        if (wav_writer_write(&wav, block, count) != 0) {
+            wav_writer_close(&wav);
+            return -1;
+        }
+    }
+    return wav_writer_close(&wav);
+}
+
+static void sleep_ns(long ns) {
+    struct timespec ts = {0, ns};
+    nanosleep(&ts, NULL);
+}
+
+// Acts as the render thread: consumes frames from the ring, waiting for
+// the I/O thread instead of counting underruns, and checks each one
+// against the file. Returns the frames consumed.
+static size_t consume(sound_stream_t *stream, uint32_t epoch, size_t start, size_t frames) {
+    size_t length = sound_stream_length(stream);
+    size_t head = sound_stream_head_length(stream);
+    size_t position = start;
+    size_t done = 0;
+    size_t mismatches = 0;
+    int waits = 0;
+    while (done < frames && waits < WAIT_LIMIT) {
+        size_t available = sound_stream_prime(stream, epoch);
+        if (available == 0) {
+            sleep_ns(WAIT_NS);
+            waits++;
+            continue;
+        }
+        waits = 0;
+        const int16_t *samples;
+        available = sound_stream_peek(stream, epoch, &samples);
+        if (available > frames - done) {
+            available = frames - done;
+        }
+        for (size_t i = 0; i < available; i++) {
+            if (position == length) {
+                position = head; // The next pass of a loop starts after the head
+            }
+            mismatches += samples[i] != expected(position++);
+        }
+        sound_stream_advance(stream, available);
+        done += available;
+    }
+    CHECK(mismatches == 0);
+    return done;
+}
+
+static void test_stream_opens_with_head(void) {
+    sound_stream_t *stream = sound_stream_open(path);
+    CHECK(stream != NULL);
+    if (stream == NULL) {
+        return;
+    }
+    CHECK(sound_stream_length(stream) == FILE_FRAMES);
+    CHECK(sound_stream_sample_rate(stream) == SAMPLE_RATE);
+    CHECK(sound_stream_head_length(stream) == (size_t)SAMPLE_RATE * STREAM_HEAD_MS / 1000);
+
+    size_t mismatches = 0;
+    const int16_t *head = sound_stream_head(stream);
+    for (size_t i = 0; i < sound_stream_head_length(stream); i++) {
+        mismatches += head[i] != expected(i);
+    }
+    CHECK(mismatches == 0);
+    sound_stream_close(stream);
+}
+
+static void test_stream_reads_whole_file(void) {
+    sound_stream_t *stream = sound_stream_open(path);
+    CHECK(stream != NULL);
+    if (stream == NULL) {
+        return;
+    }
+    size_t head = sound_stream_head_length(stream);
+    uint32_t epoch = sound_stream_begin(stream, false);
+    CHECK(consume(stream, epoch, head, FILE_FRAMES - head) == FILE_FRAMES - head);
+
+    // Nothing is queued past the end of a one-shot pass
+    sleep_ns(20000000);
+    CHECK(sound_stream_prime(stream, epoch) == 0);
+    sound_stream_end(stream);
+    sound_stream_close(stream);
+}
+
+static void test_stream_loop_wraps(void) {
+    sound_stream_t *stream = sound_stream_open(path);
+    CHECK(stream != NULL);
+    if (stream == NULL) {
+        return;
+    }
+    // A second pass and a bit, starting from the end of the head
+    size_t head = sound_stream_head_length(stream);
+    size_t frames = 2 * (FILE_FRAMES - head) + SAMPLE_RATE;
+    uint32_t epoch = sound_stream_begin(stream, true);
+    CHECK(consume(stream, epoch, head, frames) == frames);
+    sound_stream_end(stream);
+    sound_stream_close(stream);
+}
+
+// A restart drops whatever the previous voice left in the ring
+static void test_stream_restart_discards_old_chunks(void) {
+    sound_stream_t *stream = sound_stream_open(path);
+    CHECK(stream != NULL);
+    if (stream == NULL) {
+        return;
+    }
+    size_t head = sound_stream_head_length(stream);
+    uint32_t first = sound_stream_begin(stream, false);
+    CHECK(consume(stream, first, head, SAMPLE_RATE) == SAMPLE_RATE);
+    uint32_t second = sound_stream_begin(stream, false);
+    CHECK(consume(stream, second, head, SAMPLE_RATE) == SAMPLE_RATE);
+    sound_stream_end(stream);
+    sound_stream_close(stream);
+}
+
+// Rendered a few times faster than real time, with the render thread
+// yielding between blocks as it does between device callbacks
+static void test_stream_through_mixer(void) {
+    sound_stream_t *stream = sound_stream_open(path);
+    CHECK(stream != NULL);
+    if (stream == NULL) {
+        return;
+    }
+    CHECK(mixer_init(SAMPLE_RATE, 4, VOICE_STEAL_OLDEST) == 0);
+    voice_handle_t voice = mixer_start_stream(stream, 1.0f, false, false);
+    CHECK(voice != VOICE_HANDLE_INVALID);
+
+    size_t mismatches = 0;
+    for (size_t frame = 0; frame < (size_t)SAMPLE_RATE * MIXER_SECONDS; frame += MIXER_BLOCK_FRAMES) {
+        mixer_render(output, MIXER_BLOCK_FRAMES);
+        for (size_t i = 0; i < MIXER_BLOCK_FRAMES; i++) {
+            mismatches += output[i] != expected(frame + i);
+        }
+        sleep_ns(1000000);
+    }
+    CHECK(mismatches == 0);
+    CHECK(sound_stream_underruns(stream) == 0);
+    CHECK(mixer_voice_active(voice));
+
+    // The voice must be gone before its stream is closed
+    CHECK(mixer_stop_voice(voice) == 0);
+    for (int i = 0; i < 4 && mixer_active_voices() > 0; i++) {
+        mixer_render(output, MIXER_BLOCK_FRAMES);
+    }
+    CHECK(mixer_active_voices() == 0);
+    mixer_cleanup();
+    sound_stream_close(stream);
+}
+
+int main(void) {
+    if (write_file() != 0) {
+        fprintf(stderr, "test_stream: can't write %s\n", path);
+        return 1;
+    }
+
+    RUN_TEST(test_stream_opens_with_head);
+    RUN_TEST(test_stream_reads_whole_file);
+    RUN_TEST(test_stream_loop_wraps);
+    RUN_TEST(test_stream_restart_discards_old_chunks);
+    RUN_TEST(test_stream_through_mixer);
+
+    sound_stream_shutdown();
+    unlink(path);
+    rmdir(dir);
+    return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+// Host tool: packs the sounds of a config into a sound bank image for the
+// ESP32 soundbank partition (see soundbank.h and partitions.csv), or lists
+// the contents of an existing bank.
+//
+//   soundbank_pack <config.json> <bank.bin>
+//   soundbank_pack -l <bank.bin>
+//
+// Every sound is decoded, converted to the output rate if configured with
+// "resample": "load", and stored as 16-bit PCM or, with "storage": "adpcm",
+// as IMA-ADPCM at a quarter of the size.
+
+#include "../src/adpcm.h"
+#include "../src/audio_loader.h"
+#include "../src/config.h"
+#include "../src/midi_soundboard.h"
+#include "../src/resampler.h"
+#include "../src/soundbank.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *storage_name(uint8_t storage) {
+    return storage == STORAGE_ADPCM ? "adpcm" : "pcm";
+}
+
+static int list_bank(const char *path) {
+    soundbank_t bank;
+    if (soundbank_open(path, &bank) != 0) {
+        fprintf(stderr, "[PACK] Not a valid sound bank: %s\n", path);
+        return 1;
+    }
+
+    printf("%s: version %u, %u sound(s), output rate %u Hz, %zu KiB\n", path,
+           (unsigned)bank.header->version, (unsigned)bank.header->entry_count,
+           (unsigned)bank.header->output_rate, bank.size / 1024);
+    for (uint32_t i = 0; i < bank.header->entry_count; i++) {
+        const soundbank_entry_t *entry = &bank.entries[i];
+        printf("  page %2u note %3u  %-5s %6u Hz %7.2f s %8zu bytes @ 0x%08llx  %s\n",
+               entry->page, entry->note, storage_name(entry->storage), (unsigned)entry->sample_rate,
+               entry->sample_rate ? (double)entry->sample_count / entry->sample_rate : 0.0,
+               soundbank_entry_bytes(entry), (unsigned long long)entry->data_offset, entry->filename);
+    }
+    soundbank_close(&bank);
+    return 0;
+}
+
+// Decodes one sound the way the loader would; fills item on success
+static int pack_sound(const config_t *config, const sound_config_t *sound, soundbank_item_t *item) {
+    char filepath[1024];
+    snprintf(filepath, sizeof(filepath), "%s%s", config->base_path, sound->filename);
+
+    audio_data_t audio = {0};
+    if (audio_load_file(filepath, &audio) != 0) {
+        fprintf(stderr, "[PACK] Failed to load: %s\n", filepath);
+        return -1;
+    }
+
+    if (sound->resample == RESAMPLE_AT_LOAD && audio.sample_rate != SOUNDBOARD_SAMPLE_RATE) {
+        int16_t *converted = NULL;
+        size_t converted_count = 0;
+        if (resample_sinc(audio.data, audio.sample_count, audio.sample_rate, SOUNDBOARD_SAMPLE_RATE,
+                          &converted, &converted_count) != 0) {
+            fprintf(stderr, "[PACK] Failed to resample: %s\n", filepath);
+            audio_free(&audio);
+            return -1;
+        }
+        audio_free(&audio);
+        audio.data = converted;
+        audio.sample_count = converted_count;
+        audio.sample_rate = SOUNDBOARD_SAMPLE_RATE;
+    }
+
+    *item = (soundbank_item_t){
+        .sound = sound,
+        .samples = audio.data,
+        .sample_count = audio.sample_count,
+        .sample_rate = audio.sample_rate,
+    };
+    soundbank_source_stat(filepath, &item->source, true);
+
+    if (sound->storage == STORAGE_ADPCM) {
+        uint8_t *blocks;
+        if (adpcm_encode(audio.data, audio.sample_count, &blocks) != 0) {
+            fprintf(stderr, "[PACK] Failed to encode: %s\n", filepath);
+            audio_free(&audio);
+            return -1;
+        }
+        item->adpcm = blocks;
+    }
+
+    printf("[PACK] page=%u note=%u %s: %.2f s, %s\n", sound->page, sound->note, sound->filename,
+           (double)audio.sample_count / audio.sample_rate, storage_name(sound->storage));
+    return 0;
+}
+
+static int pack_bank(const char *config_path, const char *bank_path) {
+    config_t config;
+    if (config_load(config_path, &config) != 0) {
+        return 1;
+    }
+
+    soundbank_item_t *items = calloc(config.sound_count ? config.sound_count : 1, sizeof(*items));
+    if (items == NULL) {
+        config_free(&config);
+        return 1;
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < config.sound_count; i++) {
+        if (pack_sound(&config, &config.sounds[i], &items[i]) != 0) {
+            failed++;
+        }
+    }
+
+    int result = 0;
+    if (failed > 0) {
+        fprintf(stderr, "[PACK] %zu sound(s) could not be packed\n", failed);
+        result = 1;
+    } else if (soundbank_write(bank_path, items, config.sound_count, SOUNDBOARD_SAMPLE_RATE) != 0) {
+        result = 1;
+    }
+
+    for (size_t i = 0; i < config.sound_count; i++) {
+        free((void *)items[i].samples);
+        free((void *)items[i].adpcm);
+    }
+    free(items);
+    config_free(&config);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "-l") == 0) {
+        return list_bank(argv[2]);
+    }
+    if (argc == 3) {
+        return pack_bank(argv[1], argv[2]);
+    }
+    fprintf(stderr, "Usage: %s <config.json> <bank.bin>\n"
+                    "       %s -l <bank.bin>\n", argv[0], argv[0]);
+    return 2;
+}